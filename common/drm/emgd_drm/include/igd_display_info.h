@@ -160,6 +160,13 @@ typedef struct _igd_display_info _pd_timing;
 
 typedef pd_timing_t igd_timing_info_t, *pigd_timing_info_t;
 
+/* A timing table sorted for exact mode matching, see timing_index.c */
+typedef struct _igd_timing_index {
+	igd_timing_info_t **entry;
+	unsigned long size;
+	igd_timing_info_t *table; /* table indexed, NULL=stale */
+} igd_timing_index_t;
+
 /*!
  * @name timing table end of list marker
  *
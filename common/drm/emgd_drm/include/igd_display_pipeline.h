@@ -514,6 +514,12 @@ typedef struct _igd_display_port {
 	unsigned short        s3d_format;
 	unsigned long		  bits_per_color;
 
+	/* timing_table sorted for exact mode matching */
+	igd_timing_index_t    timing_index;
+
+	/* Last successfully parsed EDID, see get_firmware_timings() */
+	struct _pi_edid_cache *edid_cache;
+
 }igd_display_port_t, *pigd_display_port_t;
 
 
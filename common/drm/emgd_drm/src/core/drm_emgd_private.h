@@ -36,6 +36,7 @@
 #include <drm/drm_crtc_helper.h>
 #include <igd_core_structs.h>
 #include <linux/io-mapping.h>
+#include <linux/hrtimer.h>
 #include <drm/intel-gtt.h>
 
 #ifdef KERNEL_HAS_ATOMIC_PAGE_FLIP
@@ -1200,6 +1201,19 @@ typedef struct drm_i915_private {
 		
 		int req_prty_cnts[MAX_SCHED_PRIORITIES+1];
 		struct drm_i915_file_private * req_prty_fp[MAX_SCHED_PRIORITIES+1];
+
+		/* Clients stalled in i915_schedule(), one queue per priority.
+		 * wake_seq is bumped on every i915_schedule_wake(). */
+		wait_queue_head_t wait[MAX_SCHED_PRIORITIES+1];
+		atomic_t wake_seq;
+
+		/* Fires when the bucket of a priority whose clients wait
+		 * for budget is due to be refilled. */
+		struct i915_sched_refresh {
+			struct hrtimer timer;
+			struct drm_i915_private *dev_priv;
+			int priority;
+		} refresh[MAX_SCHED_PRIORITIES+1];
 		
 		/* Sysfs objects that are used during driver life */
 		struct emgd_obj *gemsched_sysfs_obj;
@@ -1730,6 +1744,9 @@ int i915_gem_execbuffer(struct drm_device *dev, void *data,
 			struct drm_file *file_priv);
 int i915_gem_execbuffer2(struct drm_device *dev, void *data,
 			 struct drm_file *file_priv);
+void i915_schedule_wake(struct drm_device *dev, int priority);
+void i915_schedule_init_refresh(struct drm_device *dev);
+void i915_schedule_cancel_refresh(struct drm_device *dev);
 int i915_gem_pin_ioctl(struct drm_device *dev, void *data,
 		       struct drm_file *file_priv);
 int i915_gem_unpin_ioctl(struct drm_device *dev, void *data,
@@ -1711,6 +1711,9 @@ int emgd_driver_unload(struct drm_device *dev)
 	/* Cancel the retire work handler, which should be idle now. */
 	cancel_delayed_work_sync(&dev_priv->mm.retire_work);
 
+	/* and the scheduler's refresh timers, armed from i915_schedule() */
+	i915_schedule_cancel_refresh(dev);
+
 	/* Free the GTT mapping */
 	io_mapping_free(dev_priv->gtt.mappable);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3, 10, 0)
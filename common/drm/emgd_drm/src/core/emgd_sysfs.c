@@ -1805,6 +1805,8 @@ static ssize_t emgd_gemsched_process_store(emgd_obj_t *emgd, emgd_attribute_t *a
 				dev_priv->scheduler.req_prty_cnts[new_value] += dev_priv->scheduler.req_prty_cnts[old];
 				dev_priv->scheduler.req_prty_cnts[old] = 0;
 				temp->mm.sched_priority = new_value;
+				/* waiters are queued by their old priority */
+				i915_schedule_wake(dev_priv->dev, 0);
 				EMGD_DEBUG("New priority for pid %d = %d\n", 
 					PID_T_FROM_DRM_FILE(temp->drm_file), new_value);
 			}
@@ -1806,6 +1806,7 @@ set_client_sched_parm(struct drm_device *dev, pid_t pid, uint32_t change_mask,
 					dev_priv->scheduler.req_prty_cnts[new_value] += dev_priv->scheduler.req_prty_cnts[old];
 					dev_priv->scheduler.req_prty_cnts[old] = 0;
 					temp->mm.sched_priority = new_value;
+					i915_schedule_wake(dev, 0);
 					EMGD_DEBUG("New priority for pid "
 						 "%d = %d\n", pid, new_value);
 				}
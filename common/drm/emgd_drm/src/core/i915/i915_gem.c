@@ -35,6 +35,7 @@
 #include "drm_emgd_private.h"
 #include "i915_trace.h"
 #include "intel_drv.h"
+#include "i915_gem_sched.h"
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
@@ -2321,6 +2322,8 @@ int __i915_add_request(struct intel_ring_buffer *ring,
 		}
 		spin_unlock(&dev_priv->scheduler.sched_lock);
 		spin_unlock(&file_priv->mm.lock);
+		if (gem_scheduler)
+			i915_schedule_wake(dev_priv->dev, file_priv->mm.sched_priority);
 	}
 
 	trace_i915_gem_request_add(ring, request->seqno);
@@ -2352,6 +2355,7 @@ i915_gem_request_remove_from_client(struct drm_i915_private * dev_priv,
 				    struct drm_i915_gem_request *request)
 {
 	struct drm_i915_file_private *file_priv = request->file_priv;
+	bool wake = false;
 	int i;
 
 	if (!file_priv)
@@ -2461,20 +2465,16 @@ i915_gem_request_remove_from_client(struct drm_i915_private * dev_priv,
 			 * AE budgeting for the shared and prioritized processes.
 			 */
 				if (SHARED_NORMAL_PRIORITY == file_priv->mm.sched_priority) {
-					if (dev_priv->scheduler.shared_balance
-						< usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]))
-						dev_priv->scheduler.shared_balance = 0;
-					else
-						dev_priv->scheduler.shared_balance
-							-= usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]);
+					i915_sched_charge(&dev_priv->scheduler.shared_balance,
+						usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]));
+					if (!dev_priv->scheduler.shared_balance)
+						wake = true;
 				}
 				else if (SHARED_NORMAL_PRIORITY > file_priv->mm.sched_priority) {
-					if (file_priv->mm.sched_balance
-						< usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]))
-						file_priv->mm.sched_balance = 0;
-					else
-						file_priv->mm.sched_balance
-							 -= usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]);
+					i915_sched_charge(&file_priv->mm.sched_balance,
+						usecs_to_jiffies(file_priv->mm.exec_times[file_priv->mm.last_exec_slot]));
+					if (!file_priv->mm.sched_balance)
+						wake = true;
 				}
 			}
 			/* Take notice that we DONT do the balance budget reduction for
@@ -2490,6 +2490,10 @@ i915_gem_request_remove_from_client(struct drm_i915_private * dev_priv,
 		request->file_priv = NULL;
 	}
 	spin_unlock(&file_priv->mm.lock);
+
+	/* An exhausted budget lets lower priorities through */
+	if (wake)
+		i915_schedule_wake(dev_priv->dev, file_priv->mm.sched_priority);
 }
 
 static bool i915_head_inside_object(u32 acthd, struct drm_i915_gem_object *obj,
@@ -5035,8 +5039,12 @@ i915_gem_load(struct drm_device *dev)
 	dev_priv->scheduler.rogue_trigger  = INITIAL_ROGUE_TRIGGER;
 	dev_priv->scheduler.rogue_balance  = usecs_to_jiffies(INITIAL_ROGUE_CAPACITY);
 	dev_priv->scheduler.rogue_last_refresh_jiffs = jiffies;
-	for (i = 0; i < MAX_SCHED_PRIORITIES+1; i++)
+	for (i = 0; i < MAX_SCHED_PRIORITIES+1; i++) {
 		dev_priv->scheduler.req_prty_cnts[i] = 0;
+		init_waitqueue_head(&dev_priv->scheduler.wait[i]);
+	}
+	atomic_set(&dev_priv->scheduler.wake_seq, 0);
+	i915_schedule_init_refresh(dev);
 
 }
 
@@ -5262,6 +5270,7 @@ void i915_gem_release(struct drm_device *dev, struct drm_file *file)
 	file_priv->mm.outstanding_requests = -1;
 		/* hint to any thread of this app stuck in "execbuffers gem_schedule()" to bail.*/
 	spin_unlock(&file_priv->mm.lock);
+	i915_schedule_wake(dev, file_priv->mm.sched_priority);
 
 	/* Remove this client from main driver context list of gem clients */
 	mutex_lock(&dev->struct_mutex);
@@ -35,6 +35,7 @@
 #include "drm_emgd_private.h"
 #include "i915_trace.h"
 #include "intel_drv.h"
+#include "i915_gem_sched.h"
 #include <linux/dma_remapping.h>
 
 struct eb_vmas {
@@ -971,16 +972,180 @@ enum {
 };
 int sampled_debugs = 0;
 
+/* Upper bound on a priority stall. Stalls normally end on a wakeup from
+ * request submission or retirement; this only covers a higher priority
+ * client that neither submits nor runs out of budget.
+ */
+#define I915_SCHED_STALL_TIMEOUT	1000 /* usecs */
+
+/**
+ * i915_schedule_wake - wake clients stalled behind @priority
+ *
+ * Called whenever the pending count or the balance of @priority goes
+ * down, which is what may let lower priorities (numerically higher)
+ * proceed. Waiters at @priority itself are also woken, so that a client
+ * whose file is being closed notices it.
+ */
+void i915_schedule_wake(struct drm_device *dev, int priority)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	int i;
+
+	/* Pairs with the wake_seq check in i915_schedule_wait(); the
+	 * atomic_inc_return() also orders the increment before the
+	 * waitqueue_active() checks below.
+	 */
+	atomic_inc_return(&dev_priv->scheduler.wake_seq);
+
+	for (i = priority; i <= MAX_SCHED_PRIORITIES; i++) {
+		if (waitqueue_active(&dev_priv->scheduler.wait[i]))
+			wake_up_all(&dev_priv->scheduler.wait[i]);
+	}
+}
+
+/*
+ * Fires at the refresh deadline of an exhausted bucket and wakes the
+ * clients of its priority, which refill it on their next pass through
+ * i915_schedule(). Runs in hardirq context, so it does not touch
+ * sched_lock.
+ */
+static enum hrtimer_restart
+i915_schedule_refresh_timer(struct hrtimer *timer)
+{
+	struct i915_sched_refresh *refresh =
+		container_of(timer, struct i915_sched_refresh, timer);
+	drm_i915_private_t *dev_priv = refresh->dev_priv;
+
+	atomic_inc_return(&dev_priv->scheduler.wake_seq);
+	if (waitqueue_active(&dev_priv->scheduler.wait[refresh->priority]))
+		wake_up_all(&dev_priv->scheduler.wait[refresh->priority]);
+
+	return HRTIMER_NORESTART;
+}
+
+void i915_schedule_init_refresh(struct drm_device *dev)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	struct i915_sched_refresh *refresh;
+	int i;
+
+	for (i = 0; i < MAX_SCHED_PRIORITIES+1; i++) {
+		refresh = &dev_priv->scheduler.refresh[i];
+		hrtimer_init(&refresh->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		refresh->timer.function = i915_schedule_refresh_timer;
+		refresh->dev_priv = dev_priv;
+		refresh->priority = i;
+	}
+}
+
+void i915_schedule_cancel_refresh(struct drm_device *dev)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	int i;
+
+	for (i = 0; i < MAX_SCHED_PRIORITIES+1; i++)
+		hrtimer_cancel(&dev_priv->scheduler.refresh[i].timer);
+}
+
+/*
+ * Arm the refresh timer of @priority @timeout_us from now, unless it is
+ * already due to fire sooner for another client of the same priority;
+ * that one wakes us early and we come back here. Called with sched_lock
+ * held, which serialises the check against other callers.
+ */
+static void
+i915_schedule_arm_refresh(drm_i915_private_t *dev_priv, int priority,
+			  unsigned long timeout_us)
+{
+	struct hrtimer *timer = &dev_priv->scheduler.refresh[priority].timer;
+	ktime_t expires = ktime_add_us(ktime_get(), timeout_us);
+
+	if (hrtimer_active(timer) &&
+	    ktime_to_ns(hrtimer_get_expires(timer)) <= ktime_to_ns(expires))
+		return;
+
+	hrtimer_start(timer, expires, HRTIMER_MODE_ABS);
+}
+
+/*
+ * Drop struct_mutex and sleep on the queue for @priority until
+ * i915_schedule_wake() is called for a higher priority or the refresh
+ * timer of @priority fires. A nonzero @timeout_us also bounds the sleep
+ * with an hrtimer of its own. @seq is the wake_seq sampled while the
+ * scheduler state that made us wait was still locked, so a wakeup
+ * in between is not lost.
+ *
+ * Returns 0 with struct_mutex reacquired, or a negative error code
+ * (and struct_mutex not held) if interrupted while relocking.
+ */
+static int
+i915_schedule_wait(struct drm_device *dev, int priority,
+		   unsigned int seq, unsigned long timeout_us)
+{
+	drm_i915_private_t *dev_priv = dev->dev_private;
+	wait_queue_head_t *wq = &dev_priv->scheduler.wait[priority];
+	ktime_t timeout = ns_to_ktime((u64)timeout_us * NSEC_PER_USEC);
+	DEFINE_WAIT(wait);
+
+	mutex_unlock(&dev->struct_mutex);
+
+	prepare_to_wait(wq, &wait, TASK_INTERRUPTIBLE);
+	if (atomic_read(&dev_priv->scheduler.wake_seq) == seq &&
+	    !signal_pending(current))
+		schedule_hrtimeout(timeout_us ? &timeout : NULL,
+				   HRTIMER_MODE_REL);
+	finish_wait(wq, &wait);
+
+	return i915_mutex_lock_interruptible(dev);
+}
+
+/* Bucket state consulted by i915_sched_blocker() for a higher priority */
+struct i915_schedule_budget {
+	drm_i915_private_t *dev_priv;
+	unsigned long now;
+};
+
+static int
+i915_schedule_has_budget(void *data, int priority)
+{
+	struct i915_schedule_budget *budget = data;
+	drm_i915_private_t *dev_priv = budget->dev_priv;
+	struct drm_i915_file_private *fp;
+
+	if (priority == SHARED_NORMAL_PRIORITY)
+		return i915_sched_has_budget(dev_priv->scheduler.shared_balance,
+				dev_priv->scheduler.shared_last_refresh_jiffs,
+				budget->now,
+				usecs_to_jiffies(dev_priv->scheduler.shared_period),
+				usecs_to_jiffies(dev_priv->scheduler.shared_capacity));
+
+	fp = dev_priv->scheduler.req_prty_fp[priority];
+	if (!fp)
+		return 0;
+
+	return i915_sched_has_budget(fp->mm.sched_balance,
+				     fp->mm.sched_last_refresh_jiffs,
+				     budget->now,
+				     usecs_to_jiffies(fp->mm.sched_period),
+				     usecs_to_jiffies(fp->mm.sched_capacity));
+}
+
 static int
 i915_schedule(struct drm_device *dev, struct intel_ring_buffer *ring, struct drm_file *file)
 {
 	drm_i915_private_t *dev_priv = dev->dev_private;
 	struct drm_i915_file_private *file_priv = file->driver_priv;
-	int higher_priority_requestors=0;
-	unsigned long diff_jiffs, new_jiffs = 0;
-	int i = 0;
+	unsigned long new_jiffs = 0;
+	unsigned long *balance, *last_refresh;
+	int period, capacity;
+	unsigned long timeout;
+	unsigned int seq;
+	struct i915_schedule_budget budget;
+	int blocker;
+	int priority;
 	struct drm_i915_file_private *temp;
 	int again;
+	int ret;
 
 	/* Bail if GPU scheduler is not enabled */
 	if (!gem_scheduler) {
@@ -1059,39 +1224,24 @@ i915_schedule(struct drm_device *dev, struct intel_ring_buffer *ring, struct drm
 	/* check for other clients with pending higher priority requests */
 	if (file_priv->mm.sched_priority) {
 		/* make sure this client isnt priority-0 - i.e. highest */
-		for ( i=(file_priv->mm.sched_priority-1); i>=0 ; i-- ) {
-            if (dev_priv->scheduler.req_prty_cnts[i]) {
-				if(i == SHARED_NORMAL_PRIORITY &&
-						dev_priv->scheduler.shared_balance) {
-					higher_priority_requestors += dev_priv->scheduler.req_prty_cnts[i];
-					break;
-				} else if(dev_priv->scheduler.req_prty_fp[i] &&
-						dev_priv->scheduler.req_prty_fp[i]->mm.sched_balance)  {
-					higher_priority_requestors += dev_priv->scheduler.req_prty_cnts[i];
-					break;
-				}
-            }
-
-			if ((sampled_debugs%1000)==0){
-				EMGD_DEBUG("Check higher priorities, i = %d, count = %d",
-					 i, dev_priv->scheduler.req_prty_cnts[i]);
-			}
-
-		}
-		if (higher_priority_requestors) {
+		budget.dev_priv = dev_priv;
+		budget.now = jiffies;
+		blocker = i915_sched_blocker(dev_priv->scheduler.req_prty_cnts,
+					     file_priv->mm.sched_priority,
+					     i915_schedule_has_budget, &budget);
+		if (blocker >= 0) {
+			priority = file_priv->mm.sched_priority;
+			seq = atomic_read(&dev_priv->scheduler.wake_seq);
 			spin_unlock(&dev_priv->scheduler.sched_lock);
 			spin_unlock(&file_priv->mm.lock);
 			if((sampled_debugs%1000)==0)
-				EMGD_DEBUG("Stall");
-			/* this is gonna spin mad - we need to wait on some 
-			 * FIXME - replace temp hack usleep with interrupt on next seqno */
-			mutex_unlock(&dev->struct_mutex);
-			udelay(20);
-			i=0;
-			while(i915_mutex_lock_interruptible(dev) && (++i<1000000));
-			if (i==1000000) {
-				EMGD_DEBUG("LockFail1");
-			}
+				EMGD_DEBUG("Stall behind priority %d", blocker);
+			/* Sleep until the higher priority work is submitted
+			 * or its budget runs out. */
+			ret = i915_schedule_wait(dev, priority, seq,
+						 I915_SCHED_STALL_TIMEOUT);
+			if (ret)
+				return ret;
 			return GEM_CMD_RESCHED;
 		}
 	} else {
@@ -1102,186 +1252,70 @@ i915_schedule(struct drm_device *dev, struct intel_ring_buffer *ring, struct drm
 	}
 
 	new_jiffs = jiffies;
+	priority = file_priv->mm.sched_priority;
 
 	/* Step 3 - lets ensure we refresh the capacity if its time */
-	if (file_priv->mm.sched_priority == SHARED_NORMAL_PRIORITY) {
-
-		if (time_is_after_jiffies(dev_priv->scheduler.shared_last_refresh_jiffs))
-			diff_jiffs = dev_priv->scheduler.shared_last_refresh_jiffs - new_jiffs;
-				 /* wrap around of jiffies bits? */
-		else
-			diff_jiffs = new_jiffs - dev_priv->scheduler.shared_last_refresh_jiffs;
+	if (priority == SHARED_NORMAL_PRIORITY) {
 		/* this means we're in the common-grouped priority - shared bucket */
-		if ( time_after_eq( new_jiffs, 
-			(dev_priv->scheduler.shared_last_refresh_jiffs + 
-			 usecs_to_jiffies(dev_priv->scheduler.shared_period)))) {
-			if (dev_priv->scheduler.shared_balance < usecs_to_jiffies(dev_priv->scheduler.shared_capacity)) {
-				EMGD_DEBUG("FreshSh");
-				dev_priv->scheduler.shared_balance = usecs_to_jiffies(dev_priv->scheduler.shared_capacity);
-			}
-			dev_priv->scheduler.shared_last_refresh_jiffs = new_jiffs;
-		}
-	}
-	else if (file_priv->mm.sched_priority == SHARED_ROGUE_PRIORITY) {
-		if (time_is_after_jiffies(dev_priv->scheduler.rogue_last_refresh_jiffs))
-			diff_jiffs = dev_priv->scheduler.rogue_last_refresh_jiffs - new_jiffs;
-		else
-			diff_jiffs = new_jiffs - dev_priv->scheduler.rogue_last_refresh_jiffs;
+		balance = &dev_priv->scheduler.shared_balance;
+		last_refresh = &dev_priv->scheduler.shared_last_refresh_jiffs;
+		period = dev_priv->scheduler.shared_period;
+		capacity = dev_priv->scheduler.shared_capacity;
+	} else if (priority == SHARED_ROGUE_PRIORITY) {
 		/* this means we're in the common-grouped priority - rogue bucket */
-		if ( time_after_eq( new_jiffs, 
-			(dev_priv->scheduler.rogue_last_refresh_jiffs + 
-			 usecs_to_jiffies(dev_priv->scheduler.rogue_period)))) {
-			if (dev_priv->scheduler.rogue_balance < usecs_to_jiffies(dev_priv->scheduler.rogue_capacity)) {
-				EMGD_DEBUG("FreshRg");
-				dev_priv->scheduler.rogue_balance = usecs_to_jiffies(dev_priv->scheduler.rogue_capacity);
-			}
-			dev_priv->scheduler.rogue_last_refresh_jiffs = new_jiffs;
-		}
-	}
-	else {
+		balance = &dev_priv->scheduler.rogue_balance;
+		last_refresh = &dev_priv->scheduler.rogue_last_refresh_jiffs;
+		period = dev_priv->scheduler.rogue_period;
+		capacity = dev_priv->scheduler.rogue_capacity;
+	} else {
 		/* this process has its own special priority */
-		if (time_is_after_jiffies(file_priv->mm.sched_last_refresh_jiffs))
-			diff_jiffs = file_priv->mm.sched_last_refresh_jiffs - new_jiffs;
-				 /* wrap around of jiffies bits? */
-		else
-			diff_jiffs = new_jiffs - file_priv->mm.sched_last_refresh_jiffs;
-
-		if (time_after_eq(new_jiffs,
-			(file_priv->mm.sched_last_refresh_jiffs + 
-			 usecs_to_jiffies(file_priv->mm.sched_period)))) {
-			if (file_priv->mm.sched_balance < usecs_to_jiffies(file_priv->mm.sched_capacity)) {
-				EMGD_DEBUG("FreshPv");
-				file_priv->mm.sched_balance = usecs_to_jiffies(file_priv->mm.sched_capacity);
-			}
-			file_priv->mm.sched_last_refresh_jiffs = new_jiffs;
-		}
+		balance = &file_priv->mm.sched_balance;
+		last_refresh = &file_priv->mm.sched_last_refresh_jiffs;
+		period = file_priv->mm.sched_period;
+		capacity = file_priv->mm.sched_capacity;
 	}
 
-	/* Step 4 - Ensure we have enough balance budget to continue */
-	if (file_priv->mm.sched_priority == SHARED_NORMAL_PRIORITY) {
-		/* this means we're in the common-grouped priority - shared bucket */
-		if (dev_priv->scheduler.shared_balance > 0) {
-
-			/* Lets see if we're using AE Policy for reservation:
-			 * AE means we deduct the balance before returning from scheduler.
-			 * During retirement, DONT double deduct from balance for AE.
- 			 * NOTE: For rogue, we always only do this.
-			 */
-			if(dev_priv->scheduler.shared_aereserve) {
-				if (dev_priv->scheduler.shared_balance < usecs_to_jiffies(file_priv->mm.sched_avgexectime))
-					dev_priv->scheduler.shared_balance = 0;
-				else
-					dev_priv->scheduler.shared_balance -= usecs_to_jiffies(file_priv->mm.sched_avgexectime);
-			}
-
-			spin_unlock(&dev_priv->scheduler.sched_lock);
-			spin_unlock(&file_priv->mm.lock);
-			return GEM_CMD_DONE;
-		} else {
-			/* oh well, we dont have budget - lets just sleep the minimal time */
-			if (jiffies_to_usecs(diff_jiffs) < dev_priv->scheduler.shared_period) {
-				spin_unlock(&dev_priv->scheduler.sched_lock);
-				spin_unlock(&file_priv->mm.lock);
-				EMGD_DEBUG("NoBdgtSh");
-				mutex_unlock(&dev->struct_mutex);
-				udelay(100);
-				i=0;
-				while(i915_mutex_lock_interruptible(dev) && (++i<1000000));
-				if (i==1000000) {
-					EMGD_DEBUG("LockFail2");
-				}
-				spin_lock(&file_priv->mm.lock);
-				spin_lock(&dev_priv->scheduler.sched_lock);
-			} else {
-				DRM_ERROR("Invalid state, no balance, but we overshot shared period!?\n");
-			}
-		}
-	} 
-	else if (file_priv->mm.sched_priority == SHARED_ROGUE_PRIORITY) {
-		/* this means we're in the common-grouped priority - rogue bucket */
-		if (dev_priv->scheduler.rogue_balance > 0) {
-			/* Rogue AE Policy: Deduct the balance before returning from scheduler*/
-			if (dev_priv->scheduler.rogue_balance < usecs_to_jiffies(file_priv->mm.sched_avgexectime))
-				dev_priv->scheduler.rogue_balance = 0;
-			else
-				dev_priv->scheduler.rogue_balance -= usecs_to_jiffies(file_priv->mm.sched_avgexectime);
-
-			spin_unlock(&dev_priv->scheduler.sched_lock);
-			spin_unlock(&file_priv->mm.lock);
-			return GEM_CMD_DONE;
-		} else {
-			/* oh well, we dont have budget - lets just sleep the minimal time */
-			if (jiffies_to_usecs(diff_jiffs) < dev_priv->scheduler.rogue_period) {
-				spin_unlock(&dev_priv->scheduler.sched_lock);
-				spin_unlock(&file_priv->mm.lock);
-				//udelay(dev_priv->scheduler.rogue_period - jiffies_to_usecs(diff_jiffs));
-				EMGD_DEBUG("NoBdgtRg");
-				mutex_unlock(&dev->struct_mutex);
-				udelay(100);
-				i=0;
-				while(i915_mutex_lock_interruptible(dev) && (++i<1000000));
-				if (i==1000000) {
-					EMGD_DEBUG("LockFail2");
-				}
-				spin_lock(&file_priv->mm.lock);
-				spin_lock(&dev_priv->scheduler.sched_lock);
-			} else {
-				DRM_ERROR("Invalid state, no balance, but we overshot shared period!?\n");
-			}
-		}
-	}
-	else {
-		/* this process has its own special priority */
-		if  (file_priv->mm.sched_balance > 0) {
-			/* Lets see if we're using AE Policy for reservation:
-			 * AE means we deduct the balance before returning from scheduler.
-			 * During retirement, DONT double deduct from balance for AE.
-			 * NOTE: For rogue, we always only do this.
-			 */
-			if(dev_priv->scheduler.shared_aereserve) {
-				if (file_priv->mm.sched_balance < usecs_to_jiffies(file_priv->mm.sched_avgexectime))
-					file_priv->mm.sched_balance = 0;
-				else
-					file_priv->mm.sched_balance -= usecs_to_jiffies(file_priv->mm.sched_avgexectime);
-			}
-			spin_unlock(&dev_priv->scheduler.sched_lock);
-			spin_unlock(&file_priv->mm.lock);
-			return GEM_CMD_DONE;
-		} else {
-			/* oh well, we dont have budget - lets just sleep the minimal time */
-			if (jiffies_to_usecs(diff_jiffs) < file_priv->mm.sched_period) {
-				spin_unlock(&dev_priv->scheduler.sched_lock);
-				spin_unlock(&file_priv->mm.lock);
-
-				EMGD_DEBUG("NoBdgtPv");
-				mutex_unlock(&dev->struct_mutex);
-				udelay(100);
-				i=0;
-				while(i915_mutex_lock_interruptible(dev) && (++i<1000000));
-				if (i==1000000) {
-					EMGD_DEBUG("LockFail3");
-				}
-				spin_lock(&file_priv->mm.lock);
-				spin_lock(&dev_priv->scheduler.sched_lock);
-			} else {
-				DRM_ERROR("Invalid state, no balance, but we just overshot private period!?\n");
-			}
-		}
-	}
+	if (i915_sched_refresh(balance, last_refresh, new_jiffs,
+			       usecs_to_jiffies(period),
+			       usecs_to_jiffies(capacity)))
+		EMGD_DEBUG("Fresh %d", priority);
 
+	/* Step 4 - Ensure we have enough balance budget to continue */
+	if (*balance > 0) {
+		/* Lets see if we're using AE Policy for reservation:
+		 * AE means we deduct the balance before returning from scheduler.
+		 * During retirement, DONT double deduct from balance for AE.
+		 * NOTE: For rogue, we always only do this.
+		 */
+		if (priority == SHARED_ROGUE_PRIORITY ||
+		    dev_priv->scheduler.shared_aereserve)
+			i915_sched_charge(balance,
+					  usecs_to_jiffies(file_priv->mm.sched_avgexectime));
 
-	/* If we're here, we need to reschedule - we may have gone thru a sleep
-	 * So we should check if our fd was released while spinning again */
-	if (file_priv->mm.outstanding_requests == -1) {
 		spin_unlock(&dev_priv->scheduler.sched_lock);
 		spin_unlock(&file_priv->mm.lock);
-		return GEM_CMD_OUT;
+		return GEM_CMD_DONE;
 	}
 
+	/* oh well, we dont have budget - sleep until the bucket is refilled.
+	 * seq is sampled first, so that the timer firing right away is not
+	 * missed. */
+	timeout = i915_sched_budget_timeout(*last_refresh, new_jiffs,
+				usecs_to_jiffies(period),
+				usecs_to_jiffies(I915_SCHED_STALL_TIMEOUT));
+	seq = atomic_read(&dev_priv->scheduler.wake_seq);
+	i915_schedule_arm_refresh(dev_priv, priority, jiffies_to_usecs(timeout));
 	spin_unlock(&dev_priv->scheduler.sched_lock);
 	spin_unlock(&file_priv->mm.lock);
-	return GEM_CMD_RESCHED;
 
+	EMGD_DEBUG("NoBdgt %d", priority);
+	ret = i915_schedule_wait(dev, priority, seq, 0);
+	if (ret)
+		return ret;
+
+	/* We went thru a sleep, the next pass checks whether our fd was
+	 * released meanwhile. */
+	return GEM_CMD_RESCHED;
 }
 
 
@@ -1474,7 +1508,8 @@ again:
 		gem_sched_queued = 1;
 	}
 
-	switch (i915_schedule(dev, ring, file)) {
+	ret = i915_schedule(dev, ring, file);
+	switch (ret) {
 		case GEM_CMD_RESCHED:
 			goto again;
 			break;
@@ -1488,6 +1523,12 @@ again:
 			break;
 		case GEM_CMD_ERROR:
 		default:
+			/* Interrupted while waiting for our turn, the
+			 * struct_mutex has already been dropped. */
+			if (ret < 0) {
+				eb_destroy(eb);
+				goto pre_mutex_err;
+			}
 			BUG();
 	}
 
@@ -1636,6 +1677,7 @@ pre_mutex_err:
 			dev_priv->scheduler.req_prty_fp[file_priv->mm.sched_priority] = 0;
 		}
 		spin_unlock(&dev_priv->scheduler.sched_lock);
+		i915_schedule_wake(dev, file_priv->mm.sched_priority);
 	}
 	kfree(cliprects);
 	return ret;
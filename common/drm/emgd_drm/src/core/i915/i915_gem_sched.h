@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2014 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Budget accounting for the GEM scheduler.
+ *
+ * Every priority bucket (the shared normal slot, the shared rogue slot and
+ * each privileged client) owns a balance that is refilled to its capacity
+ * once per period and charged with the execution time of the batches run
+ * against it. These helpers only do the arithmetic on plain jiffies values
+ * and carry no kernel dependencies, so the policy can be driven from a
+ * simulated request stream outside of the driver, as tools/sched_test
+ * does.
+ */
+
+#ifndef _I915_GEM_SCHED_H_
+#define _I915_GEM_SCHED_H_
+
+static inline int
+i915_sched_time_after_eq(unsigned long a, unsigned long b)
+{
+	return (long)(a - b) >= 0;
+}
+
+/*
+ * Refill the bucket if its period has elapsed. A bucket is never drained
+ * by a refresh, only topped back up to @capacity. Returns nonzero if the
+ * period rolled over.
+ */
+static inline int
+i915_sched_refresh(unsigned long *balance, unsigned long *last_refresh,
+		   unsigned long now, unsigned long period,
+		   unsigned long capacity)
+{
+	if (!i915_sched_time_after_eq(now, *last_refresh + period))
+		return 0;
+
+	if (*balance < capacity)
+		*balance = capacity;
+	*last_refresh = now;
+	return 1;
+}
+
+/* Charge @cost against the bucket, saturating at zero. */
+static inline void
+i915_sched_charge(unsigned long *balance, unsigned long cost)
+{
+	if (*balance < cost)
+		*balance = 0;
+	else
+		*balance -= cost;
+}
+
+/* Time left until the bucket is next refilled, 0 if already due. */
+static inline unsigned long
+i915_sched_until_refresh(unsigned long last_refresh, unsigned long now,
+			 unsigned long period)
+{
+	unsigned long deadline = last_refresh + period;
+
+	if (i915_sched_time_after_eq(now, deadline))
+		return 0;
+
+	return deadline - now;
+}
+
+/*
+ * How long a client out of budget sleeps: until its bucket is next
+ * refilled, but never less than @min. A bucket that stays empty after a
+ * refresh (no capacity, or a period shorter than a tick) would otherwise
+ * have the caller retry without sleeping at all.
+ */
+static inline unsigned long
+i915_sched_budget_timeout(unsigned long last_refresh, unsigned long now,
+			  unsigned long period, unsigned long min)
+{
+	unsigned long timeout = i915_sched_until_refresh(last_refresh, now,
+							 period);
+
+	return timeout < min ? min : timeout;
+}
+
+/*
+ * Whether a bucket can let a request through at @now, either from its
+ * balance or because its refill is due. A bucket whose refill is due
+ * counts even before the refresh, which only happens when its owner next
+ * runs, so that lower priorities do not slip in ahead of an owner woken
+ * by its refresh timer.
+ */
+static inline int
+i915_sched_has_budget(unsigned long balance, unsigned long last_refresh,
+		      unsigned long now, unsigned long period,
+		      unsigned long capacity)
+{
+	if (balance)
+		return 1;
+
+	return capacity && i915_sched_time_after_eq(now, last_refresh + period);
+}
+
+/*
+ * Find the priority a client at @priority has to stall behind: the
+ * nearest higher one (numerically lower) with requests pending in
+ * @pending and budget left according to @has_budget. Returns -1 if the
+ * client may go ahead.
+ */
+static inline int
+i915_sched_blocker(const int *pending, int priority,
+		   int (*has_budget)(void *data, int priority), void *data)
+{
+	int i;
+
+	for (i = priority - 1; i >= 0; i--) {
+		if (pending[i] && has_budget(data, i))
+			return i;
+	}
+
+	return -1;
+}
+
+#endif /* _I915_GEM_SCHED_H_ */
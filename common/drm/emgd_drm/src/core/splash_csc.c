@@ -0,0 +1,233 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: splash_csc.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Fixed-point RGB to YUV conversion. Coefficients are Q10, applied to the
+ *  sum of a horizontal pixel pair for chroma so that the pair average
+ *  falls out of the same shift. Each output pair is stored as one 32 bit
+ *  write, which matters when the destination is a write-combined mapping.
+ *  NV12 chroma is taken the same way from the sum of a 2x2 block.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "splash_csc.h"
+
+#define CSC_SHIFT 10
+
+typedef struct _splash_csc_matrix {
+	int yr, yg, yb;
+	int ur, ug, ub;
+	int vr, vg, vb;
+} splash_csc_matrix;
+
+/*
+ * Each chroma row sums to zero and each luma row to 219/255 in Q10, so for
+ * 8 bit input every result already lands inside the studio range and no
+ * clamping is needed.
+ */
+static const splash_csc_matrix csc_matrices[] = {
+	/* SPLASH_CSC_BT601 */
+	{  263,  516,  100,
+	  -152, -298,  450,
+	   450, -377,  -73 },
+	/* SPLASH_CSC_BT709 */
+	{  187,  629,   63,
+	  -103, -347,  450,
+	   450, -409,  -41 },
+};
+
+/*
+ * This function converts an XRGB32 surface to packed YUV 4:2:2. An odd
+ * trailing column is dropped, as the pixel pair it would form is
+ * incomplete.
+ *
+ * @param src (IN) The source surface, B G R X byte order.
+ * @param dest (OUT) The destination surface.
+ * @param s_pitch (IN) The stride of the source surface.
+ * @param d_pitch (IN) The stride of the destination surface.
+ * @param width (IN) The width of the surfaces.
+ * @param height (IN) The height of the surfaces.
+ * @param matrix (IN) SPLASH_CSC_BT601 or SPLASH_CSC_BT709.
+ * @param order (IN) SPLASH_CSC_YUY2 or SPLASH_CSC_UYVY.
+ */
+void splash_csc_xrgb_to_yuv422(
+	const unsigned char *src,
+	unsigned char *dest,
+	int s_pitch,
+	int d_pitch,
+	int width,
+	int height,
+	int matrix,
+	int order)
+{
+	const splash_csc_matrix *m;
+	const uint32_t *s;
+	uint32_t *d;
+	uint32_t p0, p1;
+	int r0, g0, b0, r1, g1, b1;
+	int y0, y1, u, v;
+	int row, col;
+
+	if (matrix != SPLASH_CSC_BT709) {
+		matrix = SPLASH_CSC_BT601;
+	}
+	m = &csc_matrices[matrix];
+
+	for (row = 0; row < height; row++) {
+		s = (const uint32_t *)(src + row * s_pitch);
+		d = (uint32_t *)(dest + row * d_pitch);
+
+		for (col = 0; col < width / 2; col++) {
+			p0 = s[2 * col];
+			p1 = s[2 * col + 1];
+
+			r0 = (p0 >> 16) & 0xFF;
+			g0 = (p0 >> 8) & 0xFF;
+			b0 = p0 & 0xFF;
+			r1 = (p1 >> 16) & 0xFF;
+			g1 = (p1 >> 8) & 0xFF;
+			b1 = p1 & 0xFF;
+
+			y0 = (m->yr * r0 + m->yg * g0 + m->yb * b0 +
+				(16 << CSC_SHIFT) + (1 << (CSC_SHIFT - 1))) >> CSC_SHIFT;
+			y1 = (m->yr * r1 + m->yg * g1 + m->yb * b1 +
+				(16 << CSC_SHIFT) + (1 << (CSC_SHIFT - 1))) >> CSC_SHIFT;
+
+			/* Chroma of the pair average, hence the extra bit of shift */
+			r0 += r1;
+			g0 += g1;
+			b0 += b1;
+			u = (m->ur * r0 + m->ug * g0 + m->ub * b0 +
+				(128 << (CSC_SHIFT + 1)) + (1 << CSC_SHIFT)) >>
+				(CSC_SHIFT + 1);
+			v = (m->vr * r0 + m->vg * g0 + m->vb * b0 +
+				(128 << (CSC_SHIFT + 1)) + (1 << CSC_SHIFT)) >>
+				(CSC_SHIFT + 1);
+
+			/* Surfaces are little endian, first byte in the low bits */
+			if (order == SPLASH_CSC_UYVY) {
+				d[col] = u | (y0 << 8) | (v << 16) | ((uint32_t)y1 << 24);
+			} else {
+				d[col] = y0 | (u << 8) | (y1 << 16) | ((uint32_t)v << 24);
+			}
+		}
+	}
+}
+
+static inline int csc_luma(const splash_csc_matrix *m, uint32_t p)
+{
+	return (m->yr * ((p >> 16) & 0xFF) + m->yg * ((p >> 8) & 0xFF) +
+		m->yb * (p & 0xFF) +
+		(16 << CSC_SHIFT) + (1 << (CSC_SHIFT - 1))) >> CSC_SHIFT;
+}
+
+/*
+ * This function converts an XRGB32 surface to NV12: a full size Y plane
+ * followed, wherever the caller places it, by a half size plane of
+ * interleaved Cb/Cr pairs. Each chroma sample is taken from the average of
+ * a 2x2 block. An odd trailing column or row is not dropped, as NV12 has
+ * chroma for it; its block repeats the last column or row instead.
+ *
+ * @param src (IN) The source surface, B G R X byte order.
+ * @param dest_y (OUT) The destination Y plane.
+ * @param dest_uv (OUT) The destination CbCr plane.
+ * @param s_pitch (IN) The stride of the source surface.
+ * @param y_pitch (IN) The stride of the Y plane.
+ * @param uv_pitch (IN) The stride of the CbCr plane.
+ * @param width (IN) The width of the surfaces.
+ * @param height (IN) The height of the surfaces.
+ * @param matrix (IN) SPLASH_CSC_BT601 or SPLASH_CSC_BT709.
+ */
+void splash_csc_xrgb_to_nv12(
+	const unsigned char *src,
+	unsigned char *dest_y,
+	unsigned char *dest_uv,
+	int s_pitch,
+	int y_pitch,
+	int uv_pitch,
+	int width,
+	int height,
+	int matrix)
+{
+	const splash_csc_matrix *m;
+	const uint32_t *s0, *s1;
+	unsigned char *y0, *y1;
+	uint16_t *uv;
+	uint32_t p00, p01, p10, p11;
+	int r, g, b, u, v;
+	int row, col, col1, last;
+
+	if (matrix != SPLASH_CSC_BT709) {
+		matrix = SPLASH_CSC_BT601;
+	}
+	m = &csc_matrices[matrix];
+
+	for (row = 0; row < height; row += 2) {
+		s0 = (const uint32_t *)(src + row * s_pitch);
+		y0 = dest_y + row * y_pitch;
+		y1 = y0 + y_pitch;
+		last = (row + 1 == height);
+		s1 = last ? s0 : (const uint32_t *)(src + (row + 1) * s_pitch);
+		uv = (uint16_t *)(dest_uv + (row / 2) * uv_pitch);
+
+		for (col = 0; col < width; col += 2) {
+			col1 = (col + 1 < width) ? col + 1 : col;
+			p00 = s0[col];
+			p01 = s0[col1];
+			p10 = s1[col];
+			p11 = s1[col1];
+
+			y0[col] = csc_luma(m, p00);
+			y0[col1] = csc_luma(m, p01);
+			if (!last) {
+				y1[col] = csc_luma(m, p10);
+				y1[col1] = csc_luma(m, p11);
+			}
+
+			r = ((p00 >> 16) & 0xFF) + ((p01 >> 16) & 0xFF) +
+				((p10 >> 16) & 0xFF) + ((p11 >> 16) & 0xFF);
+			g = ((p00 >> 8) & 0xFF) + ((p01 >> 8) & 0xFF) +
+				((p10 >> 8) & 0xFF) + ((p11 >> 8) & 0xFF);
+			b = (p00 & 0xFF) + (p01 & 0xFF) + (p10 & 0xFF) + (p11 & 0xFF);
+
+			/* Chroma of the block average, two extra bits of shift */
+			u = (m->ur * r + m->ug * g + m->ub * b +
+				(128 << (CSC_SHIFT + 2)) + (1 << (CSC_SHIFT + 1))) >>
+				(CSC_SHIFT + 2);
+			v = (m->vr * r + m->vg * g + m->vb * b +
+				(128 << (CSC_SHIFT + 2)) + (1 << (CSC_SHIFT + 1))) >>
+				(CSC_SHIFT + 2);
+
+			/* Cb in the first byte, stored as one 16 bit write */
+			uv[col / 2] = u | (v << 8);
+		}
+	}
+}
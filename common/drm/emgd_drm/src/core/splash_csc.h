@@ -0,0 +1,66 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: splash_csc.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Fixed-point RGB to YUV 4:2:2 and NV12 4:2:0 conversion for the splash
+ *  video and other boot time overlay surfaces. Integer only, so it needs
+ *  no FPU state in the kernel, and it builds unchanged as a userspace
+ *  library.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _SPLASH_CSC_H
+#define _SPLASH_CSC_H
+
+/* Colour matrices, studio swing (Y 16-235, Cb/Cr 16-240) */
+#define SPLASH_CSC_BT601  0
+#define SPLASH_CSC_BT709  1
+
+/* Packed 4:2:2 byte orders */
+#define SPLASH_CSC_YUY2   0
+#define SPLASH_CSC_UYVY   1
+
+void splash_csc_xrgb_to_yuv422(
+		const unsigned char *src,
+		unsigned char *dest,
+		int s_pitch,
+		int d_pitch,
+		int width,
+		int height,
+		int matrix,
+		int order);
+
+void splash_csc_xrgb_to_nv12(
+		const unsigned char *src,
+		unsigned char *dest_y,
+		unsigned char *dest_uv,
+		int s_pitch,
+		int y_pitch,
+		int uv_pitch,
+		int width,
+		int height,
+		int matrix);
+
+#endif
@@ -0,0 +1,604 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: splash_inflate.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Table driven deflate decoder for the PNG splash screen. Input is pulled
+ *  into a 64 bit buffer a byte at a time and Huffman codes are resolved
+ *  through lookup tables instead of walking a tree bit by bit.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef __KERNEL__
+#include <linux/string.h>
+#else
+#include <string.h>
+#endif
+
+#include "splash_inflate.h"
+
+/* Base values and extra bits for length codes 257..285 */
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/* Base values and extra bits for distance codes 0..29 */
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Order in which the code length code lengths are transmitted */
+static const unsigned char clc_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+/*
+ * Top the bit buffer up to at least 56 bits, or as many as remain in the
+ * input. 56 bits cover the longest length/distance pair (15 + 5 + 15 + 13),
+ * so the decode loop refills once per symbol.
+ */
+static inline void refill(splash_bitstream *bs)
+{
+	while (bs->count <= 56 && bs->in < bs->end) {
+		bs->bits |= (uint64_t)*bs->in++ << bs->count;
+		bs->count += 8;
+	}
+}
+
+/*
+ * Take num_bits from the bit buffer. The caller must have refilled. Returns
+ * 0 on success, >0 if the input ran out.
+ */
+static inline int take_bits(
+	splash_bitstream *bs,
+	uint32_t num_bits,
+	uint32_t *value)
+{
+	if (num_bits > bs->count) {
+		return 1;
+	}
+
+	*value = (uint32_t)bs->bits & ((1U << num_bits) - 1);
+	bs->bits >>= num_bits;
+	bs->count -= num_bits;
+	return 0;
+}
+
+static inline uint32_t reverse_bits(uint32_t code, uint32_t length)
+{
+	uint32_t result = 0;
+
+	while (length--) {
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+
+/*
+ * This function builds a lookup table for a canonical Huffman code.
+ *
+ * @param h (OUT) The table to fill in.
+ * @param lengths (IN) The code length for each symbol, 0 if unused.
+ * @param num_codes (IN) The number of symbols.
+ *
+ * @return 0 on Success
+ * @return >0 on Error (over-subscribed code)
+ */
+static int build_huffman(
+	splash_huffman *h,
+	const unsigned char *lengths,
+	uint32_t num_codes)
+{
+	uint32_t count[16];
+	uint32_t next_code[16];
+	uint32_t code = 0, symbol = 0;
+	uint32_t i, j;
+
+	memset(count, 0, sizeof(count));
+	memset(h->fast, 0, sizeof(h->fast));
+
+	for (i = 0; i < num_codes; i++) {
+		count[lengths[i]]++;
+	}
+	count[0] = 0;
+
+	for (i = 1; i < 16; i++) {
+		next_code[i] = code;
+		h->first_code[i] = code;
+		h->first_symbol[i] = symbol;
+		code += count[i];
+		if (count[i] && code - 1 >= (1U << i)) {
+			return 1;
+		}
+		/* Left aligned to 16 bits so every length compares alike */
+		h->max_code[i] = code << (16 - i);
+		code <<= 1;
+		symbol += count[i];
+	}
+	h->max_code[16] = 0x10000;
+
+	for (i = 0; i < num_codes; i++) {
+		uint32_t len = lengths[i];
+
+		if (!len) {
+			continue;
+		}
+
+		h->symbol[next_code[len] - h->first_code[len] +
+			h->first_symbol[len]] = i;
+
+		if (len <= SPLASH_FAST_BITS) {
+			/* Every index whose low bits spell this code maps to it */
+			for (j = reverse_bits(next_code[len], len);
+				j < (1 << SPLASH_FAST_BITS); j += 1 << len) {
+				h->fast[j] = (len << 9) | i;
+			}
+		}
+		next_code[len]++;
+	}
+
+	return 0;
+}
+
+
+/*
+ * This function decodes one Huffman symbol. The caller must have refilled.
+ *
+ * @return the symbol, or -1 if the input is corrupt or ran out.
+ */
+static inline int decode_symbol(splash_bitstream *bs, const splash_huffman *h)
+{
+	uint32_t entry, code, len;
+
+	entry = h->fast[bs->bits & ((1 << SPLASH_FAST_BITS) - 1)];
+	if (entry) {
+		len = entry >> 9;
+		if (len > bs->count) {
+			return -1;
+		}
+		bs->bits >>= len;
+		bs->count -= len;
+		return entry & 0x1FF;
+	}
+
+	/* Slow path: codes are sent MSB first, so compare them reversed */
+	code = reverse_bits((uint32_t)bs->bits & 0xFFFF, 16);
+	for (len = SPLASH_FAST_BITS + 1; len < 16; len++) {
+		if (code < h->max_code[len]) {
+			break;
+		}
+	}
+	if (len >= 16 || len > bs->count) {
+		return -1;
+	}
+
+	code = (code >> (16 - len)) - h->first_code[len] + h->first_symbol[len];
+	bs->bits >>= len;
+	bs->count -= len;
+	return h->symbol[code];
+}
+
+
+static int build_fixed_tables(splash_inflate *z)
+{
+	unsigned char lengths[SPLASH_MAX_LIT];
+	uint32_t i;
+
+	for (i = 0; i < 144; i++) {
+		lengths[i] = 8;
+	}
+	for (; i < 256; i++) {
+		lengths[i] = 9;
+	}
+	for (; i < 280; i++) {
+		lengths[i] = 7;
+	}
+	for (; i < 288; i++) {
+		lengths[i] = 8;
+	}
+	if (build_huffman(&z->length, lengths, 288)) {
+		return 1;
+	}
+
+	for (i = 0; i < 30; i++) {
+		lengths[i] = 5;
+	}
+	return build_huffman(&z->distance, lengths, 30);
+}
+
+
+static int build_dynamic_tables(splash_inflate *z)
+{
+	splash_bitstream *bs = &z->bs;
+	unsigned char lengths[SPLASH_MAX_LIT + SPLASH_MAX_DIST];
+	uint32_t hlit, hdist, hclen;
+	uint32_t i, n, repeat, fill;
+	int sym;
+
+	refill(bs);
+	if (take_bits(bs, 5, &hlit) ||
+		take_bits(bs, 5, &hdist) ||
+		take_bits(bs, 4, &hclen)) {
+		return 1;
+	}
+	hlit += 257;
+	hdist += 1;
+	hclen += 4;
+	if (hlit > 286 || hdist > 30) {
+		return 1;
+	}
+
+	/* The code length code, which is used to send the other two */
+	memset(lengths, 0, 19);
+	for (i = 0; i < hclen; i++) {
+		refill(bs);
+		if (take_bits(bs, 3, &n)) {
+			return 1;
+		}
+		lengths[clc_order[i]] = n;
+	}
+	if (build_huffman(&z->length, lengths, 19)) {
+		return 1;
+	}
+
+	/* Literal/length and distance lengths form one sequence; repeats
+	 * are allowed to run across the boundary between them. */
+	i = 0;
+	while (i < hlit + hdist) {
+		refill(bs);
+		sym = decode_symbol(bs, &z->length);
+		if (sym < 0) {
+			return 1;
+		}
+
+		if (sym < 16) {
+			lengths[i++] = sym;
+			continue;
+		}
+
+		switch (sym) {
+		case 16:
+			if (i == 0 || take_bits(bs, 2, &repeat)) {
+				return 1;
+			}
+			repeat += 3;
+			fill = lengths[i - 1];
+			break;
+		case 17:
+			if (take_bits(bs, 3, &repeat)) {
+				return 1;
+			}
+			repeat += 3;
+			fill = 0;
+			break;
+		default:
+			if (take_bits(bs, 7, &repeat)) {
+				return 1;
+			}
+			repeat += 11;
+			fill = 0;
+			break;
+		}
+
+		if (i + repeat > hlit + hdist) {
+			return 1;
+		}
+		memset(&lengths[i], fill, repeat);
+		i += repeat;
+	}
+
+	if (build_huffman(&z->length, lengths, hlit)) {
+		return 1;
+	}
+	return build_huffman(&z->distance, &lengths[hlit], hdist);
+}
+
+
+/*
+ * This function appends decoded bytes to the history window that back
+ * references copy from.
+ */
+static void window_write(
+	splash_inflate *z,
+	const unsigned char *data,
+	uint32_t len)
+{
+	uint32_t pos, chunk;
+
+	if (len > SPLASH_WINDOW_SIZE) {
+		z->total += len - SPLASH_WINDOW_SIZE;
+		data += len - SPLASH_WINDOW_SIZE;
+		len = SPLASH_WINDOW_SIZE;
+	}
+
+	pos = z->total & (SPLASH_WINDOW_SIZE - 1);
+	chunk = SPLASH_WINDOW_SIZE - pos;
+	if (chunk > len) {
+		chunk = len;
+	}
+	memcpy(&z->window[pos], data, chunk);
+	memcpy(z->window, data + chunk, len - chunk);
+	z->total += len;
+}
+
+
+/*
+ * This function reads the header of the next block and sets up the
+ * tables or the stored length for it.
+ */
+static int begin_block(splash_inflate *z)
+{
+	splash_bitstream *bs = &z->bs;
+	uint32_t btype, len, nlen;
+
+	refill(bs);
+	if (take_bits(bs, 1, &z->last_block) || take_bits(bs, 2, &btype)) {
+		return 1;
+	}
+
+	switch (btype) {
+	case 0:
+		/* Skip to the byte boundary, then hand back whole bytes we
+		 * prefetched so the stored data can be copied straight out */
+		bs->bits >>= bs->count & 7;
+		bs->count &= ~7;
+		bs->in -= bs->count >> 3;
+		bs->bits = 0;
+		bs->count = 0;
+
+		if (bs->end - bs->in < 4) {
+			return 1;
+		}
+		len = bs->in[0] | (bs->in[1] << 8);
+		nlen = bs->in[2] | (bs->in[3] << 8);
+		bs->in += 4;
+		if ((len ^ 0xFFFF) != nlen) {
+			return 1;
+		}
+
+		z->stored_left = len;
+		z->state = SPLASH_INFLATE_STORED;
+		return 0;
+	case 1:
+		if (build_fixed_tables(z)) {
+			return 1;
+		}
+		break;
+	case 2:
+		if (build_dynamic_tables(z)) {
+			return 1;
+		}
+		break;
+	default:
+		return 1;
+	}
+
+	z->state = SPLASH_INFLATE_HUFFMAN;
+	return 0;
+}
+
+
+static void end_block(splash_inflate *z)
+{
+	z->state = z->last_block ? SPLASH_INFLATE_DONE : SPLASH_INFLATE_HEADER;
+}
+
+
+/*
+ * This function copies out as much of a stored (uncompressed) block as
+ * fits in the output.
+ */
+static int read_stored(
+	splash_inflate *z,
+	unsigned char *out,
+	uint32_t out_size,
+	uint32_t *out_iter)
+{
+	splash_bitstream *bs = &z->bs;
+	uint32_t len = z->stored_left;
+
+	if (len > out_size - *out_iter) {
+		len = out_size - *out_iter;
+	}
+	if ((uint32_t)(bs->end - bs->in) < len) {
+		return 1;
+	}
+
+	memcpy(&out[*out_iter], bs->in, len);
+	window_write(z, bs->in, len);
+	bs->in += len;
+	*out_iter += len;
+
+	z->stored_left -= len;
+	if (!z->stored_left) {
+		end_block(z);
+	}
+	return 0;
+}
+
+
+/*
+ * This function decompresses Huffman coded data from the current block
+ * until the output is full or the block ends. A back reference that does
+ * not fit is left pending and finished on the next call.
+ */
+static int read_huffman(
+	splash_inflate *z,
+	unsigned char *out,
+	uint32_t out_size,
+	uint32_t *out_iter)
+{
+	splash_bitstream *bs = &z->bs;
+	unsigned char *window = z->window;
+	uint32_t op = *out_iter;
+	uint32_t total = z->total;
+	uint32_t length = z->copy_length;
+	uint32_t distance = z->copy_distance;
+	uint32_t extra;
+	unsigned char value;
+	int sym;
+
+	for (;;) {
+		/* Byte copy; the source may overlap what we're writing */
+		while (length && op < out_size) {
+			value = window[(total - distance) & (SPLASH_WINDOW_SIZE - 1)];
+			window[total++ & (SPLASH_WINDOW_SIZE - 1)] = value;
+			out[op++] = value;
+			length--;
+		}
+		if (op == out_size) {
+			break;
+		}
+
+		refill(bs);
+		sym = decode_symbol(bs, &z->length);
+		if (sym < 0) {
+			return 1;
+		}
+
+		if (sym < 256) {
+			window[total++ & (SPLASH_WINDOW_SIZE - 1)] = sym;
+			out[op++] = sym;
+			continue;
+		}
+
+		if (sym == 256) {
+			end_block(z);
+			break;
+		}
+
+		sym -= 257;
+		if (sym >= 29 || take_bits(bs, length_extra[sym], &extra)) {
+			return 1;
+		}
+		length = length_base[sym] + extra;
+
+		sym = decode_symbol(bs, &z->distance);
+		if (sym < 0 || sym >= 30 ||
+			take_bits(bs, dist_extra[sym], &extra)) {
+			return 1;
+		}
+		distance = dist_base[sym] + extra;
+
+		if (distance > total) {
+			return 1;
+		}
+	}
+
+	z->total = total;
+	z->copy_length = length;
+	z->copy_distance = distance;
+	*out_iter = op;
+	return 0;
+}
+
+
+/*
+ * This function prepares to inflate a raw deflate stream (no zlib header).
+ *
+ * @param z (OUT) Decoder state, allocated by the caller.
+ * @param in (IN) The compressed stream, which must stay valid while reading.
+ * @param in_size (IN) Size of the compressed stream.
+ */
+void splash_inflate_init(
+	splash_inflate *z,
+	const unsigned char *in,
+	uint32_t in_size)
+{
+	z->bs.in = in;
+	z->bs.end = in + in_size;
+	z->bs.bits = 0;
+	z->bs.count = 0;
+	z->state = SPLASH_INFLATE_HEADER;
+	z->last_block = 0;
+	z->stored_left = 0;
+	z->copy_length = 0;
+	z->copy_distance = 0;
+	z->total = 0;
+}
+
+
+/*
+ * This function produces the next out_size bytes of decompressed data.
+ * Only a short read at the end of the stream returns less; everything
+ * still needed for back references is kept in the decoder's own window,
+ * so the caller may reuse its buffer between calls.
+ *
+ * @param z (IN/OUT) Decoder state.
+ * @param out (OUT) The decompressed data.
+ * @param out_size (IN) The number of bytes wanted.
+ * @param out_used (OUT) Number of bytes written to the output buffer.
+ *
+ * @return 0 on Success
+ * @return >0 on Error
+ */
+int splash_inflate_read(
+	splash_inflate *z,
+	unsigned char *out,
+	uint32_t out_size,
+	uint32_t *out_used)
+{
+	uint32_t out_iter = 0;
+	int ret = 0;
+
+	while (out_iter < out_size && !ret) {
+		switch (z->state) {
+		case SPLASH_INFLATE_HEADER:
+			ret = begin_block(z);
+			break;
+		case SPLASH_INFLATE_STORED:
+			ret = read_stored(z, out, out_size, &out_iter);
+			break;
+		case SPLASH_INFLATE_HUFFMAN:
+			ret = read_huffman(z, out, out_size, &out_iter);
+			break;
+		case SPLASH_INFLATE_DONE:
+			*out_used = out_iter;
+			return 0;
+		default:
+			ret = 1;
+			break;
+		}
+	}
+
+	if (ret) {
+		z->state = SPLASH_INFLATE_ERROR;
+	}
+	*out_used = out_iter;
+	return ret;
+}
@@ -0,0 +1,108 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: splash_inflate.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Deflate (RFC 1951) decoder used by the PNG splash screen. It has no
+ *  dependencies beyond the C library subset available in the kernel and
+ *  does not allocate, so it builds unchanged as a userspace library.
+ *  Output is produced incrementally, in whatever amounts the caller asks
+ *  for, so an image can be decoded a row at a time.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _SPLASH_INFLATE_H
+#define _SPLASH_INFLATE_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+/* Width of the primary Huffman lookup table, in bits */
+#define SPLASH_FAST_BITS   9
+
+#define SPLASH_MAX_LIT    288
+#define SPLASH_MAX_DIST    32
+
+/*
+ * Canonical Huffman decode table. Codes of up to SPLASH_FAST_BITS bits
+ * resolve with a single lookup in fast[], indexed by the next input bits
+ * (LSB first). The rare longer codes fall back to a per-length search
+ * over the canonical first-code tables.
+ */
+typedef struct _splash_huffman {
+	/* (code length << 9) | symbol, 0 if the code is longer */
+	uint16_t fast[1 << SPLASH_FAST_BITS];
+	uint16_t first_code[16];
+	uint16_t first_symbol[16];
+	uint32_t max_code[17];
+	uint16_t symbol[SPLASH_MAX_LIT];
+} splash_huffman;
+
+/* Bit reader state. Bits above 'count' in 'bits' are always zero. */
+typedef struct _splash_bitstream {
+	const unsigned char *in;
+	const unsigned char *end;
+	uint64_t bits;
+	uint32_t count;
+} splash_bitstream;
+
+/* Deflate back references reach at most 32KB */
+#define SPLASH_WINDOW_SIZE 32768
+
+#define SPLASH_INFLATE_HEADER   0
+#define SPLASH_INFLATE_STORED   1
+#define SPLASH_INFLATE_HUFFMAN  2
+#define SPLASH_INFLATE_DONE     3
+#define SPLASH_INFLATE_ERROR    4
+
+typedef struct _splash_inflate {
+	splash_bitstream bs;
+	splash_huffman length;
+	splash_huffman distance;
+	uint32_t state;
+	uint32_t last_block;
+	/* Bytes left in the current stored block */
+	uint32_t stored_left;
+	/* Back reference still to be copied when the output filled up */
+	uint32_t copy_length;
+	uint32_t copy_distance;
+	/* Bytes decoded so far; the window holds the last 32KB of them */
+	uint32_t total;
+	unsigned char window[SPLASH_WINDOW_SIZE];
+} splash_inflate;
+
+void splash_inflate_init(
+		splash_inflate *z,
+		const unsigned char *in,
+		uint32_t in_size);
+int splash_inflate_read(
+		splash_inflate *z,
+		unsigned char *out,
+		uint32_t out_size,
+		uint32_t *out_used);
+
+#endif
@@ -0,0 +1,763 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: splash_png.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  PNG image data decoding for the splash screen: rows are inflated,
+ *  unfiltered and converted to ARGB one at a time, then either collected
+ *  into a frame or blended straight into the framebuffer. Apart from
+ *  vmalloc() and EMGD_ERROR() this has no kernel dependencies, and it
+ *  builds in userspace against the C library (see tools/splash_test).
+ *-----------------------------------------------------------------------------
+ */
+#define MODULE_NAME hal.splash
+
+#ifdef __KERNEL__
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include "io.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef vmalloc
+#define vmalloc malloc
+#define vfree free
+#endif
+#define EMGD_ERROR(...) \
+	(fprintf(stderr, "%s ERROR: ", __FUNCTION__), \
+	 fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+#include "splash_png.h"
+#include "splash_inflate.h"
+
+/*
+ * This function blends one row of ARGB pixels into the framebuffer.
+ *
+ * @param src (IN) The row's pixels.
+ * @param dst (IN/OUT) The framebuffer row.
+ * @param width (IN) The number of pixels in the row.
+ * @param background (IN) The background colour.
+ * @param blend_op (IN) APNG_BLEND_OP_SOURCE blends against the background
+ *   colour, APNG_BLEND_OP_OVER against what is already in the framebuffer.
+ */
+void splash_blend_row(
+	const uint32_t *src,
+	uint32_t *dst,
+	uint32_t width,
+	uint32_t background,
+	uint32_t blend_op)
+{
+	uint32_t col, under;
+	unsigned char image_alpha;
+	unsigned char background_alpha;
+
+	for (col = 0; col < width; col++) {
+		image_alpha = src[col]>>24;
+
+		if (!image_alpha) {
+			/* Fully transparent shows whatever is underneath */
+			if (blend_op == APNG_BLEND_OP_SOURCE) {
+				dst[col] = background;
+			}
+			continue;
+		}
+		if (image_alpha == 0xFF) {
+			dst[col] = src[col];
+			continue;
+		}
+
+		under = (blend_op == APNG_BLEND_OP_SOURCE) ? background : dst[col];
+		background_alpha = (0xFF - image_alpha) & 0xFF;
+
+		dst[col] = 0xFF000000 |
+			((((((src[col]&0xFF0000)>>16) * image_alpha)/0xFF) +
+			  ((((under&0xFF0000)>>16) * background_alpha)/0xFF))<<16) |
+			((((((src[col]&0x00FF00)>>8) * image_alpha)/0xFF) +
+			  ((((under&0x00FF00)>>8) * background_alpha)/0xFF))<<8) |
+			((((((src[col]&0x0000FF)) * image_alpha)/0xFF) +
+			  ((((under&0x0000FF)) * background_alpha)/0xFF)));
+	}
+}
+
+
+/*
+ * This function reverses the PNG scanline filter of one row, in place.
+ *
+ * @param filter_type (IN) The filter type byte that precedes the row.
+ * @param cur (IN/OUT) The row's data, not including the filter type byte.
+ * @param prev (IN) The previous row's unfiltered data, NULL for the first row.
+ * @param length (IN) The number of bytes in the row.
+ * @param bpp (IN) Bytes per pixel, rounded up to at least one.
+ */
+static void unfilter_row(
+	unsigned char filter_type,
+	unsigned char *cur,
+	const unsigned char *prev,
+	uint32_t length,
+	uint32_t bpp)
+{
+	uint32_t k;
+	int pa, pb, pc;
+	unsigned char a, b, c;
+
+	/* Without a previous row, Up is a no-op and Paeth reduces to Sub */
+	if (!prev && filter_type == 4) {
+		filter_type = 1;
+	}
+
+	switch (filter_type) {
+	case 1:
+		/* Filter type of 1 uses the previous pixel */
+		for (k = bpp; k < length; k++) {
+			cur[k] += cur[k - bpp];
+		}
+		break;
+	case 2:
+		/* Filter type of 2 uses the previous row's pixel */
+		if (prev) {
+			for (k = 0; k < length; k++) {
+				cur[k] += prev[k];
+			}
+		}
+		break;
+	case 3:
+		/*
+		 * Filter type of 3 uses the average of the
+		 * previous pixel and the previous row's pixel
+		 */
+		if (prev) {
+			for (k = 0; k < bpp; k++) {
+				cur[k] += prev[k] >> 1;
+			}
+			for (; k < length; k++) {
+				cur[k] += (cur[k - bpp] + prev[k]) >> 1;
+			}
+		} else {
+			for (k = bpp; k < length; k++) {
+				cur[k] += cur[k - bpp] >> 1;
+			}
+		}
+		break;
+	case 4:
+		/*
+		 * Filter type of 4 picks whichever of the previous pixel,
+		 * the previous row's pixel, or the pixel before that is
+		 * closest to a + b - c. The first pixel only has b.
+		 */
+		for (k = 0; k < bpp; k++) {
+			cur[k] += prev[k];
+		}
+		for (; k < length; k++) {
+			a = cur[k - bpp];
+			b = prev[k];
+			c = prev[k - bpp];
+
+			pa = b - c;
+			pb = a - c;
+			pc = abs(pa + pb);
+			pa = abs(pa);
+			pb = abs(pb);
+
+			if (pa <= pb && pa <= pc) {
+				cur[k] += a;
+			} else if (pb <= pc) {
+				cur[k] += b;
+			} else {
+				cur[k] += c;
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * This function converts one unfiltered row to 32 bit ARGB pixels.
+ * Pixels matching the tRNS colour are left untouched, so the caller
+ * should clear the row first.
+ *
+ * @param image_header (IN) The image's header information.
+ * @param width (IN) The number of pixels in the row.
+ * @param output (IN) The unfiltered row data.
+ * @param pixels (OUT) The converted pixels.
+ */
+static void convert_row(
+	png_header *image_header,
+	uint32_t width,
+	const unsigned char *output,
+	uint32_t *pixels)
+{
+	uint32_t j = 0, l = 0, col = 0;
+	unsigned int small_color;
+
+	/* Put together the pixel */
+	while (col < width) {
+
+		/* Truecolor with alpha, 16 bits per component */
+		if (image_header->colour_type == COLOR_TRUE_ALPHA &&
+			image_header->bit_depth == 16) {
+
+			pixels[l] = (output[j+6]<<24 | output[j]<<16 |
+				output[j+2]<<8 | output[j+4]);
+		}
+
+
+		/* Truecolor with alpha, 8 bits per component */
+		if (image_header->colour_type == COLOR_TRUE_ALPHA &&
+			image_header->bit_depth == 8) {
+
+			pixels[l] = (output[j+3]<<24 | output[j]<<16 |
+				output[j+1]<<8 | output[j+2]);
+		}
+
+		/* Grayscale with alpha, 16 bits per component */
+		if (image_header->colour_type == COLOR_GREY_ALPHA &&
+			image_header->bit_depth == 16) {
+
+			pixels[l] = (output[j+2]<<24 | output[j]<<16 |
+				output[j]<<8 | output[j]);
+		}
+
+		/* Grayscale with alpha, 8 bits per component */
+		if (image_header->colour_type == COLOR_GREY_ALPHA &&
+			image_header->bit_depth == 8) {
+
+			pixels[l] = (output[j+1]<<24 | output[j]<<16 |
+				output[j]<<8 | output[j]);
+
+		}
+
+		/* Truecolor, 16 bits per component */
+		if (image_header->colour_type == COLOR_TRUE &&
+			image_header->bit_depth == 16) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r !=
+				(output[j] | output[j+1]) ||
+				image_header->transparency_g !=
+				(output[j+2] | output[j+3]) ||
+				image_header->transparency_b !=
+				(output[j+4] | output[j+5])) {
+
+				pixels[l] = (0xFF000000 | output[j]<<16 |
+					output[j+2]<<8 | output[j+4]);
+			}
+		}
+
+		/* Truecolor, 8 bits per component */
+		if (image_header->colour_type == COLOR_TRUE &&
+			image_header->bit_depth == 8) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r != output[j] ||
+				image_header->transparency_g != output[j+1] ||
+				image_header->transparency_b != output[j+2]) {
+
+				pixels[l] = (0xFF000000 | (output[j]<<16) |
+					(output[j+1]<<8) | (output[j+2]));
+			}
+		}
+
+		/* Grayscale, 16 bits per component */
+		if (image_header->colour_type == COLOR_GREY &&
+			image_header->bit_depth == 16) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r !=
+				(output[j] | output[j+1])) {
+
+				pixels[l] = (0xFF000000 |(output[j]<<16) |
+					(output[j]<<8) | output[j]);
+			}
+		}
+
+		/* Grayscale, 8 bits per component */
+		if (image_header->colour_type == COLOR_GREY &&
+			 image_header->bit_depth == 8) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r != output[j]) {
+				pixels[l] = (0xFF000000 | (output[j]<<16) |
+					(output[j]<<8) | output[j]);
+			}
+		}
+
+		/* Grayscale, 4 bits per component */
+		if (image_header->colour_type == COLOR_GREY &&
+			image_header->bit_depth == 4) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r != ((output[j] & 0xF0)>>4)) {
+
+				pixels[l] =
+					CONV_GS_4_TO_32((output[j] & 0xF0)>>4);
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != (output[j] & 0x0F)) {
+
+					pixels[l] =
+						CONV_GS_4_TO_32(output[j] & 0x0F);
+				}
+			}
+		}
+
+		/* Grayscale, 2 bits per component */
+		if (image_header->colour_type == COLOR_GREY &&
+			image_header->bit_depth == 2) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r != ((output[j] & 0xC0)>>6)) {
+
+				pixels[l] =
+					CONV_GS_2_TO_32((output[j] & 0xC0) >> 6);
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x30)>>4)) {
+
+					pixels[l] =
+						CONV_GS_2_TO_32((output[j] & 0x30) >> 4);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x0C)>>2)) {
+
+					pixels[l] =
+						CONV_GS_2_TO_32((output[j] & 0x0C) >> 2);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != (output[j] & 0x03)) {
+
+					pixels[l] =
+						CONV_GS_2_TO_32(output[j] & 0x03);
+				}
+			}
+		}
+
+		/* Grayscale, 1 bit per component */
+		if (image_header->colour_type == COLOR_GREY &&
+			image_header->bit_depth == 1) {
+
+			if (!image_header->using_transparency ||
+				image_header->transparency_r != ((output[j] & 0x80)>>7)) {
+
+				pixels[l] =
+					CONV_GS_1_TO_32((output[j] & 0x80) >> 7);
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x40)>>6)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x40) >> 6);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x20)>>5)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x20) >> 5);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x10)>>4)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x10) >> 4);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x08)>>3)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x08) >> 3);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x04)>>2)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x04) >> 2);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != ((output[j] & 0x02)>>1)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32((output[j] & 0x02) >> 1);
+				}
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				if (!image_header->using_transparency ||
+					image_header->transparency_r != (output[j] & 0x01)) {
+
+					pixels[l] =
+						CONV_GS_1_TO_32(output[j] & 0x01);
+				}
+			}
+		}
+
+		/* Palette, 8 bit per component */
+		if (image_header->colour_type == COLOR_INDEXED &&
+			image_header->bit_depth == 8) {
+
+			small_color = output[j];
+			pixels[l] = 0xFF000000 |
+				image_header->image_palette[small_color];
+		}
+
+		/* Palette, 4 bit per component */
+		if (image_header->colour_type == COLOR_INDEXED &&
+			image_header->bit_depth == 4) {
+
+			small_color = (output[j] & 0xF0) >> 4;
+			pixels[l] = 0xFF000000 |
+				image_header->image_palette[small_color];
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = output[j] & 0x0F;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+		}
+
+		/* Palette, 2 bit per component */
+		if (image_header->colour_type == COLOR_INDEXED &&
+			image_header->bit_depth == 2) {
+
+			small_color = (output[j] & 0xC0) >> 6;
+			pixels[l] = 0xFF000000 |
+				image_header->image_palette[small_color];
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = output[j] & 0x30 >> 4;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = output[j] & 0x0C >> 2;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = output[j] & 0x03;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+		}
+
+		/* Palette, 1 bit per component */
+		if (image_header->colour_type == COLOR_INDEXED &&
+			image_header->bit_depth == 1) {
+
+			small_color = (output[j] & 0x80) >> 7;
+			pixels[l] = 0xFF000000 |
+				image_header->image_palette[small_color];
+
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x40) >> 6;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x20) >> 5;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x10) >> 4;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x08) >> 3;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x04) >> 2;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x02) >> 1;
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+			if (col + 1 < width) {
+				l++;
+				col++;
+				small_color = (output[j] & 0x01);
+				pixels[l] = 0xFF000000 |
+					image_header->image_palette[small_color];
+			}
+		}
+
+		j += image_header->bytes_pp;
+		l++;
+		col++;
+	}
+}
+
+
+/*
+ * This function prepares to decode a frame's image data a row at a time.
+ * Only the current and previous rows are kept, plus the inflate window.
+ *
+ * @param rows (OUT) The row decoder state.
+ * @param frame (IN) The frame being decoded.
+ * @param input_data (IN) The frame's zlib stream (concatenated IDAT/fdAT).
+ * @param input_size (IN) The size of the zlib stream.
+ *
+ * @return 0 on Success
+ * @return >0 on Error
+ */
+int begin_png_rows(
+	png_rows *rows,
+	png_frame *frame,
+	unsigned char *input_data,
+	uint32_t input_size)
+{
+	uint32_t iter = 0;
+
+	memset(rows, 0, sizeof(*rows));
+
+	/* Each row is preceded by its filter type byte */
+	rows->cur = vmalloc(2 * (frame->bytes_pl + 1));
+	rows->inflate = vmalloc(sizeof(*rows->inflate));
+	if (!rows->cur || !rows->inflate) {
+		EMGD_ERROR("Out of memory.");
+		vfree(rows->cur);
+		vfree(rows->inflate);
+		return 1;
+	}
+	rows->prev = rows->cur + frame->bytes_pl + 1;
+
+	/*
+	 * Data, this needs to be decompressed per zlib spec. Skip the CMF
+	 * and FLG bytes, and the preset dictionary id if FDICT is set.
+	 */
+	if (input_size > 2) {
+		iter = (input_data[1] & 0x20) ? 6 : 2;
+	}
+	if (iter >= input_size) {
+		EMGD_ERROR("Corrupt image data, no zlib stream.");
+		rows->error = 1;
+		iter = input_size;
+	}
+	splash_inflate_init(rows->inflate, &input_data[iter], input_size - iter);
+
+	return 0;
+}
+
+
+/*
+ * This function decodes, unfilters and converts the next row of a frame.
+ * Once the data turns out to be corrupt, the remaining rows come back
+ * empty and so show up as background.
+ *
+ * @param rows (IN/OUT) The row decoder state.
+ * @param image_header (IN) The image's header information.
+ * @param frame (IN) The frame being decoded.
+ * @param pixels (OUT) The row's ARGB pixels, frame->width of them.
+ */
+void next_png_row(
+	png_rows *rows,
+	png_header *image_header,
+	png_frame *frame,
+	uint32_t *pixels)
+{
+	unsigned char *tmp;
+	uint32_t used;
+
+	memset(pixels, 0, frame->width * sizeof(uint32_t));
+
+	if (rows->error) {
+		return;
+	}
+
+	if (splash_inflate_read(rows->inflate, rows->cur,
+			frame->bytes_pl + 1, &used) ||
+		used != frame->bytes_pl + 1) {
+		EMGD_ERROR("Corrupt image data at row %u.", rows->row);
+		rows->error = 1;
+		return;
+	}
+
+	/*
+	 * Process the scanline filtering
+	 * This filtering works by using a difference from a previous pixel
+	 * instead of full pixel data.
+	 */
+	unfilter_row(rows->cur[0], &rows->cur[1],
+		rows->row ? &rows->prev[1] : NULL,
+		frame->bytes_pl, frame->bytes_pp);
+	convert_row(image_header, frame->width, &rows->cur[1], pixels);
+
+	tmp = rows->prev;
+	rows->prev = rows->cur;
+	rows->cur = tmp;
+	rows->row++;
+}
+
+
+void end_png_rows(png_rows *rows)
+{
+	/* cur and prev share one allocation */
+	vfree(rows->cur < rows->prev ? rows->cur : rows->prev);
+	vfree(rows->inflate);
+}
+
+
+/*
+ * This function decodes a whole frame into frame->output. This is used for
+ * APNG frames, which are replayed and so have to be kept around.
+ */
+void decode_png_data(
+	png_header *image_header,
+	unsigned char *input_data,
+	uint32_t input_size,
+	png_frame *frame)
+{
+	png_rows rows;
+	uint32_t row;
+
+	frame->size = frame->height * frame->width * sizeof(uint32_t);
+	frame->output = vmalloc(frame->size);
+	if (!frame->output) {
+		frame->size = 0;
+		EMGD_ERROR("Out of memory.");
+		return;
+	}
+
+	if (begin_png_rows(&rows, frame, input_data, input_size)) {
+		memset(frame->output, 0, frame->size);
+		return;
+	}
+
+	for (row = 0; row < frame->height; row++) {
+		next_png_row(&rows, image_header, frame,
+			&frame->output[row * frame->width]);
+	}
+
+	end_png_rows(&rows);
+}
+
+
+/*
+ * This function decodes a still image straight to the framebuffer, one row
+ * at a time, blending each against the background as it is produced. The
+ * top of the splash shows up as soon as its rows are decoded, and no full
+ * size intermediate image is needed.
+ *
+ * @param image_header (IN) The image's header information.
+ * @param frame (IN) The frame being decoded.
+ * @param input_data (IN) The frame's zlib stream.
+ * @param input_size (IN) The size of the zlib stream.
+ * @param fb_addr (IN) Where the frame's first pixel goes.
+ * @param pitch (IN) The framebuffer pitch in bytes.
+ */
+void stream_png_rows(
+	png_header *image_header,
+	png_frame *frame,
+	unsigned char *input_data,
+	uint32_t input_size,
+	unsigned char *fb_addr,
+	uint32_t pitch)
+{
+	png_rows rows;
+	uint32_t *pixels;
+	uint32_t row;
+
+	pixels = vmalloc(frame->width * sizeof(uint32_t));
+	if (!pixels) {
+		EMGD_ERROR("Out of memory.");
+		return;
+	}
+
+	if (begin_png_rows(&rows, frame, input_data, input_size)) {
+		vfree(pixels);
+		return;
+	}
+
+	for (row = 0; row < frame->height; row++) {
+		next_png_row(&rows, image_header, frame, pixels);
+		splash_blend_row(pixels, (uint32_t *)fb_addr, frame->width,
+			image_header->background, APNG_BLEND_OP_SOURCE);
+		fb_addr += pitch;
+	}
+
+	end_png_rows(&rows);
+	vfree(pixels);
+}
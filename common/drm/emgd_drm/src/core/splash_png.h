@@ -0,0 +1,148 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: splash_png.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  PNG image data decoding for the splash screen. Only the image data path
+ *  is here; chunk parsing and display stay in splash_screen.c.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _SPLASH_PNG_H
+#define _SPLASH_PNG_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#define CONV_GS_4_TO_32(a) (0xFF000000 | ((a)<<20) | ((a)<<16) | ((a)<<12) |\
+						((a)<<8) | ((a)<<4) | ((a)))
+
+#define CONV_GS_2_TO_32(a) (0xFF000000 | ((a)<<22) | ((a)<<20) | ((a)<<18) |\
+						((a)<<16) | ((a)<<14) | ((a)<<12) | ((a)<<10) |\
+						((a)<<8) | ((a)<<6) | ((a)<<4) | ((a)<<2) | ((a)))
+
+#define CONV_GS_1_TO_32(a) (0xFF000000 | ((a)<<23) | ((a)<<22) | ((a)<<21) |\
+						((a)<<20) |	((a)<<19) | ((a)<<18) | ((a)<<17) |\
+						((a)<<16) |	((a)<<15) | ((a)<<14) | ((a)<<13) |\
+						((a)<<12) |	((a)<<11) | ((a)<<10) | ((a)<<9) |\
+						((a)<<8) | ((a)<<7) | ((a)<<6) | ((a)<<5) | ((a)<<4) |\
+						((a)<<3) | ((a)<<2) | ((a)<<1) | ((a)))
+/* Colour_type options */
+#define COLOR_GREY       0
+#define COLOR_TRUE       2
+#define COLOR_INDEXED    3
+#define COLOR_GREY_ALPHA 4
+#define COLOR_TRUE_ALPHA 6
+
+/* APNG dispose_op codes */
+#define APNG_DISPOSE_OP_NONE       0
+#define APNG_DISPOSE_OP_BACKGROUND 1
+#define APNG_DISPOSE_OP_PREVIOUS   2
+
+/* APNG blend_op codes */
+#define APNG_BLEND_OP_SOURCE 0
+#define APNG_BLEND_OP_OVER   1
+
+typedef struct _png_header {
+	uint32_t width;
+	uint32_t height;
+	uint32_t x_offset;
+	uint32_t y_offset;
+	unsigned char bit_depth;
+	unsigned char colour_type;
+	unsigned char compression_method;
+	unsigned char filter_method;
+	unsigned char interlace_method;
+	uint32_t bpp;
+	uint32_t bytes_pp;
+	uint32_t bytes_pl;
+	uint32_t background;
+	unsigned char background_r;
+	unsigned char background_g;
+	unsigned char background_b;
+	uint32_t *image_palette;
+	uint32_t using_transparency;
+	unsigned short transparency_r;
+	unsigned short transparency_g;
+	unsigned short transparency_b;
+} png_header;
+
+typedef struct _png_frame {
+	uint32_t *output;
+	uint32_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t x_offset;
+	uint32_t y_offset;
+	uint32_t bytes_pp;
+	uint32_t bytes_pl;
+	uint32_t delay;
+	unsigned char dispose_op;
+	unsigned char blend_op;
+} png_frame;
+
+/* Row at a time decode state, see begin_png_rows() */
+typedef struct _png_rows {
+	struct _splash_inflate *inflate;
+	/* Current and previous row, each led by its filter type byte */
+	unsigned char *cur;
+	unsigned char *prev;
+	uint32_t row;
+	uint32_t error;
+} png_rows;
+
+void splash_blend_row(
+	const uint32_t *src,
+	uint32_t *dst,
+	uint32_t width,
+	uint32_t background,
+	uint32_t blend_op);
+int begin_png_rows(
+	png_rows *rows,
+	png_frame *frame,
+	unsigned char *input_data,
+	uint32_t input_size);
+void next_png_row(
+	png_rows *rows,
+	png_header *image_header,
+	png_frame *frame,
+	uint32_t *pixels);
+void end_png_rows(png_rows *rows);
+void decode_png_data(
+	png_header *image_header,
+	unsigned char *input_data,
+	uint32_t input_size,
+	png_frame *frame);
+void stream_png_rows(
+	png_header *image_header,
+	png_frame *frame,
+	unsigned char *input_data,
+	uint32_t input_size,
+	unsigned char *fb_addr,
+	uint32_t pitch);
+
+#endif
@@ -34,56 +34,13 @@
 #define _SPLASH_SCREEN_H
 
 #include <default_config.h>
+#include "splash_png.h"
 
 #define CONV_16_TO_32_BIT(a) (0xFF000000 | ((a & 0xF800)<<8) |\
 						((a & 0x7E0)<<5) | (a & 0x1F)<<3)
-#define CONV_GS_4_TO_32(a) (0xFF000000 | ((a)<<20) | ((a)<<16) |\
-						((a)<<12) | ((a)<<8) | ((a)<<4) | ((a)))
-
-#define CONV_GS_2_TO_32(a) (0xFF000000 | ((a)<<22) | ((a)<<20) | ((a)<<18) |\
-						((a)<<16) | ((a)<<14) | ((a)<<12) | ((a)<<10) |\
-						((a)<<8) | ((a)<<6) | ((a)<<4) | ((a)<<2) | ((a)))
-
-#define CONV_GS_1_TO_32(a) (0xFF000000 | ((a)<<23) | ((a)<<22) | ((a)<<21) |\
-						((a)<<20) | ((a)<<19) | ((a)<<18) | ((a)<<17) |\
-						((a)<<16) |	((a)<<15) | ((a)<<14) | ((a)<<13) |\
-						((a)<<12) |	((a)<<11) | ((a)<<10) | ((a)<<9) |\
-						((a)<<8) | ((a)<<7) | ((a)<<6) | ((a)<<5) | ((a)<<4) |\
-						((a)<<3) | ((a)<<2) | ((a)<<1) | ((a)))
-
-/* Colour_type options */
-#define COLOR_GREY       0
-#define COLOR_TRUE       2
-#define COLOR_INDEXED    3
-#define COLOR_GREY_ALPHA 4
-#define COLOR_TRUE_ALPHA 6
-
-#define CONV_GS_4_TO_32(a) (0xFF000000 | ((a)<<20) | ((a)<<16) | ((a)<<12) |\
-						((a)<<8) | ((a)<<4) | ((a)))
-
-#define CONV_GS_2_TO_32(a) (0xFF000000 | ((a)<<22) | ((a)<<20) | ((a)<<18) |\
-						((a)<<16) | ((a)<<14) | ((a)<<12) | ((a)<<10) |\
-						((a)<<8) | ((a)<<6) | ((a)<<4) | ((a)<<2) | ((a)))
-
-#define CONV_GS_1_TO_32(a) (0xFF000000 | ((a)<<23) | ((a)<<22) | ((a)<<21) |\
-						((a)<<20) |	((a)<<19) | ((a)<<18) | ((a)<<17) |\
-						((a)<<16) |	((a)<<15) | ((a)<<14) | ((a)<<13) |\
-						((a)<<12) |	((a)<<11) | ((a)<<10) | ((a)<<9) |\
-						((a)<<8) | ((a)<<7) | ((a)<<6) | ((a)<<5) | ((a)<<4) |\
-						((a)<<3) | ((a)<<2) | ((a)<<1) | ((a)))
 
 #define PNG_HEADER_SIZE                   8
 #define PNG_CRC_SIZE                      4
-#define CLC_MAX_BITS                      7
-#define CLC_NUM_CODES                    19
-#define LEN_MAX_BITS                     15
-#define LEN_NUM_CODES                   288
-#define DIST_MAX_BITS                    15
-#define DIST_NUM_CODES                   32
-#define LEN_NUM_DISTINCT_EXTRA_BITS       7
-#define DIST_NUM_DISTINCT_EXTRA_BITS     14
-#define LEN_START_REAL_VALUES           257
-#define DIST_START_REAL_VALUES            1
 #define DISPLAY_START                  8365
 #define DISPLAY_MAX                    8372
 #define DISPLAY_MAX2                   8372
@@ -113,22 +70,6 @@
 #define CHUNK_FCTL 0x6663544C
 #define CHUNK_FDAT 0x66644154
 
-/* Colour_type options */
-#define COLOR_GREY       0
-#define COLOR_TRUE       2
-#define COLOR_INDEXED    3
-#define COLOR_GREY_ALPHA 4
-#define COLOR_TRUE_ALPHA 6
-
-/* APNG dispose_op codes */
-#define APNG_DISPOSE_OP_NONE       0
-#define APNG_DISPOSE_OP_BACKGROUND 1
-#define APNG_DISPOSE_OP_PREVIOUS   2
-
-/* APNG blend_op codes */
-#define APNG_BLEND_OP_SOURCE 0
-#define APNG_BLEND_OP_OVER   1
-
 typedef struct _bitmap_header {
 	/* What is the widht and height of the bitmap */
 	unsigned short width;
@@ -141,70 +82,19 @@ typedef struct _bitmap_header {
 	short y_coord;
 } bitmap_header;
 
-typedef struct _png_header {
-	uint32_t width;
-	uint32_t height;
-	uint32_t x_offset;
-	uint32_t y_offset;
-	unsigned char bit_depth;
-	unsigned char colour_type;
-	unsigned char compression_method;
-	unsigned char filter_method;
-	unsigned char interlace_method;
-	uint32_t bpp;
-	uint32_t bytes_pp;
-	uint32_t bytes_pl;
-	uint32_t background;
-	unsigned char background_r;
-	unsigned char background_g;
-	unsigned char background_b;
-	uint32_t *image_palette;
-	uint32_t using_transparency;
-	unsigned short transparency_r;
-	unsigned short transparency_g;
-	unsigned short transparency_b;
-} png_header;
-
-typedef struct _png_frame {
-	uint32_t *output;
-	uint32_t size;
-	uint32_t width;
-	uint32_t height;
-	uint32_t x_offset;
-	uint32_t y_offset;
-	uint32_t bytes_pp;
-	uint32_t bytes_pl;
-	uint32_t delay;
-	unsigned char dispose_op;
-	unsigned char blend_op;
-} png_frame;
-
-typedef struct _huffman_node {
-	uint32_t value;
-	uint32_t real;
-	unsigned char extra_bits;
-	struct huffman_node *leaf[2];
-} huffman_node;
-
 void display_png_frame(
 	emgd_framebuffer_t *fb_info,
 	unsigned char *fb,
 	png_header image_header,
 	png_frame *frame,
 	uint32_t prev_dispose_op);
-void decode_png_data(
+void stream_png_frame(
+	emgd_framebuffer_t *fb_info,
+	unsigned char *fb,
 	png_header *image_header,
+	png_frame *frame,
 	unsigned char *input_data,
-	png_frame *frame);
-int create_tree(
-		uint32_t max_bits,
-		uint32_t num_codes,
-		uint32_t *code_lengths,
-		uint32_t *extra_bits,
-		uint32_t *values,
-		uint32_t *real_values,
-		huffman_node **tree);
-void free_node(huffman_node *node);
+	uint32_t input_size);
 /*
 void display_splash_screen(
 	igd_framebuffer_info_t *fb_info,
@@ -220,41 +110,6 @@ void display_png_splash_screen(
 		emgd_framebuffer_t *fb_info,
 		unsigned char *fb,
 		emgd_drm_splash_screen_t *ss_data);
-void decompress_huffman(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter,
-		huffman_node **length_tree,
-		huffman_node **distance_tree,
-		unsigned char *output,
-		uint32_t *output_iter);
-void build_static_huffman_tree(
-		huffman_node **length_tree,
-		huffman_node **distance_tree);
-void build_dynamic_huffman_tree(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter,
-		huffman_node **length_tree,
-		huffman_node **distance_tree);
-void get_code_lengths(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter,
-		huffman_node **code_length_tree,
-		uint32_t num_lengths,
-		uint32_t *dynamic_lengths);
-void get_huffman_code(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter,
-		huffman_node **tree,
-		huffman_node **final_node);
-int add_node(
-		huffman_node **tree,
-		huffman_node *node,
-		uint32_t code,
-		uint32_t code_length);
 int read_int_from_stream(
 		unsigned char *stream,
 		uint32_t *iter,
@@ -267,16 +122,6 @@ int read_char_from_stream(
 		unsigned char *stream,
 		uint32_t *iter,
 		unsigned char *value);
-int read_bits_from_stream(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter,
-		uint32_t num_bits,
-		uint32_t *value);
-unsigned int read_bit_from_stream(
-		unsigned char *stream,
-		uint32_t *iter,
-		unsigned char *bit_iter);
 
 #endif
 
@@ -42,6 +42,7 @@
 #include <igd_ovl.h>
 #include "default_config.h"
 #include "splash_video.h"
+#include "splash_csc.h"
 #include "io.h"
 
 /*
@@ -118,124 +119,6 @@ unsigned char * create_rgb_picture(int width, int height)
 }
 
 
-/**
- * convert_rgb_to_yuy2
- *
- * This function will convert from a source surface buffer (XRGB32) to a dest surface
- * buffer (YUY2), given the width, height,their pointers and strides
- *
- * @param src (IN) the pointer to the source surface
- * @param dst (IN) the pointer to the destination surface
- * @param s_pitch (IN) the stride of the source surface
- * @param d_pitch (IN) the stride of the destination surface
- * @param width  (IN) the width of the surfaces
- * @param height (IN) the width of the surfaces
- *
- */
-void convert_rgb_to_yuy2(unsigned char * src, unsigned char * dest,
-		int s_pitch, int d_pitch, int width, int height)
-{
-	int loop1, loop2;
-
-	unsigned char r = 0;
-	unsigned char g = 0;
-	unsigned char b = 0;
-	unsigned char x = 0;
-
-	unsigned char y = 0;
-	unsigned char u = 0;
-	unsigned char v = 0;
-
-	long inty = 0;
-	long intu = 0;
-	long intv = 0;
-	long floatx;
-	long floatr;
-	long floatg;
-	long floatb;
-
-	for(loop1=0; loop1< height; ++loop1)
-	{
-		for(loop2=0; loop2< width/2; ++loop2)
-		{
-			/* Read RGB for the first set of pixel aligned data - YU */
-			b = src[(loop1*s_pitch)+(loop2*2*4)+0];
-			g = src[(loop1*s_pitch)+(loop2*2*4)+1];
-			r = src[(loop1*s_pitch)+(loop2*2*4)+2];
-			x = src[(loop1*s_pitch)+(loop2*2*4)+3];
-
-			floatr = r;
-			floatg = g;
-			floatb = b;
-			floatx = x;
-
-			/* calculate the conversion to YUV */
-			inty =  ((263 * floatr) + (516 * floatg) + (100 * floatb) + 1600);
-			intv =  ((450 * floatr) - (377 * floatg) - (73 * floatb) + 12800);
-			intu =  (-(151 * floatr) - (298 * floatg) + (450 * floatb) + 12800);
-			inty = inty / 100;
-			intu = intu / 100;
-			intv = intv / 100;
-			if(inty>255)
-				inty = 255;
-			if(inty<0)
-				inty = 0;
-			if(intu>255)
-				intu = 255;
-			if(intu<0)
-				intu = 0;
-			if(intv>255)
-				intv = 255;
-			if(intv<0)
-				intv = 0;
-			y = (unsigned char)inty;
-			u = (unsigned char)intu;
-
-			/* put the YU into the dest buffer */
-			dest[(loop1*(d_pitch))+(loop2*2*2)+0] = y;
-			dest[(loop1*(d_pitch))+(loop2*2*2)+1] = u;
-
-			/* for the second set of pixel aligned data - YV */
-			b = src[(loop1*s_pitch)+(loop2*2*4)+4];
-			g = src[(loop1*s_pitch)+(loop2*2*4)+5];
-			r = src[(loop1*s_pitch)+(loop2*2*4)+6];
-			x = src[(loop1*s_pitch)+(loop2*2*4)+7];
-
-			floatr = r;
-			floatg = g;
-			floatb = b;
-			floatx = x;
-
-			inty =  ((263 * floatr) + (516 * floatg) + (100 * floatb) + 1600);
-			intv =  ((450 * floatr) - (377 * floatg) - (73 * floatb) + 12800);
-			intu =  (-(151 * floatr) - (298 * floatg) + (450 * floatb) + 12800);
-			inty = inty / 100;
-			intu = intu / 100;
-			intv = intv / 100;
-			if(inty>255)
-				inty = 255;
-			if(inty<0)
-				inty = 0;
-			if(intu>255)
-				intu = 255;
-			if(intu<0)
-				intu = 0;
-			if(intv>255)
-				intv = 255;
-			if(intv<0)
-				intv = 0;
-			y = (unsigned char)inty;
-			v = (unsigned char)intv;
-
-			dest[(loop1*(d_pitch))+(loop2*2*2)+2] = y;
-			dest[(loop1*(d_pitch))+(loop2*2*2)+3] = v;
-		}
-	}
-
-	return;
-
-}
-
 /**
  * destroy_splash_video
  *
@@ -415,9 +298,10 @@ int display_splash_video(void *data)
 				}
 				/* If NOT XRGB32, then convert the rgb picture we generated */
 				if(sv_data->igd_pixel_format == IGD_PF_YUV422_PACKED_YUY2) {
-					convert_rgb_to_yuy2(rgb_ptr, surf_ptr,
+					splash_csc_xrgb_to_yuv422(rgb_ptr, surf_ptr,
 							(sv_data->src_width*4), sv_data->src_pitch,
-							sv_data->src_width, sv_data->src_height);
+							sv_data->src_width, sv_data->src_height,
+							SPLASH_CSC_BT601, SPLASH_CSC_YUY2);
 				} else {
 					for(i=0; i < sv_data->src_height; ++i) {
 						memcpy( (surf_ptr + (i *  sv_data->src_pitch)),
@@ -622,6 +622,7 @@ static int igd_set_attrs(
 		}
 
 		port->timing_table = pd_timing_table;
+		port->timing_index.table = NULL;
 		port->num_timing = get_native_dtd(pd_timing_table,
 				PI_SUPPORTED_TIMINGS, &port->fp_native_dtd,
 				PD_MODE_DTD_FP_NATIVE);
@@ -41,6 +41,7 @@
 #include <edid.h>
 #include <pi.h>
 #include "match.h"
+#include "timing_index.h"
 
 /*!
  * @addtogroup display_group
@@ -201,6 +202,23 @@ igd_timing_info_t *kms_match_resolution(
 		}
 	}
 
+	if (type == MATCH_EXACT && !(pt_info->flags & IGD_MODE_VESA) &&
+		timing_table == port->timing_table) {
+		if (timing_index_get(&port->timing_index, timing_table)) {
+			match = timing_index_match_exact(&port->timing_index, pt_info);
+			if (!match) {
+				EMGD_DEBUG("Returning with NO match");
+				return NULL;
+			}
+			EMGD_DEBUG("Returning with a match");
+			EMGD_DEBUG("Width=%d, height=%d, refresh=%d mode_number=0x%x",
+				match->width, match->height, match->refresh,
+				match->mode_number);
+			return match;
+		}
+		/* Out of memory, fall back to walking the table */
+	}
+
 	while (timing->width != IGD_TIMING_TABLE_END) {
 		if(!(timing->flags & IGD_MODE_SUPPORTED)) {
 			timing++;
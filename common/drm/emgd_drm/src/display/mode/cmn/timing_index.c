@@ -0,0 +1,188 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: timing_index.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Index of a port timing table for exact mode matching. Kept apart from
+ *  match.c so that it can be checked against the table walk outside the
+ *  kernel, see tools/display_test.
+ *-----------------------------------------------------------------------------
+ */
+
+#define MODULE_NAME hal.mode
+
+#include <io.h>
+#include <memory.h>
+
+#include <igd_core_structs.h>
+#include "timing_index.h"
+
+/*
+ * Exact matches are looked up in an index of the port's timing table,
+ * sorted by width, height and refresh with ties kept in table order. The
+ * index is rebuilt the first time it is needed after port->timing_table
+ * changes. Code replacing the table in place of a freed one must also
+ * clear port->timing_index.table, since the new table may land at the
+ * same address.
+ */
+static int timing_index_cmp(
+	igd_timing_info_t *timing,
+	unsigned short width,
+	unsigned short height,
+	unsigned short refresh)
+{
+	if (timing->width != width) {
+		return (timing->width < width) ? -1 : 1;
+	}
+	if (timing->height != height) {
+		return (timing->height < height) ? -1 : 1;
+	}
+	if (timing->refresh != refresh) {
+		return (timing->refresh < refresh) ? -1 : 1;
+	}
+	return 0;
+}
+
+/*!
+ * Returns the index of @timing_table, building it first if @index holds
+ * none or one of another table.
+ *
+ * @param index
+ * @param timing_table
+ *
+ * @return NULL if the table is empty or on allocation failure
+ * @return index entries on success
+ */
+igd_timing_info_t **timing_index_get(
+	igd_timing_index_t *index,
+	igd_timing_info_t *timing_table)
+{
+	igd_timing_info_t *timing;
+	igd_timing_info_t *cur;
+	unsigned long count = 0;
+	unsigned long i, j;
+
+	if (index->entry && index->table == timing_table) {
+		return index->entry;
+	}
+
+	timing_index_free(index);
+
+	for (timing = timing_table;
+		timing->width != IGD_TIMING_TABLE_END; timing++) {
+		count++;
+	}
+	if (!count) {
+		return NULL;
+	}
+
+	index->entry = (igd_timing_info_t **)
+		OS_ALLOC(count * sizeof(igd_timing_info_t *));
+	if (!index->entry) {
+		return NULL;
+	}
+
+	/* Insertion sort, so equal keys stay in table order */
+	for (i = 0; i < count; i++) {
+		cur = &timing_table[i];
+		for (j = i; j > 0 && timing_index_cmp(index->entry[j-1],
+				cur->width, cur->height, cur->refresh) > 0; j--) {
+			index->entry[j] = index->entry[j-1];
+		}
+		index->entry[j] = cur;
+	}
+
+	index->table = timing_table;
+	index->size = count;
+	return index->entry;
+}
+
+/*!
+ * Same result as the MATCH_EXACT table walk for non VESA modes: the first
+ * matching DTD, or failing that the last matching timing. The index must
+ * be current, see timing_index_get().
+ *
+ * @param index
+ * @param pt_info
+ *
+ * @return NULL if nothing matches
+ * @return timing on success
+ */
+igd_timing_info_t *timing_index_match_exact(
+	igd_timing_index_t *index,
+	igd_display_info_t *pt_info)
+{
+	igd_timing_info_t *timing;
+	igd_timing_info_t *match = NULL;
+	unsigned long lo = 0, hi = index->size, mid;
+	unsigned long scan_flags = IGD_SCAN_INTERLACE | IGD_PIXEL_DOUBLE |
+		IGD_LINE_DOUBLE;
+
+	/* Find the first entry not below the requested mode */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (timing_index_cmp(index->entry[mid], pt_info->width,
+				pt_info->height, pt_info->refresh) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for (; lo < index->size; lo++) {
+		timing = index->entry[lo];
+		if (timing_index_cmp(timing, pt_info->width, pt_info->height,
+				pt_info->refresh)) {
+			break;
+		}
+		if (!(timing->flags & IGD_MODE_SUPPORTED) ||
+			(timing->flags & scan_flags) != (pt_info->flags & scan_flags)) {
+			continue;
+		}
+		match = timing;
+		if ((timing->flags & PD_MODE_DTD_USER) ||
+			(timing->flags & PD_MODE_DTD)) {
+			break;
+		}
+	}
+
+	return match;
+}
+
+/*!
+ * Frees the index and marks it stale.
+ *
+ * @param index
+ *
+ * @return void
+ */
+void timing_index_free(igd_timing_index_t *index)
+{
+	if (index->entry) {
+		OS_FREE(index->entry);
+		index->entry = NULL;
+	}
+	index->table = NULL;
+	index->size = 0;
+}
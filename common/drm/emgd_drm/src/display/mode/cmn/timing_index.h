@@ -0,0 +1,46 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: timing_index.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Index of a port timing table for exact mode matching.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _TIMING_INDEX_H
+#define _TIMING_INDEX_H
+
+#include <igd_display_info.h>
+
+igd_timing_info_t **timing_index_get(
+	igd_timing_index_t *index,
+	igd_timing_info_t *timing_table);
+
+igd_timing_info_t *timing_index_match_exact(
+	igd_timing_index_t *index,
+	igd_display_info_t *pt_info);
+
+void timing_index_free(igd_timing_index_t *index);
+
+#endif
@@ -44,6 +44,7 @@
 #include "i915/intel_bios.h"
 #include "i915/intel_ringbuffer.h"
 #include "drm_emgd_private.h"
+#include "clocks_vlv_search.h"
 
 /*!
  * @addtogroup display_group
@@ -73,8 +74,6 @@ static fixed_clock_t fixed_clock_table[] =  {
 
 #endif
 
-/* #define TARGET_ERROR 48 */
-#define TARGET_ERROR 5000
 
 /*  Definitions for VLV PLL hardware */
 
@@ -104,60 +103,6 @@ static fixed_clock_t fixed_clock_table[] =  {
 
 #define POST_DIV_SEL_BITS_MASK 0x70000000
 
-typedef const struct _min_max {
-	unsigned long min;
-	unsigned long max;
-} min_max_t;
-
-
-
-typedef const struct _vlv_limits {
-	unsigned long ref_freq;
-	min_max_t m1;
-	min_max_t m2;
-	min_max_t n;
-	min_max_t p1;
-	min_max_t p2;
-	min_max_t vco;
-
-} vlv_limits_t;
-
-/* FIXME: all the limit down here may not be accurate*/
-static vlv_limits_t vlv_dac_limits[] =
-{
-	/*  ref   	m1     	m2    		n     		p1  		p2    		vco */
-	{  19200L, 	{2, 3}, {2, 255},	{1, 10}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  27000L, 	{2, 3}, {2, 255},	{1, 10}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  96000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  100000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  120000L, 	{2, 3},	{2, 255},	{1, 10}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  135000L, 	{2, 3},	{2, 255},	{1, 10}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-}; /*Based on Excel sheet.*/
-
-static vlv_limits_t vlv_hdmi_limits[] =
-{
-	/*  ref   	m1     	m2    		n     		p1  		p2    		vco */
-	{  19200L, 	{2, 3}, {11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  27000L, 	{2, 3}, {11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  96000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  100000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{2, 20},	{4000000L, 6000000L}},
-	{  120000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  135000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-
-}; /*Based on Excel sheet. */
-
-static vlv_limits_t vlv_dp_limits[] =
-{
-	/*  ref   	m1     	m2    		n     		p1  		p2    		vco */
-	{  19200L, 	{2, 3}, {11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  27000L, 	{2, 3}, {11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  96000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  100000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  120000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-	{  135000L, 	{2, 3},	{11, 156},	{1, 7}, 	{2, 3}, 	{1, 20},	{4000000L, 5994000L}},
-
-}; /*Based on Excel sheet. */
-
 
 /* Helper functions to send dividers value via IOSF SB */
 /* Not needed for now*/
@@ -165,7 +110,6 @@ static unsigned long kms_read_dpio_register(
 			unsigned char * mmio, unsigned long reg);
 static int kms_write_dpio_register(unsigned char * mmio,
 			unsigned long reg, unsigned long value);
-static unsigned long find_GCD(unsigned long larger_num, unsigned long smaller_num);
 static void pipe_protect(emgd_crtc_t *emgd_crtc, bool protect);
 
 
@@ -195,293 +139,9 @@ static void pipe_protect(emgd_crtc_t *emgd_crtc, bool protect);
 #define DPLL_LANE_CTRL3_REG             0x2820
 
 
-static int calculate_clock_vlv(
-	unsigned long dclk,
-	unsigned long ref_freq,
-	vlv_limits_t *l,
-	unsigned long *m1,
-	unsigned long *m2,
-	unsigned long *n,
-	unsigned long *p1,
-	unsigned long *p2,
-	unsigned long *post_div_sel,
-	unsigned long *actual_dclk,
-	unsigned long *target_vco,
-	unsigned long port_type,
-	unsigned long pd_type)
-{
-
-	unsigned long current_m1, current_m2, current_n, current_p1, current_p2;
-	unsigned long actual_freq = 0;
-	long freq_error = 0, min_error = 0, freq_error_min = 10000;
-	unsigned long freq_error_mod, least_freq_error_mod = 0;
-	unsigned long ulGCDFactor;
-	unsigned long temp_data_rate = 0;
-	unsigned long data_rate = 0, fastclk = 0, update_rate = 0;
-	
-	EMGD_TRACE_ENTER;
-
-	min_error = 100000L;
-
-	*m1 = 0;
-	*m2 = 0;
-	*n = 0;
-	*p1 = 0;
-	*p2 = 0;
-	*post_div_sel = 0;
-
-	/*
-	 * P2 Values
-	 * ---------
-	 * 1. DP   - P2Div = 10
-	 * 2. DAC  - 10 (< 225MHz), 5 (> 225MHz)
-	 * 3. HDMI - 10 (< 225MHz), 5 (> 225MHz)
-	 * 4. LVDS - 14 (Single Channel)
-	 *
-	 * P2 Divider value
-	 * ----------------
-	 * 00 - HDMI/DP/DAC (25M - 225M)  divide by 10 <<spec
-	 *      specifies P2=01 which is wrong>>
-	 * 01 - DAC (225M - 400M rate)  divide by 5
-	 * 10 - LVDS  single (enable the 7x clock)  divide by 14
-	 */
-	/*FIXME: Yet to be determined.*/
-	*post_div_sel = 0x001; /*FIXME: why this bit need to set to 1*/
-	data_rate = dclk * 10;
-	switch (port_type) {
-		case IGD_PORT_ANALOG:
-			if (dclk > 225000L){
-				EMGD_DEBUG("High Rest DAC data_rate = dclk * 10");
-			}
-			break;
-		case IGD_PORT_DIGITAL:
-			if (pd_type == PD_DISPLAY_DP_INT) {
-				*post_div_sel = 0x001;			
-				data_rate = dclk * 5;
-				EMGD_DEBUG("data_rate = dclk * 5");
-			} else if (pd_type == PD_DISPLAY_HDMI_INT) {
-				*post_div_sel = 0x001;			
-				/*data_rate = dclk * 5;*/
-				data_rate = dclk * 10;
-				EMGD_DEBUG("data_rate = dclk * 5");
-			}
-			break;
-		default:
-			EMGD_ERROR("Invalid port type. %lu", port_type);
-			EMGD_TRACE_EXIT;
-	}
-
-
-	if (pd_type == PD_DISPLAY_DP_INT){
-		if (dclk == RATE_270_MHZ) {
-			if (ref_freq == 27000){			
-				*m1 = 2;
-				*m2 = 100;
-				*n= 1;
-				*p1= 2;
-				*p2= 2;
-			} else if(ref_freq == 96000){
-				*m1 = 3;
-				*m2 = 75;
-				*n= 4;
-				*p1= 2;
-				*p2= 2;
-			} else if(ref_freq == 100000){
-				*m1 = 2;
-				*m2 = 27;
-				*n= 1;
-				*p1= 2;
-				*p2= 2;
-			}else {
-				EMGD_ERROR ("Clock for DP does not supported.");
-			}
- 
-		} else if (dclk == RATE_162_MHZ) {
-			if (ref_freq == 27000)	{		
-				*m1 = 2;
-				*m2 = 90;
-				*n= 1;
-				*p1= 3;
-				*p2= 2;
-			}else if(ref_freq == 96000){
-				*m1 = 2;
-				*m2 = 76;
-				*n= 3;
-				*p1= 3;
-				*p2= 2;
-			}else if(ref_freq == 100000){
-				*m1 = 3;
-				*m2 = 81;
-				*n= 5;
-				*p1= 3;
-				*p2= 2;
-			}else {
-				EMGD_ERROR ("Clock for DP does not supported.");
-			}
-		} else {
-			EMGD_ERROR ("Clock for DP does not supported.");
-		}
-		*target_vco = (ref_freq/(*n)) * (*m1) * (*m2); /*FIXME: Based on formula in excel.Need to re-confirm.*/
-		min_error = 0;
-		freq_error = freq_error_min;
-	} else {
-
-		/*TODO:  Cedarview has different formula fo DP. We are unsure about VLV. 
- 		* Will revisit this later. */
-		/* Get best m,n,p1,p2 combinations by trying all the valid combinations */
-		min_error = TARGET_ERROR;
-		least_freq_error_mod = 10000;
- 
-		for(current_m1 = l->m1.min; current_m1 <= l->m1.max; current_m1 ++) {
-			for(current_m2 = l->m2.min; current_m2 <= l->m2.max; current_m2 ++) {
-				for(current_n = l->n.min; current_n <= l->n.max; current_n++) {
-					update_rate = ref_freq/current_n;
-			
-					if ((update_rate < 19200) || (update_rate > 135000)){
-						continue;
-					}
-
-					*target_vco = (update_rate) * current_m1 * current_m2; /*FIXME: Based on formula in excel.Need to re-confirm.*/
-					if  ((*target_vco < l->vco.min) ||(*target_vco > l->vco.max)) {
-						continue;
-					}
-
-					for(current_p1 = l->p1.min; current_p1 <= l->p1.max; current_p1++) {
-						for(current_p2 = l->p2.min; current_p2 <= l->p2.max; current_p2++) {
-							if ((current_p2 == 11) || 
-								(current_p2 == 13) ||
-								(current_p2 == 15) ||
-								(current_p2 == 17) ||
-								(current_p2 == 19) || current_p2 >= 21){
-								/* Reserved value */
-								continue;
-							}
-							fastclk = (*target_vco)/(current_p1*current_p2);
-							/* Fast clock minimum is 124.8 Mhz but max is 
-							 * different between DAC and HDMI */
-							if (fastclk < 124800) { 
-								continue;
-							}
-							if (port_type == IGD_PORT_ANALOG) {
-								/* this is not in modphy excel spec - its a guess */
-								if (fastclk > 2650000) {
-									continue;
-								}
-							} else if (fastclk > 1804800 ) {
-								continue;
-							}
-
-							actual_freq = 2 * (fastclk); /*From excel sheet*/
-
-							/* Minimum clocks are at 25Mhz, but maximum is different 
-							 * for HDMI vs DAC */
-							if (actual_freq < 249600) {
-								continue;
-							}
-							if (port_type == IGD_PORT_ANALOG) {
-								/* this is not in modphy excel spec - its a guess */
-								if( actual_freq > 3500000){
-									continue;
-								}
-							} else if (actual_freq > 1804800 ) {
-								continue;
-							}
-
-							if (data_rate <= actual_freq) {
-								freq_error = actual_freq - data_rate;
-							} else if (actual_freq < data_rate) {
-								freq_error = data_rate - actual_freq;
-							}
-
-							/*Based on Excel sheet error more than 9MHz never exist.*/
-							if (freq_error > 9000){
-								continue;
-							}
-
-							/* From UMG's code: As per experiment 
- 							 * it was observed that for dot clocks
-		 					 * greater than 350Mhz, the 32 bit not was getting overflowed
-	 						 * because of multiplication with with 1000. Added GCD for
-							 * modes greater that 350M to solve this issue.
-	 						 * This is to cover the decimal accuracy
-							 * because of non-floating point calculation
-		 					 */
-							freq_error_mod = freq_error;
-							ulGCDFactor = 1;
-							if(data_rate >= 1290000)
-							{
-								ulGCDFactor = find_GCD(freq_error,actual_freq);
-							}
-
-						   	freq_error = freq_error/ulGCDFactor;
-						   	temp_data_rate = data_rate/ulGCDFactor;
-						
-							/* Prevent data get overflow causing the invalid value freq_error */	
-							if(freq_error > 4294){
-								/* "Potential overflow in clock calculation." */
-								if(port_type == IGD_PORT_ANALOG){
-									/*EMGD_ERROR("freq error OVERFLOW?!");*/
-								}
-								continue;
-							}
-
-						    /* From UMG's codes: (eq 1)tries to find the error based upon
-		 					 * the difference between difference of actual and target freq 
-	 						*/
-							freq_error = 1000000*freq_error/temp_data_rate;
-
-							if (freq_error > TARGET_ERROR){
-								continue;
-							}
-
-							if ((freq_error < min_error)) {				
-								/* values that get into registers */
-								*m1 = current_m1;
-								*m2 = current_m2;
-								*n = current_n;
-								*p1 = current_p1;
-								*p2 = current_p2;
-								freq_error_min = freq_error;
-								least_freq_error_mod = freq_error_mod;
-								min_error = freq_error;
-							
-							} else if ((freq_error == freq_error_min) &&
-					   			(freq_error_mod <= least_freq_error_mod)){
-								/* values that get into registers */
-								*m1 = current_m1;
-								*m2 = current_m2;
-								*n = current_n;
-								*p1 = current_p1;
-								*p2 = current_p2;
-
-								least_freq_error_mod = freq_error_mod;
-								min_error = freq_error;
-
-							}
-
-						} /*p2*/
-					}/*p1*/
-				} /*n*/
-			} /*m2*/
-		} /*m1*/
-	}
-	/*
-	 * No clock found that meets error requirement
-	 */
-	if (freq_error < freq_error_min) {
-		EMGD_ERROR ("No clock found.");
-		EMGD_TRACE_EXIT;
-		return 1;
-	}
-
-	EMGD_DEBUG("PLL--> dclk= %lu, n = %lu, m1= %lu, m2 = %lu, p1= %lu, p2=%lu, ref_clk=%lu\n  ", dclk, *n, *m1, *m2, *p1, *p2, ref_freq );
-	EMGD_DEBUG ("Actual Frequency = %ld, data_rate requested = %ld", (2 *( ( (ref_freq / (*n)) * (*m1) * (*m2)  ) /((*p1) * (*p2))) ), data_rate);
-	EMGD_DEBUG("min_error:%ld", min_error);
-	EMGD_TRACE_EXIT;
-	return 0;
-}
-
-
+/* Shared by all CRTCs, filled in as clocks get programmed */
+static vlv_clock_cache_t vlv_clock_cache;
+static DEFINE_SPINLOCK(vlv_clock_cache_lock);
 
 static int get_clock_vlv(
 	unsigned long dclk,
@@ -498,6 +158,9 @@ static int get_clock_vlv(
 	unsigned long port_type,
 	unsigned long pd_type)
 {
+	vlv_clock_entry_t found;
+	int hit;
+
 #ifdef CONFIG_FIXED_TABLE
 	fixed_clock_table *fixed;
 	EMGD_TRACE_ENTER;
@@ -522,11 +185,37 @@ static int get_clock_vlv(
 
 	EMGD_TRACE_ENTER;
 
-	EMGD_DEBUG("Calculating dynamic clock for clock %ld", dclk);
+	found.dclk = dclk;
+	found.ref_freq = ref_freq;
+	found.l = l;
+	found.port_type = port_type;
+	found.pd_type = pd_type;
+
+	spin_lock(&vlv_clock_cache_lock);
+	hit = vlv_clock_cache_lookup(&vlv_clock_cache, &found);
+	spin_unlock(&vlv_clock_cache_lock);
+
+	if (hit) {
+		EMGD_DEBUG("Using cached clock for clock %ld", dclk);
+	} else {
+		EMGD_DEBUG("Calculating dynamic clock for clock %ld", dclk);
+
+		vlv_clock_entry_calculate(&found, actual_dclk);
+
+		spin_lock(&vlv_clock_cache_lock);
+		vlv_clock_cache_insert(&vlv_clock_cache, &found);
+		spin_unlock(&vlv_clock_cache_lock);
+	}
 
-	if (calculate_clock_vlv(dclk, ref_freq, l, m1, m2, n, p1, p2,
-		post_div_sel,
-		actual_dclk, target_vco, port_type, pd_type)) {
+	*m1 = found.m1;
+	*m2 = found.m2;
+	*n = found.n;
+	*p1 = found.p1;
+	*p2 = found.p2;
+	*post_div_sel = found.post_div_sel;
+	*target_vco = found.target_vco;
+
+	if (found.ret) {
 		EMGD_ERROR("Could not calculate clock %ld, returning default.", dclk);
 		EMGD_TRACE_EXIT;
 		return 1;
@@ -1055,20 +744,6 @@ static void pipe_protect(emgd_crtc_t *emgd_crtc, bool protect)
 	EMGD_TRACE_EXIT;
 }
 
-/*!
- *  * Routine to calculate GCD
- *   * @param larger_num
- *    * @param smaller_num
- *     *
- *      */
-static unsigned long find_GCD(unsigned long larger_num, unsigned long smaller_num)
-{
-	if (smaller_num == 0)
-		return larger_num;
-	return (find_GCD(smaller_num, (larger_num % smaller_num)));
-}
-
-
 
 
 
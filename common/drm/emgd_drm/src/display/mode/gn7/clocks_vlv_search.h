@@ -0,0 +1,111 @@
+/*
+ *-----------------------------------------------------------------------------
+ * Filename: clocks_vlv_search.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  VLV PLL divisor search and the cache of its results. Kept apart from
+ *  the register programming in clocks_vlv.c as it depends only on its
+ *  arguments.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _CLOCKS_VLV_SEARCH_H
+#define _CLOCKS_VLV_SEARCH_H
+
+typedef const struct _min_max {
+	unsigned long min;
+	unsigned long max;
+} min_max_t;
+
+typedef const struct _vlv_limits {
+	unsigned long ref_freq;
+	min_max_t m1;
+	min_max_t m2;
+	min_max_t n;
+	min_max_t p1;
+	min_max_t p2;
+	min_max_t vco;
+
+} vlv_limits_t;
+
+#define VLV_LIMITS_COUNT 6
+
+extern vlv_limits_t vlv_dac_limits[VLV_LIMITS_COUNT];
+extern vlv_limits_t vlv_hdmi_limits[VLV_LIMITS_COUNT];
+extern vlv_limits_t vlv_dp_limits[VLV_LIMITS_COUNT];
+
+/*
+ * The divisor search only depends on its inputs, and a handful of dot
+ * clocks make up nearly every mode set (hotplug storms on multi-display
+ * setups repeat the same few), so recent results are remembered. The
+ * cache does no locking of its own.
+ */
+#define VLV_CLOCK_CACHE_SIZE 16
+
+typedef struct _vlv_clock_entry {
+	/* Key */
+	unsigned long dclk;
+	unsigned long ref_freq;
+	vlv_limits_t *l;
+	unsigned long port_type;
+	unsigned long pd_type;
+	/* Result of calculate_clock_vlv() */
+	int ret;
+	unsigned long m1, m2, n, p1, p2;
+	unsigned long post_div_sel;
+	unsigned long target_vco;
+} vlv_clock_entry_t;
+
+typedef struct _vlv_clock_cache {
+	vlv_clock_entry_t entry[VLV_CLOCK_CACHE_SIZE];
+	/* Filled round-robin */
+	unsigned int next;
+} vlv_clock_cache_t;
+
+int calculate_clock_vlv(
+	unsigned long dclk,
+	unsigned long ref_freq,
+	vlv_limits_t *l,
+	unsigned long *m1,
+	unsigned long *m2,
+	unsigned long *n,
+	unsigned long *p1,
+	unsigned long *p2,
+	unsigned long *post_div_sel,
+	unsigned long *actual_dclk,
+	unsigned long *target_vco,
+	unsigned long port_type,
+	unsigned long pd_type);
+
+void vlv_clock_entry_calculate(
+	vlv_clock_entry_t *entry,
+	unsigned long *actual_dclk);
+int vlv_clock_cache_lookup(
+	vlv_clock_cache_t *cache,
+	vlv_clock_entry_t *entry);
+void vlv_clock_cache_insert(
+	vlv_clock_cache_t *cache,
+	vlv_clock_entry_t *entry);
+
+#endif
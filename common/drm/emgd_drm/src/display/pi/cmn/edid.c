@@ -909,6 +909,7 @@ int parse_vendor_data_block(edid_t *edid)
 	int offset=0;
 	uint32_t hdmi_id;
 	unsigned char *edid_ext = edid->cea->vendor_data_block;
+	int size = edid->cea->vendor_block.vendor_block_size;
 	int hdmi_xx_len, hdmi_3d_len;
 	int multi_present = 0;
 
@@ -916,6 +917,10 @@ int parse_vendor_data_block(edid_t *edid)
 	edid->cea->s3d_format = 0;
 
 	/* Note: Header byte are not included in vendor_data_block */
+	if (size < 3) {
+		EMGD_ERROR("Vendor specific data block too short!");
+		return 1;
+	}
 	hdmi_id = edid_ext[0] | (edid_ext[1] << 8) | edid_ext[2] << 16;
 
 	EMGD_DEBUG("HDMI ID: 0x%x", hdmi_id);
@@ -927,7 +932,7 @@ int parse_vendor_data_block(edid_t *edid)
 	}
 
 	/* Check if HDMI Video_present is set */
-	if (!(edid_ext[7] & BIT(5))) {
+	if (size < 8 || !(edid_ext[7] & BIT(5))) {
 		EMGD_ERROR("No additional video format capabilities in vendor specific data block!");
 		return 1;
 	}
@@ -946,7 +951,7 @@ int parse_vendor_data_block(edid_t *edid)
 	}
 
 	/* Check for the S3D_Present flag */
-	if (edid_ext[offset] & BIT(7)) {
+	if (offset < size && (edid_ext[offset] & BIT(7))) {
 		EMGD_DEBUG("S3D monitor present");
 		edid->cea->s3d_supported = 1;
 	} else {
@@ -956,8 +961,10 @@ int parse_vendor_data_block(edid_t *edid)
 
 	/* Collect S3D capabilities of the monitor */
 	multi_present = (edid_ext[offset] & (BIT(5)|BIT(6))) >> 5 ;
-	hdmi_xx_len = (edid_ext[offset + 1] & 0xE0) >> 5;
-	hdmi_3d_len = edid_ext[offset + 1] & 0x1F;
+	if (offset + 1 < size) {
+		hdmi_xx_len = (edid_ext[offset + 1] & 0xE0) >> 5;
+		hdmi_3d_len = edid_ext[offset + 1] & 0x1F;
+	}
 
 	/* For now only mandatory 3D formats are supported
 	 * if 3D_present flag is set to 1 */
@@ -994,8 +1001,11 @@ int read_data_block_collection(unsigned char *buffer,
 	}
 
 	*list = OS_ALLOC((sizeof(char)*total_bytes));
+	if(*list == NULL){
+		return 0;
+	}
 	for(i=0;i<total_blocks;i++){
-		OS_MEMCPY(*list+i, buffer, block_size);
+		OS_MEMCPY(*list+i*block_size, buffer, block_size);
 		buffer+=block_size;
 	}
 
@@ -1122,14 +1132,19 @@ int edid_parse_cea (unsigned char *buffer,
 	//            | ...    | Vendor Specific Data block Payload               |
 	// -----------+-----------------------------------------------------------+*/
 	data_block_buffer=&buffer[4];
-	/* Start reading data block collection */
+	/* Start reading data block collection, which ends where the DTDs
+	 * start */
 	i = 0;
-	while(i<offset){
+	while(i+4 < offset){
 		unsigned int total_bytes;
 		tag_code = (unsigned int)*data_block_buffer & 0xE0;
 		total_bytes = (unsigned int)*data_block_buffer & 0x1F;
 		data_block_buffer++;
 		i++;
+		if (i + 4 + total_bytes > offset) {
+			EMGD_ERROR("Data block runs past the DTD offset");
+			break;
+		}
 
 		switch(tag_code){
 			case CEA_VIDEO_DATA_BLOCK:
@@ -1180,7 +1195,7 @@ int edid_parse_cea (unsigned char *buffer,
 			case CEA_SPEAKER_DATA_BLOCK:
 				EMGD_DEBUG("CEA_SPEAKER_DATA_BLOCK tag code found!");
 				/* Reading Speaker Data Descriptor block */
-				for(j=0; j<3; j++){
+				for(j=0; j<3 && j<total_bytes; j++){
 					edid->cea->speaker_alloc_block[j] = data_block_buffer[j];
 				}
 				break;
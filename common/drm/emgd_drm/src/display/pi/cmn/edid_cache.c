@@ -0,0 +1,219 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: edid_cache.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Per port cache of the last successful EDID parse. Kept apart from pi.c
+ *  so that it can be checked against edid_parse() outside the kernel, see
+ *  tools/display_test.
+ *-----------------------------------------------------------------------------
+ */
+
+#define MODULE_NAME hal.dpd
+
+#include <io.h>
+#include <memory.h>
+
+#include <igd_core_structs.h>
+#include <edid.h>
+#include "edid_cache.h"
+
+/*
+ * The parse of a monitor's EDID only depends on the EDID bytes, the
+ * timing list it filters and the port's upscaling flag. Hotplug and detect
+ * re-run it for the same monitor over and over, so the result of the last
+ * successful parse is kept per port.
+ *
+ * The key is block 0, which ends in the extension count and its own
+ * checksum, compared byte for byte. An unchanged monitor then costs the
+ * read of block 0 and nothing else. When there is a CEA extension only its
+ * checksum byte is read and compared, the block itself is read only on a
+ * miss.
+ *
+ * The timing list is rebuilt from the same sources on every detect, so
+ * rather than walking it the caller names those sources with a
+ * generation, see update_timing_table(). The flags the parse left on the
+ * list are restored on a hit.
+ *
+ * The parse allocates the CEA extension, which calculate_eld() later
+ * updates in place, so the cache keeps its own copy and a hit hands out a
+ * fresh one, just as a parse would. The descriptor lists it points to are
+ * only read after the parse and never freed, so those are shared.
+ */
+struct _pi_edid_cache {
+	unsigned char   block0[128];
+	unsigned char   ext_checksum;
+	unsigned char   upscale;
+	/* Timing list the parse ran against, and the flags it left behind */
+	unsigned long   timings_gen;
+	unsigned long   num_timings;
+	unsigned long   *flags;
+	edid_t          edid;
+	cea_extension_t cea;
+};
+
+/*!
+ * Reuse the previous parse if this port is still showing the same EDID.
+ *
+ * @param cache the port's cache, may be NULL
+ * @param firmware_data block 0, followed by the extension's checksum at
+ *   offset 255 if block 0 announces one extension
+ * @param timing_table timing list to mark, as the parse would
+ * @param timings_gen generation of the timing list
+ * @param upscale
+ * @param edid receives the parsed EDID
+ *
+ * @return 1 on a hit
+ * @return 0 if the extension has to be read and the EDID parsed
+ */
+int edid_cache_lookup(pi_edid_cache_t *cache,
+	unsigned char *firmware_data, igd_timing_info_t *timing_table,
+	unsigned long timings_gen, unsigned char upscale, edid_t *edid)
+{
+	cea_extension_t *cea = NULL;
+	unsigned long i;
+
+	if (!cache || cache->upscale != upscale ||
+		cache->timings_gen != timings_gen ||
+		cache->block0[127] != firmware_data[127] ||
+		OS_MEMCMP(cache->block0, firmware_data, 128)) {
+		return 0;
+	}
+	if (firmware_data[0x7e] == 0x1 &&
+		cache->ext_checksum != firmware_data[255]) {
+		return 0;
+	}
+
+	if (cache->edid.cea) {
+		cea = (cea_extension_t *) OS_ALLOC(sizeof(cea_extension_t));
+		if (!cea) {
+			return 0;
+		}
+		OS_MEMCPY(cea, &cache->cea, sizeof(cea_extension_t));
+	}
+
+	OS_MEMCPY(edid, &cache->edid, sizeof(edid_t));
+	edid->cea = cea;
+
+	for (i = 0; i < cache->num_timings &&
+		timing_table->width != IGD_TIMING_TABLE_END; i++) {
+		timing_table->flags = cache->flags[i];
+		timing_table++;
+		if (timing_table->width == IGD_TIMING_TABLE_END &&
+			timing_table->private.extn_ptr) {
+			timing_table = timing_table->private.extn_ptr;
+		}
+	}
+
+	return 1;
+}
+
+/*!
+ * Remember a successful parse.
+ *
+ * @param cache the port's cache, allocated on first use
+ * @param firmware_data the EDID that was parsed, with the extension block
+ *   if block 0 announces one
+ * @param timing_table timing list as the parse left it
+ * @param timings_gen generation of the timing list
+ * @param upscale
+ * @param edid the parse result
+ *
+ * @return void
+ */
+void edid_cache_store(pi_edid_cache_t **cache,
+	unsigned char *firmware_data, igd_timing_info_t *timing_table,
+	unsigned long timings_gen, unsigned char upscale, edid_t *edid)
+{
+	pi_edid_cache_t *c = *cache;
+	igd_timing_info_t *timing;
+	unsigned long count = 0, i;
+
+	if (!c) {
+		c = (pi_edid_cache_t *) OS_ALLOC(sizeof(pi_edid_cache_t));
+		if (!c) {
+			return;
+		}
+		OS_MEMSET(c, 0, sizeof(pi_edid_cache_t));
+		*cache = c;
+	}
+
+	for (timing = timing_table; timing &&
+		timing->width != IGD_TIMING_TABLE_END; count++) {
+		timing++;
+		if (timing->width == IGD_TIMING_TABLE_END &&
+			timing->private.extn_ptr) {
+			timing = timing->private.extn_ptr;
+		}
+	}
+
+	if (!c->flags || c->num_timings < count) {
+		if (c->flags) {
+			OS_FREE(c->flags);
+		}
+		c->flags = (unsigned long *) OS_ALLOC(
+			(count ? count : 1) * sizeof(unsigned long));
+		if (!c->flags) {
+			edid_cache_free(cache);
+			return;
+		}
+	}
+
+	OS_MEMCPY(c->block0, firmware_data, 128);
+	c->ext_checksum = firmware_data[255];
+	c->upscale = upscale;
+	c->timings_gen = timings_gen;
+	c->num_timings = count;
+	OS_MEMCPY(&c->edid, edid, sizeof(edid_t));
+	if (edid->cea) {
+		OS_MEMCPY(&c->cea, edid->cea, sizeof(cea_extension_t));
+	}
+
+	for (i = 0; i < count; i++) {
+		c->flags[i] = timing_table->flags;
+		timing_table++;
+		if (timing_table->width == IGD_TIMING_TABLE_END &&
+			timing_table->private.extn_ptr) {
+			timing_table = timing_table->private.extn_ptr;
+		}
+	}
+}
+
+/*!
+ * Frees the cache.
+ *
+ * @param cache
+ *
+ * @return void
+ */
+void edid_cache_free(pi_edid_cache_t **cache)
+{
+	if (*cache) {
+		if ((*cache)->flags) {
+			OS_FREE((*cache)->flags);
+		}
+		OS_FREE(*cache);
+		*cache = NULL;
+	}
+}
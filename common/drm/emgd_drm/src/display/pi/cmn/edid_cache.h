@@ -0,0 +1,56 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: edid_cache.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Per port cache of the last successful EDID parse.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _EDID_CACHE_H
+#define _EDID_CACHE_H
+
+#include <edid.h>
+
+typedef struct _pi_edid_cache pi_edid_cache_t;
+
+int edid_cache_lookup(
+	pi_edid_cache_t *cache,
+	unsigned char *firmware_data,
+	igd_timing_info_t *timing_table,
+	unsigned long timings_gen,
+	unsigned char upscale,
+	edid_t *edid);
+
+void edid_cache_store(
+	pi_edid_cache_t **cache,
+	unsigned char *firmware_data,
+	igd_timing_info_t *timing_table,
+	unsigned long timings_gen,
+	unsigned char upscale,
+	edid_t *edid);
+
+void edid_cache_free(pi_edid_cache_t **cache);
+
+#endif
@@ -47,6 +47,8 @@
 #include <edid.h>
 #include <displayid.h>
 #include "i2c_dispatch.h"
+#include "timing_index.h"
+#include "edid_cache.h"
 #include <igd_vga.h>
 
 
@@ -63,7 +65,8 @@ typedef struct _pi_context {
 
 /* Function to filter the modes using EDID or DisplayID*/
 int get_firmware_timings(igd_display_port_t *port,
-	unsigned char  *firmware_data, pd_timing_t *timing_table);
+	unsigned char  *firmware_data, pd_timing_t *timing_table,
+	unsigned long timings_gen);
 
 int pi_pd_init(igd_display_port_t *port, unsigned long port_feature,
 	unsigned long second_port_feature, int drm_load_time);
@@ -142,6 +145,8 @@ static void pi_shutdown(igd_context_t *context)
 			port->pd_context = NULL;
 			port->timing_table = NULL;
 			port->num_timing = 0;
+			timing_index_free(&port->timing_index);
+			edid_cache_free(&port->edid_cache);
 			if (port->edid) {
 				OS_FREE(port->edid);
 				port->edid = NULL;
@@ -586,6 +591,7 @@ int pi_pd_register(pd_driver_t *pd_driver)
 				port->i2c_speed    = prev_i2c_speed;
 				port->mult_port    = NULL;
 				port->timing_table = NULL;
+				port->timing_index.table = NULL;
 				port->num_timing   = 0;
 				if (port->callback) {
 					OS_FREE(port->callback);
@@ -1144,18 +1150,23 @@ unsigned long get_magic_cookie(pd_driver_t *pd_driver)
  * Function to filter modes based on EDID or DisplayID
  *
  * @param port
- * @param firmware_data
+ * @param firmware_data block 0, as read
  * @param timing_table
+ * @param timings_gen names the sources timing_table was built from, for
+ *   the EDID cache
  *
  * @return 0 on success
  * @return -IGD_ERROR_EDID, -IGD_ERROR_NOMEM on failure
  */
 int get_firmware_timings(igd_display_port_t *port,
-	unsigned char *firmware_data, igd_timing_info_t *timing_table)
+	unsigned char *firmware_data, igd_timing_info_t *timing_table,
+	unsigned long timings_gen)
 {
 	edid_t         *edid;
 	displayid_t    *displayid;
 	int            ret = -1;
+	unsigned char  upscale;
+	int            cached = 0;
 
 	EMGD_TRACE_ENTER;
 
@@ -1187,12 +1198,30 @@ int get_firmware_timings(igd_display_port_t *port,
 		firmware_dump(firmware_data, 256);
 #endif
 		/* This is EDID data */
-		ret = edid_parse(firmware_data, edid, timing_table, 0,
-			(unsigned char) (port->pd_driver->flags&PD_FLAG_UP_SCALING?1:0));
-		if (ret == EDID_READ_AGAIN) {
-			/* Check to see if there is an extension block */
+		upscale = (unsigned char)
+			(port->pd_driver->flags&PD_FLAG_UP_SCALING?1:0);
+		/* An unchanged monitor is known by block 0. Of the extension
+		 * block only the checksum is read unless the lookup misses */
+		if((firmware_data[0x7e] == 0x1)){
+			pi_context->i2c_dispatch->i2c_read_regs(
+				pi_context->igd_context,
+				port,
+				port->ddc_reg,      /* DDC register */
+				port->ddc_speed,    /* DDC speed */
+				port->ddc_dab,      /* Data Addr Byte*/
+				0xff,                /* Register */
+				&firmware_data[255], /* Values */
+				1);					 /* extension checksum */
+		}
+		if (edid_cache_lookup(port->edid_cache, firmware_data, timing_table,
+				timings_gen, upscale, edid)) {
+			EMGD_DEBUG("Using cached EDID parse for port %s",
+				port->port_name);
+			ret = 0;
+			cached = 1;
+		} else {
 			if((firmware_data[0x7e] == 0x1)){
-				ret = pi_context->i2c_dispatch->i2c_read_regs(
+				pi_context->i2c_dispatch->i2c_read_regs(
 					pi_context->igd_context,
 					port,
 					port->ddc_reg,      /* DDC register */
@@ -1201,6 +1230,12 @@ int get_firmware_timings(igd_display_port_t *port,
 					0x80,                /* Register */
 					&firmware_data[128], /* Values */
 					128);				 /* next 128 bytes include extension */
+			}
+			ret = edid_parse(firmware_data, edid, timing_table, 0, upscale);
+		}
+		if (ret == EDID_READ_AGAIN) {
+			/* Check to see if there is an extension block */
+			if((firmware_data[0x7e] == 0x1)){
 				ret = edid_ext_parse(&firmware_data[128], edid, timing_table,0,
 					(unsigned char)(port->pd_driver->flags&
 					PD_FLAG_UP_SCALING?1:0));
@@ -1217,6 +1252,11 @@ int get_firmware_timings(igd_display_port_t *port,
 			return -IGD_ERROR_EDID;
 		}
 
+		if (!cached) {
+			edid_cache_store(&port->edid_cache, firmware_data, timing_table,
+				timings_gen, upscale, edid);
+		}
+
 		if(edid->cea) {
 			port->s3d_supported = edid->cea->s3d_supported;
 			port->s3d_format = edid->cea->s3d_format;
@@ -1688,6 +1728,7 @@ int update_timing_table(igd_display_port_t *port)
 	unsigned char      num_firmware_timings = 0;
 	igd_display_params_t *display_params = NULL;
 	unsigned long edid_flags;
+	unsigned long timings_gen;
 	igd_param_t *init_params;
 
 	EMGD_TRACE_ENTER;
@@ -1770,7 +1811,13 @@ int update_timing_table(igd_display_port_t *port)
 	/* Include EDID timings and filter modes */
 	if (edid_flags & IGD_DISPLAY_USE_EDID) {
 		EMGD_DEBUG("Using EDID-DTDs ");
-		ret = get_firmware_timings(port, firmware_data, final_timings);
+		/* The list is rebuilt from the same CRT table and the port's
+		 * fixed user DTDs on every call, so these flags are all that
+		 * can change it between two parses */
+		timings_gen = edid_flags &
+			(IGD_DISPLAY_USE_STD_TIMINGS | IGD_DISPLAY_USE_USERDTDS);
+		ret = get_firmware_timings(port, firmware_data, final_timings,
+			timings_gen);
 		if ((ret == EDID_ERROR_PARSE) ||
 			(ret == DISPLAYID_ERROR_PARSE)) {
 			/* Second chance here */
@@ -1787,7 +1834,8 @@ int update_timing_table(igd_display_port_t *port)
 				firmware_data,      /* Values */
 				128);               /* Num bytes to read */
 
-			ret = get_firmware_timings(port, firmware_data, final_timings);
+			ret = get_firmware_timings(port, firmware_data, final_timings,
+				timings_gen);
 		}
 		if (port->firmware_type == PI_FIRMWARE_EDID) {
 			firmware_timings = port->edid->timings;
@@ -1890,6 +1938,7 @@ int update_timing_table(igd_display_port_t *port)
 
 	/* Now save the timings in port */
 	port->timing_table = pd_timing_table;
+	port->timing_index.table = NULL;
 	port->num_timing = get_native_dtd(pd_timing_table,
 			PI_SUPPORTED_TIMINGS, &port->fp_native_dtd, PD_MODE_DTD_FP_NATIVE);
 
@@ -0,0 +1,585 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: edid_cache_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Fuzzes the EDID parse cache (src/display/pi/cmn/edid_cache.c). A digital
+ *  monitor EDID with a CEA extension is mutated at random, usually with the
+ *  checksums fixed up so that the parse gets past them, and every EDID is
+ *  read and parsed both directly and through the cache the way
+ *  get_firmware_timings() does. Monitors are often repeated so that the
+ *  cache hits. Both must give the same result, edid_t, CEA extension and
+ *  timing list flags, unless only the extension changed and kept its
+ *  checksum, which the cache takes for the same monitor. After each run the
+ *  CEA extension handed out is scribbled over, as calculate_eld() does,
+ *  which must not leak into later hits. Finally the time and the DDC bytes
+ *  read of a parse are reported next to those of a cache hit.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <io.h>
+#include <memory.h>
+#include <igd_core_structs.h>
+#include <edid.h>
+#include "edid_cache.h"
+
+#define NUM_MONITORS   8
+#define NUM_USER_DTDS  3
+#define BENCH_LOOPS    20000
+
+/* From mode_table.c */
+extern igd_timing_info_t crt_timing_table[];
+extern int crt_timing_table_size;
+
+static pi_edid_cache_t *cache;
+/* What the monitor returns on DDC, and pi.c's buffer it is read into */
+static unsigned char monitor_edid[256];
+static unsigned char firmware_data[256];
+static unsigned long ddc_bytes;
+/* The EDID the cache last stored */
+static unsigned char stored[256];
+static int have_stored;
+static unsigned long hits, misses, parse_errors, same_checksum;
+
+void *test_os_alloc(size_t size)
+{
+	return malloc(size);
+}
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void ddc_read(unsigned char reg, unsigned char *values,
+	unsigned long num)
+{
+	memcpy(values, &monitor_edid[reg], num);
+	ddc_bytes += num;
+}
+
+static void fix_checksum(unsigned char *block)
+{
+	unsigned char sum = 0;
+	int i;
+
+	for (i = 0; i < 127; i++) {
+		sum += block[i];
+	}
+	block[127] = (unsigned char)(0x100 - sum);
+}
+
+static void put_dtd(unsigned char *d, unsigned long dclk, int hactive,
+	int hblank, int hso, int hsw, int vactive, int vblank, int vso, int vsw,
+	unsigned char flags)
+{
+	d[0] = (dclk / 10) & 0xff;
+	d[1] = (dclk / 10) >> 8;
+	d[2] = hactive & 0xff;
+	d[3] = hblank & 0xff;
+	d[4] = ((hactive >> 8) << 4) | (hblank >> 8);
+	d[5] = vactive & 0xff;
+	d[6] = vblank & 0xff;
+	d[7] = ((vactive >> 8) << 4) | (vblank >> 8);
+	d[8] = hso & 0xff;
+	d[9] = hsw & 0xff;
+	d[10] = ((vso & 0xf) << 4) | (vsw & 0xf);
+	d[11] = ((hso >> 8) << 6) | ((hsw >> 8) << 4) | ((vso >> 4) << 2) |
+		(vsw >> 4);
+	d[12] = 0x10;
+	d[13] = 0x09;
+	d[14] = 0x32;
+	d[15] = 0;
+	d[16] = 0;
+	d[17] = flags;
+}
+
+/*
+ * A 1080p HDMI monitor: EDID 1.4 with established, standard and detailed
+ * timings, a range limits and a name descriptor, and a CEA extension with
+ * video, audio, speaker and HDMI vendor data blocks.
+ */
+static void make_monitor(unsigned char *edid)
+{
+	static const unsigned char header[8] = {
+		0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00
+	};
+	static const unsigned char std_timings[16] = {
+		0xd1, 0xc0, 0x81, 0xc0, 0x81, 0x80, 0x95, 0x00,
+		0xa9, 0x40, 0xb3, 0x00, 0x71, 0x4f, 0x01, 0x01
+	};
+	static const unsigned char cea_blocks[] = {
+		/* Video: 1080p60 native, 720p60, 480p60, 1080i60, 1080p50 */
+		0x45, 0x90, 0x04, 0x03, 0x05, 0x1f,
+		/* Audio: 2 channel LPCM, 32-48 kHz, 16/20/24 bit */
+		0x23, 0x09, 0x07, 0x07,
+		/* Speaker allocation: front left/right */
+		0x83, 0x01, 0x00, 0x00,
+		/* HDMI vendor block, physical address 1.0.0.0, 3D present */
+		0x68, 0x03, 0x0c, 0x00, 0x10, 0x00, 0x80, 0x00, 0x80
+	};
+	unsigned char *ext = edid + 128;
+
+	memset(edid, 0, 256);
+	memcpy(edid, header, 8);
+	edid[8] = 0x10;     /* "DEL" */
+	edid[9] = 0xac;
+	edid[10] = 0x42;
+	edid[11] = 0xa0;
+	edid[12] = 0x4c;
+	edid[16] = 12;
+	edid[17] = 24;
+	edid[18] = 1;
+	edid[19] = 4;
+	edid[20] = 0xa5;    /* digital, 8 bpc, DisplayPort */
+	edid[21] = 53;
+	edid[22] = 30;
+	edid[23] = 0x78;
+	edid[24] = 0x3a;
+	edid[35] = 0x21;    /* 640x480@60, 800x600@60, 1024x768@60 */
+	edid[36] = 0x08;
+	edid[37] = 0x00;
+	memcpy(&edid[38], std_timings, sizeof(std_timings));
+	put_dtd(&edid[54], 148500, 1920, 280, 88, 44, 1080, 45, 4, 5, 0x1e);
+	/* Range limits: 56-76 Hz, 30-83 kHz, 170 MHz */
+	edid[72 + 3] = 0xfd;
+	edid[72 + 5] = 56;
+	edid[72 + 6] = 76;
+	edid[72 + 7] = 30;
+	edid[72 + 8] = 83;
+	edid[72 + 9] = 17;
+	edid[72 + 10] = 0x0a;
+	/* Name */
+	edid[90 + 3] = 0xfc;
+	memcpy(&edid[90 + 5], "TEST 1080P\n  ", 13);
+	/* Serial */
+	edid[108 + 3] = 0xff;
+	memcpy(&edid[108 + 5], "0123456789\n  ", 13);
+	edid[126] = 1;
+	fix_checksum(edid);
+
+	ext[0] = 0x02;
+	ext[1] = 0x03;
+	ext[2] = 4 + sizeof(cea_blocks);
+	ext[3] = 0xf1;
+	memcpy(&ext[4], cea_blocks, sizeof(cea_blocks));
+	put_dtd(&ext[ext[2]], 74250, 1280, 370, 110, 40, 720, 30, 5, 5, 0x1e);
+	fix_checksum(ext);
+}
+
+/*
+ * Random byte changes, mostly inside the parsed parts of both blocks.
+ * Usually the checksums are fixed afterwards, otherwise the parse stops at
+ * them.
+ */
+static void mutate(unsigned char *edid)
+{
+	int i, n = 1 + rand() % 4;
+	int pos;
+
+	for (i = 0; i < n; i++) {
+		switch (rand() % 4) {
+		case 0:
+			pos = 128 + rand() % 127;
+			break;
+		case 1:
+			pos = 8 + rand() % 119;
+			break;
+		case 2:
+			/* Extension count: none, one or an unsupported two */
+			pos = 126;
+			break;
+		default:
+			pos = rand() % 256;
+			break;
+		}
+		if (pos == 126) {
+			edid[pos] = rand() % 3;
+		} else if (rand() % 2) {
+			edid[pos] ^= 1 << (rand() % 8);
+		} else {
+			edid[pos] = rand();
+		}
+	}
+	if (rand() % 8) {
+		fix_checksum(edid);
+		fix_checksum(edid + 128);
+	}
+}
+
+/*
+ * A copy of the CRT table, as update_timing_table() makes, optionally
+ * behind a list of user DTDs.
+ */
+static igd_timing_info_t *make_list(int with_user, igd_timing_info_t **free1,
+	igd_timing_info_t **free2)
+{
+	igd_timing_info_t *std, *user;
+	int i;
+
+	std = malloc(crt_timing_table_size);
+	memcpy(std, crt_timing_table, crt_timing_table_size);
+	*free1 = std;
+	*free2 = NULL;
+	if (!with_user) {
+		return std;
+	}
+
+	user = calloc(NUM_USER_DTDS + 1, sizeof(igd_timing_info_t));
+	for (i = 0; i < NUM_USER_DTDS; i++) {
+		user[i] = crt_timing_table[i * 7];
+		user[i].refresh += i;
+		user[i].flags |= PD_MODE_DTD_USER;
+	}
+	user[NUM_USER_DTDS].width = IGD_TIMING_TABLE_END;
+	user[NUM_USER_DTDS].private.extn_ptr = std;
+	*free2 = user;
+	return user;
+}
+
+/*
+ * The EDID branch of get_firmware_timings(), with or without the cache,
+ * from the read of block 0 in update_timing_table() on. The rest of the
+ * buffer holds whatever the last read left there.
+ */
+static int parse(igd_timing_info_t *list, unsigned long timings_gen,
+	unsigned char upscale, edid_t *edid, int use_cache, int *hit)
+{
+	int ret;
+
+	memset(edid, 0, sizeof(*edid));
+	*hit = 0;
+	ddc_bytes = 0;
+	ddc_read(0, firmware_data, 128);
+	if (use_cache && firmware_data[0x7e] == 0x1) {
+		ddc_read(0xff, &firmware_data[255], 1);
+	}
+	if (use_cache && edid_cache_lookup(cache, firmware_data, list,
+			timings_gen, upscale, edid)) {
+		ret = 0;
+		*hit = 1;
+	} else {
+		if (firmware_data[0x7e] == 0x1) {
+			ddc_read(0x80, &firmware_data[128], 128);
+		}
+		ret = edid_parse(firmware_data, edid, list, 0, upscale);
+	}
+	if (ret == EDID_READ_AGAIN) {
+		if (firmware_data[0x7e] == 0x1) {
+			ret = edid_ext_parse(&firmware_data[128], edid, list, 0, upscale);
+		} else {
+			ret = 0;
+		}
+	}
+	if (ret) {
+		return ret;
+	}
+	if (use_cache && !*hit) {
+		edid_cache_store(&cache, firmware_data, list, timings_gen, upscale,
+			edid);
+		memcpy(stored, firmware_data, 256);
+		have_stored = 1;
+	}
+	return 0;
+}
+
+static int same_cea(cea_extension_t *a, cea_extension_t *b)
+{
+	cea_extension_t ca, cb;
+
+	if (!a || !b) {
+		return a == b;
+	}
+	if (a->total_short_video_desc != b->total_short_video_desc ||
+		a->total_short_audio_desc != b->total_short_audio_desc ||
+		!a->vendor_data_block != !b->vendor_data_block) {
+		return 0;
+	}
+	if (a->total_short_video_desc > 0 &&
+		memcmp(a->short_video_desc, b->short_video_desc,
+			a->total_short_video_desc)) {
+		return 0;
+	}
+	if (a->total_short_audio_desc > 0 &&
+		memcmp(a->short_audio_desc, b->short_audio_desc,
+			a->total_short_audio_desc * 3)) {
+		return 0;
+	}
+
+	/* The lists are separate allocations, compare the rest */
+	ca = *a;
+	cb = *b;
+	ca.short_video_desc = cb.short_video_desc = NULL;
+	ca.short_audio_desc = cb.short_audio_desc = NULL;
+	ca.vendor_data_block = cb.vendor_data_block = NULL;
+	return !memcmp(&ca, &cb, sizeof(ca));
+}
+
+static int same_edid(edid_t *a, edid_t *b)
+{
+	edid_t ea = *a, eb = *b;
+
+	ea.cea = eb.cea = NULL;
+	return !memcmp(&ea, &eb, sizeof(ea)) && same_cea(a->cea, b->cea);
+}
+
+static int same_flags(igd_timing_info_t *a, igd_timing_info_t *b)
+{
+	while (a->width != IGD_TIMING_TABLE_END) {
+		if (a->width != b->width || a->flags != b->flags) {
+			return 0;
+		}
+		a++;
+		b++;
+		if (a->width == IGD_TIMING_TABLE_END && a->private.extn_ptr) {
+			a = a->private.extn_ptr;
+			b = b->private.extn_ptr;
+		}
+	}
+	return b->width == IGD_TIMING_TABLE_END;
+}
+
+/* What calculate_eld() and calculate_infoframes() do to the extension */
+static void scribble_cea(cea_extension_t *cea)
+{
+	if (!cea) {
+		return;
+	}
+	cea->LPCM_CAD[0] = 0x9;
+	cea->speaker_alloc_block[0] = 0x1;
+	cea->pixel_rep = rand();
+	cea->colorimetry = rand();
+	cea->quantization = rand();
+	cea->video_code = rand();
+	cea->aspect_ratio = rand();
+	memset(cea->misc_data, rand(), sizeof(cea->misc_data));
+}
+
+/*
+ * Reads and parses monitor_edid both ways. The user DTDs stand for the
+ * timing list sources update_timing_table() names with the generation.
+ */
+static int check_one(unsigned char upscale, int with_user,
+	unsigned long *cached_ddc_bytes)
+{
+	igd_timing_info_t *list_a, *list_b, *f[4];
+	edid_t edid_a, edid_b;
+	int ret_a, ret_b, hit_a, hit_b, failed = 0;
+	int same_key;
+
+	/* Another extension behind the same block 0 and checksum */
+	same_key = have_stored && monitor_edid[0x7e] == 0x1 &&
+		!memcmp(stored, monitor_edid, 128) &&
+		stored[255] == monitor_edid[255] &&
+		memcmp(&stored[128], &monitor_edid[128], 128);
+
+	list_a = make_list(with_user, &f[0], &f[1]);
+	list_b = make_list(with_user, &f[2], &f[3]);
+
+	ret_a = parse(list_a, with_user, upscale, &edid_a, 0, &hit_a);
+	ret_b = parse(list_b, with_user, upscale, &edid_b, 1, &hit_b);
+	if (cached_ddc_bytes) {
+		*cached_ddc_bytes = ddc_bytes;
+	}
+
+	if (hit_b) {
+		hits++;
+	} else {
+		misses++;
+	}
+	if (ret_a) {
+		parse_errors++;
+	}
+
+	if (hit_b && same_key) {
+		same_checksum++;
+	} else if (ret_a != ret_b) {
+		printf("FAIL: parse returned %d, cached path %d\n", ret_a, ret_b);
+		failed = 1;
+	} else if (!ret_a && !same_edid(&edid_a, &edid_b)) {
+		printf("FAIL: edid_t differs (%s)\n", hit_b ? "hit" : "miss");
+		failed = 1;
+	} else if (!ret_a && !same_flags(list_a, list_b)) {
+		printf("FAIL: timing flags differ (%s)\n", hit_b ? "hit" : "miss");
+		failed = 1;
+	}
+
+	scribble_cea(edid_b.cea);
+	free(edid_a.cea);
+	free(edid_b.cea);
+	free(f[0]);
+	free(f[1]);
+	free(f[2]);
+	free(f[3]);
+	return failed;
+}
+
+static int run_fuzz(unsigned long iterations)
+{
+	unsigned char monitors[NUM_MONITORS][256];
+	unsigned long i;
+	unsigned char upscale = 0;
+	int with_user = 0, m = 0, failed = 0;
+
+	for (i = 0; i < NUM_MONITORS; i++) {
+		make_monitor(monitors[i]);
+		if (i) {
+			mutate(monitors[i]);
+		}
+	}
+
+	for (i = 0; i < iterations && !failed; i++) {
+		/*
+		 * Mostly the same monitor again, as hotplug and detect see it,
+		 * otherwise another known one or a fresh mutation.
+		 */
+		switch (rand() % 8) {
+		case 0:
+			m = rand() % NUM_MONITORS;
+			break;
+		case 1:
+			m = rand() % NUM_MONITORS;
+			make_monitor(monitors[m]);
+			mutate(monitors[m]);
+			break;
+		case 2:
+			upscale = rand() % 2;
+			break;
+		case 3:
+			with_user = rand() % 2;
+			break;
+		default:
+			break;
+		}
+		memcpy(monitor_edid, monitors[m], 256);
+		failed += check_one(upscale, with_user, NULL);
+	}
+
+	return failed;
+}
+
+/*
+ * An unchanged monitor is served from the cache after reading block 0 and
+ * the extension's checksum, but an extension changed behind the same
+ * block 0 must not hit.
+ */
+static int run_extension_change(void)
+{
+	unsigned long bytes;
+	int failed = 0;
+
+	make_monitor(monitor_edid);
+	failed += check_one(0, 0, &bytes);
+	hits = 0;
+	failed += check_one(0, 0, &bytes);
+	if (!hits || bytes != 129) {
+		printf("FAIL: unchanged monitor %s after reading %lu bytes\n",
+			hits ? "hit" : "missed", bytes);
+		failed++;
+	}
+
+	monitor_edid[128 + 5] = 0x10;    /* 1080p60 no longer native */
+	fix_checksum(monitor_edid + 128);
+	hits = 0;
+	failed += check_one(0, 0, &bytes);
+	if (hits) {
+		printf("FAIL: extension change served from the cache\n");
+		failed++;
+	}
+	return failed;
+}
+
+static void run_bench(void)
+{
+	igd_timing_info_t *list, *f[2];
+	edid_t edid;
+	double start, parse_ms, hit_ms;
+	unsigned long parse_bytes, hit_bytes;
+	int i, hit;
+
+	make_monitor(monitor_edid);
+	list = make_list(1, &f[0], &f[1]);
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		parse(list, 1, 0, &edid, 0, &hit);
+		free(edid.cea);
+	}
+	parse_ms = (now_ms() - start) / BENCH_LOOPS;
+	parse_bytes = ddc_bytes;
+
+	parse(list, 1, 0, &edid, 1, &hit);
+	free(edid.cea);
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		parse(list, 1, 0, &edid, 1, &hit);
+		free(edid.cea);
+	}
+	hit_ms = (now_ms() - start) / BENCH_LOOPS;
+	hit_bytes = ddc_bytes;
+
+	printf("HDMI EDID with CEA extension: parse %.2f us, cache hit %.2f us\n",
+		parse_ms * 1e3, hit_ms * 1e3);
+	printf("DDC bytes read: parse %lu, cache hit %lu\n",
+		parse_bytes, hit_bytes);
+	free(f[0]);
+	free(f[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+	unsigned long iterations = 200000;
+	int failed;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	if (argc > 2) {
+		iterations = strtoul(argv[2], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	failed = run_extension_change();
+	failed += run_fuzz(iterations);
+
+	printf("%lu EDIDs, %lu cache hits (%lu with only the extension "
+		"changed), %lu misses, %lu rejected by the parse, %d failures\n",
+		hits + misses, hits, same_checksum, misses, parse_errors, failed);
+	if (failed) {
+		return 1;
+	}
+
+	run_bench();
+	edid_cache_free(&cache);
+	return 0;
+}
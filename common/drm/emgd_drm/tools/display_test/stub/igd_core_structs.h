@@ -0,0 +1,60 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: igd_core_structs.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Stands in for include/igd_core_structs.h, which pulls in the DRM headers,
+ *  when kernel sources are built by the tests in this directory. Only the
+ *  types and constants those sources use are provided.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _IGD_CORE_STRUCTS_H
+#define _IGD_CORE_STRUCTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <igd_display_info.h>
+#include <igd_pd.h>
+#include <displayid.h>
+#include <general.h>
+#include <igd_init.h>
+
+/* From igd_display_pipeline.h */
+#define IGD_PORT_ANALOG   0x00001000
+#define IGD_PORT_DIGITAL  0x00002000
+#define RATE_270_MHZ      270000
+#define RATE_162_MHZ      162000
+
+/* Only what displayid.c reads */
+typedef struct _igd_display_port {
+	displayid_t *displayid;
+} igd_display_port_t;
+
+/* From igd_display_pipeline.h */
+void convert_color_char(unsigned char *edid_ptr, displayid_t *did);
+
+#define BIT(n)            (1UL << (n))
+
+#endif
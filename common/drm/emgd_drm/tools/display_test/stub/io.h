@@ -0,0 +1,47 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: io.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Stands in for include/io.h when kernel sources are built by the tests in
+ *  this directory. Tracing and debug output compile away, errors go to
+ *  stderr.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _IO_H
+#define _IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define EMGD_TRACE_ENTER
+#define EMGD_TRACE_EXIT
+#define EMGD_DEBUG(...) do {} while(0)
+#define EMGD_ERROR(...) do { fprintf(stderr, __VA_ARGS__); \
+	fprintf(stderr, "\n"); } while(0)
+#define EMGD_ERROR_EXIT(...) EMGD_ERROR(__VA_ARGS__)
+
+#endif
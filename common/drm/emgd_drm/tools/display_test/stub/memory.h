@@ -0,0 +1,50 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: memory.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Stands in for src/include/memory.h when kernel sources are built by the
+ *  tests in this directory. OS_ALLOC() goes through test_os_alloc(), which
+ *  the tests define so that they can count allocations or fail them.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _MEMORY_H
+#define _MEMORY_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+void *test_os_alloc(size_t size);
+
+#define OS_ALLOC(a) test_os_alloc(a)
+#define OS_ZALLOC(a) memset(test_os_alloc(a), 0, (a))
+#define OS_FREE(a) free(a)
+#define OS_MEMCPY(d, s, n) memcpy(d, s, n)
+#define OS_MEMSET(d, v, n) memset(d, v, n)
+#define OS_MEMCMP(a, b, n) memcmp(a, b, n)
+#define OS_OFFSETOF(t, m) offsetof(t, m)
+
+#endif
@@ -0,0 +1,358 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: timing_index_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Checks the timing index used by kms_match_resolution() for exact
+ *  matches (src/display/mode/cmn/timing_index.c) against the MATCH_EXACT
+ *  table walk it replaces. Random tables with duplicate modes, DTDs and
+ *  random flags are looked up for modes in and out of the table, as are
+ *  the CRT and CEA mode tables, and a table replaced at the same address
+ *  must not be served from the stale index. Finally the time of a lookup
+ *  in the CRT table is reported for both.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <io.h>
+#include <memory.h>
+#include <igd_core_structs.h>
+#include "timing_index.h"
+
+#define MAX_TIMINGS    120
+#define NUM_TABLES     2000
+#define NUM_QUERIES    50
+#define BENCH_LOOPS    200000
+
+/* From mode_table.c */
+extern igd_timing_info_t crt_timing_table[];
+extern igd_timing_info_t cea_timing_table[];
+
+static int fail_allocs;
+static unsigned long allocs;
+
+void *test_os_alloc(size_t size)
+{
+	if (fail_allocs) {
+		return NULL;
+	}
+	allocs++;
+	return malloc(size);
+}
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/*
+ * The non VESA MATCH_EXACT part of the table walk in
+ * kms_match_resolution(), as it was before the index.
+ */
+static igd_timing_info_t *walk_match_exact(
+	igd_timing_info_t *timing,
+	igd_display_info_t *pt_info)
+{
+	igd_timing_info_t *match = NULL;
+
+	while (timing->width != IGD_TIMING_TABLE_END) {
+		if(!(timing->flags & IGD_MODE_SUPPORTED)) {
+			timing++;
+			continue;
+		}
+
+		/* If exact match found, then break the loop */
+		if((timing->width == pt_info->width) &&
+			(timing->height == pt_info->height) &&
+			(timing->refresh == pt_info->refresh) &&
+			(
+				(timing->flags &
+					(IGD_SCAN_INTERLACE|IGD_PIXEL_DOUBLE|
+						IGD_LINE_DOUBLE)) ==
+				(pt_info->flags &
+					(IGD_SCAN_INTERLACE|IGD_PIXEL_DOUBLE|
+						IGD_LINE_DOUBLE)))) {
+			match = timing;
+
+			/* If exact match found, then break the loop */
+			if ((timing->flags & PD_MODE_DTD_USER) ||
+				(timing->flags & PD_MODE_DTD)) {
+				break;
+			}
+		}
+		timing++;
+	}
+
+	return match;
+}
+
+static unsigned long random_flags(void)
+{
+	static const unsigned long bits[] = {
+		IGD_MODE_SUPPORTED, IGD_MODE_SUPPORTED, IGD_MODE_SUPPORTED,
+		PD_MODE_DTD, PD_MODE_DTD_USER, IGD_SCAN_INTERLACE,
+		IGD_PIXEL_DOUBLE, IGD_LINE_DOUBLE, IGD_MODE_VESA,
+		PD_MODE_DTD_FP_NATIVE
+	};
+	unsigned long flags = 0;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(bits) / sizeof(bits[0]); i++) {
+		if (rand() % 3 == 0) {
+			flags |= bits[i];
+		}
+	}
+	return flags;
+}
+
+/*
+ * Modes are drawn from a small set so that tables hold duplicates, with
+ * and without DTD flags, and so that queries often hit.
+ */
+static void random_timing(igd_timing_info_t *t)
+{
+	static const unsigned short widths[] = { 640, 800, 1024, 1280, 1920 };
+	static const unsigned short heights[] = { 480, 600, 768, 1080 };
+	static const unsigned short refreshes[] = { 50, 60, 75 };
+
+	memset(t, 0, sizeof(*t));
+	t->width = widths[rand() % 5];
+	t->height = heights[rand() % 4];
+	t->refresh = refreshes[rand() % 3];
+	t->flags = random_flags();
+}
+
+static int check_query(
+	igd_timing_index_t *index,
+	igd_timing_info_t *table,
+	igd_display_info_t *pt_info)
+{
+	igd_timing_info_t *walked, *indexed = NULL;
+
+	walked = walk_match_exact(table, pt_info);
+	if (timing_index_get(index, table)) {
+		indexed = timing_index_match_exact(index, pt_info);
+	}
+	if (indexed != walked) {
+		printf("FAIL: %ux%u@%u flags 0x%lx: walk gives entry %ld, "
+			"index %ld\n", pt_info->width, pt_info->height,
+			pt_info->refresh, pt_info->flags,
+			walked ? (long)(walked - table) : -1L,
+			indexed ? (long)(indexed - table) : -1L);
+		return 1;
+	}
+	return 0;
+}
+
+static int run_random(unsigned long *queries)
+{
+	igd_timing_info_t *table;
+	igd_timing_index_t index;
+	igd_display_info_t pt_info;
+	int i, j, count, failed = 0;
+
+	memset(&index, 0, sizeof(index));
+	table = malloc((MAX_TIMINGS + 1) * sizeof(igd_timing_info_t));
+	if (!table) {
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	for (i = 0; i < NUM_TABLES; i++) {
+		count = rand() % (MAX_TIMINGS + 1);
+		for (j = 0; j < count; j++) {
+			random_timing(&table[j]);
+		}
+		memset(&table[count], 0, sizeof(table[count]));
+		table[count].width = IGD_TIMING_TABLE_END;
+
+		/*
+		 * Each table reuses the address of the one before, the way a
+		 * freed and reallocated timing table can, so the index has to
+		 * be marked stale like pi.c and kms_mode.c do.
+		 */
+		index.table = NULL;
+
+		for (j = 0; j < NUM_QUERIES; j++) {
+			if (count && rand() % 2) {
+				pt_info = table[rand() % count];
+				pt_info.flags &= ~IGD_MODE_VESA;
+			} else {
+				random_timing(&pt_info);
+				pt_info.flags &= ~IGD_MODE_VESA;
+			}
+			failed += check_query(&index, table, &pt_info);
+			(*queries)++;
+		}
+	}
+
+	timing_index_free(&index);
+	free(table);
+	return failed;
+}
+
+static int run_table(igd_timing_info_t *table, unsigned long *queries)
+{
+	igd_timing_index_t index;
+	igd_display_info_t pt_info;
+	igd_timing_info_t *t;
+	int failed = 0;
+
+	memset(&index, 0, sizeof(index));
+	for (t = table; t->width != IGD_TIMING_TABLE_END; t++) {
+		pt_info = *t;
+		pt_info.flags &= ~IGD_MODE_VESA;
+		failed += check_query(&index, table, &pt_info);
+		pt_info.refresh++;
+		failed += check_query(&index, table, &pt_info);
+		*queries += 2;
+	}
+	timing_index_free(&index);
+	return failed;
+}
+
+/* Flags are checked at lookup time, not when the index is built */
+static int run_flags_in_place(void)
+{
+	igd_timing_info_t table[3];
+	igd_timing_index_t index;
+	igd_display_info_t pt_info;
+
+	memset(table, 0, sizeof(table));
+	memset(&index, 0, sizeof(index));
+	table[0].width = table[1].width = 1280;
+	table[0].height = table[1].height = 720;
+	table[0].refresh = table[1].refresh = 60;
+	table[0].flags = IGD_MODE_SUPPORTED;
+	table[1].flags = IGD_MODE_SUPPORTED;
+	table[2].width = IGD_TIMING_TABLE_END;
+	pt_info = table[0];
+
+	if (check_query(&index, table, &pt_info)) {
+		return 1;
+	}
+	table[1].flags &= ~IGD_MODE_SUPPORTED;
+	table[0].flags |= PD_MODE_DTD;
+	if (check_query(&index, table, &pt_info)) {
+		return 1;
+	}
+	table[0].flags &= ~IGD_MODE_SUPPORTED;
+	if (check_query(&index, table, &pt_info)) {
+		return 1;
+	}
+	timing_index_free(&index);
+	return 0;
+}
+
+/* Without memory there is no index and the caller walks the table */
+static int run_alloc_failure(void)
+{
+	igd_timing_index_t index;
+
+	memset(&index, 0, sizeof(index));
+	fail_allocs = 1;
+	if (timing_index_get(&index, crt_timing_table) || index.table) {
+		printf("FAIL: index built without memory\n");
+		fail_allocs = 0;
+		return 1;
+	}
+	fail_allocs = 0;
+	if (!timing_index_get(&index, crt_timing_table)) {
+		printf("FAIL: index not built once memory is back\n");
+		return 1;
+	}
+	timing_index_free(&index);
+	return 0;
+}
+
+static void run_bench(void)
+{
+	igd_timing_index_t index;
+	igd_display_info_t pt_info;
+	igd_timing_info_t *t, *match = NULL;
+	unsigned long count = 0;
+	double start, walk_ms, index_ms;
+	int i;
+
+	memset(&index, 0, sizeof(index));
+	for (t = crt_timing_table; t->width != IGD_TIMING_TABLE_END; t++) {
+		count++;
+	}
+	/* The last mode is the worst case for the walk */
+	pt_info = crt_timing_table[count - 1];
+	pt_info.flags &= ~IGD_MODE_VESA;
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		match = walk_match_exact(crt_timing_table, &pt_info);
+	}
+	walk_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		if (timing_index_get(&index, crt_timing_table)) {
+			match = timing_index_match_exact(&index, &pt_info);
+		}
+	}
+	index_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	printf("%ux%u@%u in the %lu entry CRT table: walk %.3f us, "
+		"index %.3f us (%s)\n", pt_info.width, pt_info.height,
+		pt_info.refresh, count, walk_ms * 1e3, index_ms * 1e3,
+		match ? "found" : "not found");
+	timing_index_free(&index);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+	unsigned long queries = 0;
+	int failed;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	failed = run_random(&queries);
+	failed += run_table(crt_timing_table, &queries);
+	failed += run_table(cea_timing_table, &queries);
+	failed += run_flags_in_place();
+	failed += run_alloc_failure();
+
+	printf("%lu queries, %d failures\n", queries, failed);
+	if (failed) {
+		return 1;
+	}
+
+	run_bench();
+	return 0;
+}
@@ -0,0 +1,335 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: vlv_clock_ref.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  The VLV divisor search as it was before it moved to clocks_vlv_search.c,
+ *  kept verbatim apart from its name. vlv_clock_test checks the current
+ *  search and its cache against it.
+ *-----------------------------------------------------------------------------
+ */
+
+#define MODULE_NAME hal.mode
+
+#include <io.h>
+
+#include <igd_core_structs.h>
+
+#include "clocks_vlv_search.h"
+
+/* #define TARGET_ERROR 48 */
+#define TARGET_ERROR 5000
+
+static unsigned long find_GCD(unsigned long larger_num, unsigned long smaller_num)
+{
+	if (smaller_num == 0)
+		return larger_num;
+	return (find_GCD(smaller_num, (larger_num % smaller_num)));
+}
+
+int ref_calculate_clock_vlv(
+	unsigned long dclk,
+	unsigned long ref_freq,
+	vlv_limits_t *l,
+	unsigned long *m1,
+	unsigned long *m2,
+	unsigned long *n,
+	unsigned long *p1,
+	unsigned long *p2,
+	unsigned long *post_div_sel,
+	unsigned long *actual_dclk,
+	unsigned long *target_vco,
+	unsigned long port_type,
+	unsigned long pd_type)
+{
+
+	unsigned long current_m1, current_m2, current_n, current_p1, current_p2;
+	unsigned long actual_freq = 0;
+	long freq_error = 0, min_error = 0, freq_error_min = 10000;
+	unsigned long freq_error_mod, least_freq_error_mod = 0;
+	unsigned long ulGCDFactor;
+	unsigned long temp_data_rate = 0;
+	unsigned long data_rate = 0, fastclk = 0, update_rate = 0;
+	
+	EMGD_TRACE_ENTER;
+
+	min_error = 100000L;
+
+	*m1 = 0;
+	*m2 = 0;
+	*n = 0;
+	*p1 = 0;
+	*p2 = 0;
+	*post_div_sel = 0;
+
+	/*
+	 * P2 Values
+	 * ---------
+	 * 1. DP   - P2Div = 10
+	 * 2. DAC  - 10 (< 225MHz), 5 (> 225MHz)
+	 * 3. HDMI - 10 (< 225MHz), 5 (> 225MHz)
+	 * 4. LVDS - 14 (Single Channel)
+	 *
+	 * P2 Divider value
+	 * ----------------
+	 * 00 - HDMI/DP/DAC (25M - 225M)  divide by 10 <<spec
+	 *      specifies P2=01 which is wrong>>
+	 * 01 - DAC (225M - 400M rate)  divide by 5
+	 * 10 - LVDS  single (enable the 7x clock)  divide by 14
+	 */
+	/*FIXME: Yet to be determined.*/
+	*post_div_sel = 0x001; /*FIXME: why this bit need to set to 1*/
+	data_rate = dclk * 10;
+	switch (port_type) {
+		case IGD_PORT_ANALOG:
+			if (dclk > 225000L){
+				EMGD_DEBUG("High Rest DAC data_rate = dclk * 10");
+			}
+			break;
+		case IGD_PORT_DIGITAL:
+			if (pd_type == PD_DISPLAY_DP_INT) {
+				*post_div_sel = 0x001;			
+				data_rate = dclk * 5;
+				EMGD_DEBUG("data_rate = dclk * 5");
+			} else if (pd_type == PD_DISPLAY_HDMI_INT) {
+				*post_div_sel = 0x001;			
+				/*data_rate = dclk * 5;*/
+				data_rate = dclk * 10;
+				EMGD_DEBUG("data_rate = dclk * 5");
+			}
+			break;
+		default:
+			EMGD_ERROR("Invalid port type. %lu", port_type);
+			EMGD_TRACE_EXIT;
+	}
+
+
+	if (pd_type == PD_DISPLAY_DP_INT){
+		if (dclk == RATE_270_MHZ) {
+			if (ref_freq == 27000){			
+				*m1 = 2;
+				*m2 = 100;
+				*n= 1;
+				*p1= 2;
+				*p2= 2;
+			} else if(ref_freq == 96000){
+				*m1 = 3;
+				*m2 = 75;
+				*n= 4;
+				*p1= 2;
+				*p2= 2;
+			} else if(ref_freq == 100000){
+				*m1 = 2;
+				*m2 = 27;
+				*n= 1;
+				*p1= 2;
+				*p2= 2;
+			}else {
+				EMGD_ERROR ("Clock for DP does not supported.");
+			}
+ 
+		} else if (dclk == RATE_162_MHZ) {
+			if (ref_freq == 27000)	{		
+				*m1 = 2;
+				*m2 = 90;
+				*n= 1;
+				*p1= 3;
+				*p2= 2;
+			}else if(ref_freq == 96000){
+				*m1 = 2;
+				*m2 = 76;
+				*n= 3;
+				*p1= 3;
+				*p2= 2;
+			}else if(ref_freq == 100000){
+				*m1 = 3;
+				*m2 = 81;
+				*n= 5;
+				*p1= 3;
+				*p2= 2;
+			}else {
+				EMGD_ERROR ("Clock for DP does not supported.");
+			}
+		} else {
+			EMGD_ERROR ("Clock for DP does not supported.");
+		}
+		*target_vco = (ref_freq/(*n)) * (*m1) * (*m2); /*FIXME: Based on formula in excel.Need to re-confirm.*/
+		min_error = 0;
+		freq_error = freq_error_min;
+	} else {
+
+		/*TODO:  Cedarview has different formula fo DP. We are unsure about VLV. 
+ 		* Will revisit this later. */
+		/* Get best m,n,p1,p2 combinations by trying all the valid combinations */
+		min_error = TARGET_ERROR;
+		least_freq_error_mod = 10000;
+ 
+		for(current_m1 = l->m1.min; current_m1 <= l->m1.max; current_m1 ++) {
+			for(current_m2 = l->m2.min; current_m2 <= l->m2.max; current_m2 ++) {
+				for(current_n = l->n.min; current_n <= l->n.max; current_n++) {
+					update_rate = ref_freq/current_n;
+			
+					if ((update_rate < 19200) || (update_rate > 135000)){
+						continue;
+					}
+
+					*target_vco = (update_rate) * current_m1 * current_m2; /*FIXME: Based on formula in excel.Need to re-confirm.*/
+					if  ((*target_vco < l->vco.min) ||(*target_vco > l->vco.max)) {
+						continue;
+					}
+
+					for(current_p1 = l->p1.min; current_p1 <= l->p1.max; current_p1++) {
+						for(current_p2 = l->p2.min; current_p2 <= l->p2.max; current_p2++) {
+							if ((current_p2 == 11) || 
+								(current_p2 == 13) ||
+								(current_p2 == 15) ||
+								(current_p2 == 17) ||
+								(current_p2 == 19) || current_p2 >= 21){
+								/* Reserved value */
+								continue;
+							}
+							fastclk = (*target_vco)/(current_p1*current_p2);
+							/* Fast clock minimum is 124.8 Mhz but max is 
+							 * different between DAC and HDMI */
+							if (fastclk < 124800) { 
+								continue;
+							}
+							if (port_type == IGD_PORT_ANALOG) {
+								/* this is not in modphy excel spec - its a guess */
+								if (fastclk > 2650000) {
+									continue;
+								}
+							} else if (fastclk > 1804800 ) {
+								continue;
+							}
+
+							actual_freq = 2 * (fastclk); /*From excel sheet*/
+
+							/* Minimum clocks are at 25Mhz, but maximum is different 
+							 * for HDMI vs DAC */
+							if (actual_freq < 249600) {
+								continue;
+							}
+							if (port_type == IGD_PORT_ANALOG) {
+								/* this is not in modphy excel spec - its a guess */
+								if( actual_freq > 3500000){
+									continue;
+								}
+							} else if (actual_freq > 1804800 ) {
+								continue;
+							}
+
+							if (data_rate <= actual_freq) {
+								freq_error = actual_freq - data_rate;
+							} else if (actual_freq < data_rate) {
+								freq_error = data_rate - actual_freq;
+							}
+
+							/*Based on Excel sheet error more than 9MHz never exist.*/
+							if (freq_error > 9000){
+								continue;
+							}
+
+							/* From UMG's code: As per experiment 
+ 							 * it was observed that for dot clocks
+		 					 * greater than 350Mhz, the 32 bit not was getting overflowed
+	 						 * because of multiplication with with 1000. Added GCD for
+							 * modes greater that 350M to solve this issue.
+	 						 * This is to cover the decimal accuracy
+							 * because of non-floating point calculation
+		 					 */
+							freq_error_mod = freq_error;
+							ulGCDFactor = 1;
+							if(data_rate >= 1290000)
+							{
+								ulGCDFactor = find_GCD(freq_error,actual_freq);
+							}
+
+						   	freq_error = freq_error/ulGCDFactor;
+						   	temp_data_rate = data_rate/ulGCDFactor;
+						
+							/* Prevent data get overflow causing the invalid value freq_error */	
+							if(freq_error > 4294){
+								/* "Potential overflow in clock calculation." */
+								if(port_type == IGD_PORT_ANALOG){
+									/*EMGD_ERROR("freq error OVERFLOW?!");*/
+								}
+								continue;
+							}
+
+						    /* From UMG's codes: (eq 1)tries to find the error based upon
+		 					 * the difference between difference of actual and target freq 
+	 						*/
+							freq_error = 1000000*freq_error/temp_data_rate;
+
+							if (freq_error > TARGET_ERROR){
+								continue;
+							}
+
+							if ((freq_error < min_error)) {				
+								/* values that get into registers */
+								*m1 = current_m1;
+								*m2 = current_m2;
+								*n = current_n;
+								*p1 = current_p1;
+								*p2 = current_p2;
+								freq_error_min = freq_error;
+								least_freq_error_mod = freq_error_mod;
+								min_error = freq_error;
+							
+							} else if ((freq_error == freq_error_min) &&
+					   			(freq_error_mod <= least_freq_error_mod)){
+								/* values that get into registers */
+								*m1 = current_m1;
+								*m2 = current_m2;
+								*n = current_n;
+								*p1 = current_p1;
+								*p2 = current_p2;
+
+								least_freq_error_mod = freq_error_mod;
+								min_error = freq_error;
+
+							}
+
+						} /*p2*/
+					}/*p1*/
+				} /*n*/
+			} /*m2*/
+		} /*m1*/
+	}
+	/*
+	 * No clock found that meets error requirement
+	 */
+	if (freq_error < freq_error_min) {
+		EMGD_ERROR ("No clock found.");
+		EMGD_TRACE_EXIT;
+		return 1;
+	}
+
+	EMGD_DEBUG("PLL--> dclk= %lu, n = %lu, m1= %lu, m2 = %lu, p1= %lu, p2=%lu, ref_clk=%lu\n  ", dclk, *n, *m1, *m2, *p1, *p2, ref_freq );
+	EMGD_DEBUG ("Actual Frequency = %ld, data_rate requested = %ld", (2 *( ( (ref_freq / (*n)) * (*m1) * (*m2)  ) /((*p1) * (*p2))) ), data_rate);
+	EMGD_DEBUG("min_error:%ld", min_error);
+	EMGD_TRACE_EXIT;
+	return 0;
+}
@@ -0,0 +1,273 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: vlv_clock_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Checks the VLV divisor search and the clock cache in front of it. Every
+ *  dot clock in the mode tables, plus the DP link rates, is run through
+ *  the lookup, calculate and insert sequence of get_clock_vlv() for each
+ *  port type and reference frequency, twice over so that the second pass
+ *  comes from the cache. Each result must match a direct call to
+ *  calculate_clock_vlv() and the search from before the cache was added.
+ *  Finally the time of a cache hit is reported next to a full search.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <io.h>
+#include <igd_core_structs.h>
+#include "clocks_vlv_search.h"
+
+#define BENCH_LOOPS 20
+
+int ref_calculate_clock_vlv(
+	unsigned long dclk,
+	unsigned long ref_freq,
+	vlv_limits_t *l,
+	unsigned long *m1,
+	unsigned long *m2,
+	unsigned long *n,
+	unsigned long *p1,
+	unsigned long *p2,
+	unsigned long *post_div_sel,
+	unsigned long *actual_dclk,
+	unsigned long *target_vco,
+	unsigned long port_type,
+	unsigned long pd_type);
+
+/* From mode_table.c */
+extern igd_timing_info_t crt_timing_table[];
+extern igd_timing_info_t vga_timing_table[];
+extern igd_timing_info_t cea_timing_table[];
+
+typedef struct _port_case {
+	const char *name;
+	vlv_limits_t *limits;
+	unsigned long port_type;
+	unsigned long pd_type;
+} port_case_t;
+
+static port_case_t ports[] = {
+	{ "dac", vlv_dac_limits, IGD_PORT_ANALOG, 0 },
+	{ "hdmi", vlv_hdmi_limits, IGD_PORT_DIGITAL, PD_DISPLAY_HDMI_INT },
+	{ "dp", vlv_dp_limits, IGD_PORT_DIGITAL, PD_DISPLAY_DP_INT },
+};
+#define NUM_PORTS (sizeof(ports) / sizeof(ports[0]))
+
+static igd_timing_info_t *tables[] = {
+	crt_timing_table, vga_timing_table, cea_timing_table
+};
+#define NUM_TABLES (sizeof(tables) / sizeof(tables[0]))
+
+static unsigned long dp_rates[] = { RATE_162_MHZ, RATE_270_MHZ };
+#define NUM_DP_RATES (sizeof(dp_rates) / sizeof(dp_rates[0]))
+
+static vlv_clock_cache_t cache;
+static unsigned long hits, misses;
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* The body of get_clock_vlv() without its locking */
+static void get_clock(vlv_clock_entry_t *found)
+{
+	unsigned long actual_dclk = 0;
+
+	if (vlv_clock_cache_lookup(&cache, found)) {
+		hits++;
+	} else {
+		misses++;
+		vlv_clock_entry_calculate(found, &actual_dclk);
+		vlv_clock_cache_insert(&cache, found);
+	}
+}
+
+static int same_result(vlv_clock_entry_t *a, vlv_clock_entry_t *b)
+{
+	return a->ret == b->ret && a->m1 == b->m1 && a->m2 == b->m2 &&
+		a->n == b->n && a->p1 == b->p1 && a->p2 == b->p2 &&
+		a->post_div_sel == b->post_div_sel &&
+		a->target_vco == b->target_vco;
+}
+
+static void print_entry(const char *what, vlv_clock_entry_t *e)
+{
+	printf("  %-9s ret %d m1 %lu m2 %lu n %lu p1 %lu p2 %lu post_div %lu "
+		"vco %lu\n", what, e->ret, e->m1, e->m2, e->n, e->p1, e->p2,
+		e->post_div_sel, e->target_vco);
+}
+
+static int check_clock(unsigned long dclk, port_case_t *port, int r)
+{
+	vlv_clock_entry_t key, cached, direct, ref;
+	unsigned long actual_dclk = 0;
+
+	memset(&key, 0, sizeof(key));
+	key.dclk = dclk;
+	key.ref_freq = port->limits[r].ref_freq;
+	key.l = &port->limits[r];
+	key.port_type = port->port_type;
+	key.pd_type = port->pd_type;
+
+	cached = key;
+	get_clock(&cached);
+
+	direct = key;
+	vlv_clock_entry_calculate(&direct, &actual_dclk);
+
+	ref = key;
+	ref.ret = ref_calculate_clock_vlv(dclk, ref.ref_freq, ref.l,
+		&ref.m1, &ref.m2, &ref.n, &ref.p1, &ref.p2, &ref.post_div_sel,
+		&actual_dclk, &ref.target_vco, ref.port_type, ref.pd_type);
+
+	if (!same_result(&cached, &direct) || !same_result(&direct, &ref)) {
+		printf("FAIL: %s dclk %lu ref %lu\n", port->name, dclk,
+			key.ref_freq);
+		print_entry("cache", &cached);
+		print_entry("search", &direct);
+		print_entry("reference", &ref);
+		return 1;
+	}
+	return 0;
+}
+
+static int dp_ref_supported(unsigned long ref_freq)
+{
+	return ref_freq == 27000 || ref_freq == 96000 || ref_freq == 100000;
+}
+
+/* Runs every dot clock for every port and reference frequency once */
+static int run_pass(unsigned long *cases)
+{
+	igd_timing_info_t *t;
+	unsigned int i, p, r;
+	int failed = 0;
+
+	for (p = 0; p < NUM_PORTS; p++) {
+		for (r = 0; r < VLV_LIMITS_COUNT; r++) {
+			/*
+			 * DP only ever asks for the link rates, and only has
+			 * divisors for them at 27, 96 and 100 MHz. Anything else
+			 * divides by zero in both searches.
+			 */
+			if (ports[p].pd_type == PD_DISPLAY_DP_INT) {
+				if (!dp_ref_supported(ports[p].limits[r].ref_freq)) {
+					continue;
+				}
+			} else {
+				for (i = 0; i < NUM_TABLES; i++) {
+					for (t = tables[i];
+						t->width != IGD_TIMING_TABLE_END; t++) {
+						failed += check_clock(t->dclk, &ports[p], r);
+						(*cases)++;
+					}
+				}
+			}
+			for (i = 0; i < NUM_DP_RATES; i++) {
+				failed += check_clock(dp_rates[i], &ports[p], r);
+				(*cases)++;
+			}
+		}
+	}
+	return failed;
+}
+
+/*
+ * The same dot clock on one port and reference frequency, as repeated
+ * hotplugs or mode sets ask for it.
+ */
+static int run_repeat(unsigned long *cases)
+{
+	int failed = 0, i;
+
+	for (i = 0; i < 4 * VLV_CLOCK_CACHE_SIZE; i++) {
+		failed += check_clock(148500, &ports[1], 0);
+		(*cases)++;
+	}
+	return failed;
+}
+
+static void run_bench(void)
+{
+	vlv_clock_entry_t key, e;
+	unsigned long actual_dclk = 0;
+	double start, search_ms, hit_ms;
+	int i;
+
+	memset(&key, 0, sizeof(key));
+	key.dclk = 148500;
+	key.ref_freq = vlv_hdmi_limits[0].ref_freq;
+	key.l = &vlv_hdmi_limits[0];
+	key.port_type = IGD_PORT_DIGITAL;
+	key.pd_type = PD_DISPLAY_HDMI_INT;
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		e = key;
+		vlv_clock_entry_calculate(&e, &actual_dclk);
+	}
+	search_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	e = key;
+	get_clock(&e);
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS * 1000; i++) {
+		e = key;
+		get_clock(&e);
+	}
+	hit_ms = (now_ms() - start) / (BENCH_LOOPS * 1000);
+
+	printf("148.5 MHz on HDMI: search %.1f us, cache hit %.3f us\n",
+		search_ms * 1e3, hit_ms * 1e3);
+}
+
+int main(void)
+{
+	unsigned long cases = 0;
+	int failed;
+
+	memset(&cache, 0, sizeof(cache));
+
+	/* The second pass over the tables hits wherever the cache still
+	 * holds the clock from the first. */
+	failed = run_pass(&cases);
+	failed += run_pass(&cases);
+	failed += run_repeat(&cases);
+
+	printf("%lu clocks, %lu cache hits, %lu misses, %d mismatches\n",
+		cases, hits, misses, failed);
+	if (failed) {
+		return 1;
+	}
+
+	run_bench();
+	return 0;
+}
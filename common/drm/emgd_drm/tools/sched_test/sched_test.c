@@ -0,0 +1,515 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: sched_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Drives the GEM scheduler's budget policy (src/core/i915/i915_gem_sched.h)
+ *  through a simulated request stream, one jiffy at a time. Clients at
+ *  privileged, shared normal and rogue priorities go through the steps of
+ *  i915_schedule(): stall behind a higher priority, refresh and charge
+ *  their bucket, or sleep until its refresh timer fires. Wakeups follow
+ *  i915_schedule_wake() and the refresh timer. No bucket may let through
+ *  more than its capacity per period, no client may sleep while it could
+ *  run, none may retry without sleeping, and none may wait longer than its
+ *  own period plus that of the slowest higher priority. The helpers are
+ *  also checked on their own across a jiffies wrap.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "i915_gem_sched.h"
+
+/* As in drm_emgd_private.h */
+#define MAX_SCHED_PRIORITIES    100
+#define SHARED_NORMAL_PRIORITY  (MAX_SCHED_PRIORITIES - 1)
+#define SHARED_ROGUE_PRIORITY   MAX_SCHED_PRIORITIES
+
+/* I915_SCHED_STALL_TIMEOUT in jiffies at HZ=1000 */
+#define STALL_JIFFIES  1
+
+#define RUN_JIFFIES    200000
+/* Starts shortly before jiffies wraps */
+#define START_JIFFIES  (ULONG_MAX - 5000)
+/* More passes through i915_schedule() in one jiffy than any wakeups explain */
+#define MAX_RETRIES    1000
+
+#define MAX_CLIENTS    8
+
+enum client_state {
+	CLIENT_THINK,	/* outside the execbuffer ioctl */
+	CLIENT_READY,	/* about to go through i915_schedule() */
+	CLIENT_STALLED,	/* behind a higher priority, STALL_JIFFIES at most */
+	CLIENT_BUDGET,	/* until its bucket's refresh timer fires */
+};
+
+struct bucket {
+	unsigned long balance;
+	unsigned long last_refresh;
+	unsigned long period;
+	unsigned long capacity;
+	unsigned long used;	/* let through since the last refresh */
+	int timer_armed;
+	unsigned long timer_expires;
+};
+
+struct client {
+	int priority;
+	unsigned long cost;	/* sched_avgexectime, charged up front */
+	enum client_state state;
+	unsigned long until;
+	unsigned long ready_since;
+	unsigned long max_wait;
+	unsigned long admitted;
+	unsigned long admitted_seq;	/* order of the last admission */
+	unsigned long attempts;
+	int tick_attempts;
+};
+
+struct sim {
+	struct bucket bucket[MAX_SCHED_PRIORITIES + 1];
+	struct client client[MAX_CLIENTS];
+	int num_clients;
+	int pending[MAX_SCHED_PRIORITIES + 1];	/* req_prty_cnts */
+	unsigned long admissions;
+	unsigned long now;
+	int worst_order;	/* lowest priority goes through first */
+	int failed;
+};
+
+static int sim_has_budget(void *data, int priority)
+{
+	struct sim *sim = data;
+	struct bucket *b = &sim->bucket[priority];
+
+	return i915_sched_has_budget(b->balance, b->last_refresh, sim->now,
+				     b->period, b->capacity);
+}
+
+static void fail(struct sim *sim, struct client *c, const char *what)
+{
+	if (sim->failed++ < 10) {
+		printf("FAIL: jiffy %lu, client at priority %d: %s\n",
+		       sim->now - START_JIFFIES, c->priority, what);
+	}
+}
+
+static void add_bucket(struct sim *sim, int priority,
+		       unsigned long period, unsigned long capacity)
+{
+	struct bucket *b = &sim->bucket[priority];
+
+	b->period = period;
+	b->capacity = capacity;
+	b->balance = capacity;
+	b->last_refresh = sim->now;
+}
+
+static struct client *add_client(struct sim *sim, int priority,
+				 unsigned long cost)
+{
+	struct client *c = &sim->client[sim->num_clients++];
+
+	memset(c, 0, sizeof(*c));
+	c->priority = priority;
+	c->cost = cost;
+	c->state = CLIENT_READY;
+	c->ready_since = sim->now;
+	sim->pending[priority]++;
+	return c;
+}
+
+/* i915_schedule_wake(): everything at @priority and below it */
+static void wake(struct sim *sim, int priority)
+{
+	int i;
+
+	for (i = 0; i < sim->num_clients; i++) {
+		struct client *c = &sim->client[i];
+
+		if (c->priority >= priority &&
+		    (c->state == CLIENT_STALLED || c->state == CLIENT_BUDGET))
+			c->state = CLIENT_READY;
+	}
+}
+
+/* The refresh timer of @priority only wakes its own clients */
+static void wake_priority(struct sim *sim, int priority)
+{
+	int i;
+
+	for (i = 0; i < sim->num_clients; i++) {
+		struct client *c = &sim->client[i];
+
+		if (c->priority == priority && c->state == CLIENT_BUDGET)
+			c->state = CLIENT_READY;
+	}
+}
+
+/* Steps 2 to 4 of i915_schedule() and the submission that follows */
+static void schedule(struct sim *sim, struct client *c)
+{
+	struct bucket *b = &sim->bucket[c->priority];
+	unsigned long timeout;
+
+	c->attempts++;
+	if (++c->tick_attempts > MAX_RETRIES) {
+		fail(sim, c, "retries without sleeping");
+		c->state = CLIENT_STALLED;
+		c->until = sim->now + 1;
+		return;
+	}
+
+	if (i915_sched_blocker(sim->pending, c->priority,
+			       sim_has_budget, sim) >= 0) {
+		c->state = CLIENT_STALLED;
+		c->until = sim->now + STALL_JIFFIES;
+		return;
+	}
+
+	if (i915_sched_refresh(&b->balance, &b->last_refresh, sim->now,
+			       b->period, b->capacity))
+		b->used = 0;
+
+	if (b->balance > 0) {
+		i915_sched_charge(&b->balance, c->cost);
+		b->used += c->cost;
+		/* the last request let through may overrun the balance */
+		if (b->used > b->capacity + c->cost - 1)
+			fail(sim, c, "bucket overdrawn");
+		if (sim->now - c->ready_since > c->max_wait)
+			c->max_wait = sim->now - c->ready_since;
+		c->admitted++;
+		c->admitted_seq = ++sim->admissions;
+
+		/* __i915_add_request(), then leaving the ioctl */
+		wake(sim, c->priority);
+		sim->pending[c->priority]--;
+		wake(sim, c->priority);
+		c->state = CLIENT_THINK;
+		c->until = sim->now + 1 + rand() % 4;
+		return;
+	}
+
+	timeout = i915_sched_budget_timeout(b->last_refresh, sim->now,
+					    b->period, STALL_JIFFIES);
+	if (!timeout) {
+		/* schedule_hrtimeout() returns at once */
+		c->state = CLIENT_READY;
+		return;
+	}
+	if (!b->timer_armed ||
+	    i915_sched_time_after_eq(b->timer_expires, sim->now + timeout + 1)) {
+		b->timer_armed = 1;
+		b->timer_expires = sim->now + timeout;
+	}
+	c->state = CLIENT_BUDGET;
+}
+
+static int compare_worst(const void *a, const void *b)
+{
+	const struct client *ca = *(struct client * const *)a;
+	const struct client *cb = *(struct client * const *)b;
+
+	return cb->priority - ca->priority;
+}
+
+static void tick(struct sim *sim)
+{
+	struct client *order[MAX_CLIENTS];
+	int i, j, ran;
+
+	for (i = 0; i <= MAX_SCHED_PRIORITIES; i++) {
+		struct bucket *b = &sim->bucket[i];
+
+		if (b->timer_armed &&
+		    i915_sched_time_after_eq(sim->now, b->timer_expires)) {
+			b->timer_armed = 0;
+			wake_priority(sim, i);
+		}
+	}
+
+	for (i = 0; i < sim->num_clients; i++) {
+		struct client *c = &sim->client[i];
+
+		c->tick_attempts = 0;
+		if ((c->state == CLIENT_THINK || c->state == CLIENT_STALLED) &&
+		    i915_sched_time_after_eq(sim->now, c->until)) {
+			if (c->state == CLIENT_THINK) {
+				sim->pending[c->priority]++;
+				c->ready_since = sim->now;
+			}
+			c->state = CLIENT_READY;
+		}
+		order[i] = c;
+	}
+
+	/* Clients go through in any order, the worst one if asked */
+	if (sim->worst_order) {
+		qsort(order, sim->num_clients, sizeof(order[0]), compare_worst);
+	} else {
+		for (i = sim->num_clients - 1; i > 0; i--) {
+			struct client *t;
+
+			j = rand() % (i + 1);
+			t = order[i];
+			order[i] = order[j];
+			order[j] = t;
+		}
+	}
+
+	do {
+		ran = 0;
+		for (i = 0; i < sim->num_clients; i++) {
+			if (order[i]->state == CLIENT_READY) {
+				schedule(sim, order[i]);
+				ran = 1;
+			}
+		}
+	} while (ran);
+
+	/* Whoever sleeps now must have a reason to */
+	for (i = 0; i < sim->num_clients; i++) {
+		struct client *c = &sim->client[i];
+
+		if (c->state != CLIENT_STALLED && c->state != CLIENT_BUDGET)
+			continue;
+		if (i915_sched_blocker(sim->pending, c->priority,
+				       sim_has_budget, sim) < 0 &&
+		    sim_has_budget(sim, c->priority))
+			fail(sim, c, "sleeps though it could run");
+	}
+}
+
+/* Jiffies @c may wait to be let through, see the description */
+static unsigned long wait_bound(struct sim *sim, struct client *c)
+{
+	unsigned long bound = 0;
+	int i;
+
+	for (i = 0; i < sim->num_clients; i++) {
+		struct client *h = &sim->client[i];
+		struct bucket *b = &sim->bucket[h->priority];
+
+		if (h->priority < c->priority && b->capacity &&
+		    b->period > bound)
+			bound = b->period;
+	}
+	return bound + sim->bucket[c->priority].period;
+}
+
+static const char *priority_name(int priority)
+{
+	static char name[16];
+
+	if (priority == SHARED_NORMAL_PRIORITY)
+		return "shared";
+	if (priority == SHARED_ROGUE_PRIORITY)
+		return "rogue";
+	sprintf(name, "%d", priority);
+	return name;
+}
+
+/*
+ * Privileged clients at 1 and 2, one at 5 whose capacity was set to 0
+ * through sysfs, two sharing the normal bucket and one rogue, all with
+ * their default periods scaled to jiffies at HZ=1000.
+ */
+static int run_stream(void)
+{
+	static struct sim sim;
+	struct client *starved;
+	unsigned long t;
+	int i;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.now = START_JIFFIES;
+	add_bucket(&sim, 1, 20, 5);
+	add_bucket(&sim, 2, 30, 8);
+	add_bucket(&sim, 5, 0, 0);
+	add_bucket(&sim, SHARED_NORMAL_PRIORITY, 50, 35);
+	add_bucket(&sim, SHARED_ROGUE_PRIORITY, 500, 1);
+	add_client(&sim, 1, 2);
+	add_client(&sim, 2, 3);
+	starved = add_client(&sim, 5, 1);
+	add_client(&sim, SHARED_NORMAL_PRIORITY, 1);
+	add_client(&sim, SHARED_NORMAL_PRIORITY, 3);
+	add_client(&sim, SHARED_ROGUE_PRIORITY, 4);
+
+	for (t = 0; t < RUN_JIFFIES; t++, sim.now++)
+		tick(&sim);
+
+	printf("%lu jiffies:\n", (unsigned long)RUN_JIFFIES);
+	printf("%-9s %6s %9s %8s %9s %8s %8s\n", "priority", "cost",
+	       "capacity", "period", "requests", "max wait", "attempts");
+	for (i = 0; i < sim.num_clients; i++) {
+		struct client *c = &sim.client[i];
+		struct bucket *b = &sim.bucket[c->priority];
+
+		printf("%-9s %6lu %9lu %8lu %9lu %8lu %8lu\n",
+		       priority_name(c->priority), c->cost, b->capacity,
+		       b->period, c->admitted, c->max_wait, c->attempts);
+		if (c == starved)
+			continue;
+		if (!c->admitted)
+			fail(&sim, c, "never let through");
+		if (c->max_wait > wait_bound(&sim, c))
+			fail(&sim, c, "starved");
+	}
+	if (starved->admitted)
+		fail(&sim, starved, "let through without capacity");
+
+	return sim.failed;
+}
+
+/*
+ * A privileged client is out of budget when its refresh timer fires and a
+ * shared client goes through i915_schedule() first: the refill is due, so
+ * the shared client has to stall until the privileged one is through.
+ */
+static int run_wake_order(void)
+{
+	static struct sim sim;
+	struct client *high, *low;
+	unsigned long t, deadline;
+
+	memset(&sim, 0, sizeof(sim));
+	sim.now = START_JIFFIES;
+	sim.worst_order = 1;
+	add_bucket(&sim, 1, 10, 2);
+	add_bucket(&sim, SHARED_NORMAL_PRIORITY, 10, 100);
+	high = add_client(&sim, 1, 2);
+	low = add_client(&sim, SHARED_NORMAL_PRIORITY, 1);
+
+	for (t = 0; t < 1000; t++, sim.now++) {
+		unsigned long high_before = high->admitted;
+		unsigned long low_before = low->admitted;
+
+		deadline = sim.bucket[1].last_refresh + sim.bucket[1].period;
+		tick(&sim);
+		if (sim.now != deadline)
+			continue;
+		/* high is waiting for this refill, low may go after it */
+		if (high->admitted == high_before)
+			fail(&sim, high, "not let through at its refill");
+		else if (low->admitted != low_before &&
+			 low->admitted_seq < high->admitted_seq)
+			fail(&sim, low, "let through ahead of a due refill");
+	}
+	if (!high->admitted || !low->admitted)
+		fail(&sim, low, "no progress");
+
+	return sim.failed;
+}
+
+static int check(int cond, const char *what)
+{
+	if (!cond)
+		printf("FAIL: %s\n", what);
+	return !cond;
+}
+
+/* The helpers on their own, across a jiffies wrap */
+static int run_helpers(void)
+{
+	unsigned long last = ULONG_MAX - 5, balance = 3;
+	int pending[MAX_SCHED_PRIORITIES + 1];
+	struct sim sim;
+	int failed = 0;
+
+	failed += check(!i915_sched_refresh(&balance, &last, last + 9, 10, 8) &&
+			balance == 3 && last == ULONG_MAX - 5,
+			"refresh before the period is over");
+	failed += check(i915_sched_refresh(&balance, &last, last + 10, 10, 8) &&
+			balance == 8 && last == 4,
+			"refresh across the wrap");
+	balance = 12;
+	failed += check(i915_sched_refresh(&balance, &last, last + 11, 10, 8) &&
+			balance == 12, "refresh drains a bucket above capacity");
+
+	balance = 5;
+	i915_sched_charge(&balance, 3);
+	failed += check(balance == 2, "charge");
+	i915_sched_charge(&balance, 3);
+	failed += check(balance == 0, "charge does not saturate");
+
+	last = ULONG_MAX - 2;
+	failed += check(i915_sched_until_refresh(last, ULONG_MAX, 10) == 8,
+			"until_refresh before the wrap");
+	failed += check(i915_sched_until_refresh(last, 3, 10) == 4,
+			"until_refresh after the wrap");
+	failed += check(i915_sched_until_refresh(last, 8, 10) == 0,
+			"until_refresh once due");
+	failed += check(i915_sched_budget_timeout(last, 8, 10, 1) == 1 &&
+			i915_sched_budget_timeout(last, 3, 0, 2) == 2 &&
+			i915_sched_budget_timeout(last, 3, 10, 2) == 4,
+			"budget_timeout floor");
+
+	failed += check(i915_sched_has_budget(1, last, last, 10, 0) &&
+			!i915_sched_has_budget(0, last, last + 9, 10, 8) &&
+			i915_sched_has_budget(0, last, last + 10, 10, 8) &&
+			!i915_sched_has_budget(0, last, last + 10, 10, 0),
+			"has_budget");
+
+	memset(&sim, 0, sizeof(sim));
+	memset(pending, 0, sizeof(pending));
+	sim.now = 100;
+	add_bucket(&sim, 3, 10, 4);
+	add_bucket(&sim, 7, 10, 4);
+	add_bucket(&sim, 9, 10, 4);
+	sim.bucket[9].balance = 0;
+	pending[3] = pending[7] = pending[9] = 1;
+	failed += check(i915_sched_blocker(pending, 8, sim_has_budget, &sim) == 7,
+			"blocker is the nearest higher priority");
+	failed += check(i915_sched_blocker(pending, 3, sim_has_budget, &sim) < 0,
+			"blocker at the same priority");
+	failed += check(i915_sched_blocker(pending, 10, sim_has_budget, &sim) == 7,
+			"blocker without budget");
+	pending[7] = 0;
+	failed += check(i915_sched_blocker(pending, 8, sim_has_budget, &sim) == 3,
+			"blocker without requests");
+
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+	int failed;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	failed = run_helpers();
+	failed += run_wake_order();
+	failed += run_stream();
+
+	printf("%d failures\n", failed);
+	return failed ? 1 : 0;
+}
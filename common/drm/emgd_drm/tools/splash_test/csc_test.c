@@ -0,0 +1,548 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: csc_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Checks splash_csc_xrgb_to_yuv422() against the scalar conversion it
+ *  replaced in splash_video.c. The old convert_rgb_to_yuy2() is kept here
+ *  verbatim. Its output cannot be matched as is, because it divided Q10
+ *  products by 100 and so saturated almost every luma value. Bit accuracy
+ *  is therefore checked against the same byte at a time loop with only
+ *  the arithmetic corrected: rounding Q10 shifts, a zero sum Cb row, and
+ *  chroma from the pixel pair average. The result is also checked to
+ *  within 1 LSB of a floating point BT.601/BT.709 reference. The NV12
+ *  converter is checked the same way, and its Y plane against the YUY2
+ *  luma. Ends with the time per 1080p frame of the old routine and the
+ *  new ones.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "splash_csc.h"
+
+#define NUM_SURFACES 200
+#define PAD_BYTE     0xA5
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+#define BENCH_LOOPS  20
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/*
+ * The conversion splash_video.c used before splash_csc.c, unchanged.
+ */
+static void old_convert_rgb_to_yuy2(unsigned char * src, unsigned char * dest,
+		int s_pitch, int d_pitch, int width, int height)
+{
+	int loop1, loop2;
+
+	unsigned char r = 0;
+	unsigned char g = 0;
+	unsigned char b = 0;
+	unsigned char x = 0;
+
+	unsigned char y = 0;
+	unsigned char u = 0;
+	unsigned char v = 0;
+
+	long inty = 0;
+	long intu = 0;
+	long intv = 0;
+	long floatx;
+	long floatr;
+	long floatg;
+	long floatb;
+
+	for(loop1=0; loop1< height; ++loop1)
+	{
+		for(loop2=0; loop2< width/2; ++loop2)
+		{
+			/* Read RGB for the first set of pixel aligned data - YU */
+			b = src[(loop1*s_pitch)+(loop2*2*4)+0];
+			g = src[(loop1*s_pitch)+(loop2*2*4)+1];
+			r = src[(loop1*s_pitch)+(loop2*2*4)+2];
+			x = src[(loop1*s_pitch)+(loop2*2*4)+3];
+
+			floatr = r;
+			floatg = g;
+			floatb = b;
+			floatx = x;
+
+			/* calculate the conversion to YUV */
+			inty =  ((263 * floatr) + (516 * floatg) + (100 * floatb) + 1600);
+			intv =  ((450 * floatr) - (377 * floatg) - (73 * floatb) + 12800);
+			intu =  (-(151 * floatr) - (298 * floatg) + (450 * floatb) + 12800);
+			inty = inty / 100;
+			intu = intu / 100;
+			intv = intv / 100;
+			if(inty>255)
+				inty = 255;
+			if(inty<0)
+				inty = 0;
+			if(intu>255)
+				intu = 255;
+			if(intu<0)
+				intu = 0;
+			if(intv>255)
+				intv = 255;
+			if(intv<0)
+				intv = 0;
+			y = (unsigned char)inty;
+			u = (unsigned char)intu;
+
+			/* put the YU into the dest buffer */
+			dest[(loop1*(d_pitch))+(loop2*2*2)+0] = y;
+			dest[(loop1*(d_pitch))+(loop2*2*2)+1] = u;
+
+			/* for the second set of pixel aligned data - YV */
+			b = src[(loop1*s_pitch)+(loop2*2*4)+4];
+			g = src[(loop1*s_pitch)+(loop2*2*4)+5];
+			r = src[(loop1*s_pitch)+(loop2*2*4)+6];
+			x = src[(loop1*s_pitch)+(loop2*2*4)+7];
+
+			floatr = r;
+			floatg = g;
+			floatb = b;
+			floatx = x;
+
+			inty =  ((263 * floatr) + (516 * floatg) + (100 * floatb) + 1600);
+			intv =  ((450 * floatr) - (377 * floatg) - (73 * floatb) + 12800);
+			intu =  (-(151 * floatr) - (298 * floatg) + (450 * floatb) + 12800);
+			inty = inty / 100;
+			intu = intu / 100;
+			intv = intv / 100;
+			if(inty>255)
+				inty = 255;
+			if(inty<0)
+				inty = 0;
+			if(intu>255)
+				intu = 255;
+			if(intu<0)
+				intu = 0;
+			if(intv>255)
+				intv = 255;
+			if(intv<0)
+				intv = 0;
+			y = (unsigned char)inty;
+			v = (unsigned char)intv;
+
+			dest[(loop1*(d_pitch))+(loop2*2*2)+2] = y;
+			dest[(loop1*(d_pitch))+(loop2*2*2)+3] = v;
+		}
+	}
+
+	return;
+
+}
+
+/*
+ * The loop of old_convert_rgb_to_yuy2() with its arithmetic corrected,
+ * the bit exact reference. Q10 coefficients, Y, Cb then Cr rows.
+ */
+static const int ref_coef[2][9] = {
+	{  263,  516,  100, -152, -298,  450,  450, -377,  -73 },
+	{  187,  629,   63, -103, -347,  450,  450, -409,  -41 },
+};
+
+static unsigned char ref_clamp(long value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static void ref_convert(unsigned char *src, unsigned char *dest,
+		int s_pitch, int d_pitch, int width, int height,
+		int matrix, int order)
+{
+	const int *c = ref_coef[matrix];
+	int loop1, loop2;
+	long r0, g0, b0, r1, g1, b1;
+	unsigned char y0, y1, u, v;
+	unsigned char *s, *d;
+
+	for (loop1 = 0; loop1 < height; ++loop1) {
+		for (loop2 = 0; loop2 < width / 2; ++loop2) {
+			s = &src[(loop1 * s_pitch) + (loop2 * 2 * 4)];
+			d = &dest[(loop1 * d_pitch) + (loop2 * 2 * 2)];
+
+			b0 = s[0]; g0 = s[1]; r0 = s[2];
+			b1 = s[4]; g1 = s[5]; r1 = s[6];
+
+			y0 = ref_clamp((c[0] * r0 + c[1] * g0 + c[2] * b0 +
+				16 * 1024 + 512) / 1024);
+			y1 = ref_clamp((c[0] * r1 + c[1] * g1 + c[2] * b1 +
+				16 * 1024 + 512) / 1024);
+			/* Chroma sums are non negative, so / rounds like >> */
+			u = ref_clamp((c[3] * (r0 + r1) + c[4] * (g0 + g1) +
+				c[5] * (b0 + b1) + 128 * 2048 + 1024) / 2048);
+			v = ref_clamp((c[6] * (r0 + r1) + c[7] * (g0 + g1) +
+				c[8] * (b0 + b1) + 128 * 2048 + 1024) / 2048);
+
+			if (order == SPLASH_CSC_UYVY) {
+				d[0] = u; d[1] = y0; d[2] = v; d[3] = y1;
+			} else {
+				d[0] = y0; d[1] = u; d[2] = y1; d[3] = v;
+			}
+		}
+	}
+}
+
+/*
+ * Largest difference from the floating point studio swing conversion,
+ * chroma taken from the pair average.
+ */
+static int float_error(unsigned char *src, unsigned char *dest,
+		int s_pitch, int d_pitch, int width, int height, int matrix)
+{
+	static const double kr[2] = { 0.299, 0.2126 };
+	static const double kb[2] = { 0.114, 0.0722 };
+	double r, g, b, y, cb, cr, expect[4];
+	unsigned char *s, *d;
+	int row, col, k, err, max_err = 0;
+
+	for (row = 0; row < height; row++) {
+		for (col = 0; col < width / 2; col++) {
+			s = &src[row * s_pitch + col * 8];
+			d = &dest[row * d_pitch + col * 4];
+			cb = cr = 0;
+			for (k = 0; k < 2; k++) {
+				r = s[k * 4 + 2] / 255.0;
+				g = s[k * 4 + 1] / 255.0;
+				b = s[k * 4] / 255.0;
+				y = kr[matrix] * r + (1 - kr[matrix] - kb[matrix]) * g +
+					kb[matrix] * b;
+				expect[k * 2] = 16 + 219 * y;
+				cb += (b - y) / (2 * (1 - kb[matrix])) * 224 / 2;
+				cr += (r - y) / (2 * (1 - kr[matrix])) * 224 / 2;
+			}
+			expect[1] = 128 + cb;
+			expect[3] = 128 + cr;
+			for (k = 0; k < 4; k++) {
+				err = abs(d[k] - (int)lround(expect[k]));
+				if (err > max_err) {
+					max_err = err;
+				}
+			}
+		}
+	}
+
+	return max_err;
+}
+
+/*
+ * Byte at a time NV12 reference, chroma from the 2x2 block average with
+ * the last column and row repeated for odd sizes.
+ */
+static void ref_convert_nv12(unsigned char *src, unsigned char *dest_y,
+		unsigned char *dest_uv, int s_pitch, int y_pitch, int uv_pitch,
+		int width, int height, int matrix)
+{
+	const int *c = ref_coef[matrix];
+	long r, g, b;
+	unsigned char *s;
+	int row, col, k;
+
+	for (row = 0; row < height; row++) {
+		for (col = 0; col < width; col++) {
+			s = &src[row * s_pitch + col * 4];
+			dest_y[row * y_pitch + col] = ref_clamp((c[0] * s[2] +
+				c[1] * s[1] + c[2] * s[0] + 16 * 1024 + 512) / 1024);
+		}
+	}
+
+	for (row = 0; row < height; row += 2) {
+		for (col = 0; col < width; col += 2) {
+			r = g = b = 0;
+			for (k = 0; k < 4; k++) {
+				s = &src[(row + (k / 2 && row + 1 < height)) * s_pitch +
+					(col + (k % 2 && col + 1 < width)) * 4];
+				b += s[0]; g += s[1]; r += s[2];
+			}
+			dest_uv[(row / 2) * uv_pitch + col] = ref_clamp((c[3] * r +
+				c[4] * g + c[5] * b + 128 * 4096 + 2048) / 4096);
+			dest_uv[(row / 2) * uv_pitch + col + 1] = ref_clamp((c[6] * r +
+				c[7] * g + c[8] * b + 128 * 4096 + 2048) / 4096);
+		}
+	}
+}
+
+/*
+ * Largest difference of the NV12 chroma from the floating point
+ * conversion of the 2x2 block average.
+ */
+static int float_error_nv12(unsigned char *src, unsigned char *dest_uv,
+		int s_pitch, int uv_pitch, int width, int height, int matrix)
+{
+	static const double kr[2] = { 0.299, 0.2126 };
+	static const double kb[2] = { 0.114, 0.0722 };
+	double r, g, b, y, cb, cr;
+	unsigned char *s, *d;
+	int row, col, k, err, max_err = 0;
+
+	for (row = 0; row < height; row += 2) {
+		for (col = 0; col < width; col += 2) {
+			d = &dest_uv[(row / 2) * uv_pitch + col];
+			cb = cr = 0;
+			for (k = 0; k < 4; k++) {
+				s = &src[(row + (k / 2 && row + 1 < height)) * s_pitch +
+					(col + (k % 2 && col + 1 < width)) * 4];
+				r = s[2] / 255.0;
+				g = s[1] / 255.0;
+				b = s[0] / 255.0;
+				y = kr[matrix] * r + (1 - kr[matrix] - kb[matrix]) * g +
+					kb[matrix] * b;
+				cb += (b - y) / (2 * (1 - kb[matrix])) * 224 / 4;
+				cr += (r - y) / (2 * (1 - kr[matrix])) * 224 / 4;
+			}
+			err = abs(d[0] - (int)lround(128 + cb));
+			if (err > max_err) {
+				max_err = err;
+			}
+			err = abs(d[1] - (int)lround(128 + cr));
+			if (err > max_err) {
+				max_err = err;
+			}
+		}
+	}
+
+	return max_err;
+}
+
+static int run_surfaces(void)
+{
+	unsigned char *src, *out, *ref;
+	int width, height, s_pitch, d_pitch, matrix, order, err;
+	int i, n, failed = 0, worst = 0;
+
+	for (n = 0; n < NUM_SURFACES; n++) {
+		width = 1 + rand() % 400;
+		height = 1 + rand() % 64;
+		s_pitch = width * 4 + 4 * (rand() % 8);
+		d_pitch = ((width / 2) * 4) + 4 * (rand() % 8);
+		matrix = n % 2;
+		order = (n / 2) % 2;
+
+		src = malloc(s_pitch * height);
+		out = malloc(d_pitch * height);
+		ref = malloc(d_pitch * height);
+		for (i = 0; i < s_pitch * height; i++) {
+			/* Include the extremes every so often */
+			src[i] = (rand() % 8) ? rand() : ((rand() & 1) ? 0xFF : 0);
+		}
+		memset(out, PAD_BYTE, d_pitch * height);
+		memset(ref, PAD_BYTE, d_pitch * height);
+
+		splash_csc_xrgb_to_yuv422(src, out, s_pitch, d_pitch, width,
+			height, matrix, order);
+		ref_convert(src, ref, s_pitch, d_pitch, width, height, matrix,
+			order);
+
+		/* Includes the pitch padding, which must be left alone */
+		if (memcmp(out, ref, d_pitch * height)) {
+			printf("FAIL: %dx%d matrix %d order %d differs from the "
+				"scalar reference\n", width, height, matrix, order);
+			failed++;
+		}
+		if (order == SPLASH_CSC_YUY2) {
+			err = float_error(src, out, s_pitch, d_pitch, width,
+				height, matrix);
+			if (err > worst) {
+				worst = err;
+			}
+			if (err > 1) {
+				printf("FAIL: %dx%d matrix %d is %d LSB off the floating "
+					"point reference\n", width, height, matrix, err);
+				failed++;
+			}
+		}
+
+		free(src);
+		free(out);
+		free(ref);
+	}
+
+	printf("%d surfaces, %d failures, largest error %d LSB\n",
+		NUM_SURFACES, failed, worst);
+	return failed != 0;
+}
+
+static int run_nv12_surfaces(void)
+{
+	unsigned char *src, *out_y, *out_uv, *ref_y, *ref_uv, *yuy2;
+	int width, height, s_pitch, y_pitch, uv_pitch, uv_height, matrix, err;
+	int i, row, col, n, failed = 0, worst = 0;
+
+	for (n = 0; n < NUM_SURFACES; n++) {
+		width = 1 + rand() % 400;
+		height = 1 + rand() % 64;
+		s_pitch = width * 4 + 4 * (rand() % 8);
+		y_pitch = width + rand() % 8;
+		uv_pitch = ((width + 1) & ~1) + 2 * (rand() % 8);
+		uv_height = (height + 1) / 2;
+		matrix = n % 2;
+
+		src = malloc(s_pitch * height);
+		out_y = malloc(y_pitch * height);
+		ref_y = malloc(y_pitch * height);
+		out_uv = malloc(uv_pitch * uv_height);
+		ref_uv = malloc(uv_pitch * uv_height);
+		yuy2 = malloc(width * 2 * height);
+		for (i = 0; i < s_pitch * height; i++) {
+			src[i] = (rand() % 8) ? rand() : ((rand() & 1) ? 0xFF : 0);
+		}
+		memset(out_y, PAD_BYTE, y_pitch * height);
+		memset(ref_y, PAD_BYTE, y_pitch * height);
+		memset(out_uv, PAD_BYTE, uv_pitch * uv_height);
+		memset(ref_uv, PAD_BYTE, uv_pitch * uv_height);
+
+		splash_csc_xrgb_to_nv12(src, out_y, out_uv, s_pitch, y_pitch,
+			uv_pitch, width, height, matrix);
+		ref_convert_nv12(src, ref_y, ref_uv, s_pitch, y_pitch, uv_pitch,
+			width, height, matrix);
+
+		if (memcmp(out_y, ref_y, y_pitch * height) ||
+				memcmp(out_uv, ref_uv, uv_pitch * uv_height)) {
+			printf("FAIL: NV12 %dx%d matrix %d differs from the scalar "
+				"reference\n", width, height, matrix);
+			failed++;
+		}
+
+		/* Both converters must agree on luma where YUY2 has it */
+		splash_csc_xrgb_to_yuv422(src, yuy2, s_pitch, width * 2, width,
+			height, matrix, SPLASH_CSC_YUY2);
+		for (row = 0; row < height; row++) {
+			for (col = 0; col < (width & ~1); col++) {
+				if (out_y[row * y_pitch + col] !=
+						yuy2[row * width * 2 + col * 2]) {
+					break;
+				}
+			}
+			if (col < (width & ~1)) {
+				printf("FAIL: NV12 %dx%d matrix %d luma differs from "
+					"YUY2 at %d,%d\n", width, height, matrix, col, row);
+				failed++;
+				break;
+			}
+		}
+
+		err = float_error_nv12(src, out_uv, s_pitch, uv_pitch, width,
+			height, matrix);
+		if (err > worst) {
+			worst = err;
+		}
+		if (err > 1) {
+			printf("FAIL: NV12 %dx%d matrix %d is %d LSB off the floating "
+				"point reference\n", width, height, matrix, err);
+			failed++;
+		}
+
+		free(src);
+		free(out_y);
+		free(ref_y);
+		free(out_uv);
+		free(ref_uv);
+		free(yuy2);
+	}
+
+	printf("%d NV12 surfaces, %d failures, largest chroma error %d LSB\n",
+		NUM_SURFACES, failed, worst);
+	return failed != 0;
+}
+
+static void run_bench(void)
+{
+	int s_pitch = BENCH_WIDTH * 4, d_pitch = BENCH_WIDTH * 2;
+	unsigned char *src, *dest;
+	double start, old_ms, new_ms, nv12_ms;
+	int i, saturated = 0;
+
+	src = malloc(s_pitch * BENCH_HEIGHT);
+	dest = malloc(d_pitch * BENCH_HEIGHT);
+	for (i = 0; i < s_pitch * BENCH_HEIGHT; i++) {
+		src[i] = rand();
+	}
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		old_convert_rgb_to_yuy2(src, dest, s_pitch, d_pitch,
+			BENCH_WIDTH, BENCH_HEIGHT);
+	}
+	old_ms = (now_ms() - start) / BENCH_LOOPS;
+	for (i = 0; i < d_pitch * BENCH_HEIGHT; i += 2) {
+		saturated += dest[i] == 0xFF;
+	}
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		splash_csc_xrgb_to_yuv422(src, dest, s_pitch, d_pitch,
+			BENCH_WIDTH, BENCH_HEIGHT, SPLASH_CSC_BT601, SPLASH_CSC_YUY2);
+	}
+	new_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	/* The Y plane then the CbCr plane, both BENCH_WIDTH bytes a row */
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		splash_csc_xrgb_to_nv12(src, dest,
+			dest + BENCH_WIDTH * BENCH_HEIGHT, s_pitch, BENCH_WIDTH,
+			BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, SPLASH_CSC_BT601);
+	}
+	nv12_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	printf("%dx%d frame: convert_rgb_to_yuy2 %.2f ms (%.1f%% of luma "
+		"saturated), splash_csc_xrgb_to_yuv422 %.2f ms, "
+		"splash_csc_xrgb_to_nv12 %.2f ms\n",
+		BENCH_WIDTH, BENCH_HEIGHT, old_ms,
+		100.0 * saturated / (BENCH_WIDTH * BENCH_HEIGHT), new_ms, nv12_ms);
+
+	free(src);
+	free(dest);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	if (run_surfaces() || run_nv12_surfaces()) {
+		return 1;
+	}
+	run_bench();
+	return 0;
+}
@@ -0,0 +1,330 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: inflate_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Checks the splash screen's deflate decoder against zlib. A corpus of
+ *  generated inputs is compressed at every level and with every strategy,
+ *  then decoded in randomly sized reads and compared with the original.
+ *  Truncated and corrupted copies must fail cleanly without overrunning
+ *  the output. Finally the decode time of a 1080p RGBA sized stream is
+ *  reported next to zlib's own inflate.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <zlib.h>
+#include "splash_inflate.h"
+
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+#define BENCH_LOOPS  10
+
+/* Input shapes that steer deflate towards different block types */
+#define DATA_RANDOM  0
+#define DATA_RUNS    1
+#define DATA_TEXT    2
+#define DATA_FAR     3
+#define DATA_IMAGE   4
+#define DATA_TYPES   5
+
+static const int strategies[] = {
+	Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED
+};
+#define NUM_STRATEGIES (sizeof(strategies) / sizeof(strategies[0]))
+
+static splash_inflate z;
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/*
+ * Fills a buffer with data of the given shape.  DATA_FAR repeats blocks
+ * from close to 32KB back so that matches reach the far end of the window.
+ */
+static void make_data(unsigned char *data, uint32_t size, int type)
+{
+	static const char words[] = "the quick brown fox jumps over a lazy dog ";
+	uint32_t i;
+
+	for (i = 0; i < size; i++) {
+		switch (type) {
+		case DATA_RANDOM:
+			data[i] = rand();
+			break;
+		case DATA_RUNS:
+			data[i] = (rand() % 16) ? (i / 37) & 0xFF : rand();
+			break;
+		case DATA_TEXT:
+			data[i] = words[(i * 7 + rand() % 3) % (sizeof(words) - 1)];
+			break;
+		case DATA_FAR:
+			data[i] = (i >= 32700 && rand() % 8) ?
+				data[i - 32700 + (rand() % 60)] : rand();
+			break;
+		default:
+			/* Gradient with noise, like a filtered image row */
+			data[i] = ((i % 7680) < 4000) ? (i / 4) & 0x3F : rand() & 3;
+			break;
+		}
+	}
+}
+
+static uint32_t compress_raw(
+	const unsigned char *in,
+	uint32_t in_size,
+	unsigned char *out,
+	uint32_t out_size,
+	int level,
+	int strategy)
+{
+	z_stream s;
+	uint32_t used;
+
+	memset(&s, 0, sizeof(s));
+	if (deflateInit2(&s, level, Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+		return 0;
+	}
+	s.next_in = (unsigned char *)in;
+	s.avail_in = in_size;
+	s.next_out = out;
+	s.avail_out = out_size;
+	if (deflate(&s, Z_FINISH) != Z_STREAM_END) {
+		deflateEnd(&s);
+		return 0;
+	}
+	used = s.total_out;
+	deflateEnd(&s);
+
+	return used;
+}
+
+/*
+ * Decodes a stream in reads of random size, the way the row decoder asks
+ * for one scanline at a time.  Returns non zero on a decode error.
+ */
+static int inflate_chunked(
+	const unsigned char *in,
+	uint32_t in_size,
+	unsigned char *out,
+	uint32_t out_size,
+	uint32_t *out_total)
+{
+	uint32_t total = 0, chunk, used;
+
+	splash_inflate_init(&z, in, in_size);
+	while (total < out_size) {
+		chunk = 1 + rand() % ((rand() % 4) ? 64 : 70000);
+		if (chunk > out_size - total) {
+			chunk = out_size - total;
+		}
+		if (splash_inflate_read(&z, out + total, chunk, &used)) {
+			*out_total = total + used;
+			return 1;
+		}
+		total += used;
+		if (used < chunk) {
+			break;
+		}
+	}
+	*out_total = total;
+
+	return 0;
+}
+
+static int check_guard(const unsigned char *guard)
+{
+	int i;
+
+	for (i = 0; i < GUARD_SIZE; i++) {
+		if (guard[i] != GUARD_BYTE) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int run_corpus(void)
+{
+	unsigned char *data, *comp, *out;
+	uint32_t size, comp_size, comp_max, used;
+	uint32_t level, strategy, type, cases = 0;
+	int failed = 0;
+
+	comp_max = compressBound(300000) + 64;
+	data = malloc(300000);
+	comp = malloc(comp_max);
+	out = malloc(300000 + GUARD_SIZE);
+	if (!data || !comp || !out) {
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	for (level = 0; level <= 9; level++) {
+		for (strategy = 0; strategy < NUM_STRATEGIES; strategy++) {
+			for (type = 0; type < DATA_TYPES; type++) {
+				size = (type == DATA_FAR || (rand() & 1)) ?
+					40000 + rand() % 260000 : rand() % 5000;
+				make_data(data, size, type);
+				comp_size = compress_raw(data, size, comp, comp_max,
+					level, strategies[strategy]);
+				if (!comp_size) {
+					printf("zlib failed, level %u strategy %u\n",
+						level, strategy);
+					return 1;
+				}
+
+				memset(out + size, GUARD_BYTE, GUARD_SIZE);
+				if (inflate_chunked(comp, comp_size, out, size, &used) ||
+					used != size || memcmp(out, data, size) ||
+					check_guard(out + size)) {
+					printf("FAIL: level %u strategy %u type %u size %u, "
+						"decoded %u\n", level, strategy, type, size, used);
+					failed++;
+				}
+				/* Reading past the end yields nothing and ends the stream */
+				if (splash_inflate_read(&z, out, 1, &used) || used ||
+					z.state != SPLASH_INFLATE_DONE) {
+					printf("FAIL: level %u strategy %u type %u: stream "
+						"does not end with the data\n", level, strategy, type);
+					failed++;
+				}
+
+				/* Truncated: must stop short or report an error */
+				memset(out + size, GUARD_BYTE, GUARD_SIZE);
+				if (!inflate_chunked(comp, comp_size / 2, out, size, &used) &&
+					used == size && size > 64) {
+					printf("FAIL: level %u strategy %u type %u: truncated "
+						"stream decoded in full\n", level, strategy, type);
+					failed++;
+				}
+
+				/* Corrupted: anything goes except an overrun */
+				comp[rand() % comp_size] ^= 1 << (rand() % 8);
+				comp[rand() % comp_size] ^= 1 << (rand() % 8);
+				inflate_chunked(comp, comp_size, out, size, &used);
+				if (used > size || check_guard(out + size)) {
+					printf("FAIL: level %u strategy %u type %u: corrupt "
+						"stream overran the output\n", level, strategy, type);
+					failed++;
+				}
+				cases++;
+			}
+		}
+	}
+
+	printf("%u corpus streams, %d failures\n", cases, failed);
+
+	free(data);
+	free(comp);
+	free(out);
+	return failed != 0;
+}
+
+static int run_bench(void)
+{
+	uint32_t size = BENCH_WIDTH * BENCH_HEIGHT * 4 + BENCH_HEIGHT;
+	unsigned char *data, *comp, *out;
+	uint32_t comp_size, comp_max, used;
+	double start, splash_ms, zlib_ms;
+	z_stream s;
+	int i;
+
+	comp_max = compressBound(size) + 64;
+	data = malloc(size);
+	comp = malloc(comp_max);
+	out = malloc(size);
+	if (!data || !comp || !out) {
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	make_data(data, size, DATA_IMAGE);
+	comp_size = compress_raw(data, size, comp, comp_max, 9,
+		Z_DEFAULT_STRATEGY);
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		splash_inflate_init(&z, comp, comp_size);
+		if (splash_inflate_read(&z, out, size, &used) || used != size) {
+			printf("FAIL: benchmark stream did not decode\n");
+			return 1;
+		}
+	}
+	splash_ms = (now_ms() - start) / BENCH_LOOPS;
+	if (memcmp(out, data, size)) {
+		printf("FAIL: benchmark stream decoded wrongly\n");
+		return 1;
+	}
+
+	start = now_ms();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		memset(&s, 0, sizeof(s));
+		inflateInit2(&s, -15);
+		s.next_in = comp;
+		s.avail_in = comp_size;
+		s.next_out = out;
+		s.avail_out = size;
+		inflate(&s, Z_FINISH);
+		inflateEnd(&s);
+	}
+	zlib_ms = (now_ms() - start) / BENCH_LOOPS;
+
+	printf("%ux%u RGBA, %u -> %u bytes: splash_inflate %.2f ms, "
+		"zlib %.2f ms\n", BENCH_WIDTH, BENCH_HEIGHT, comp_size, size,
+		splash_ms, zlib_ms);
+
+	free(data);
+	free(comp);
+	free(out);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	if (run_corpus()) {
+		return 1;
+	}
+	return run_bench();
+}
@@ -0,0 +1,418 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: png_test.c
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Checks the streamed PNG path, which blends each row into the framebuffer
+ *  as it is decoded, against the whole frame decode followed by a blend
+ *  that still images used before. Random images are filtered with random
+ *  per-row filter types and compressed with zlib; the whole frame decode
+ *  must give back the original pixels, and both paths must leave the same
+ *  framebuffer, including for truncated and corrupted streams. Ends with
+ *  the time to the first row on screen and the peak allocation of both
+ *  paths for a 1080p RGBA image.
+ *
+ *  splash_png.c is built with vmalloc()/vfree() pointing at the counting
+ *  allocator below.
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <zlib.h>
+#include "splash_png.h"
+#include "test_alloc.h"
+
+#define NUM_IMAGES 200
+#define FB_BORDER  3
+#define FB_GUARD   0x5A5A5A5A
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+
+static size_t alloc_current;
+static size_t alloc_peak;
+
+void *test_vmalloc(size_t size)
+{
+	size_t *p = malloc(sizeof(size_t) * 2 + size);
+
+	if (!p) {
+		return NULL;
+	}
+	p[0] = size;
+	alloc_current += size;
+	if (alloc_current > alloc_peak) {
+		alloc_peak = alloc_current;
+	}
+	return p + 2;
+}
+
+void test_vfree(const void *ptr)
+{
+	size_t *p = (size_t *)ptr;
+
+	if (!p) {
+		return;
+	}
+	alloc_current -= p[-2];
+	free(p - 2);
+}
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static unsigned char paeth(unsigned char a, unsigned char b, unsigned char c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc) {
+		return a;
+	}
+	return (pb <= pc) ? b : c;
+}
+
+/*
+ * Filters raw 8 bit per channel rows the way a PNG encoder would, with a
+ * random filter type per row, and compresses the result into a zlib
+ * stream. Returns the stream size, 0 on failure.
+ */
+static uint32_t encode_image(
+	const unsigned char *raw,
+	uint32_t width,
+	uint32_t height,
+	uint32_t bpp,
+	unsigned char *out,
+	uint32_t out_size)
+{
+	uint32_t stride = width * bpp, row, i;
+	unsigned char *filtered, *f;
+	const unsigned char *cur, *prev;
+	unsigned char a, b, c, pred = 0;
+	uLongf used = out_size;
+
+	filtered = malloc(height * (stride + 1));
+	if (!filtered) {
+		return 0;
+	}
+
+	for (row = 0; row < height; row++) {
+		cur = raw + row * stride;
+		prev = row ? cur - stride : NULL;
+		f = filtered + row * (stride + 1);
+		f[0] = rand() % 5;
+		for (i = 0; i < stride; i++) {
+			a = (i >= bpp) ? cur[i - bpp] : 0;
+			b = prev ? prev[i] : 0;
+			c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+			switch (f[0]) {
+			case 0: pred = 0; break;
+			case 1: pred = a; break;
+			case 2: pred = b; break;
+			case 3: pred = (a + b) / 2; break;
+			case 4: pred = paeth(a, b, c); break;
+			}
+			f[i + 1] = cur[i] - pred;
+		}
+	}
+
+	if (compress2(out, &used, filtered, height * (stride + 1),
+			rand() % 10) != Z_OK) {
+		used = 0;
+	}
+	free(filtered);
+
+	return used;
+}
+
+/* The ARGB value convert_row() must produce for a raw pixel */
+static uint32_t reference_pixel(const unsigned char *p, int colour_type)
+{
+	switch (colour_type) {
+	case COLOR_TRUE:
+		return 0xFF000000 | p[0] << 16 | p[1] << 8 | p[2];
+	case COLOR_TRUE_ALPHA:
+		return (uint32_t)p[3] << 24 | p[0] << 16 | p[1] << 8 | p[2];
+	case COLOR_GREY:
+		return 0xFF000000 | p[0] << 16 | p[0] << 8 | p[0];
+	default:
+		return (uint32_t)p[1] << 24 | p[0] << 16 | p[0] << 8 | p[0];
+	}
+}
+
+static void setup_image(
+	png_header *header,
+	png_frame *frame,
+	int colour_type,
+	uint32_t width,
+	uint32_t height)
+{
+	memset(header, 0, sizeof(*header));
+	memset(frame, 0, sizeof(*frame));
+
+	header->colour_type = colour_type;
+	header->bit_depth = 8;
+	switch (colour_type) {
+	case COLOR_TRUE:
+		header->bpp = 24;
+		break;
+	case COLOR_TRUE_ALPHA:
+		header->bpp = 32;
+		break;
+	case COLOR_GREY:
+		header->bpp = 8;
+		break;
+	default:
+		header->bpp = 16;
+		break;
+	}
+	header->bytes_pp = header->bpp / 8;
+	header->bytes_pl = width * header->bytes_pp;
+	header->width = width;
+	header->height = height;
+	header->background = 0xFF000000 | (rand() & 0xFFFFFF);
+
+	frame->width = width;
+	frame->height = height;
+	frame->bytes_pp = header->bytes_pp;
+	frame->bytes_pl = header->bytes_pl;
+}
+
+/*
+ * Decodes one stream both ways into two framebuffers with a border of
+ * guard pixels around the image, and compares them.
+ */
+static int compare_paths(
+	png_header *header,
+	png_frame *frame,
+	unsigned char *stream,
+	uint32_t stream_size,
+	const uint32_t *reference)
+{
+	uint32_t fb_width = frame->width + 2 * FB_BORDER;
+	uint32_t fb_height = frame->height + 2 * FB_BORDER;
+	uint32_t pitch = fb_width * sizeof(uint32_t);
+	uint32_t *streamed, *buffered, row, i;
+	unsigned char *origin;
+	int ret = 0;
+
+	streamed = malloc(fb_height * pitch);
+	buffered = malloc(fb_height * pitch);
+	for (i = 0; i < fb_width * fb_height; i++) {
+		streamed[i] = buffered[i] = FB_GUARD;
+	}
+
+	origin = (unsigned char *)&streamed[FB_BORDER * fb_width + FB_BORDER];
+	stream_png_rows(header, frame, stream, stream_size, origin, pitch);
+
+	decode_png_data(header, stream, stream_size, frame);
+	if (!frame->output) {
+		printf("FAIL: whole frame decode did not allocate\n");
+		ret = 1;
+		goto out;
+	}
+	for (row = 0; row < frame->height; row++) {
+		splash_blend_row(&frame->output[row * frame->width],
+			&buffered[(FB_BORDER + row) * fb_width + FB_BORDER],
+			frame->width, header->background, APNG_BLEND_OP_SOURCE);
+	}
+
+	if (reference &&
+		memcmp(frame->output, reference, frame->size)) {
+		printf("FAIL: %ux%u colour type %u: whole frame decode differs "
+			"from the source image\n", frame->width, frame->height,
+			header->colour_type);
+		ret = 1;
+	}
+	if (memcmp(streamed, buffered, fb_height * pitch)) {
+		printf("FAIL: %ux%u colour type %u: streamed framebuffer differs "
+			"from the whole frame decode\n", frame->width, frame->height,
+			header->colour_type);
+		ret = 1;
+	}
+	test_vfree(frame->output);
+	frame->output = NULL;
+
+out:
+	free(streamed);
+	free(buffered);
+	return ret;
+}
+
+static int run_images(void)
+{
+	static const int colour_types[] = {
+		COLOR_TRUE, COLOR_TRUE_ALPHA, COLOR_GREY, COLOR_GREY_ALPHA
+	};
+	unsigned char *raw, *stream;
+	uint32_t *reference;
+	uint32_t width, height, size, stream_size, i, n;
+	png_header header;
+	png_frame frame;
+	int failed = 0;
+
+	for (n = 0; n < NUM_IMAGES; n++) {
+		width = 1 + rand() % 300;
+		height = 1 + rand() % 200;
+		setup_image(&header, &frame, colour_types[n % 4], width, height);
+
+		size = height * header.bytes_pl;
+		raw = malloc(size);
+		reference = malloc(width * height * sizeof(uint32_t));
+		stream = malloc(compressBound(size + height) + 16);
+		for (i = 0; i < size; i++) {
+			/* Mostly smooth so that filters matter, some noise */
+			raw[i] = (rand() % 4) ? (i * 3 / header.bytes_pp) & 0xFF : rand();
+		}
+		for (i = 0; i < width * height; i++) {
+			reference[i] = reference_pixel(raw + i * header.bytes_pp,
+				header.colour_type);
+		}
+
+		stream_size = encode_image(raw, width, height, header.bytes_pp,
+			stream, compressBound(size + height) + 16);
+		if (!stream_size) {
+			printf("zlib failed\n");
+			return 1;
+		}
+
+		failed += compare_paths(&header, &frame, stream, stream_size,
+			reference);
+
+		/* Truncated and corrupted streams must still agree */
+		failed += compare_paths(&header, &frame, stream,
+			rand() % stream_size, NULL);
+		stream[2 + rand() % (stream_size - 2)] ^= 1 << (rand() % 8);
+		failed += compare_paths(&header, &frame, stream, stream_size, NULL);
+
+		if (alloc_current) {
+			printf("FAIL: %u bytes leaked\n", (unsigned int)alloc_current);
+			failed++;
+		}
+
+		free(raw);
+		free(reference);
+		free(stream);
+	}
+
+	printf("%u images, %d failures\n", NUM_IMAGES, failed);
+	return failed != 0;
+}
+
+static int run_bench(void)
+{
+	uint32_t size = BENCH_HEIGHT * BENCH_WIDTH * 4, stream_size, row;
+	uint32_t pitch = BENCH_WIDTH * sizeof(uint32_t);
+	unsigned char *raw, *stream, *fb;
+	uint32_t *pixels;
+	png_header header;
+	png_frame frame;
+	png_rows rows;
+	double start, first_row = 0, total;
+	size_t peak;
+	uint32_t i;
+
+	setup_image(&header, &frame, COLOR_TRUE_ALPHA, BENCH_WIDTH,
+		BENCH_HEIGHT);
+	raw = malloc(size);
+	stream = malloc(compressBound(size + BENCH_HEIGHT));
+	fb = malloc(size);
+	for (i = 0; i < size; i++) {
+		raw[i] = ((i % pitch) < 4000) ? (i / 4) & 0x3F : rand() & 3;
+	}
+	stream_size = encode_image(raw, BENCH_WIDTH, BENCH_HEIGHT, 4, stream,
+		compressBound(size + BENCH_HEIGHT));
+
+	/* Streamed: the steps of stream_png_rows(), timing the first row */
+	alloc_peak = 0;
+	start = now_ms();
+	pixels = test_vmalloc(BENCH_WIDTH * sizeof(uint32_t));
+	begin_png_rows(&rows, &frame, stream, stream_size);
+	for (row = 0; row < BENCH_HEIGHT; row++) {
+		next_png_row(&rows, &header, &frame, pixels);
+		splash_blend_row(pixels, (uint32_t *)(fb + row * pitch),
+			BENCH_WIDTH, header.background, APNG_BLEND_OP_SOURCE);
+		if (row == 0) {
+			first_row = now_ms() - start;
+		}
+	}
+	end_png_rows(&rows);
+	test_vfree(pixels);
+	total = now_ms() - start;
+	peak = alloc_peak;
+	printf("streamed:    first row %.3f ms, all rows %.2f ms, "
+		"peak allocation %zu KB\n", first_row, total, peak / 1024);
+
+	/* Whole frame: nothing shows until the frame is decoded */
+	alloc_peak = 0;
+	start = now_ms();
+	decode_png_data(&header, stream, stream_size, &frame);
+	for (row = 0; row < BENCH_HEIGHT; row++) {
+		splash_blend_row(&frame.output[row * BENCH_WIDTH],
+			(uint32_t *)(fb + row * pitch), BENCH_WIDTH,
+			header.background, APNG_BLEND_OP_SOURCE);
+		if (row == 0) {
+			first_row = now_ms() - start;
+		}
+	}
+	total = now_ms() - start;
+	test_vfree(frame.output);
+	printf("whole frame: first row %.3f ms, all rows %.2f ms, "
+		"peak allocation %zu KB\n", first_row, total, alloc_peak / 1024);
+
+	free(raw);
+	free(stream);
+	free(fb);
+
+	if (peak >= alloc_peak) {
+		printf("FAIL: streaming does not save memory\n");
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+
+	if (argc > 1) {
+		seed = strtoul(argv[1], NULL, 0);
+	}
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	if (run_images()) {
+		return 1;
+	}
+	return run_bench();
+}
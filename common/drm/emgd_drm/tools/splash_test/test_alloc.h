@@ -0,0 +1,44 @@
+/* -*- pse-c -*-
+ *-----------------------------------------------------------------------------
+ * Filename: test_alloc.h
+ *-----------------------------------------------------------------------------
+ * Copyright (c) 2002-2014, Intel Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *-----------------------------------------------------------------------------
+ * Description:
+ *  Force included into the driver sources built by the tests, so that
+ *  their vmalloc()/vfree() calls go through an allocator that tracks the
+ *  bytes outstanding and the peak.
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _TEST_ALLOC_H
+#define _TEST_ALLOC_H
+
+#include <stddef.h>
+
+void *test_vmalloc(size_t size);
+void test_vfree(const void *ptr);
+
+#define vmalloc test_vmalloc
+#define vfree test_vfree
+
+#endif
@@ -59,6 +59,8 @@ struct drm_ipvr_context_destroy {
 /* ioctl used for querying info from driver */
 enum drm_ipvr_misc_key {
 	IPVR_DEVICE_INFO,
+	/* value is 1 if execbuffer takes IPVR_EXEC_NO_RELOC */
+	IPVR_HAS_EXEC_NO_RELOC,
 };
 struct drm_ipvr_get_info {
 	__u64 key;
@@ -159,6 +161,13 @@ struct drm_ipvr_gem_execbuffer {
 	 */
 	__u32 ctx_id;
 
+	/**
+	 * Relocations whose presumed_offset matches the target's offset are
+	 * skipped, userspace having already written presumed_offset + delta
+	 * into the buffer, as with I915_EXEC_NO_RELOC. Supported if the
+	 * IPVR_HAS_EXEC_NO_RELOC info reads 1.
+	 */
+#define IPVR_EXEC_NO_RELOC (1 << 0)
 	__u64 flags;
 	__u64 rsvd1;
 	__u64 rsvd2;
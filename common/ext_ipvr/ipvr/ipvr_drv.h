@@ -264,6 +264,10 @@ struct ved_private {
 	spinlock_t ved_lock;
 	struct mutex ved_mutex;
 	struct list_head ved_queue;
+	u32 ved_queue_depth;
+	/* idle command slots, see struct ved_cmd_queue */
+	struct list_head ved_cmd_slots;
+	u32 ved_cmd_slots_free;
 	/* busy means cmd submitted to fw, while irq hasn't been receieved */
 	bool ved_busy;
 	u32 ved_dash_access_ctrl;
@@ -242,8 +242,9 @@ static int ipvr_update_buffers(struct drm_file *file_priv,
 			IPVR_DEBUG_WARN("unexpected end of val_arg list!!!\n");
 			return -EINVAL;
 		}
-		if (unlikely(copy_to_user(val_arg, &entry->val_req,
-					    sizeof(entry->val_req)))) {
+		/* the offset is the only field execbuffer changes */
+		if (unlikely(copy_to_user(&val_arg->offset, &entry->val_req.offset,
+					    sizeof(entry->val_req.offset)))) {
 			IPVR_ERROR("copy_to_user fault.\n");
 			return -EFAULT;
 		}
@@ -304,15 +305,19 @@ out_err:
 
 static int ipvr_fixup_reloc_entries(struct drm_device *dev,
 					struct drm_file *filp,
-					struct ipvr_validate_buffer *val_obj)
+					struct ipvr_validate_buffer *val_obj,
+					bool no_reloc)
 {
-	int i, ret;
-	u64 mmu_offset;
-	struct drm_ipvr_gem_object *obj, *target_obj;
+#define N_RELOC(x) ((x) / sizeof(struct drm_ipvr_gem_relocation_entry))
+	struct drm_ipvr_gem_relocation_entry stack_reloc[N_RELOC(512)];
+	int i, count, remain, ret = 0;
+	u32 target_handle = 0;
+	u64 mmu_offset, target_offset = 0;
+	struct drm_ipvr_gem_object *obj, *target_obj = NULL;
 	struct drm_ipvr_gem_exec_object *exec_obj = &val_obj->val_req;
 	struct drm_ipvr_gem_relocation_entry __user *reloc_entries
 		= (struct drm_ipvr_gem_relocation_entry __user *)(uintptr_t)exec_obj->relocs_ptr;
-	struct drm_ipvr_gem_relocation_entry local_reloc_entry;
+	struct drm_ipvr_gem_relocation_entry *r;
 	obj = val_obj->ipvr_gem_bo;
 	if (!obj)
 		return -ENOENT;
@@ -326,42 +331,72 @@ static int ipvr_fixup_reloc_entries(struct drm_device *dev,
 		IPVR_DEBUG_GENERAL("Fixup BO %u offset to 0x%llx\n",
 			exec_obj->handle, exec_obj->offset);
 	}
-	for (i = 0; i < exec_obj->relocation_count; ++i) {
-		if (unlikely(copy_from_user(&local_reloc_entry, &reloc_entries[i],
-					    sizeof(local_reloc_entry)) != 0)) {
+
+	remain = exec_obj->relocation_count;
+	while (remain) {
+		count = min_t(int, remain, ARRAY_SIZE(stack_reloc));
+		if (unlikely(copy_from_user(stack_reloc, reloc_entries,
+					    count * sizeof(stack_reloc[0])) != 0)) {
 			IPVR_ERROR("copy_from_user fault.\n");
-			return -EFAULT;
-		}
-		target_obj = to_ipvr_bo(drm_gem_object_lookup(dev, filp,
-						local_reloc_entry.target_handle));
-		if (&target_obj->base == NULL) {
-			IPVR_ERROR("cannot find obj for handle %u at position %d.\n",
-				local_reloc_entry.target_handle, i);
-			return -ENOENT;
-		}
-		ret = ipvr_gem_object_apply_reloc(obj,
-				local_reloc_entry.offset,
-				local_reloc_entry.delta + ipvr_gem_object_mmu_offset(target_obj));
-		if (ret) {
-			IPVR_ERROR("Failed applying reloc: %d\n", ret);
-			drm_gem_object_unreference_unlocked(&target_obj->base);
-			return ret;
+			ret = -EFAULT;
+			goto out;
 		}
-		if (unlikely(copy_to_user(&reloc_entries[i], &local_reloc_entry,
-						sizeof(local_reloc_entry)) != 0)) {
-			IPVR_DEBUG_WARN("copy_to_user fault.\n");
+
+		for (i = 0, r = stack_reloc; i < count; i++, r++) {
+			/* relocations mostly come in runs against one target */
+			if (!target_obj || r->target_handle != target_handle) {
+				if (target_obj)
+					drm_gem_object_unreference_unlocked(&target_obj->base);
+				target_obj = to_ipvr_bo(drm_gem_object_lookup(dev,
+						filp, r->target_handle));
+				if (&target_obj->base == NULL) {
+					IPVR_ERROR("cannot find obj for handle %u at position %d.\n",
+						r->target_handle,
+						exec_obj->relocation_count - remain + i);
+					target_obj = NULL;
+					ret = -ENOENT;
+					goto out;
+				}
+				target_handle = r->target_handle;
+				target_offset = ipvr_gem_object_mmu_offset(target_obj);
+			}
+
+			if (no_reloc && r->presumed_offset == target_offset)
+				continue;
+
+			ret = ipvr_gem_object_apply_reloc(obj, r->offset,
+					r->delta + target_offset);
+			if (ret) {
+				IPVR_ERROR("Failed applying reloc: %d\n", ret);
+				goto out;
+			}
+			IPVR_DEBUG_GENERAL("Fixup offset %llx in BO %u to 0x%llx\n",
+				r->offset, exec_obj->handle,
+				r->delta + target_offset);
+
+			if (r->presumed_offset != target_offset) {
+				r->presumed_offset = target_offset;
+				if (unlikely(copy_to_user(&reloc_entries[i].presumed_offset,
+						&r->presumed_offset,
+						sizeof(r->presumed_offset)) != 0))
+					IPVR_DEBUG_WARN("copy_to_user fault.\n");
+			}
 		}
-		IPVR_DEBUG_GENERAL("Fixup offset %llx in BO %u to 0x%lx\n",
-			local_reloc_entry.offset, exec_obj->handle,
-			local_reloc_entry.delta + ipvr_gem_object_mmu_offset(target_obj));
-		drm_gem_object_unreference(&target_obj->base);
+
+		reloc_entries += count;
+		remain -= count;
 	}
-	return 0;
+out:
+	if (target_obj)
+		drm_gem_object_unreference_unlocked(&target_obj->base);
+	return ret;
+#undef N_RELOC
 }
 
 static int ipvr_fixup_relocs(struct drm_device *dev,
 					struct drm_file *filp,
-					struct ipvr_validate_context *context)
+					struct ipvr_validate_context *context,
+					bool no_reloc)
 {
 	int ret;
 	struct ipvr_validate_buffer *entry;
@@ -374,7 +409,7 @@ static int ipvr_fixup_relocs(struct drm_device *dev,
 	list_for_each_entry(entry, &context->validate_list, head) {
 		IPVR_DEBUG_GENERAL("Fixing up reloc for BO handle %u\n",
 			entry->val_req.handle);
-		ret = ipvr_fixup_reloc_entries(dev, filp, entry);
+		ret = ipvr_fixup_reloc_entries(dev, filp, entry, no_reloc);
 		if (ret) {
 			IPVR_ERROR("Failed to fixup reloc for BO handle %u\n",
 				entry->val_req.handle);
@@ -448,6 +483,7 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 	struct ipvr_context *ipvr_ctx  = NULL;
 	int ret, ctx_id;
 	bool need_fixup_relocs = false;
+	ktime_t start, ref, reserve, validate, reloc;
 
 	/* if not pass 0, use default context instead */
 	if (args->ctx_id == 0)
@@ -465,6 +501,7 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 		return -ENOENT;
 	}
 
+	start = ktime_get();
 	IPVR_DEBUG_GENERAL("reference all buffers passed through buffer_list.\n");
 	ret = ipvr_reference_buffers(file_priv, context,
 				args->buffers_ptr, args->buffer_count);
@@ -473,6 +510,7 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 		return ret;
 	}
 
+	ref = ktime_get();
 	IPVR_DEBUG_GENERAL("reserve all buffers to make them not accessed "
 			"by other threads.\n");
 	ret = ipvr_reserve_buffers(&context->validate_list);
@@ -482,6 +520,7 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 		goto out_unref_buf;
 	}
 
+	reserve = ktime_get();
 	IPVR_DEBUG_GENERAL("validate buffer list, mainly check "
 			"the bo mmu offset.\n");
 	ret = ipvr_validate_buffer_list(file_priv, context, &need_fixup_relocs, &cmd_buffer);
@@ -496,13 +535,16 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 		goto out_backoff_reserv;
 	}
 
+	validate = ktime_get();
 	if (unlikely(need_fixup_relocs)) {
-		ret = ipvr_fixup_relocs(dev, file_priv, context);
+		ret = ipvr_fixup_relocs(dev, file_priv, context,
+				args->flags & IPVR_EXEC_NO_RELOC);
 		if (ret) {
 			IPVR_ERROR("fixup relocs failed.\n");
 			goto out_backoff_reserv;
 		}
 	}
+	reloc = ktime_get();
 
 	/**
 	 * check contex id and type
@@ -539,14 +581,24 @@ static int ipvr_gem_do_execbuffer(struct drm_device *dev,
 		mutex_unlock(&ved_priv->ved_mutex);
 	}
 
+	trace_ipvr_execbuffer_stages(ctx_id, args->buffer_count,
+		need_fixup_relocs,
+		ktime_to_ns(ktime_sub(ref, start)),
+		ktime_to_ns(ktime_sub(reserve, ref)),
+		ktime_to_ns(ktime_sub(validate, reserve)),
+		ktime_to_ns(ktime_sub(reloc, validate)),
+		ktime_to_ns(ktime_sub(ktime_get(), reloc)));
+
 	/**
-	 * update mmu_offsets and fence fds to user
+	 * update mmu_offsets to user, they only change when relocs were fixed
 	 */
-	ret = ipvr_update_buffers(file_priv, context,
-				args->buffers_ptr, args->buffer_count);
-	if (unlikely(ret)) {
-		IPVR_DEBUG_WARN("ipvr_update_buffers returns error %d.\n", ret);
-		ret = 0;
+	if (unlikely(need_fixup_relocs)) {
+		ret = ipvr_update_buffers(file_priv, context,
+					args->buffers_ptr, args->buffer_count);
+		if (unlikely(ret)) {
+			IPVR_DEBUG_WARN("ipvr_update_buffers returns error %d.\n", ret);
+			ret = 0;
+		}
 	}
 
 out_backoff_reserv:
@@ -150,6 +150,9 @@ ipvr_get_info_ioctl(struct drm_device *dev, void *data,
 		args->value = VLV_IPVR_DEV_ID << 16;
 		break;
 	}
+	case IPVR_HAS_EXEC_NO_RELOC:
+		args->value = 1;
+		break;
 	default:
 		ret = -EINVAL;
 		break;
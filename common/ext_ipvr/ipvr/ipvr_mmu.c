@@ -114,9 +114,11 @@ ipvr_mmu_page_clflush(struct ipvr_mmu_driver *driver, struct page* page)
 	u32 clflush_count = PAGE_SIZE / clflush_add;
 	int i;
 	u8 *clf;
+	void *v;
 
-	clf = kmap_atomic(page);
+	v = kmap_atomic(page);
 
+	clf = v;
 	mb();
 	for (i = 0; i < clflush_count; ++i) {
 		ipvr_clflush(clf);
@@ -124,7 +126,7 @@ ipvr_mmu_page_clflush(struct ipvr_mmu_driver *driver, struct page* page)
 	}
 	mb();
 
-	kunmap_atomic(clf);
+	kunmap_atomic(v);
 }
 
 static void ipvr_mmu_pages_clflush(struct ipvr_mmu_driver *driver,
@@ -138,6 +140,23 @@ static void ipvr_mmu_pages_clflush(struct ipvr_mmu_driver *driver,
 	for (i = 0; i < num_pages; i++)
 		ipvr_mmu_page_clflush(driver, *page++);
 }
+
+/* clflush each cacheline holding one of the num_ptes entries at v, once */
+static void
+ipvr_mmu_ptes_clflush(struct ipvr_mmu_driver *driver, u32 *v, u32 num_ptes)
+{
+	unsigned long line = driver->clflush_add / (PAGE_SIZE / sizeof(u32));
+	unsigned long clf = (unsigned long)v & ~(line - 1);
+	unsigned long end = (unsigned long)(v + num_ptes);
+
+	if (!driver->has_clflush || !num_ptes)
+		return;
+
+	mb();
+	for (; clf < end; clf += line)
+		ipvr_clflush((void *)clf);
+	mb();
+}
 #else
 
 static inline void
@@ -152,6 +171,12 @@ static void ipvr_mmu_pages_clflush(struct ipvr_mmu_driver *driver,
 	IPVR_DEBUG_GENERAL("Dumy ipvr_mmu_pages_clflush\n");
 }
 
+static inline void
+ipvr_mmu_ptes_clflush(struct ipvr_mmu_driver *driver, u32 *v, u32 num_ptes)
+{
+	;
+}
+
 #endif
 
 static void
@@ -167,19 +192,20 @@ out:
 	atomic_set(&driver->needs_tlbflush, 0);
 }
 
-static void ipvr_mmu_flush(struct ipvr_mmu_driver *driver, bool rc_prot)
+/*
+ * The firmware invalidates the VED MMU when the next decode message
+ * carries FW_INVALIDATE_MMU (see ved_map_command), so flushing only raises
+ * that flag. However many binds land between two submissions, the TLB is
+ * invalidated once, and binds never wait on each other for the semaphore.
+ */
+static void ipvr_mmu_flush(struct ipvr_mmu_driver *driver)
 {
-	if (rc_prot)
-		down_write(&driver->sem);
-
 	if (!driver->dev_priv)
-		goto out;
+		return;
 
+	/* PTE writes must be visible before the invalidate is requested */
+	smp_wmb();
 	atomic_set(&driver->dev_priv->ipvr_mmu_invaldc, 1);
-
-out:
-	if (rc_prot)
-		up_write(&driver->sem);
 }
 
 void ipvr_mmu_set_pd_context(struct ipvr_mmu_pd *pd, u32 hw_context)
@@ -451,7 +477,7 @@ static void ipvr_mmu_pt_unmap_unlock(struct ipvr_mmu_pt *pt)
 			atomic_set(&pd->driver->needs_tlbflush, 1);
 		}
 
-		kunmap_atomic(pt->v);
+		kunmap_atomic(v);
 
 		spin_unlock(&pd->driver->lock);
 		ipvr_mmu_free_pt(pt);
@@ -460,16 +486,56 @@ static void ipvr_mmu_pt_unmap_unlock(struct ipvr_mmu_pt *pt)
 	spin_unlock(&pd->driver->lock);
 }
 
-static inline void
-ipvr_mmu_set_pte(struct ipvr_mmu_pt *pt, unsigned long addr, u32 pte)
+/*
+ * Write the PTEs for [addr, next), which lie in one page table, as a
+ * single run and clflush the cachelines they cover while the table is
+ * still mapped. On a bad pfn the PTEs written so far stay accounted in
+ * pt->count, so that ipvr_mmu_insert_pages() can clear them again.
+ */
+static int ipvr_mmu_fill_ptes(struct ipvr_mmu_pt *pt, struct page ***pages,
+			unsigned long addr, unsigned long next, u32 type)
 {
-	pt->v[ipvr_mmu_pt_index(addr)] = pte;
+	struct ipvr_mmu_pd *pd = pt->pd;
+	u32 *v = pt->v + ipvr_mmu_pt_index(addr);
+	u32 num_ptes = (next - addr) >> PAGE_SHIFT;
+	struct page **p = *pages;
+	unsigned long pfn;
+	int ret = 0;
+	u32 i;
+
+	for (i = 0; i < num_ptes; i++) {
+		pfn = page_to_pfn(p[i]);
+		/* should be under 4GiB */
+		if (pfn >= 0x00100000UL) {
+			IPVR_ERROR("cannot support pfn 0x%lx\n", pfn);
+			ret = -EINVAL;
+			break;
+		}
+		v[i] = ipvr_mmu_mask_pte(pfn, type);
+	}
+
+	pt->count += i;
+	*pages = p + i;
+	if (pd->hw_context != -1)
+		ipvr_mmu_ptes_clflush(pd->driver, v, i);
+	return ret;
 }
 
-static inline void
-ipvr_mmu_invalidate_pte(struct ipvr_mmu_pt *pt, unsigned long addr)
+static void ipvr_mmu_clear_ptes(struct ipvr_mmu_pt *pt,
+			unsigned long addr, unsigned long next)
 {
-	pt->v[ipvr_mmu_pt_index(addr)] = pt->pd->invalid_pte;
+	struct ipvr_mmu_pd *pd = pt->pd;
+	u32 *v = pt->v + ipvr_mmu_pt_index(addr);
+	u32 num_ptes = (next - addr) >> PAGE_SHIFT;
+	u32 i;
+
+	for (i = 0; i < num_ptes; i++)
+		v[i] = pd->invalid_pte;
+
+	/* an emptied table is freed and its PDE flushed instead */
+	pt->count -= num_ptes;
+	if (pd->hw_context != -1 && pt->count)
+		ipvr_mmu_ptes_clflush(pd->driver, v, num_ptes);
 }
 
 struct ipvr_mmu_pd *ipvr_mmu_get_default_pd(struct ipvr_mmu_driver *driver)
@@ -553,75 +619,9 @@ out_err1:
 	return NULL;
 }
 
-#if defined(CONFIG_X86)
-static void ipvr_mmu_flush_ptes(struct ipvr_mmu_pd *pd,
-			unsigned long address,
-			int num_pages,
-			u32 desired_tile_stride,
-			u32 hw_tile_stride)
-{
-	struct ipvr_mmu_pt *pt;
-	int rows = 1;
-	int i;
-	unsigned long addr;
-	unsigned long end;
-	unsigned long next;
-	unsigned long add;
-	unsigned long row_add;
-	unsigned long clflush_add = pd->driver->clflush_add;
-	unsigned long clflush_mask = pd->driver->clflush_mask;
-	IPVR_DEBUG_GENERAL("call x86 ipvr_mmu_flush_ptes, address is 0x%lx, "
-			"num pages is %d.\n", address, num_pages);
-	if (!pd->driver->has_clflush) {
-		IPVR_DEBUG_GENERAL("call ipvr_mmu_pages_clflush.\n");
-		ipvr_mmu_pages_clflush(pd->driver, &pd->p, num_pages);
-		return;
-	}
-
-	if (hw_tile_stride)
-		rows = num_pages / desired_tile_stride;
-	else
-		desired_tile_stride = num_pages;
-
-	add = desired_tile_stride << PAGE_SHIFT;
-	row_add = hw_tile_stride << PAGE_SHIFT;
-	mb();
-	for (i = 0; i < rows; ++i) {
-		addr = address;
-		end = addr + add;
-
-		do {
-			next = ipvr_pd_addr_end(addr, end);
-			pt = ipvr_mmu_pt_map_lock(pd, addr);
-			if (!pt)
-				continue;
-			do {
-				ipvr_clflush(&pt->v[ipvr_mmu_pt_index(addr)]);
-			} while (addr +=
-					 clflush_add,
-				 (addr & clflush_mask) < next);
-
-			ipvr_mmu_pt_unmap_unlock(pt);
-		} while (addr = next, next != end);
-		address += row_add;
-	}
-	mb();
-}
-#else
-
-static void ipvr_mmu_flush_ptes(struct ipvr_mmu_pd *pd,
-					unsigned long address,
-					int num_pages,
-					u32 desired_tile_stride,
-					u32 hw_tile_stride)
-{
-	IPVR_DEBUG_GENERAL("call non-x86 ipvr_mmu_flush_ptes.\n");
-}
-#endif
-
-void ipvr_mmu_remove_pages(struct ipvr_mmu_pd *pd, unsigned long address,
-			int num_pages, u32 desired_tile_stride,
-			u32 hw_tile_stride)
+static void ipvr_mmu_clear_pages(struct ipvr_mmu_pd *pd,
+			unsigned long address, int num_pages,
+			u32 desired_tile_stride, u32 hw_tile_stride)
 {
 	struct ipvr_mmu_pt *pt;
 	int rows = 1;
@@ -631,7 +631,6 @@ void ipvr_mmu_remove_pages(struct ipvr_mmu_pd *pd, unsigned long address,
 	unsigned long next;
 	unsigned long add;
 	unsigned long row_add;
-	unsigned long f_address = address;
 
 	if (hw_tile_stride)
 		rows = num_pages / desired_tile_stride;
@@ -655,24 +654,25 @@ void ipvr_mmu_remove_pages(struct ipvr_mmu_pd *pd, unsigned long address,
 			pt = ipvr_mmu_pt_map_lock(pd, addr);
 			if (!pt)
 				continue;
-			do {
-				ipvr_mmu_invalidate_pte(pt, addr);
-				--pt->count;
-
-			} while (addr += PAGE_SIZE, addr < next);
+			ipvr_mmu_clear_ptes(pt, addr, next);
 			ipvr_mmu_pt_unmap_unlock(pt);
 
 		} while (addr = next, next != end);
 		address += row_add;
 	}
-	if (pd->hw_context != -1)
-		ipvr_mmu_flush_ptes(pd, f_address, num_pages,
-				   desired_tile_stride, hw_tile_stride);
 
 	/* up_read(&pd->driver->sem); */
+}
+
+void ipvr_mmu_remove_pages(struct ipvr_mmu_pd *pd, unsigned long address,
+			int num_pages, u32 desired_tile_stride,
+			u32 hw_tile_stride)
+{
+	ipvr_mmu_clear_pages(pd, address, num_pages,
+			desired_tile_stride, hw_tile_stride);
 
 	if (pd->hw_context != -1)
-		ipvr_mmu_flush(pd->driver, 0);
+		ipvr_mmu_flush(pd->driver);
 	ipvr_stat_remove_mmu_bind(pd->driver->dev_priv, num_pages << PAGE_SHIFT);
 }
 
@@ -682,16 +682,16 @@ int ipvr_mmu_insert_pages(struct ipvr_mmu_pd *pd, struct page **pages,
 			u32 hw_tile_stride, u32 type)
 {
 	struct ipvr_mmu_pt *pt;
+	struct page **first = pages;
+	unsigned long start = address;
 	int rows = 1;
 	int i;
-	u32 pte;
 	unsigned long addr;
 	unsigned long end;
 	unsigned long next;
 	unsigned long add;
 	unsigned long row_add;
-	unsigned long f_address = address;
-	unsigned long pfn;
+	int done;
 	int ret = 0;
 
 	if (hw_tile_stride) {
@@ -719,34 +719,38 @@ int ipvr_mmu_insert_pages(struct ipvr_mmu_pd *pd, struct page **pages,
 				ret = -ENOMEM;
 				goto out;
 			}
-			do {
-				pfn = page_to_pfn(*pages++);
-				/* should be under 4GiB */
-				if (pfn >= 0x00100000UL) {
-					IPVR_ERROR("cannot support pfn 0x%lx\n", pfn);
-					ret = -EINVAL;
-					goto out;
-				}
-				pte = ipvr_mmu_mask_pte(pfn, type);
-				ipvr_mmu_set_pte(pt, addr, pte);
-				pt->count++;
-			} while (addr += PAGE_SIZE, addr < next);
+			ret = ipvr_mmu_fill_ptes(pt, &pages, addr, next, type);
 			ipvr_mmu_pt_unmap_unlock(pt);
+			if (ret)
+				goto out;
 
 		} while (addr = next, next != end);
 
 		address += row_add;
 	}
 out:
-	if (pd->hw_context != -1)
-		ipvr_mmu_flush_ptes(pd, f_address, num_pages,
-				   desired_tile_stride, hw_tile_stride);
-
+	/*
+	 * The callers do not unbind after a failure, so clear the PTEs
+	 * written before it: whole rows, then the start of the failed one.
+	 */
+	done = pages - first;
+	if (ret && done) {
+		rows = done / desired_tile_stride;
+		if (rows)
+			ipvr_mmu_clear_pages(pd, start,
+				rows * desired_tile_stride,
+				desired_tile_stride, hw_tile_stride);
+		if (done % desired_tile_stride)
+			ipvr_mmu_clear_pages(pd, start + rows * row_add,
+				done % desired_tile_stride, 0, 0);
+	}
 	up_read(&pd->driver->sem);
 
 	if (pd->hw_context != -1)
-		ipvr_mmu_flush(pd->driver, 1);
+		ipvr_mmu_flush(pd->driver);
 
-	ipvr_stat_add_mmu_bind(pd->driver->dev_priv, num_pages << PAGE_SHIFT);
+	if (!ret)
+		ipvr_stat_add_mmu_bind(pd->driver->dev_priv,
+			num_pages << PAGE_SHIFT);
 	return ret;
 }
@@ -166,6 +166,38 @@ TRACE_EVENT(ipvr_execbuffer,
 		__entry->ctx_id)
 );
 
+TRACE_EVENT(ipvr_execbuffer_stages,
+	TP_PROTO(u32 ctx_id, u32 buffer_count, bool relocs, u64 ref_ns,
+		u64 reserve_ns, u64 validate_ns, u64 reloc_ns, u64 submit_ns),
+	TP_ARGS(ctx_id, buffer_count, relocs, ref_ns, reserve_ns,
+		validate_ns, reloc_ns, submit_ns),
+	TP_STRUCT__entry(
+		__field(u32, ctx_id)
+		__field(u32, buffer_count)
+		__field(bool, relocs)
+		__field(u64, ref_ns)
+		__field(u64, reserve_ns)
+		__field(u64, validate_ns)
+		__field(u64, reloc_ns)
+		__field(u64, submit_ns)
+	),
+	TP_fast_assign(
+		__entry->ctx_id = ctx_id;
+		__entry->buffer_count = buffer_count;
+		__entry->relocs = relocs;
+		__entry->ref_ns = ref_ns;
+		__entry->reserve_ns = reserve_ns;
+		__entry->validate_ns = validate_ns;
+		__entry->reloc_ns = reloc_ns;
+		__entry->submit_ns = submit_ns;
+	),
+	TP_printk("ctx_id=%d, buffer_count=%u, relocs=%d, ref=%lluns, "
+		"reserve=%lluns, validate=%lluns, reloc=%lluns, submit=%lluns",
+		__entry->ctx_id, __entry->buffer_count, __entry->relocs,
+		__entry->ref_ns, __entry->reserve_ns, __entry->validate_ns,
+		__entry->reloc_ns, __entry->submit_ns)
+);
+
 TRACE_EVENT(ved_cmd_send,
 	TP_PROTO(u32 ctx_id, u32 cmd_id, u32 seq),
 	TP_ARGS(ctx_id, cmd_id, seq),
@@ -200,6 +232,43 @@ TRACE_EVENT(ved_cmd_copy,
 		__entry->ctx_id, __entry->cmd_id, __entry->seq)
 );
 
+TRACE_EVENT(ved_cmd_queue,
+	TP_PROTO(u32 ctx_id, u32 seq, u32 depth),
+	TP_ARGS(ctx_id, seq, depth),
+	TP_STRUCT__entry(
+		__field(u32, ctx_id)
+		__field(u32, seq)
+		__field(u32, depth)
+	),
+	TP_fast_assign(
+		__entry->ctx_id = ctx_id;
+		__entry->seq = seq;
+		__entry->depth = depth;
+	),
+	TP_printk("ctx_id=0x%08x, seq=0x%08x, depth=%u",
+		__entry->ctx_id, __entry->seq, __entry->depth)
+);
+
+TRACE_EVENT(ved_cmd_dequeue,
+	TP_PROTO(u32 ctx_id, u32 seq, u32 depth, s64 latency_us),
+	TP_ARGS(ctx_id, seq, depth, latency_us),
+	TP_STRUCT__entry(
+		__field(u32, ctx_id)
+		__field(u32, seq)
+		__field(u32, depth)
+		__field(s64, latency_us)
+	),
+	TP_fast_assign(
+		__entry->ctx_id = ctx_id;
+		__entry->seq = seq;
+		__entry->depth = depth;
+		__entry->latency_us = latency_us;
+	),
+	TP_printk("ctx_id=0x%08x, seq=0x%08x, depth=%u, latency=%lldus",
+		__entry->ctx_id, __entry->seq, __entry->depth,
+		__entry->latency_us)
+);
+
 TRACE_EVENT(ipvr_get_power,
 	TP_PROTO(int usage, int pending),
 	TP_ARGS(usage, pending),
@@ -0,0 +1,200 @@
+/**************************************************************************
+ * mmu_stub.h: userspace stand-ins for what ipvr_mmu.c needs from the kernel
+ *
+ * Copyright (c) 2014 Intel Corporation, Hillsboro, OR, USA
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **************************************************************************/
+
+#ifndef _MMU_STUB_H_
+#define _MMU_STUB_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+/* ipvr_mmu.c's own headers pull in the whole driver, these replace them */
+#define _IPVR_DRV_H_
+#define _IPVR_DEBUG_H_
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#define CONFIG_X86
+#endif
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+
+#define __must_check
+#define __force
+#define __iomem
+#define unlikely(x)		(x)
+#define MAX_ERRNO		4095
+
+#define PAGE_SHIFT		12
+#define PAGE_SIZE		(1UL << PAGE_SHIFT)
+#define GFP_KERNEL		0
+#define GFP_DMA32		0
+
+#define mb()			__sync_synchronize()
+#define wmb()			__sync_synchronize()
+#define smp_wmb()		__sync_synchronize()
+
+/* Misuse found by the stubs, see mmu_test.c */
+void mmu_stub_fail(const char *what);
+
+typedef struct {
+	int counter;
+} atomic_t;
+
+#define atomic_read(a)		((a)->counter)
+#define atomic_set(a, v)	((a)->counter = (v))
+
+/* Single threaded: taking a held lock would deadlock in the kernel */
+typedef struct {
+	int locked;
+} spinlock_t;
+
+static inline void spin_lock_init(spinlock_t *lock)
+{
+	lock->locked = 0;
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	if (lock->locked)
+		mmu_stub_fail("spin_lock on a held lock");
+	lock->locked = 1;
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+	if (!lock->locked)
+		mmu_stub_fail("spin_unlock of a free lock");
+	lock->locked = 0;
+}
+
+struct rw_semaphore {
+	int readers;
+	int writer;
+};
+
+static inline void init_rwsem(struct rw_semaphore *sem)
+{
+	sem->readers = 0;
+	sem->writer = 0;
+}
+
+static inline void down_read(struct rw_semaphore *sem)
+{
+	if (sem->writer)
+		mmu_stub_fail("down_read under the write lock");
+	sem->readers++;
+}
+
+static inline void up_read(struct rw_semaphore *sem)
+{
+	if (sem->readers-- <= 0)
+		mmu_stub_fail("up_read without down_read");
+}
+
+static inline void down_write(struct rw_semaphore *sem)
+{
+	if (sem->writer || sem->readers)
+		mmu_stub_fail("down_write on a held semaphore");
+	sem->writer = 1;
+}
+
+static inline void up_write(struct rw_semaphore *sem)
+{
+	if (!sem->writer)
+		mmu_stub_fail("up_write without down_write");
+	sem->writer = 0;
+}
+
+/*
+ * The mocked page allocator: pages get increasing pfns and page aligned
+ * memory. The pages of a buffer object are made by the test instead and
+ * have a pfn only.
+ */
+struct page {
+	unsigned long pfn;
+	void *virt;
+};
+
+struct page *alloc_page(int gfp);
+void __free_page(struct page *page);
+void *kmalloc(size_t size, int gfp);
+void kfree(const void *p);
+void *vmalloc_user(unsigned long size);
+void vfree(const void *p);
+
+#define page_to_pfn(page)	((page)->pfn)
+
+static inline void clear_page(void *v)
+{
+	memset(v, 0, PAGE_SIZE);
+}
+
+/* kmap_atomic slots are a stack, kunmap_atomic must take the newest */
+void *kmap_atomic(struct page *page);
+void kunmap_atomic(void *addr);
+
+static inline void *kmap(struct page *page)
+{
+	return page->virt;
+}
+
+static inline void kunmap(struct page *page)
+{
+}
+
+#ifdef CONFIG_X86
+#define cpu_has_clflush		1
+
+static inline void cpuid(unsigned int op, u32 *eax, u32 *ebx, u32 *ecx,
+			u32 *edx)
+{
+	__cpuid(op, *eax, *ebx, *ecx, *edx);
+}
+#endif
+
+struct drm_ipvr_private {
+	atomic_t ipvr_mmu_invaldc;
+	long mmu_bound;
+};
+
+extern unsigned long ipvr_errors;
+
+#define IPVR_ERROR(_fmt, _arg...)		(ipvr_errors++)
+#define IPVR_DEBUG_GENERAL(_fmt, _arg...)	do { } while (0)
+
+static inline void ipvr_stat_add_mmu_bind(struct drm_ipvr_private *dev_priv,
+			size_t size)
+{
+	dev_priv->mmu_bound += size;
+}
+
+static inline void ipvr_stat_remove_mmu_bind(struct drm_ipvr_private *dev_priv,
+			size_t size)
+{
+	dev_priv->mmu_bound -= size;
+}
+
+#endif
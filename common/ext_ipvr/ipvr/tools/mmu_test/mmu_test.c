@@ -0,0 +1,471 @@
+/**************************************************************************
+ * mmu_test.c: userspace check of the VED MMU page table code
+ *
+ * Copyright (c) 2014 Intel Corporation, Hillsboro, OR, USA
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ **************************************************************************/
+
+/*
+ * ipvr_mmu.c is built unchanged against mmu_stub.h, with a mocked page
+ * allocator, and driven through random sequences of ipvr_mmu_insert_pages
+ * and ipvr_mmu_remove_pages: linear and tiled ranges at unaligned
+ * addresses, some with a pfn above 4GiB or a failing allocation injected.
+ * After every call the page directory, the page table counts and the PTEs
+ * of the tables it touched must match a model of the bound objects, a
+ * failed insert must leave nothing bound, and the spinlock, the semaphore
+ * and the kmap_atomic slots must all be released.
+ */
+
+#include "mmu_stub.h"
+#include "ipvr_mmu.c"
+
+#define NUM_SEQUENCES		60
+#define OPS_PER_SEQUENCE	200
+#define MAX_OBJECTS		64
+#define LINEAR_PAGES		(IPVR_MEM_MMU_LINEAR_END >> PAGE_SHIFT)
+#define TOTAL_PAGES		(IPVR_MEM_MMU_TILING_END >> PAGE_SHIFT)
+#define NUM_PDES		(TOTAL_PAGES >> 10)
+#define BAD_PFN			0x00100000UL
+
+struct object {
+	unsigned long address;
+	int num_pages;
+	u32 desired_tile_stride;
+	u32 hw_tile_stride;
+};
+
+unsigned long ipvr_errors;
+
+static int failures;
+static long live_pages, live_allocs;
+/* Fail the allocation this many from now, 0 for none */
+static int fail_countdown;
+static int alloc_failed;
+
+static void *kmap_stack[4];
+static int kmap_depth;
+
+/* Expected PTE of each page of the MMU, 0 when unbound */
+static u32 model[TOTAL_PAGES];
+static u32 model_count[NUM_PDES];
+
+static struct object objects[MAX_OBJECTS];
+static int num_objects;
+
+static struct {
+	unsigned long inserts, bad_pfn, no_memory, removes;
+} stats;
+
+void mmu_stub_fail(const char *what)
+{
+	printf("FAIL: %s\n", what);
+	failures++;
+}
+
+static int alloc_fails(void)
+{
+	if (fail_countdown && --fail_countdown == 0) {
+		alloc_failed = 1;
+		return 1;
+	}
+	return 0;
+}
+
+struct page *alloc_page(int gfp)
+{
+	static unsigned long next_pfn = 0x1000;
+	struct page *page;
+
+	if (alloc_fails())
+		return NULL;
+	page = malloc(sizeof(*page));
+	if (!page || posix_memalign(&page->virt, PAGE_SIZE, PAGE_SIZE)) {
+		printf("Out of memory.\n");
+		exit(1);
+	}
+	/* kernel pages are not cleared */
+	memset(page->virt, 0x5a, PAGE_SIZE);
+	page->pfn = next_pfn++;
+	live_pages++;
+	return page;
+}
+
+void __free_page(struct page *page)
+{
+	free(page->virt);
+	free(page);
+	live_pages--;
+}
+
+void *kmalloc(size_t size, int gfp)
+{
+	void *p;
+
+	if (alloc_fails())
+		return NULL;
+	p = malloc(size);
+	if (!p) {
+		printf("Out of memory.\n");
+		exit(1);
+	}
+	memset(p, 0x5a, size);
+	live_allocs++;
+	return p;
+}
+
+void kfree(const void *p)
+{
+	if (p) {
+		free((void *)p);
+		live_allocs--;
+	}
+}
+
+void *vmalloc_user(unsigned long size)
+{
+	void *p = calloc(1, size);
+
+	if (p)
+		live_allocs++;
+	return p;
+}
+
+void vfree(const void *p)
+{
+	kfree(p);
+}
+
+void *kmap_atomic(struct page *page)
+{
+	if (!page->virt || kmap_depth == 4) {
+		mmu_stub_fail("kmap_atomic of a buffer page or out of slots");
+		return page->virt;
+	}
+	kmap_stack[kmap_depth++] = page->virt;
+	return page->virt;
+}
+
+void kunmap_atomic(void *addr)
+{
+	unsigned long base = (unsigned long)addr & ~(PAGE_SIZE - 1);
+
+	if (!kmap_depth || base != (unsigned long)kmap_stack[kmap_depth - 1]) {
+		mmu_stub_fail("kunmap_atomic of other than the newest mapping");
+		return;
+	}
+	kmap_depth--;
+}
+
+static unsigned long rnd(void)
+{
+	return ((unsigned long)rand() << 15) ^ rand();
+}
+
+static unsigned long object_page(struct object *o, int k)
+{
+	if (!o->hw_tile_stride)
+		return (o->address >> PAGE_SHIFT) + k;
+	return (o->address >> PAGE_SHIFT) +
+		(k / o->desired_tile_stride) * o->hw_tile_stride +
+		k % o->desired_tile_stride;
+}
+
+static void model_set(unsigned long page, u32 pte)
+{
+	if (model[page] && !pte)
+		model_count[page >> 10]--;
+	else if (!model[page] && pte)
+		model_count[page >> 10]++;
+	model[page] = pte;
+}
+
+static void check_table(struct ipvr_mmu_pd *pd, int index)
+{
+	struct ipvr_mmu_pt *pt = pd->tables[index];
+	u32 *v = pt->p->virt;
+	u32 want;
+	int i;
+
+	for (i = 0; i < 1024; i++) {
+		want = model[index * 1024 + i];
+		if (v[i] != (want ? want : pd->invalid_pte)) {
+			printf("FAIL: PTE 0x%x of table %d is 0x%x, "
+				"expected 0x%x\n", i, index, v[i],
+				want ? want : pd->invalid_pte);
+			failures++;
+			return;
+		}
+	}
+}
+
+/*
+ * Every PDE, page table and count against the model, and the PTEs of the
+ * tables from first to last.
+ */
+static void check(struct ipvr_mmu_driver *driver, int first, int last)
+{
+	struct ipvr_mmu_pd *pd = driver->default_pd;
+	u32 *pde = pd->p->virt;
+	long tables = 0;
+	int i;
+
+	if (driver->lock.locked || driver->sem.readers || driver->sem.writer ||
+		kmap_depth) {
+		printf("FAIL: left with lock %d, semaphore %d/%d, %d kmaps\n",
+			driver->lock.locked, driver->sem.readers,
+			driver->sem.writer, kmap_depth);
+		failures++;
+		driver->lock.locked = 0;
+		init_rwsem(&driver->sem);
+		kmap_depth = 0;
+	}
+
+	for (i = 0; i < 1024; i++) {
+		struct ipvr_mmu_pt *pt = pd->tables[i];
+		u32 count = i < NUM_PDES ? model_count[i] : 0;
+
+		if (!pt) {
+			if (count || pde[i] != pd->invalid_pde) {
+				printf("FAIL: table %d missing with %u PTEs, "
+					"PDE 0x%x\n", i, count, pde[i]);
+				failures++;
+			}
+			continue;
+		}
+		tables++;
+		if (pt->count != count || pt->index != i ||
+			pde[i] != ((page_to_pfn(pt->p) << 12) | IPVR_PTE_VALID)) {
+			printf("FAIL: table %d counts %u PTEs, expected %u, "
+				"PDE 0x%x\n", i, pt->count, count, pde[i]);
+			failures++;
+			continue;
+		}
+		if (i >= first && i <= last)
+			check_table(pd, i);
+	}
+
+	if (live_pages != 3 + tables) {
+		printf("FAIL: %ld pages allocated for %ld page tables\n",
+			live_pages, tables);
+		failures++;
+	}
+}
+
+static int free_for(struct object *o)
+{
+	int k;
+
+	for (k = 0; k < o->num_pages; k++)
+		if (model[object_page(o, k)])
+			return 0;
+	return 1;
+}
+
+static void pick_object(struct object *o)
+{
+	unsigned long span;
+	int rows;
+
+	do {
+		if (rand() % 3) {
+			o->num_pages = 1 + rnd() % (rand() % 4 ? 256 : 4096);
+			o->desired_tile_stride = 0;
+			o->hw_tile_stride = 0;
+			o->address = (rnd() % (LINEAR_PAGES - o->num_pages))
+				<< PAGE_SHIFT;
+		} else {
+			o->desired_tile_stride = 1 + rnd() % 256;
+			o->hw_tile_stride = o->desired_tile_stride + rnd() % 512;
+			rows = 1 + rand() % 32;
+			o->num_pages = rows * o->desired_tile_stride;
+			span = (rows - 1) * o->hw_tile_stride +
+				o->desired_tile_stride;
+			o->address = (LINEAR_PAGES +
+				rnd() % (TOTAL_PAGES - LINEAR_PAGES - span))
+				<< PAGE_SHIFT;
+		}
+	} while (!free_for(o));
+}
+
+static void insert(struct ipvr_mmu_driver *driver, struct drm_ipvr_private *dev_priv)
+{
+	struct ipvr_mmu_pd *pd = driver->default_pd;
+	struct object *o = &objects[num_objects];
+	struct page *pages, **ptrs;
+	int bad = -1, expect_nomem = 0;
+	u32 type = rand() % 8;
+	int k, ret;
+
+	pick_object(o);
+	pages = malloc(o->num_pages * sizeof(*pages));
+	ptrs = malloc(o->num_pages * sizeof(*ptrs));
+	if (!pages || !ptrs) {
+		printf("Out of memory.\n");
+		exit(1);
+	}
+	for (k = 0; k < o->num_pages; k++) {
+		pages[k].pfn = 1 + rnd() % (BAD_PFN - 1);
+		pages[k].virt = NULL;
+		ptrs[k] = &pages[k];
+	}
+
+	switch (rand() % 8) {
+	case 0:
+		bad = rnd() % o->num_pages;
+		pages[bad].pfn = BAD_PFN + rnd() % BAD_PFN;
+		stats.bad_pfn++;
+		break;
+	case 1:
+		fail_countdown = 1 + rand() % 4;
+		alloc_failed = 0;
+		break;
+	default:
+		break;
+	}
+
+	atomic_set(&dev_priv->ipvr_mmu_invaldc, 0);
+	ret = ipvr_mmu_insert_pages(pd, ptrs, o->address, o->num_pages,
+		o->desired_tile_stride, o->hw_tile_stride, type);
+	if (fail_countdown) {
+		fail_countdown = 0;
+	} else if (alloc_failed) {
+		expect_nomem = 1;
+		alloc_failed = 0;
+		stats.no_memory++;
+	}
+	stats.inserts++;
+
+	if (ret != (bad >= 0 ? -EINVAL : expect_nomem ? -ENOMEM : 0)) {
+		printf("FAIL: insert of %d pages at 0x%lx returned %d\n",
+			o->num_pages, o->address, ret);
+		failures++;
+	}
+	if (!ret) {
+		for (k = 0; k < o->num_pages; k++)
+			model_set(object_page(o, k),
+				ipvr_mmu_mask_pte(pages[k].pfn, type));
+		num_objects++;
+	}
+	if (pd->hw_context != -1 && !atomic_read(&dev_priv->ipvr_mmu_invaldc)) {
+		printf("FAIL: insert did not request a TLB flush\n");
+		failures++;
+	}
+
+	check(driver, object_page(o, 0) >> 10,
+		object_page(o, o->num_pages - 1) >> 10);
+	free(pages);
+	free(ptrs);
+}
+
+static void remove_object(struct ipvr_mmu_driver *driver,
+			struct drm_ipvr_private *dev_priv, int i)
+{
+	struct ipvr_mmu_pd *pd = driver->default_pd;
+	struct object o = objects[i];
+	int k;
+
+	objects[i] = objects[--num_objects];
+	atomic_set(&dev_priv->ipvr_mmu_invaldc, 0);
+	ipvr_mmu_remove_pages(pd, o.address, o.num_pages,
+		o.desired_tile_stride, o.hw_tile_stride);
+	stats.removes++;
+
+	for (k = 0; k < o.num_pages; k++)
+		model_set(object_page(&o, k), 0);
+	if (pd->hw_context != -1 && !atomic_read(&dev_priv->ipvr_mmu_invaldc)) {
+		printf("FAIL: remove did not request a TLB flush\n");
+		failures++;
+	}
+
+	check(driver, object_page(&o, 0) >> 10,
+		object_page(&o, o.num_pages - 1) >> 10);
+}
+
+static void run_sequence(int n)
+{
+	struct drm_ipvr_private dev_priv;
+	struct ipvr_mmu_driver *driver;
+	long bound;
+	int i, k;
+
+	memset(&dev_priv, 0, sizeof(dev_priv));
+	driver = ipvr_mmu_driver_init(NULL, 0, &dev_priv);
+	if (!driver) {
+		printf("FAIL: ipvr_mmu_driver_init\n");
+		failures++;
+		return;
+	}
+	/* Half the sequences run with the directory live, so with clflushes */
+	if (n % 2)
+		ipvr_mmu_set_pd_context(ipvr_mmu_get_default_pd(driver), 0);
+	check(driver, 0, -1);
+
+	for (i = 0; i < OPS_PER_SEQUENCE; i++) {
+		if (num_objects < MAX_OBJECTS && (!num_objects || rand() % 3))
+			insert(driver, &dev_priv);
+		else
+			remove_object(driver, &dev_priv, rand() % num_objects);
+	}
+
+	bound = 0;
+	for (i = 0; i < num_objects; i++)
+		bound += objects[i].num_pages << PAGE_SHIFT;
+	if (dev_priv.mmu_bound != bound) {
+		printf("FAIL: %ld bytes accounted as bound, expected %ld\n",
+			dev_priv.mmu_bound, bound);
+		failures++;
+	}
+
+	while (num_objects)
+		remove_object(driver, &dev_priv, 0);
+	check(driver, 0, NUM_PDES - 1);
+	for (k = 0; k < TOTAL_PAGES; k++) {
+		if (model[k]) {
+			printf("FAIL: model not empty\n");
+			failures++;
+			break;
+		}
+	}
+
+	ipvr_mmu_driver_takedown(driver);
+	if (live_pages || live_allocs) {
+		printf("FAIL: %ld pages and %ld allocations leaked\n",
+			live_pages, live_allocs);
+		failures++;
+		live_pages = live_allocs = 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = 1;
+	int i;
+
+	if (argc > 1)
+		seed = strtoul(argv[1], NULL, 0);
+	srand(seed);
+	printf("seed %u\n", seed);
+
+	for (i = 0; i < NUM_SEQUENCES; i++)
+		run_sequence(i);
+
+	printf("%d sequences, %lu inserts (%lu with a bad pfn, %lu out of "
+		"memory), %lu removes, %d failures\n", NUM_SEQUENCES,
+		stats.inserts, stats.bad_pfn, stats.no_memory, stats.removes,
+		failures);
+	return failures ? 1 : 0;
+}
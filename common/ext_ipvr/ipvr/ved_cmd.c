@@ -202,11 +202,105 @@ out:
 	return ret;
 }
 
+static struct ved_cmd_queue *ved_cmd_slot_alloc(gfp_t gfp)
+{
+	struct ved_cmd_queue *ved_cmd;
+
+	ved_cmd = kzalloc(sizeof(*ved_cmd), gfp);
+	if (!ved_cmd)
+		return NULL;
+	ved_cmd->cmd = kmalloc(PAGE_SIZE, gfp);
+	if (!ved_cmd->cmd) {
+		kfree(ved_cmd);
+		return NULL;
+	}
+	return ved_cmd;
+}
+
+static void ved_cmd_slot_free(struct ved_cmd_queue *ved_cmd)
+{
+	kfree(ved_cmd->cmd);
+	kfree(ved_cmd);
+}
+
+/* must be called with ved_lock held */
+static struct ved_cmd_queue *
+__ved_cmd_slot_put(struct ved_private *ved_priv, struct ved_cmd_queue *ved_cmd)
+{
+	if (ved_priv->ved_cmd_slots_free >= VED_CMD_SLOTS_MAX)
+		return ved_cmd;
+	list_add(&ved_cmd->head, &ved_priv->ved_cmd_slots);
+	ved_priv->ved_cmd_slots_free++;
+	return NULL;
+}
+
+static void
+ved_cmd_slot_put(struct ved_private *ved_priv, struct ved_cmd_queue *ved_cmd)
+{
+	unsigned long irq_flags;
+
+	spin_lock_irqsave(&ved_priv->ved_lock, irq_flags);
+	ved_cmd = __ved_cmd_slot_put(ved_priv, ved_cmd);
+	spin_unlock_irqrestore(&ved_priv->ved_lock, irq_flags);
+	if (ved_cmd)
+		ved_cmd_slot_free(ved_cmd);
+}
+
+static struct ved_cmd_queue *ved_cmd_slot_get(struct ved_private *ved_priv)
+{
+	struct ved_cmd_queue *ved_cmd = NULL;
+	unsigned long irq_flags;
+
+	spin_lock_irqsave(&ved_priv->ved_lock, irq_flags);
+	if (!list_empty(&ved_priv->ved_cmd_slots)) {
+		ved_cmd = list_first_entry(&ved_priv->ved_cmd_slots,
+					   struct ved_cmd_queue, head);
+		list_del(&ved_cmd->head);
+		ved_priv->ved_cmd_slots_free--;
+	}
+	spin_unlock_irqrestore(&ved_priv->ved_lock, irq_flags);
+
+	if (!ved_cmd)
+		ved_cmd = ved_cmd_slot_alloc(GFP_KERNEL);
+	return ved_cmd;
+}
+
+int ved_cmd_slots_init(struct ved_private *ved_priv)
+{
+	struct ved_cmd_queue *ved_cmd;
+	int i;
+
+	INIT_LIST_HEAD(&ved_priv->ved_cmd_slots);
+	ved_priv->ved_cmd_slots_free = 0;
+	for (i = 0; i < VED_CMD_SLOTS_PREALLOC; i++) {
+		ved_cmd = ved_cmd_slot_alloc(GFP_KERNEL);
+		if (!ved_cmd) {
+			ved_cmd_slots_fini(ved_priv);
+			return -ENOMEM;
+		}
+		list_add(&ved_cmd->head, &ved_priv->ved_cmd_slots);
+		ved_priv->ved_cmd_slots_free++;
+	}
+	return 0;
+}
+
+void ved_cmd_slots_fini(struct ved_private *ved_priv)
+{
+	struct ved_cmd_queue *ved_cmd, *next;
+
+	list_for_each_entry_safe(ved_cmd, next, &ved_priv->ved_cmd_slots, head) {
+		list_del(&ved_cmd->head);
+		ved_cmd_slot_free(ved_cmd);
+	}
+	ved_priv->ved_cmd_slots_free = 0;
+}
+
 int ved_cmd_dequeue_send(struct ved_private *ved_priv)
 {
 	struct ved_cmd_queue *ved_cmd = NULL;
 	int ret = 0;
 	unsigned long irq_flags;
+	u32 depth;
 
 	spin_lock_irqsave(&ved_priv->ved_lock, irq_flags);
 	if (list_empty(&ved_priv->ved_queue)) {
@@ -219,9 +313,12 @@ int ved_cmd_dequeue_send(struct ved_private *ved_priv)
 	ved_cmd = list_first_entry(&ved_priv->ved_queue,
 				     struct ved_cmd_queue, head);
 	list_del(&ved_cmd->head);
+	depth = --ved_priv->ved_queue_depth;
 	spin_unlock_irqrestore(&ved_priv->ved_lock, irq_flags);
 
 	IPVR_DEBUG_VED("VED: cmd queue seq is %08x.\n", ved_cmd->cmd_seq);
+	trace_ved_cmd_dequeue(ved_cmd->ipvr_ctx->ctx_id, ved_cmd->cmd_seq,
+		depth, ktime_to_us(ktime_sub(ktime_get(), ved_cmd->queue_time)));
 
 	ipvr_set_tile(ved_priv->dev_priv, ved_cmd->tiling_scheme,
 				   ved_cmd->tiling_stride);
@@ -233,8 +330,7 @@ int ved_cmd_dequeue_send(struct ved_private *ved_priv)
 		ret = -EFAULT;
 	}
 
-	kfree(ved_cmd->cmd);
-	kfree(ved_cmd);
+	ved_cmd_slot_put(ved_priv, ved_cmd);
 
 	return ret;
 }
@@ -244,6 +340,7 @@ void ved_flush_cmd_queue(struct ved_private *ved_priv)
 	struct ved_cmd_queue *ved_cmd;
 	struct list_head *list, *next;
 	unsigned long irq_flags;
+	LIST_HEAD(excess);
 	spin_lock_irqsave(&ved_priv->ved_lock, irq_flags);
 	/* Flush the VED cmd queue and signal all fences in the queue */
 	list_for_each_safe(list, next, &ved_priv->ved_queue) {
@@ -254,23 +351,30 @@ void ved_flush_cmd_queue(struct ved_private *ved_priv)
 		ved_priv->ved_cur_seq = ved_cmd->cmd_seq;
 
 		ipvr_fence_process(ved_priv->dev_priv, ved_cmd->cmd_seq, IPVR_CMD_SKIP);
-		kfree(ved_cmd->cmd);
-		kfree(ved_cmd);
+		ved_cmd = __ved_cmd_slot_put(ved_priv, ved_cmd);
+		if (ved_cmd)
+			list_add(&ved_cmd->head, &excess);
 	}
+	ved_priv->ved_queue_depth = 0;
 	ved_priv->ved_busy = false;
 	spin_unlock_irqrestore(&ved_priv->ved_lock, irq_flags);
+
+	list_for_each_safe(list, next, &excess) {
+		list_del(list);
+		ved_cmd_slot_free(list_entry(list, struct ved_cmd_queue, head));
+	}
 }
 
 static int
 ved_map_command(struct ved_private *ved_priv,
 				struct drm_ipvr_gem_object *cmd_buffer,
-				u32 cmd_size, void **ved_cmd,
-				u16 sequence, s32 copy_cmd,
+				u32 cmd_size, void *cmd_copy,
+				u16 sequence,
 				struct ipvr_context *ipvr_ctx)
 {
 	int ret = 0;
 	u32 cmd_size_remain;
-	void *cmd, *cmd_copy, *cmd_start;
+	void *cmd, *cmd_start;
 	union msg_header *header;
 	struct ipvr_fence *fence = NULL;
 
@@ -375,17 +479,10 @@ ved_map_command(struct ved_private *ved_priv,
 	ipvr_fence_buffer_objects(&ved_priv->dev_priv->validate_ctx.validate_list,
 				fence);
 
-	if (copy_cmd) {
+	if (cmd_copy) {
+		/* queued behind a busy VED, send it later from the copy */
 		IPVR_DEBUG_VED("VED: copying command.\n");
-
-		cmd_copy = kzalloc(cmd_size, GFP_KERNEL);
-		if (cmd_copy == NULL) {
-			ret = -ENOMEM;
-			IPVR_ERROR("VED: fail to callc, ret=:%d\n", ret);
-			goto out;
-		}
 		memcpy(cmd_copy, cmd_start, cmd_size);
-		*ved_cmd = cmd_copy;
 	} else {
 		IPVR_DEBUG_VED("VED: did NOT copy command.\n");
 		ipvr_set_tile(ved_priv->dev_priv, ved_priv->default_tiling_scheme,
@@ -413,45 +510,46 @@ ved_submit_cmdbuf_copy(struct ved_private *ved_priv,
 	struct ved_cmd_queue *ved_cmd;
 	u16 sequence =  (ved_priv->dev_priv->last_seq << 4);
 	unsigned long irq_flags;
-	void *cmd = NULL;
 	int ret;
-	union msg_header *header;
+	u32 cmd_id;
 
 	/* queue the command to be sent when the h/w is ready */
 	IPVR_DEBUG_VED("VED: queueing sequence:%08x.\n",
 			  sequence);
-	ved_cmd = kzalloc(sizeof(struct ved_cmd_queue),
-			    GFP_KERNEL);
+	ved_cmd = ved_cmd_slot_get(ved_priv);
 	if (ved_cmd == NULL) {
 		IPVR_ERROR("MSVDXQUE: Out of memory...\n");
 		return -ENOMEM;
 	}
 
 	ret = ved_map_command(ved_priv, cmd_buffer, cmd_size,
-				&cmd, sequence, 1, ipvr_ctx);
+				ved_cmd->cmd, sequence, ipvr_ctx);
 	if (ret) {
 		IPVR_ERROR("VED: Failed to extract cmd\n");
-		kfree(ved_cmd);
-		/* -EINVAL or -EFAULT or -ENOMEM */
+		ved_cmd_slot_put(ved_priv, ved_cmd);
+		/* -EINVAL or -EFAULT */
 		return ret;
 	}
-	header = (union msg_header *)cmd;
-	ved_cmd->cmd = cmd;
+	cmd_id = ((union msg_header *)ved_cmd->cmd)->bits.msg_type;
 	ved_cmd->cmd_size = cmd_size;
 	ved_cmd->cmd_seq = sequence;
 
 	ved_cmd->tiling_scheme = ved_priv->default_tiling_scheme;
 	ved_cmd->tiling_stride = ved_priv->default_tiling_stride;
 	ved_cmd->ipvr_ctx = ipvr_ctx;
+	ved_cmd->queue_time = ktime_get();
 	spin_lock_irqsave(&ved_priv->ved_lock, irq_flags);
 	list_add_tail(&ved_cmd->head, &ved_priv->ved_queue);
+	ved_priv->ved_queue_depth++;
+	trace_ved_cmd_queue(ipvr_ctx->ctx_id, sequence,
+		ved_priv->ved_queue_depth);
 	spin_unlock_irqrestore(&ved_priv->ved_lock, irq_flags);
 	if (!ved_priv->ved_busy) {
 		ved_priv->ved_busy = true;
 		IPVR_DEBUG_VED("VED: Need immediate dequeue.\n");
 		ved_cmd_dequeue_send(ved_priv);
 	}
-	trace_ved_cmd_copy(ipvr_ctx->ctx_id, header->bits.msg_type, sequence);
+	trace_ved_cmd_copy(ipvr_ctx->ctx_id, cmd_id, sequence);
 
 	return ret;
 }
@@ -535,7 +633,7 @@ ved_submit_video_cmdbuf(struct ved_private *ved_priv,
 	IPVR_DEBUG_VED("VED: commit command to HW,seq=0x%08x\n",
 			  sequence);
 	ret = ved_map_command(ved_priv, cmd_buffer, cmd_size,
-				NULL, sequence, 0, ipvr_ctx);
+				NULL, sequence, ipvr_ctx);
 	if (ret) {
 		IPVR_ERROR("VED: Failed to extract cmd.\n");
 		goto out_power_put;
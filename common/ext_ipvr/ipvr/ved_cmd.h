@@ -36,6 +36,15 @@
 #include "ved_reg.h"
 #include "ved_pm.h"
 
+/*
+ * Queued commands live in recycled slots, each with a page sized command
+ * buffer (command buffers never cross a page), so queueing a command
+ * behind a busy VED costs a memcpy and no allocation. A few slots are
+ * preallocated and at most VED_CMD_SLOTS_MAX idle ones are kept.
+ */
+#define VED_CMD_SLOTS_PREALLOC	4
+#define VED_CMD_SLOTS_MAX	16
+
 struct ved_cmd_queue {
 	struct list_head head;
 	void *cmd;
@@ -45,8 +54,13 @@ struct ved_cmd_queue {
 	u8 tiling_scheme;
 	u8 tiling_stride;
 	struct ipvr_context *ipvr_ctx;
+	/* when it was queued, for the dequeue latency tracepoint */
+	ktime_t queue_time;
 };
 
+int ved_cmd_slots_init(struct ved_private *ved_priv);
+void ved_cmd_slots_fini(struct ved_private *ved_priv);
+
 int ved_irq_handler(struct ved_private *ved_priv);
 
 int ved_mtx_send(struct ved_private *ved_priv, const void *msg);
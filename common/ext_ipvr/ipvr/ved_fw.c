@@ -1137,11 +1137,16 @@ int __must_check ved_core_init(struct drm_ipvr_private *dev_priv)
 		INIT_LIST_HEAD(&ved_priv->ved_queue);
 		mutex_init(&ved_priv->ved_mutex);
 		spin_lock_init(&ved_priv->ved_lock);
+		ret = ved_cmd_slots_init(ved_priv);
+		if (ret) {
+			IPVR_ERROR("VED: alloc command slots failed: %d.\n", ret);
+			goto err_free_ved_priv;
+		}
 		ved_priv->mmu_recover_page = alloc_page(GFP_DMA32);
 		if (!ved_priv->mmu_recover_page) {
 			ret = -ENOMEM;
 			IPVR_ERROR("VED: alloc mmu_recover_page failed: %d.\n", ret);
-			goto err_free_ved_priv;
+			goto err_free_cmd_slots;
 		}
 		IPVR_DEBUG_INIT("VED: successfully initialized ved_private.\n");
 		dev_priv->ved_private= ved_priv;
@@ -1166,6 +1171,8 @@ err_free_ccb:
 	ved_free_ccb(ved_priv);
 err_free_mmu_recover_page:
 	__free_page(ved_priv->mmu_recover_page);
+err_free_cmd_slots:
+	ved_cmd_slots_fini(ved_priv);
 err_free_ved_priv:
 	kfree(ved_priv);
 	dev_priv->ved_private = NULL;
@@ -1197,6 +1204,8 @@ int ved_core_deinit(struct drm_ipvr_private *dev_priv)
 	if (ved_priv->mmu_recover_page)
 		__free_page(ved_priv->mmu_recover_page);
 
+	ved_cmd_slots_fini(ved_priv);
+
 	kfree(ved_priv);
 	dev_priv->ved_private = NULL;
 
@@ -60,8 +60,8 @@ ipvr__execbuffer_reloc(ipvr_execbuffer_p execbuf, drm_ipvr_bo *target_bo,
             __func__, target_bo->handle, target_bo->offset, offset, ret, strerror(ret));
         return ret;
     }
-    drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s write reloc for bo %u (offset 0x%lx) at offset 0x%lx: %d (%s)\n",
-        __func__, target_bo->handle, target_bo->offset, offset, ret, strerror(ret));
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s write reloc for bo %u (offset 0x%lx) at offset 0x%lx\n",
+        __func__, target_bo->handle, target_bo->offset, offset);
     *(uint32_t*)(execbuf->vaddr + offset) = target_bo->offset + delta;
     return 0;
 }
@@ -86,11 +86,16 @@ ipvr__execbuffer_full(ipvr_execbuffer_p execbuf)
 
 int ipvr_execbuffer_run(ipvr_execbuffer_p execbuf)
 {
+    int ret;
+
     if (!execbuf->valid)
         return -EINVAL;
-    if(execbuf->run)
-        return execbuf->run(execbuf);
-    else {
+    if(execbuf->run) {
+        PSB_TRACE_EVENT(PSB_TRACE_ENTER, 0, 0, execbuf->cur_offset, 0, 0, 0);
+        ret = execbuf->run(execbuf);
+        PSB_TRACE_EVENT(PSB_TRACE_EXIT, 0, 0, ret, 0, 0, 0);
+        return ret;
+    } else {
         drv_debug_msg(VIDEO_DEBUG_WARNING, "%s: missing execbuffer run callback!\n", __func__);
         return 0;
     }
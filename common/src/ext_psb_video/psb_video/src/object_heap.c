@@ -38,65 +38,167 @@
 #define ALLOCATED    -2
 #define SUSPENDED    -3
 
+#define FREE_HEAD(index, tag)   ((unsigned int)(index) | ((unsigned long long)(tag) << 32))
+#define FREE_HEAD_INDEX(head)   ((int)(unsigned int)(head))
+#define FREE_HEAD_TAG(head)     ((unsigned int)((head) >> 32))
+
+static inline int object_heap_slab_size(int slab)
+{
+    return slab ? OBJECT_HEAP_FIRST_SLAB << (slab - 1) : OBJECT_HEAP_FIRST_SLAB;
+}
+
+/*
+ * Index to object, the index must be below heap_size
+ */
+static inline object_base_p object_heap_object(object_heap_p heap, int index)
+{
+    int slab = 0;
+
+    if (index >= OBJECT_HEAP_FIRST_SLAB) {
+        slab = 32 - __builtin_clz(index / OBJECT_HEAP_FIRST_SLAB);
+        index -= object_heap_slab_size(slab);
+    }
+    return (object_base_p)(__atomic_load_n(&heap->slabs[slab], __ATOMIC_ACQUIRE) +
+                           index * heap->object_stride);
+}
+
+/*
+ * Pushes the objects first..last, already linked through next_free, on the
+ * free list
+ */
+static void object_heap_push_free(object_heap_p heap, int first, object_base_p last)
+{
+    unsigned long long head;
+
+    if (!heap->thread_safe) {
+        last->next_free = heap->next_free;
+        heap->next_free = first;
+        return;
+    }
+
+    head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(&last->next_free, FREE_HEAD_INDEX(head), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&heap->free_head, &head,
+                                          FREE_HEAD(first, FREE_HEAD_TAG(head) + 1),
+                                          FALSE, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
 /*
- * Expands the heap
+ * Expands the heap by one slab
  * Return 0 on success, -1 on error
  */
 static int object_heap_expand(object_heap_p heap)
 {
     int i;
-    int malloc_error = FALSE;
-    object_base_p *new_heap_index;
-    int next_free;
-    int new_heap_size = heap->heap_size + heap->heap_increment;
+    int slab = heap->num_slabs;
+    int slab_size;
+    unsigned char *mem;
+    object_base_p obj = NULL;
 
-    new_heap_index = (object_base_p *) realloc(heap->heap_index, new_heap_size * sizeof(object_base_p));
-    if (NULL == new_heap_index) {
+    if (slab == OBJECT_HEAP_MAX_SLABS) {
+        /* Out of IDs: all OBJECT_HEAP_INDEX_MASK + 1 objects are in use */
+        return -1;
+    }
+    slab_size = object_heap_slab_size(slab);
+    mem = (unsigned char *) calloc(slab_size, heap->object_stride);
+    if (NULL == mem) {
         return -1; /* Out of memory */
     }
-    heap->heap_index = new_heap_index;
-    next_free = heap->next_free;
-    for (i = new_heap_size; i-- > heap->heap_size;) {
-        object_base_p obj = (object_base_p) calloc(1, heap->object_size);
-        heap->heap_index[i] = obj;
-        if (NULL == obj) {
-            malloc_error = TRUE;
-            continue; /* Clean up after the loop is completely done */
-        }
-        obj->id = i + heap->id_offset;
-        obj->next_free = next_free;
-        next_free = i;
+    for (i = 0; i < slab_size; i++) {
+        obj = (object_base_p)(mem + i * heap->object_stride);
+        obj->id = heap->heap_size + i + heap->id_offset;
+        obj->next_free = heap->heap_size + i + 1;
     }
 
-    if (malloc_error) {
-        /* Clean up the mess */
-        for (i = new_heap_size; i-- > heap->heap_size;) {
-            if (heap->heap_index[i]) {
-                free(heap->heap_index[i]);
-            }
-        }
-        /* heap->heap_index is left as is */
-        return -1; /* Out of memory */
-    }
-    heap->next_free = next_free;
-    heap->heap_size = new_heap_size;
+    /* Lookups may run concurrently: publish the slab before its IDs */
+    __atomic_store_n(&heap->slabs[slab], mem, __ATOMIC_RELEASE);
+    __atomic_store_n(&heap->heap_size, heap->heap_size + slab_size, __ATOMIC_RELEASE);
+    heap->num_slabs = slab + 1;
+
+    object_heap_push_free(heap, heap->heap_size - slab_size, obj);
     return 0; /* Success */
 }
 
-/*
- * Return 0 on success, -1 on error
- */
-int object_heap_init(object_heap_p heap, int object_size, int id_offset)
+static int object_heap_setup(object_heap_p heap, int object_size, int id_offset, int thread_safe)
 {
+    memset(heap, 0, sizeof(*heap));
     heap->object_size = object_size;
+    /*
+     * Keep every object as aligned as malloc() would, but not on a power of
+     * two stride: the object headers would then all compete for a few
+     * cache sets.
+     */
+    heap->object_stride = (object_size + 15) & ~15;
+    if ((heap->object_stride & (heap->object_stride - 1)) == 0) {
+        heap->object_stride += 16;
+    }
     heap->id_offset = id_offset & OBJECT_HEAP_OFFSET_MASK;
-    heap->heap_size = 0;
-    heap->heap_increment = 16;
-    heap->heap_index = NULL;
     heap->next_free = LAST_FREE;
+    heap->thread_safe = thread_safe;
+    heap->free_head = FREE_HEAD(LAST_FREE, 0);
+    if (thread_safe) {
+        pthread_mutex_init(&heap->expand_mutex, NULL);
+    }
     return object_heap_expand(heap);
 }
 
+/*
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init(object_heap_p heap, int object_size, int id_offset)
+{
+    return object_heap_setup(heap, object_size, id_offset, FALSE);
+}
+
+/*
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init_threadsafe(object_heap_p heap, int object_size, int id_offset)
+{
+    return object_heap_setup(heap, object_size, id_offset, TRUE);
+}
+
+static int object_heap_allocate_threadsafe(object_heap_p heap)
+{
+    unsigned long long head;
+    object_base_p obj;
+    int index;
+
+    head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        index = FREE_HEAD_INDEX(head);
+        if (LAST_FREE == index) {
+            int ret = 0;
+
+            pthread_mutex_lock(&heap->expand_mutex);
+            /* Another thread may have expanded the heap meanwhile */
+            if (LAST_FREE == FREE_HEAD_INDEX(__atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE))) {
+                ret = object_heap_expand(heap);
+            }
+            pthread_mutex_unlock(&heap->expand_mutex);
+            if (-1 == ret) {
+                return -1; /* Out of memory */
+            }
+            head = __atomic_load_n(&heap->free_head, __ATOMIC_ACQUIRE);
+            continue;
+        }
+
+        /*
+         * obj->next_free may be stale if another thread pops obj first,
+         * the tag then makes the swap fail.
+         */
+        obj = object_heap_object(heap, index);
+        if (__atomic_compare_exchange_n(&heap->free_head, &head,
+                                        FREE_HEAD(__atomic_load_n(&obj->next_free, __ATOMIC_RELAXED),
+                                                  FREE_HEAD_TAG(head) + 1),
+                                        FALSE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&obj->next_free, ALLOCATED, __ATOMIC_RELAXED);
+            return __atomic_load_n(&obj->id, __ATOMIC_RELAXED);
+        }
+    }
+}
+
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
@@ -104,6 +206,11 @@ int object_heap_init(object_heap_p heap, int object_size, int id_offset)
 int object_heap_allocate(object_heap_p heap)
 {
     object_base_p obj;
+
+    if (heap->thread_safe) {
+        return object_heap_allocate_threadsafe(heap);
+    }
+
     if (LAST_FREE == heap->next_free) {
         if (-1 == object_heap_expand(heap)) {
             return -1; /* Out of memory */
@@ -111,7 +218,7 @@ int object_heap_allocate(object_heap_p heap)
     }
     ASSERT(heap->next_free >= 0);
 
-    obj = heap->heap_index[heap->next_free];
+    obj = object_heap_object(heap, heap->next_free);
     heap->next_free = obj->next_free;
     obj->next_free = ALLOCATED;
     return obj->id;
@@ -124,12 +231,21 @@ int object_heap_allocate(object_heap_p heap)
 object_base_p object_heap_lookup(object_heap_p heap, int id)
 {
     object_base_p obj;
-    if ((id < heap->id_offset) || (id > (heap->heap_size + heap->id_offset))) {
+    int index = id & OBJECT_HEAP_INDEX_MASK;
+    int state;
+
+    if (((id & OBJECT_HEAP_OFFSET_MASK) != heap->id_offset) ||
+        (index >= __atomic_load_n(&heap->heap_size, __ATOMIC_ACQUIRE))) {
         return NULL;
     }
-    id &= OBJECT_HEAP_ID_MASK;
-    obj = heap->heap_index[id];
+    obj = object_heap_object(heap, index);
 
+    /* A different generation means the ID is stale */
+    state = __atomic_load_n(&obj->next_free, __ATOMIC_RELAXED);
+    if ((__atomic_load_n(&obj->id, __ATOMIC_RELAXED) != id) ||
+        ((state != ALLOCATED) && (state != SUSPENDED))) {
+        return NULL;
+    }
     return obj;
 }
 
@@ -152,7 +268,7 @@ object_base_p object_heap_next(object_heap_p heap, object_heap_iterator *iter)
     object_base_p obj;
     int i = *iter + 1;
     while (i < heap->heap_size) {
-        obj = heap->heap_index[i];
+        obj = object_heap_object(heap, i);
         if ((obj->next_free == ALLOCATED) || (obj->next_free == SUSPENDED)) {
             *iter = i;
             return obj;
@@ -170,13 +286,18 @@ object_base_p object_heap_next(object_heap_p heap, object_heap_iterator *iter)
  */
 void object_heap_free(object_heap_p heap, object_base_p obj)
 {
+    int id;
+
     /* Don't complain about NULL pointers */
     if (NULL != obj) {
         /* Check if the object has in fact been allocated */
         ASSERT((obj->next_free == ALLOCATED) || (obj->next_free == SUSPENDED));
 
-        obj->next_free = heap->next_free;
-        heap->next_free = obj->id & OBJECT_HEAP_ID_MASK;
+        /* Next user of this slot gets a new ID */
+        id = obj->id;
+        id = (id & ~OBJECT_HEAP_GEN_MASK) | ((id + (1 << OBJECT_HEAP_GEN_SHIFT)) & OBJECT_HEAP_GEN_MASK);
+        __atomic_store_n(&obj->id, id, __ATOMIC_RELAXED);
+        object_heap_push_free(heap, id & OBJECT_HEAP_INDEX_MASK, obj);
     }
 }
 
@@ -189,16 +310,21 @@ void object_heap_destroy(object_heap_p heap)
     int i;
     for (i = 0; i < heap->heap_size; i++) {
         /* Check if object is not still allocated */
-        obj = heap->heap_index[i];
+        obj = object_heap_object(heap, i);
         ASSERT(obj->next_free != ALLOCATED);
         ASSERT(obj->next_free != SUSPENDED);
-        /* Free object itself */
-        free(obj);
     }
-    free(heap->heap_index);
+    for (i = 0; i < heap->num_slabs; i++) {
+        free(heap->slabs[i]);
+        heap->slabs[i] = NULL;
+    }
+    if (heap->thread_safe) {
+        pthread_mutex_destroy(&heap->expand_mutex);
+    }
+    heap->num_slabs = 0;
     heap->heap_size = 0;
-    heap->heap_index = NULL;
     heap->next_free = LAST_FREE;
+    heap->free_head = FREE_HEAD(LAST_FREE, 0);
 }
 
 /*
@@ -29,8 +29,28 @@
 #ifndef _OBJECT_HEAP_H_
 #define _OBJECT_HEAP_H_
 
+#include <pthread.h>
+
+/*
+ * Object IDs are id_offset | generation | index. The generation is bumped
+ * every time an object is freed, so a stale ID no longer looks up the
+ * object once its slot has been reused. The 8 generation bits come out of
+ * the index, so a heap holds at most 65536 objects at once, where the
+ * 24 bit index used to allow 16M; object_heap_allocate() fails beyond.
+ */
 #define OBJECT_HEAP_OFFSET_MASK         0x7F000000
 #define OBJECT_HEAP_ID_MASK                     0x00FFFFFF
+#define OBJECT_HEAP_GEN_MASK            0x00FF0000
+#define OBJECT_HEAP_GEN_SHIFT           16
+#define OBJECT_HEAP_INDEX_MASK          0x0000FFFF
+
+/*
+ * Objects are carved from slabs of contiguous memory, each slab as large
+ * as all previous ones together: 16, 16, 32, ... 32768 objects, which is
+ * the 65536 the index can address.
+ */
+#define OBJECT_HEAP_FIRST_SLAB          16
+#define OBJECT_HEAP_MAX_SLABS           13
 
 typedef struct object_base_s *object_base_p;
 typedef struct object_heap_s *object_heap_p;
@@ -42,11 +62,16 @@ struct object_base_s {
 
 struct object_heap_s {
     int object_size;
+    int object_stride;
     int id_offset;
-    object_base_p *heap_index;
     int next_free;
     int heap_size;
-    int heap_increment;
+    int num_slabs;
+    unsigned char *slabs[OBJECT_HEAP_MAX_SLABS];
+    /* only used by heaps created with object_heap_init_threadsafe() */
+    int thread_safe;
+    unsigned long long free_head;       /* index of first free object | ABA tag << 32 */
+    pthread_mutex_t expand_mutex;
 };
 
 typedef int object_heap_iterator;
@@ -56,6 +81,14 @@ typedef int object_heap_iterator;
  */
 int object_heap_init(object_heap_p heap, int object_size, int id_offset);
 
+/*
+ * Same as object_heap_init(), but allocate, lookup and free may be called
+ * from several threads at once: the free list is lock free, only growing
+ * the heap takes a lock.
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init_threadsafe(object_heap_p heap, int object_size, int id_offset);
+
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
@@ -64,7 +97,8 @@ int object_heap_allocate(object_heap_p heap);
 
 /*
  * Lookup an allocated object by object ID
- * Returns a pointer to the object on success, returns NULL on error
+ * Returns a pointer to the object on success, returns NULL on error,
+ * including for IDs of objects that have since been freed
  */
 object_base_p object_heap_lookup(object_heap_p heap, int id);
 
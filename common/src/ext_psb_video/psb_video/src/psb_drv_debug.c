@@ -50,6 +50,29 @@
 #include "hwdefs/dxva_msg.h"
 #include "hwdefs/msvdx_cmds_io2.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+
+psb_trace_file *psb_video_trace_ring;
+int psb_video_call_trace;
+
+/* this thread's ring, or PSB_TRACE_NO_RING once they have run out */
+static __thread psb_trace_ring *psb__trace_thread_ring;
+#define PSB_TRACE_NO_RING       ((psb_trace_ring *)1)
+/* gives a thread's ring back when it exits */
+static pthread_key_t psb__trace_ring_key;
+static int psb__trace_ring_key_valid;
+#define PSB_TRACE_NO_NAME       0xffff
+
+static void psb__trace_ring_open(const char *path);
+static void psb__trace_ring_release(void *data);
+static void psb__verify_open(void);
+static void psb__verify_close(void);
+
 void psb__open_log(void)
 {
     char log_fn[1024] = {0};
@@ -169,6 +192,21 @@ void psb__open_log(void)
     } else {
         psb_dump_yuvbuf_fp = NULL;
     }
+
+    /* decode checksums, needs the YUV dump file opened above */
+    if (!psb_video_verify)
+        psb__verify_open();
+
+    /* binary trace ring, one file per process */
+    if (psb_video_trace_ring == NULL &&
+        psb_parse_config("PSB_VIDEO_TRACE_RING", &log_fn[0]) == 0) {
+        log_fn[1024 - 12] = '\0';
+        snprintf(log_fn + strlen(log_fn), 11, ".%d", getpid());
+        psb__trace_ring_open(log_fn);
+    }
+
+    psb_video_call_trace = (psb_video_trace_ring != NULL) ||
+        (psb_video_debug_level & VIDEO_DEBUG_ENTRY);
 }
 
 void psb__close_log(void)
@@ -196,11 +234,21 @@ void psb__close_log(void)
         psb_dump_vabuf_verbose_fp = NULL;
     }
 
+    /* may still dump frames to psb_dump_yuvbuf_fp */
+    psb__verify_close();
+
     if(psb_dump_yuvbuf_fp != NULL) {
         fclose(psb_dump_yuvbuf_fp);
         psb_dump_yuvbuf_fp = NULL;
     }
 
+    /*
+     * Other threads may still be tracing, so the ring stays mapped for the
+     * life of the process; just push what is there out to the file.
+     */
+    if (psb_video_trace_ring != NULL)
+        msync(psb_video_trace_ring, sizeof(*psb_video_trace_ring), MS_ASYNC);
+
     return;
 }
 
@@ -275,93 +323,561 @@ void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
     }
 }
 
-void psb__dump_I420_buffers(
-    psb_surface_p psb_surface,
-    short srcx,
-    short srcy,
-    unsigned short srcw,
-    unsigned short srch)
+static void psb__trace_ring_open(const char *path)
 {
-    void *mapped_buffer;
-    void *mapped_buffer1, *mapped_buffer2;
+    psb_trace_file *file;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring %s open failed, reason %s\n",
+                      path, strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, sizeof(*file)) != 0) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring %s resize failed, reason %s\n",
+                      path, strerror(errno));
+        close(fd);
+        return;
+    }
+    file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "Trace ring %s map failed, reason %s\n",
+                      path, strerror(errno));
+        return;
+    }
 
-    if (psb_dump_yuvbuf_fp) {
-        drm_ipvr_gem_bo_map(psb_surface->buf, 1);
-        mapped_buffer = psb_surface->buf->virt;
-        if(mapped_buffer == NULL)
-            return;
+    if (!psb__trace_ring_key_valid)
+        psb__trace_ring_key_valid =
+            pthread_key_create(&psb__trace_ring_key, psb__trace_ring_release) == 0;
 
-        int j,k;
-        mapped_buffer1 = mapped_buffer + psb_surface->stride * srcy;
-        mapped_buffer2= mapped_buffer + psb_surface->stride * (srch + srcy / 2);
-        mapped_buffer=mapped_buffer2;
+    /* a new file reads as zero: no rings, no names */
+    file->version = PSB_TRACE_VERSION;
+    file->pid = getpid();
+    memcpy(file->magic, PSB_TRACE_MAGIC, sizeof(file->magic));
+    __atomic_store_n(&psb_video_trace_ring, file, __ATOMIC_RELEASE);
+    drv_debug_msg(VIDEO_DEBUG_GENERAL, "Trace ring %s mapped\n", path);
+}
 
-        for(j = 0; j < srch; ++j)
-        {
-            fwrite(mapped_buffer1,  srcw, 1, psb_dump_yuvbuf_fp);
-            mapped_buffer1 += psb_surface->stride;
-        }
+/* Thread exit: the ring can be taken over by a later thread */
+static void psb__trace_ring_release(void *data)
+{
+    psb_trace_ring *ring = data;
 
-        for(j = 0 ; j < srch /2; ++j)
-        {
-            for(k = 0; k < srcw; ++k)
-            {
-                if((k%2) == 0)fwrite(mapped_buffer2, 1, 1, psb_dump_yuvbuf_fp);
+    psb__trace_thread_ring = PSB_TRACE_NO_RING;
+    __atomic_store_n(&ring->state, PSB_TRACE_RING_FREE, __ATOMIC_RELEASE);
+}
 
-                mapped_buffer2++;
-            }
-            mapped_buffer2 += psb_surface->stride-srcw;
+/*
+ * Hand the calling thread a ring of its own, claimed on first use. Rings
+ * of exited threads are taken over before new ones are used up.
+ */
+static psb_trace_ring *psb__trace_ring_get(psb_trace_file *file)
+{
+    psb_trace_ring *ring = psb__trace_thread_ring;
+    uint32_t n, used, state;
+
+    if (ring)
+        return ring == PSB_TRACE_NO_RING ? NULL : ring;
+
+    used = __atomic_load_n(&file->rings_used, __ATOMIC_RELAXED);
+    if (used > PSB_TRACE_RINGS)
+        used = PSB_TRACE_RINGS;
+    for (n = 0; n < used; n++) {
+        ring = &file->rings[n];
+        state = PSB_TRACE_RING_FREE;
+        if (__atomic_load_n(&ring->state, __ATOMIC_RELAXED) == PSB_TRACE_RING_FREE &&
+            __atomic_compare_exchange_n(&ring->state, &state, PSB_TRACE_RING_OWNED, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_fetch_add(&file->rings_reused, 1, __ATOMIC_RELAXED);
+            goto claimed;
         }
+    }
 
-        mapped_buffer2=mapped_buffer;
-        for(j = 0 ; j < srch /2; ++j)
-        {
-            for(k = 0; k < srcw; ++k)
-            {
-                if((k%2) == 1)fwrite(mapped_buffer2, 1, 1, psb_dump_yuvbuf_fp);
-                mapped_buffer2++;
+    n = __atomic_fetch_add(&file->rings_used, 1, __ATOMIC_RELAXED);
+    if (n >= PSB_TRACE_RINGS) {
+        __atomic_fetch_add(&file->rings_dropped, 1, __ATOMIC_RELAXED);
+        psb__trace_thread_ring = PSB_TRACE_NO_RING;
+        return NULL;
+    }
+    ring = &file->rings[n];
+    __atomic_store_n(&ring->state, PSB_TRACE_RING_OWNED, __ATOMIC_RELAXED);
+
+claimed:
+    /* records before "start" are the previous owner's */
+    __atomic_store_n(&ring->start, ring->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tid, (uint32_t)syscall(SYS_gettid), __ATOMIC_RELEASE);
+    if (psb__trace_ring_key_valid)
+        pthread_setspecific(psb__trace_ring_key, ring);
+    psb__trace_thread_ring = ring;
+    return ring;
+}
+
+/*
+ * Find or add the name table entry for a trace point. Names are keyed by
+ * the address of the string, which is constant per trace point, so the
+ * caller caches the result and this runs once per trace point.
+ */
+static int psb__trace_ring_name(psb_trace_file *file, const char *name)
+{
+    psb_trace_name *entry;
+    uint64_t key = (uintptr_t)name;
+    uint64_t cur;
+    uint32_t i, n, claimed;
+
+    n = (uint32_t)(key >> 4) % PSB_TRACE_NAMES;
+    for (i = 0; i < PSB_TRACE_NAMES; i++, n = (n + 1) % PSB_TRACE_NAMES) {
+        entry = &file->names[n];
+        cur = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+        if (cur == 0) {
+            claimed = 0;
+            if (__atomic_compare_exchange_n(&entry->claimed, &claimed, 1, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                /* the name is complete before the key makes it visible */
+                strncpy(entry->name, name, PSB_TRACE_NAME_LEN - 1);
+                __atomic_store_n(&entry->key, key, __ATOMIC_RELEASE);
+                return n;
             }
-            mapped_buffer2 += psb_surface->stride-srcw;
+            /* another thread is filling it in, it may be our name */
+            while ((cur = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE)) == 0)
+                sched_yield();
         }
+        if (cur == key)
+            return n;
+    }
+
+    __atomic_fetch_add(&file->names_dropped, 1, __ATOMIC_RELAXED);
+    return PSB_TRACE_NO_NAME;
+}
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    psb_trace_file *file = __atomic_load_n(&psb_video_trace_ring, __ATOMIC_ACQUIRE);
+    psb_trace_ring *ring;
+    psb_trace_record *rec;
+    struct timespec ts;
+    uint64_t head;
+
+    if (file == NULL)
+        return;
+    ring = psb__trace_ring_get(file);
+    if (ring == NULL)
+        return;
+    if (*event < 0)
+        *event = psb__trace_ring_name(file, name);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    /* only this thread writes the ring; readers check seq around the copy */
+    head = ring->head;
+    rec = &ring->records[head & (PSB_TRACE_RING_RECORDS - 1)];
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    rec->event = *event;
+    rec->type = type;
+    rec->timestamp = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    rec->context_id = context_id;
+    rec->surface_id = surface_id;
+    rec->args[0] = arg0;
+    rec->args[1] = arg1;
+    rec->args[2] = arg2;
+    rec->args[3] = arg3;
+    __atomic_store_n(&rec->seq, (uint32_t)(head + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void psb__trace_call(int type, int *event, const char *name,
+                     uint32_t context_id, uint32_t surface_id)
+{
+    psb__trace_ring_record(type, event, name, context_id, surface_id, 0, 0, 0, 0);
+
+    if (psb_video_debug_level & VIDEO_DEBUG_ENTRY)
+        drv_debug_msg(VIDEO_DEBUG_ENTRY, "%s %s.\n", name,
+                      type == PSB_TRACE_ENTER ? "enter" : "exit");
+}
+
+/*
+ * Decode verification: a CRC32C of each plane of every decoded frame,
+ * compared against a golden list, see README.debug. Frames are numbered in
+ * vaEndPicture order. The surfaces are uncached, so rows are copied into a
+ * cached buffer with wide loads and summed or dumped from there.
+ */
+#define PSB_VERIFY_JOBS         8
+#define PSB_VERIFY_MAX_WIDTH    4096
+#define PSB_VERIFY_MAX_FRAMES   (1U << 24)      /* golden list entries, 9 bytes each */
+
+typedef struct psb_verify_job_s {
+    object_surface_p obj_surface;
+    unsigned int frame;
+    unsigned char *luma;
+    unsigned char *chroma;
+    int stride;
+    int width;
+    int height;
+    uint32_t crc[2];
+    int done;
+} psb_verify_job;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    FILE *log_fp;
+    uint32_t (*golden)[2];
+    unsigned char *golden_valid;
+    unsigned int golden_count;
+    unsigned int frames;        /* frames decoded so far */
+    unsigned int verified;
+    unsigned int mismatches;
+    unsigned int unchecked;     /* verified without a golden checksum */
+
+    /* PSB_VIDEO_VERIFY_THREAD: jobs head..tail-1 are queued, work is the next to sum */
+    int threaded;
+    int stop;
+    pthread_t thread;
+    psb_verify_job jobs[PSB_VERIFY_JOBS];
+    unsigned int head, work, tail;
+
+    unsigned char row[PSB_VERIFY_MAX_WIDTH];
+    unsigned char thread_row[PSB_VERIFY_MAX_WIDTH];
+} psb_verify = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+int psb_video_verify;
+
+static uint32_t psb__crc32c_table[256];
+
+static uint32_t psb__crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len--)
+        crc = psb__crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t psb__crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    uint64_t v64;
 
-        drm_ipvr_gem_bo_unmap(psb_surface->buf);
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&v64, p, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, v64);
     }
+    crc = (uint32_t)crc64;
+#endif
+    uint32_t v32;
+
+    for (; len >= 4; len -= 4, p += 4) {
+        memcpy(&v32, p, 4);
+        crc = __builtin_ia32_crc32si(crc, v32);
+    }
+    while (len--)
+        crc = __builtin_ia32_crc32qi(crc, *p++);
+    return crc;
 }
+#endif
 
-void psb__dump_NV12_buffers(
-    psb_surface_p psb_surface,
-    short srcx,
-    short srcy,
-    unsigned short srcw,
-    unsigned short srch)
+static uint32_t (*psb__crc32c)(uint32_t crc, const unsigned char *p, size_t len) = psb__crc32c_sw;
+
+static void psb__crc32c_init(void)
 {
-    void *mapped_buffer;
-    void *mapped_start;
+    uint32_t i, j, crc;
 
-    if (psb_dump_yuvbuf_fp) {
-        drm_ipvr_gem_bo_map(psb_surface->buf, 1);
-	 mapped_buffer = psb_surface->buf->virt;
-        if(mapped_buffer == NULL)
-            return;
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+        psb__crc32c_table[i] = crc;
+    }
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        psb__crc32c = psb__crc32c_sse42;
+#endif
+}
 
-        int i;
-        int row = srch;
+static uint32_t psb__verify_plane(unsigned char *row, const unsigned char *plane,
+                                  int stride, int width, int rows)
+{
+    uint32_t crc = 0xffffffff;
+    int i;
 
-	mapped_start = mapped_buffer;
-        for(i = 0; i < row; ++i)
-        {
-            fwrite(mapped_buffer,  srcw, 1, psb_dump_yuvbuf_fp);
-            mapped_buffer += psb_surface->stride;
+    for (i = 0; i < rows; i++) {
+        memcpy(row, plane + i * stride, width);
+        crc = psb__crc32c(crc, row, width);
+    }
+    return ~crc;
+}
+
+static void psb__verify_sum(psb_verify_job *job, unsigned char *row)
+{
+    /* 4:2:0, odd sizes round the chroma up */
+    int width = (job->width + 1) & ~1;
+
+    job->crc[0] = psb__verify_plane(row, job->luma, job->stride, job->width, job->height);
+    job->crc[1] = psb__verify_plane(row, job->chroma, job->stride, width, (job->height + 1) / 2);
+}
+
+/*
+ * Appends the frame to $PSB_VIDEO_DUMP_YUVBUF as I420
+ */
+static void psb__verify_dump(psb_verify_job *job)
+{
+    unsigned char *row = psb_verify.row;
+    int width = (job->width + 1) / 2;
+    int i, j, k;
+
+    for (i = 0; i < job->height; i++) {
+        memcpy(row, job->luma + i * job->stride, job->width);
+        fwrite(row, job->width, 1, psb_dump_yuvbuf_fp);
+    }
+    /* U then V, each from the interleaved plane */
+    for (k = 0; k < 2; k++) {
+        for (i = 0; i < (job->height + 1) / 2; i++) {
+            memcpy(row, job->chroma + i * job->stride, width * 2);
+            for (j = 0; j < width; j++)
+                row[j] = row[j * 2 + k];
+            fwrite(row, width, 1, psb_dump_yuvbuf_fp);
         }
+    }
+}
 
-        mapped_buffer = mapped_start + psb_surface->chroma_offset;
-        for(i = 0; i < row/2; ++i)
-        {
-            fwrite(mapped_buffer,  srcw, 1, psb_dump_yuvbuf_fp);
-            mapped_buffer += psb_surface->stride;
+/*
+ * Compares, logs and dumps a summed frame and releases its surface, with
+ * the mutex held
+ */
+static void psb__verify_finish(psb_verify_job *job)
+{
+    int mismatch = 0, golden = 0;
+
+    if (job->frame <= psb_verify.golden_count && psb_verify.golden_valid[job->frame - 1]) {
+        golden = 1;
+        mismatch = memcmp(job->crc, psb_verify.golden[job->frame - 1], sizeof(job->crc)) != 0;
+    }
+    psb_verify.verified++;
+    if (!golden)
+        psb_verify.unchecked++;
+
+    if (psb_verify.log_fp)
+        fprintf(psb_verify.log_fp, "%u %dx%d %08x %08x%s\n", job->frame, job->width, job->height,
+                job->crc[0], job->crc[1], mismatch ? " mismatch" : "");
+    if (mismatch) {
+        psb_verify.mismatches++;
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "verify: frame %u in surface %08x Y %08x UV %08x, expected %08x %08x\n",
+                      job->frame, job->obj_surface->surface_id, job->crc[0], job->crc[1],
+                      psb_verify.golden[job->frame - 1][0], psb_verify.golden[job->frame - 1][1]);
+    }
+    /* with a golden list only the frames that differ */
+    if (psb_dump_yuvbuf_fp && (mismatch || !psb_verify.golden_count))
+        psb__verify_dump(job);
+
+    drm_ipvr_gem_bo_unmap(job->obj_surface->psb_surface->buf);
+    job->obj_surface->verify_busy = 0;
+}
+
+static void *psb__verify_thread(void *arg)
+{
+    psb_verify_job *job;
+
+    pthread_mutex_lock(&psb_verify.mutex);
+    for (;;) {
+        while (psb_verify.work == psb_verify.tail && !psb_verify.stop)
+            pthread_cond_wait(&psb_verify.cond, &psb_verify.mutex);
+        if (psb_verify.work == psb_verify.tail)
+            break;
+        job = &psb_verify.jobs[psb_verify.work % PSB_VERIFY_JOBS];
+        pthread_mutex_unlock(&psb_verify.mutex);
+
+        psb__verify_sum(job, psb_verify.thread_row);
+
+        pthread_mutex_lock(&psb_verify.mutex);
+        job->done = 1;
+        psb_verify.work++;
+        pthread_cond_broadcast(&psb_verify.cond);
+    }
+    pthread_mutex_unlock(&psb_verify.mutex);
+    return arg;
+}
+
+/* Finishes the oldest queued job, with the mutex held */
+static void psb__verify_reap(void)
+{
+    psb_verify_job *job = &psb_verify.jobs[psb_verify.head % PSB_VERIFY_JOBS];
+
+    while (!job->done)
+        pthread_cond_wait(&psb_verify.cond, &psb_verify.mutex);
+    psb__verify_finish(job);
+    psb_verify.head++;
+}
+
+static void psb__verify_load_golden(const char *path)
+{
+    char line[256];
+    unsigned int frame, n;
+    uint32_t crc[2];
+    int width, height;
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "verify: cannot open golden list %s: %s\n", path, strerror(errno));
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' ||
+            sscanf(line, "%u %dx%d %x %x", &frame, &width, &height, &crc[0], &crc[1]) != 5 ||
+            frame == 0)
+            continue;
+        if (frame > PSB_VERIFY_MAX_FRAMES) {
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "verify: %s: frame %u is out of range, at most %u frames\n",
+                path, frame, PSB_VERIFY_MAX_FRAMES);
+            continue;
+        }
+        if (frame > psb_verify.golden_count) {
+            n = psb_verify.golden_count ? psb_verify.golden_count : 1024;
+            while (n < frame)
+                n *= 2;
+            void *golden = realloc(psb_verify.golden, n * sizeof(*psb_verify.golden));
+            unsigned char *valid = realloc(psb_verify.golden_valid, n);
+            if (golden)
+                psb_verify.golden = golden;
+            if (valid)
+                psb_verify.golden_valid = valid;
+            if (golden == NULL || valid == NULL)
+                break;
+            memset(valid + psb_verify.golden_count, 0, n - psb_verify.golden_count);
+            psb_verify.golden_count = n;
         }
-        drm_ipvr_gem_bo_unmap(psb_surface->buf);
+        memcpy(psb_verify.golden[frame - 1], crc, sizeof(crc));
+        psb_verify.golden_valid[frame - 1] = 1;
+    }
+    fclose(fp);
+}
+
+static void psb__verify_open(void)
+{
+    char value[1024] = {0};
+    int enable = 0;
+
+    psb__crc32c_init();
+    if (psb_parse_config("PSB_VIDEO_VERIFY", &value[0]) == 0) {
+        psb_verify.log_fp = fopen(value, "w");
+        if (psb_verify.log_fp == NULL)
+            drv_debug_msg(VIDEO_DEBUG_ERROR, "verify: cannot open %s: %s\n", value, strerror(errno));
+        else
+            fprintf(psb_verify.log_fp, "# frame WxH Y-CRC32C UV-CRC32C\n");
+        enable = 1;
+    }
+    if (psb_parse_config("PSB_VIDEO_VERIFY_GOLDEN", &value[0]) == 0) {
+        psb__verify_load_golden(value);
+        enable = 1;
+    }
+    if (!enable && psb_dump_yuvbuf_fp == NULL)
+        return;
+
+    psb_verify.threaded = psb_parse_config("PSB_VIDEO_VERIFY_THREAD", &value[0]) == 0 && atoi(value);
+    if (psb_verify.threaded) {
+        psb_verify.stop = 0;
+        if (pthread_create(&psb_verify.thread, NULL, psb__verify_thread, NULL))
+            psb_verify.threaded = 0;
+    }
+    psb_video_verify = 1;
+}
+
+static void psb__verify_close(void)
+{
+    if (!psb_video_verify)
+        return;
+
+    pthread_mutex_lock(&psb_verify.mutex);
+    while (psb_verify.head != psb_verify.tail)
+        psb__verify_reap();
+    psb_verify.stop = 1;
+    pthread_cond_broadcast(&psb_verify.cond);
+    pthread_mutex_unlock(&psb_verify.mutex);
+    if (psb_verify.threaded)
+        pthread_join(psb_verify.thread, NULL);
+
+    drv_debug_msg(psb_verify.mismatches ? VIDEO_DEBUG_ERROR : VIDEO_DEBUG_INIT,
+                  "verify: %u frames checked, %u mismatches, %u without a golden checksum\n",
+                  psb_verify.verified, psb_verify.mismatches, psb_verify.unchecked);
+    if (psb_verify.log_fp) {
+        fprintf(psb_verify.log_fp, "# %u frames checked, %u mismatches\n",
+                psb_verify.verified, psb_verify.mismatches);
+        fclose(psb_verify.log_fp);
     }
+    free(psb_verify.golden);
+    free(psb_verify.golden_valid);
+    psb_verify.log_fp = NULL;
+    psb_verify.golden = NULL;
+    psb_verify.golden_valid = NULL;
+    psb_verify.golden_count = 0;
+    psb_verify.frames = psb_verify.verified = psb_verify.mismatches = psb_verify.unchecked = 0;
+    psb_verify.threaded = 0;
+    psb_video_verify = 0;
+}
+
+void psb__verify_frame_decoded(object_surface_p obj_surface)
+{
+    pthread_mutex_lock(&psb_verify.mutex);
+    obj_surface->verify_frame = ++psb_verify.frames;
+    pthread_mutex_unlock(&psb_verify.mutex);
+}
+
+void psb__verify_surface(object_surface_p obj_surface)
+{
+    psb_surface_p psb_surface = obj_surface->psb_surface;
+    psb_verify_job frame_job, *job = &frame_job;
+
+    pthread_mutex_lock(&psb_verify.mutex);
+    if (obj_surface->verify_frame == 0 || obj_surface->verify_busy) {
+        pthread_mutex_unlock(&psb_verify.mutex);
+        return;
+    }
+    if (obj_surface->width > PSB_VERIFY_MAX_WIDTH || obj_surface->width > psb_surface->stride ||
+        drm_ipvr_gem_bo_map(psb_surface->buf, 0) || psb_surface->buf->virt == NULL) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "verify: cannot read frame %u in surface %08x\n",
+                      obj_surface->verify_frame, obj_surface->surface_id);
+        obj_surface->verify_frame = 0;
+        pthread_mutex_unlock(&psb_verify.mutex);
+        return;
+    }
+
+    if (psb_verify.threaded) {
+        while (psb_verify.tail - psb_verify.head == PSB_VERIFY_JOBS)
+            psb__verify_reap();
+        job = &psb_verify.jobs[psb_verify.tail % PSB_VERIFY_JOBS];
+    }
+    job->obj_surface = obj_surface;
+    job->frame = obj_surface->verify_frame;
+    job->luma = (unsigned char *)psb_surface->buf->virt + psb_surface->luma_offset;
+    job->chroma = (unsigned char *)psb_surface->buf->virt + psb_surface->chroma_offset;
+    job->stride = psb_surface->stride;
+    job->width = obj_surface->width;
+    job->height = obj_surface->height_origin;
+    job->done = 0;
+    obj_surface->verify_frame = 0;
+    obj_surface->verify_busy = 1;
+
+    if (psb_verify.threaded) {
+        psb_verify.tail++;
+        pthread_cond_broadcast(&psb_verify.cond);
+    } else {
+        psb__verify_sum(job, psb_verify.row);
+        psb__verify_finish(job);
+    }
+    pthread_mutex_unlock(&psb_verify.mutex);
+}
+
+void psb__verify_wait_surface(object_surface_p obj_surface)
+{
+    pthread_mutex_lock(&psb_verify.mutex);
+    while (obj_surface->verify_busy)
+        psb__verify_reap();
+    pthread_mutex_unlock(&psb_verify.mutex);
 }
 
 int psb_cmdbuf_dump(unsigned int *buffer, int byte_size)
@@ -36,6 +36,7 @@
 #include <time.h>
 #include <unistd.h>
 #include "psb_drv_video.h"
+#include "psb_trace_ring.h"
 /* #define VA_EMULATOR 1 */
 #include <ipvr_bufmgr.h>
 
@@ -130,8 +131,40 @@ void debug_dump_cmdbuf(uint32_t *cmd_idx, uint32_t cmd_size_in_bytes);
 #define DEBUG_FAILURE           while(vaStatus) {drv_debug_msg(VIDEO_DEBUG_ERROR, "%s fails with '%d' at %s:%d\n", __FUNCTION__, vaStatus, __FILE__, __LINE__);break;}
 #define DEBUG_FAILURE_RET       while(ret)      {drv_debug_msg(VIDEO_DEBUG_ERROR, "%s fails with '%s' at %s:%d\n", __FUNCTION__, strerror(ret < 0 ? -ret : ret), __FILE__, __LINE__);break;}
 
-#define DEBUG_FUNC_ENTER while(1) {drv_debug_msg(VIDEO_DEBUG_ENTRY, "%s enter.\n", __FUNCTION__); break;}
-#define DEBUG_FUNC_EXIT while(1) {drv_debug_msg(VIDEO_DEBUG_ENTRY, "%s exit.\n", __FUNCTION__); break;}
+/*
+ * Binary trace ring, enabled with PSB_VIDEO_TRACE_RING=<file>. Records go
+ * lock-free into per-thread rings mapped from <file>.<pid>, which
+ * tools/psb_trace_decode turns into latency histograms and a Chrome trace.
+ * With the ring and VIDEO_DEBUG_ENTRY both off a trace point is one branch.
+ */
+extern psb_trace_file *psb_video_trace_ring;
+extern int psb_video_call_trace;
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+void psb__trace_call(int type, int *event, const char *name,
+                     uint32_t context_id, uint32_t surface_id);
+
+/* the event name is the function name, looked up once per trace point */
+#define PSB_TRACE_EVENT(type, context_id, surface_id, arg0, arg1, arg2, arg3) \
+    do { \
+        static int psb__trace_event = -1; \
+        if (psb_video_trace_ring) \
+            psb__trace_ring_record(type, &psb__trace_event, __FUNCTION__, \
+                                   context_id, surface_id, arg0, arg1, arg2, arg3); \
+    } while (0)
+
+#define PSB_TRACE_CALL(type, context_id, surface_id) \
+    do { \
+        static int psb__trace_event = -1; \
+        if (psb_video_call_trace) \
+            psb__trace_call(type, &psb__trace_event, __FUNCTION__, context_id, surface_id); \
+    } while (0)
+
+#define DEBUG_FUNC_ENTER while(1) {PSB_TRACE_CALL(PSB_TRACE_ENTER, 0, 0); break;}
+#define DEBUG_FUNC_ENTER_ID(context_id, surface_id) while(1) {PSB_TRACE_CALL(PSB_TRACE_ENTER, context_id, surface_id); break;}
+#define DEBUG_FUNC_EXIT while(1) {PSB_TRACE_CALL(PSB_TRACE_EXIT, 0, 0); break;}
 
 uint32_t debug_cmd_start[MAX_CMD_COUNT];
 uint32_t debug_cmd_size[MAX_CMD_COUNT];
@@ -145,6 +178,17 @@ uint32_t     debug_dump_offset[MAX_DUMP_COUNT];
 uint32_t     debug_dump_size[MAX_DUMP_COUNT];
 uint32_t     debug_dump_count;
 
+/*
+ * Decode verification, enabled by PSB_VIDEO_VERIFY, PSB_VIDEO_VERIFY_GOLDEN
+ * or PSB_VIDEO_DUMP_YUVBUF. vaEndPicture numbers the frame decoded into a
+ * surface, vaSyncSurface sums it, and the surface must be waited for
+ * before it is decoded into again or destroyed.
+ */
+extern int psb_video_verify;
+void psb__verify_frame_decoded(object_surface_p obj_surface);
+void psb__verify_surface(object_surface_p obj_surface);
+void psb__verify_wait_surface(object_surface_p obj_surface);
+
 int psb_cmdbuf_dump(unsigned int *buffer, int byte_size);
 void psb__dump_va_buffers(object_buffer_p obj_buffer);
 void psb__dump_va_buffers_verbose(object_buffer_p obj_buffer);
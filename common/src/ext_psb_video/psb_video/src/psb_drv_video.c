@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <time.h>
 #include <unistd.h>
 #include <linux/videodev2.h>
@@ -47,6 +48,7 @@
 #include "psb_def.h"
 #include "psb_drv_debug.h"
 #include "pnw_rotate.h"
+#include "ved_execbuf.h"
 
 #include <ipvr_drm.h>
 #include <ipvr_bufmgr.h>
@@ -65,6 +67,8 @@
 #define PSB_STR_VENDOR_LEXINGTON     "Intel GMA500-LEXINGTON-" PSB_DRV_VERSION " " PSB_CHG_REVISION
 
 #define MAX_UNUSED_BUFFERS      16
+#define PSB_BUFFER_POOL_BUDGET  (16 * 1024 * 1024)
+#define PSB_MAX_BUFFER_POOL_KB  (1024 * 1024)   /* keeps the pool sums far from wrapping */
 
 #define PSB_MAX_FLIP_DELAY (1000/30/10)
 
@@ -419,13 +423,33 @@ VAStatus psb_QueryConfigAttributes(
     return vaStatus;
 }
 
+/*
+ * Checksums the frame last decoded into "obj_surface" if the application
+ * never synced it, and waits for its checksum, before the surface is
+ * decoded into again or destroyed
+ */
+static void psb__verify_flush_surface(object_surface_p obj_surface)
+{
+    /* not summed if its context is in the middle of a frame, it is not decoded yet */
+    if (obj_surface->verify_frame && !ved_surface_flush(obj_surface)) {
+        if (psb_surface_sync(obj_surface->psb_surface) == VA_STATUS_SUCCESS)
+            psb__verify_surface(obj_surface);
+    }
+    psb__verify_wait_surface(obj_surface);
+}
+
 void psb__destroy_surface(psb_driver_data_p driver_data, object_surface_p obj_surface)
 {
     if (NULL != obj_surface) {
 	obj_surface->is_ref_surface = 0;
 
+        if (psb_video_verify)
+            psb__verify_flush_surface(obj_surface);
+
         /* fixme: this is to work-around the case that destroying hw context
          * with pending cmds, which might lead to incorrect driver state */
+        if (ved_surface_flush(obj_surface))
+            ved_surface_unqueue(obj_surface);
 	psb_surface_sync(obj_surface->psb_surface);
         psb_surface_destroy(obj_surface->psb_surface);
 
@@ -974,10 +998,12 @@ VAStatus psb_CreateContext(
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s created drm context 0x%08x. VADrvContext %p, driver_data %p\n",
         __func__, obj_context->ipvr_ctx->ctx_id, ctx, driver_data);
 
+    pthread_mutex_init(&obj_context->execbuf_mutex, NULL);
     vaStatus = obj_context->format_vtable->createContext(obj_context, obj_config);
 
     /* Error recovery */
     if (VA_STATUS_SUCCESS != vaStatus) {
+        pthread_mutex_destroy(&obj_context->execbuf_mutex);
         obj_context->context_id = -1;
         obj_context->config_id = -1;
         obj_context->picture_width = 0;
@@ -1017,6 +1043,43 @@ static VAStatus psb__allocate_malloc_buffer(object_buffer_p obj_buffer, int size
 
 static VAStatus psb__unmap_buffer(object_buffer_p obj_buffer);
 
+/*
+ * BO sizes are rounded to 32KB up to 256KB, above that to one of four
+ * classes per power of two, so a pooled BO fits a range of requests while
+ * wasting at most a quarter of its size.
+ */
+static unsigned int psb__buffer_size_class(unsigned int size)
+{
+    unsigned int step = 0x8000;
+
+    while (size > step * 8)
+        step <<= 1;
+    return (size + step - 1) & ~(step - 1);
+}
+
+/*
+ * Buffer types whose BO stays attached while the buffer sits on the unused
+ * list. Their cache level is fixed per type, so the per type unused lists
+ * are already bucketed by it. Image buffers are shared with other
+ * processes, coded buffers carry encoder state and protected buffers are
+ * reallocated on every use, so those go back to libdrm_ipvr.
+ */
+static int psb__buffer_poolable(VABufferType type)
+{
+    switch (type) {
+    case VABitPlaneBufferType:
+    case VASliceDataBufferType:
+    case VAResidualDataBufferType:
+    case VASliceGroupMapBufferType:
+#ifdef SLICE_HEADER_PARSING
+    case VAParseSliceHeaderGroupBufferType:
+#endif
+        return 1;
+    default:
+        return 0;
+    }
+}
+
 static VAStatus psb__allocate_BO_buffer(psb_driver_data_p driver_data, object_context_p obj_context, object_buffer_p obj_buffer, int size, unsigned char *data, VABufferType type)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
@@ -1047,7 +1110,7 @@ static VAStatus psb__allocate_BO_buffer(psb_driver_data_p driver_data, object_co
      * call libdrm_ipvr to allocate from its internal cache or get new pages
      */
     if (!obj_buffer->ipvr_bo) {
-        size = (size + 0x7fff) & ~0x7fff;
+        size = psb__buffer_size_class(size);
 		if (!obj_context)
         obj_buffer->ipvr_bo = drm_ipvr_gem_bo_alloc(driver_data->bufmgr, NULL,
             buffer_type_to_string(obj_buffer->type), size, 0, cache_level);
@@ -1107,6 +1170,9 @@ static VAStatus psb__unmap_buffer(object_buffer_p obj_buffer)
 static void psb__destroy_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buffer)
 {
     if (obj_buffer->ipvr_bo) {
+        if (obj_buffer->pooled) {
+            driver_data->buffer_pool_size -= obj_buffer->alloc_size;
+        }
         if (obj_buffer->buffer_data) {
             psb__unmap_buffer(obj_buffer);
         }
@@ -1123,16 +1189,40 @@ static void psb__destroy_buffer(psb_driver_data_p driver_data, object_buffer_p o
     object_heap_free(&driver_data->buffer_heap, (object_base_p) obj_buffer);
 }
 
+/*
+ * Gives the BO of a pooled buffer back to libdrm_ipvr
+ */
+static void psb__buffer_pool_evict(psb_driver_data_p driver_data, object_buffer_p obj_buffer)
+{
+    driver_data->buffer_pool_size -= obj_buffer->alloc_size;
+    driver_data->buffer_pool_evictions++;
+    drm_ipvr_gem_bo_unreference(obj_buffer->ipvr_bo);
+    obj_buffer->ipvr_bo = NULL;
+    obj_buffer->alloc_size = 0;
+}
+
 void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buffer)
 {
+    /* vaDestroyBuffer after vaRenderPicture finds the buffer unused already */
+    if (obj_buffer->pooled)
+        return;
 
     if (obj_buffer->ipvr_bo) {
-        /**
-         * unreference the bo
-         * libdrm_ipvr will manage the life cycle/LRU of it: free or cache it.
-         */
-        drm_ipvr_gem_bo_unreference(obj_buffer->ipvr_bo);
-        obj_buffer->ipvr_bo = NULL;
+        if (obj_buffer->buffer_data) {
+            psb__unmap_buffer(obj_buffer);
+        }
+        if (obj_buffer->context && !obj_buffer->export_refcount && psb__buffer_poolable(obj_buffer->type) &&
+            driver_data->buffer_pool_size + obj_buffer->alloc_size <= driver_data->buffer_pool_budget) {
+            /* keep the bo, psb__CreateBuffer hands it out again once the VED retired it */
+            driver_data->buffer_pool_size += obj_buffer->alloc_size;
+        } else {
+            /**
+             * unreference the bo
+             * libdrm_ipvr will manage the life cycle/LRU of it: free or cache it.
+             */
+            drm_ipvr_gem_bo_unreference(obj_buffer->ipvr_bo);
+            obj_buffer->ipvr_bo = NULL;
+        }
     }
 
     if (obj_buffer->context) {
@@ -1141,10 +1231,13 @@ void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buff
 
         /* Remove buffer from active list */
         *obj_buffer->pptr_prev_next = obj_buffer->ptr_next;
+        if (obj_buffer->ptr_next) {
+            obj_buffer->ptr_next->pptr_prev_next = obj_buffer->pptr_prev_next;
+        }
 
         /* Add buffer to tail of unused list */
         obj_buffer->ptr_next = NULL;
-        obj_buffer->last_used = obj_context->frame_count;
+        obj_buffer->last_used = obj_context->execbuf_seqno;
         if (obj_context->buffers_unused_tail[type]) {
             obj_buffer->pptr_prev_next = &(obj_context->buffers_unused_tail[type]->ptr_next);
         } else {
@@ -1153,6 +1246,7 @@ void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buff
         *obj_buffer->pptr_prev_next = obj_buffer;
         obj_context->buffers_unused_tail[type] = obj_buffer;
         obj_context->buffers_unused_count[type]++;
+        obj_buffer->pooled = 1;
 
         drv_debug_msg(VIDEO_DEBUG_GENERAL, "Adding buffer %08x type %s to unused list. unused count = %d\n", obj_buffer->base.id,
                                  buffer_type_to_string(obj_buffer->type), obj_context->buffers_unused_count[type]);
@@ -1163,10 +1257,75 @@ void psb__suspend_buffer(psb_driver_data_p driver_data, object_buffer_p obj_buff
         psb__destroy_buffer(driver_data, obj_buffer);
 }
 
+/*
+ * Picks the buffer to reuse for a new buffer of the given type and size
+ *   - the smallest retired BO of a fitting size class
+ *   - else an unused buffer without BO
+ *   - else the least recently used buffer, if its BO is retired, dropping
+ *     the BO that did not fit
+ * Returns NULL when a new buffer has to be allocated
+ */
+static object_buffer_p psb__buffer_pool_get(psb_driver_data_p driver_data, object_context_p obj_context,
+                                            VABufferType type, unsigned int size)
+{
+    object_buffer_p obj_buffer, hit = NULL, plain = NULL;
+    object_buffer_p oldest = obj_context->buffers_unused[type];
+    unsigned int size_class = psb__buffer_size_class(size);
+    int fits, retired, oldest_retired = 0;
+
+    /* Nothing but the buffer object to recycle */
+    if (!psb__buffer_poolable(type))
+        return oldest;
+
+    for (obj_buffer = oldest; obj_buffer; obj_buffer = obj_buffer->ptr_next) {
+        if (!obj_buffer->ipvr_bo) {
+            if (!plain)
+                plain = obj_buffer;
+            continue;
+        }
+        fits = (obj_buffer->alloc_size >= size_class) && (obj_buffer->alloc_size <= 2 * size_class);
+        if (fits ? (hit && hit->alloc_size <= obj_buffer->alloc_size) : (obj_buffer != oldest))
+            continue;
+        /*
+         * A buffer released while the execbuf was still open is used by
+         * commands that are not even submitted yet
+         */
+        retired = (obj_buffer->last_used != obj_context->execbuf_seqno) &&
+            !drm_ipvr_gem_bo_busy(obj_buffer->ipvr_bo);
+        if (!fits) {
+            oldest_retired = retired;
+            continue;
+        }
+        if (!retired) {
+            driver_data->buffer_pool_busy++;
+            continue;
+        }
+        hit = obj_buffer;
+        if (hit->alloc_size == size_class)
+            break;
+    }
+
+    if (hit) {
+        driver_data->buffer_pool_hits++;
+        return hit;
+    }
+
+    driver_data->buffer_pool_misses++;
+    if (plain)
+        return plain;
+    if (oldest && oldest_retired) {
+        psb__buffer_pool_evict(driver_data, oldest);
+        return oldest;
+    }
+    return NULL;
+}
+
 static void psb__destroy_context(psb_driver_data_p driver_data, object_context_p obj_context)
 {
     int i;
 
+    /* Queued frames still have to be decoded, their surfaces may be waited for */
+    ved_context_flush_execbuf(obj_context);
     obj_context->format_vtable->destroyContext(obj_context);
 
     for (i = 0; i < PSB_MAX_BUFFERTYPES; i++) {
@@ -1201,6 +1360,7 @@ static void psb__destroy_context(psb_driver_data_p driver_data, object_context_p
         free(obj_context->buffer_list);
     obj_context->num_buffers = 0;
 
+    pthread_mutex_destroy(&obj_context->execbuf_mutex);
     object_heap_free(&driver_data->context_heap, (object_base_p) obj_context);
 
     psb_rm_context(driver_data);
@@ -1238,7 +1398,7 @@ VAStatus psb__CreateBuffer(
     DEBUG_FUNC_ENTER
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     int bufferID;
-    object_buffer_p obj_buffer = obj_context ? obj_context->buffers_unused[type] : NULL;
+    object_buffer_p obj_buffer = obj_context ? psb__buffer_pool_get(driver_data, obj_context, type, size * num_elements) : NULL;
     int unused_count = obj_context ? obj_context->buffers_unused_count[type] : 0;
 
 
@@ -1247,11 +1407,12 @@ VAStatus psb__CreateBuffer(
      * For each buffer type, maintain
      *   - a LRU sorted list of unused buffers
      *   - a list of active buffers
+     * Unused buffers of the pooled types keep their BO, see psb__buffer_pool_get.
      * We only create a new buffer when
      *   - no unused buffers are available
-     *   - the last unused buffer is still queued
-     *   - the last unused buffer was used very recently and may still be fenced
-     *      - used recently is defined as within the current frame_count (subject to tweaks)
+     *   - the unused buffers all hold a BO that is still queued
+     *   - or was used very recently and may still be fenced
+     *      - used recently is defined as within the execbuf not submitted yet
      *
      * The buffer that is returned will be moved to the list of active buffers
      *   - vaDestroyBuffer and vaRenderPicture will move the active buffer back to the list of unused buffers
@@ -1265,15 +1426,23 @@ VAStatus psb__CreateBuffer(
                                  buffer_type_to_string(type), unused_count);
 
         /* Remove from unused list */
-        obj_context->buffers_unused[type] = obj_buffer->ptr_next;
-        if (obj_context->buffers_unused[type]) {
-            obj_context->buffers_unused[type]->pptr_prev_next = &(obj_context->buffers_unused[type]);
+        *obj_buffer->pptr_prev_next = obj_buffer->ptr_next;
+        if (obj_buffer->ptr_next) {
+            obj_buffer->ptr_next->pptr_prev_next = obj_buffer->pptr_prev_next;
             ASSERT(obj_context->buffers_unused_tail[type] != obj_buffer);
         } else {
             ASSERT(obj_context->buffers_unused_tail[type] == obj_buffer);
-            obj_context->buffers_unused_tail[type] = 0;
+            if (obj_buffer->pptr_prev_next == &(obj_context->buffers_unused[type]))
+                obj_context->buffers_unused_tail[type] = 0;
+            else
+                obj_context->buffers_unused_tail[type] = (object_buffer_p)
+                    ((unsigned char *)obj_buffer->pptr_prev_next - offsetof(struct object_buffer_s, ptr_next));
         }
         obj_context->buffers_unused_count[type]--;
+        if (obj_buffer->ipvr_bo) {
+            driver_data->buffer_pool_size -= obj_buffer->alloc_size;
+        }
+        obj_buffer->pooled = 0;
 
         object_heap_suspend_object((object_base_p)obj_buffer, 0); /* Make BufferID valid again */
         ASSERT(type == obj_buffer->type);
@@ -1390,7 +1559,7 @@ VAStatus psb_CreateBuffer(
     VABufferID *buf_desc    /* out */
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(context, 0)
     INIT_DRIVER_DATA
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: VADrvContext %p driver_data %p.\n", __func__, ctx, driver_data);
@@ -1561,12 +1730,13 @@ VAStatus psb_BeginPicture(
     VASurfaceID render_target
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(context, render_target)
     INIT_DRIVER_DATA
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     object_context_p obj_context;
     object_surface_p obj_surface;
     object_config_p obj_config;
+    int ret;
 
     obj_context = CONTEXT(context);
     CHECK_CONTEXT(obj_context);
@@ -1577,6 +1747,14 @@ VAStatus psb_BeginPicture(
     obj_surface = SURFACE(render_target);
     CHECK_SURFACE(obj_surface);
 
+    if (psb_video_verify)
+        psb__verify_flush_surface(obj_surface);
+
+    /* The last decode into the target may still be queued on another context */
+    ret = ved_context_depend_surface(obj_context, obj_surface);
+    if (ret)
+        return (ret == -EBUSY) ? VA_STATUS_ERROR_SURFACE_BUSY : VA_STATUS_ERROR_UNKNOWN;
+
     obj_context->current_render_surface_id = render_target;
     obj_context->current_render_target = obj_surface;
     obj_context->slice_count = 0;
@@ -1588,6 +1766,9 @@ VAStatus psb_BeginPicture(
     }
 
     vaStatus = obj_context->format_vtable->beginPicture(obj_context);
+    /* no vaEndPicture may follow to close the frame */
+    if (vaStatus != VA_STATUS_SUCCESS)
+        ved_context_end_frame(obj_context);
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "---BeginPicture 0x%08x for frame %d --\n",
                              render_target, obj_context->frame_count);
@@ -1604,7 +1785,7 @@ VAStatus psb_RenderPicture(
     int num_buffers
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(context, 0)
     INIT_DRIVER_DATA
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     object_context_p obj_context;
@@ -1667,15 +1848,25 @@ VAStatus psb_EndPicture(
     VAContextID context
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(context, 0)
     INIT_DRIVER_DATA
     VAStatus vaStatus;
     object_context_p obj_context;
+    object_surface_p obj_surface;
 
     obj_context = CONTEXT(context);
     CHECK_CONTEXT(obj_context);
 
+    obj_surface = obj_context->current_render_target;
     vaStatus = obj_context->format_vtable->endPicture(obj_context);
+    /* carries out the flushes other threads asked for meanwhile */
+    ved_context_end_frame(obj_context);
+
+    /* numbered in decode order, summed once the application syncs the surface */
+    if (psb_video_verify && vaStatus == VA_STATUS_SUCCESS && obj_surface &&
+        obj_context->entry_point != VAEntrypointEncSlice &&
+        obj_context->entry_point != VAEntrypointEncPicture)
+        psb__verify_frame_decoded(obj_surface);
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "---EndPicture for frame %d --\n", obj_context->frame_count);
 
@@ -1696,17 +1887,28 @@ VAStatus psb_SyncSurface(
     VASurfaceID render_target
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(0, render_target)
     INIT_DRIVER_DATA
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     object_surface_p obj_surface;
+    int ret;
 
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "psb_SyncSurface: 0x%08x\n", render_target);
 
     obj_surface = SURFACE(render_target);
     CHECK_SURFACE(obj_surface);
 
+    /*
+     * Submits the execbuf the frame is queued in: the frames queued after
+     * it go along and it completes only with them. If its context is in
+     * the middle of a frame, that execbuf goes out at the frame's end.
+     */
+    ret = ved_surface_flush(obj_surface);
+    if (ret)
+        return (ret == -EBUSY) ? VA_STATUS_ERROR_SURFACE_BUSY : VA_STATUS_ERROR_UNKNOWN;
     vaStatus = psb_surface_sync(obj_surface->psb_surface);
+    if (psb_video_verify && vaStatus == VA_STATUS_SUCCESS && obj_surface->verify_frame)
+        psb__verify_surface(obj_surface);
 
     DEBUG_FAILURE;
     DEBUG_FUNC_EXIT
@@ -1720,7 +1922,7 @@ VAStatus psb_QuerySurfaceStatus(
     VASurfaceStatus *status    /* out */
 )
 {
-    DEBUG_FUNC_ENTER
+    DEBUG_FUNC_ENTER_ID(0, render_target)
     INIT_DRIVER_DATA
     VAStatus vaStatus = VA_STATUS_SUCCESS;
     object_surface_p obj_surface;
@@ -1730,6 +1932,12 @@ VAStatus psb_QuerySurfaceStatus(
     CHECK_SURFACE(obj_surface);
 
     CHECK_INVALID_PARAM(status == NULL);
+    /* A queued frame would never finish rendering without being submitted */
+    if (ved_surface_flush(obj_surface) == -EBUSY) {
+        *status = VASurfaceRendering;
+        DEBUG_FUNC_EXIT
+        return VA_STATUS_SUCCESS;
+    }
     vaStatus = psb_surface_query_status(obj_surface->psb_surface, &surface_status);
 
     *status = surface_status;
@@ -1861,6 +2069,8 @@ VAStatus psb_LockSurface(
     psb_surface_p psb_surface;
     CHECK_SURFACE(obj_surface);
 
+    if (ved_surface_flush(obj_surface) == -EBUSY)
+        return VA_STATUS_ERROR_SURFACE_BUSY;
     psb_surface = obj_surface->psb_surface;
     if (buffer_name)
 	 drm_ipvr_gem_bo_flink(psb_surface->buf, buffer_name);
@@ -2089,6 +2299,10 @@ VAStatus psb_Terminate(VADriverContextP ctx)
     }
     object_heap_destroy(&driver_data->context_heap);
 
+    drv_debug_msg(VIDEO_DEBUG_INIT, "vaTerminate: buffer pool %u hits, %u misses, %u busy, %u evictions\n",
+                  driver_data->buffer_pool_hits, driver_data->buffer_pool_misses,
+                  driver_data->buffer_pool_busy, driver_data->buffer_pool_evictions);
+
     /* Clean up SubpicIDs */
     obj_subpic = (object_subpic_p) object_heap_first(&driver_data->subpic_heap, &iter);
     while (obj_subpic) {
@@ -2162,6 +2376,7 @@ EXPORT VAStatus __vaDriverInit_0_37(VADriverContextP ctx)
     psb_driver_data_p driver_data;
     VAStatus va_status = VA_STATUS_SUCCESS;
     int result;
+    char env_value[1024];
     if (psb_video_trace_fp) {
         /* make gdb always stop here */
         signal(SIGUSR1, SIG_IGN);
@@ -2314,6 +2529,27 @@ EXPORT VAStatus __vaDriverInit_0_37(VADriverContextP ctx)
         goto out_err;
     }
 
+    driver_data->buffer_pool_budget = PSB_BUFFER_POOL_BUDGET;
+    if (psb_parse_config("PSB_VIDEO_BUFFER_POOL_KB", &env_value[0]) == 0) {
+        int pool_kb = atoi(env_value);
+        if (pool_kb < 0)
+            pool_kb = 0;
+        if (pool_kb > PSB_MAX_BUFFER_POOL_KB)
+            pool_kb = PSB_MAX_BUFFER_POOL_KB;
+        driver_data->buffer_pool_budget = pool_kb * 1024U;
+        drv_debug_msg(VIDEO_DEBUG_INIT, "Buffer pool budget %u bytes\n", driver_data->buffer_pool_budget);
+    }
+
+    driver_data->decode_ahead = 1;
+    if (psb_parse_config("PSB_VIDEO_DECODE_AHEAD", &env_value[0]) == 0) {
+        driver_data->decode_ahead = atoi(env_value);
+        if (driver_data->decode_ahead < 1)
+            driver_data->decode_ahead = 1;
+        if (driver_data->decode_ahead > PSB_MAX_DECODE_AHEAD)
+            driver_data->decode_ahead = PSB_MAX_DECODE_AHEAD;
+        drv_debug_msg(VIDEO_DEBUG_INIT, "Decode ahead %d frames\n", driver_data->decode_ahead);
+    }
+
     result = object_heap_init(&driver_data->image_heap, sizeof(struct object_image_s), IMAGE_ID_OFFSET);
     if (result) {
         va_status = VA_STATUS_ERROR_OPERATION_FAILED;
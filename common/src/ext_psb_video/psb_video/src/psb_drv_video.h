@@ -93,6 +93,12 @@
 /* Max # of command submission buffers */
 #define PSB_MAX_CMDBUFS                         10
 
+/* Max # of frames queued in one execbuf, see ved_context_queue_frame() */
+#define PSB_MAX_DECODE_AHEAD                    4
+
+/* Max # of scratch buffers one frame holds, see ved_context_hold_scratch() */
+#define PSB_MAX_FRAME_SCRATCH                   4
+
 #define PSB_SURFACE_DISPLAYING_F (0x1U<<0)
 #define PSB_SURFACE_IS_FLAG_SET(flags, mask) (((flags)& PSB_SURFACE_DISPLAYING_F) != 0)
 
@@ -191,6 +197,16 @@ struct psb_driver_data_s {
 
     drm_ipvr_bufmgr *bufmgr;
 
+    /* Idle BOs kept on the unused buffer lists, see psb__suspend_buffer */
+    unsigned int buffer_pool_budget;    /* bytes, 0 disables the pool */
+    unsigned int buffer_pool_size;      /* bytes currently pooled */
+    unsigned int buffer_pool_hits;      /* vaCreateBuffer served by a pooled BO */
+    unsigned int buffer_pool_misses;    /* vaCreateBuffer that allocated a BO */
+    unsigned int buffer_pool_busy;      /* pooled BOs passed over, not retired yet */
+    unsigned int buffer_pool_evictions; /* pooled BOs given back to libdrm_ipvr */
+
+    int decode_ahead; /* frames queued per VED submission */
+
     enum psb_output_method_t output_method;
 
     /*
@@ -332,6 +348,23 @@ struct object_context_s {
     unsigned char *format_data;
 
     ipvr_execbuffer_p execbuf;
+    /*
+     * Other threads flush the execbuf to reach a queued surface, see
+     * ved_surface_flush(). execbuf_mutex orders them with the frames
+     * built here, which are never submitted half built: from the first
+     * buffer a frame holds until it is queued the frame is open, and a
+     * flush asked for meanwhile waits for the frame's end.
+     */
+    pthread_mutex_t execbuf_mutex;
+    int frame_open;
+    int flush_pending;
+    /* Frames queued in the open execbuf and the surfaces they decode into */
+    int frames_queued;
+    object_surface_p queued_surfaces[PSB_MAX_DECODE_AHEAD];
+    uint32_t execbuf_seqno; /* bumped on every execbuf submission */
+    /* Scratch buffer tags of the open frame, moved along when it spills into the next execbuf */
+    uint32_t *frame_scratch[PSB_MAX_FRAME_SCRATCH];
+    int frame_scratch_count;
 
     int cmdbuf_current;
 
@@ -458,6 +491,9 @@ struct object_surface_s {
     void *rotate_vaddr;
     struct psb_surface_share_info_s *share_info;
     int is_ref_surface; /* If true, vaDeriveImage returns error */
+    object_context_p queued_context; /* decode queued but not submitted yet */
+    unsigned int verify_frame; /* decoded frame still to be checksummed, see psb__verify_surface() */
+    int verify_busy; /* being checksummed on the verify thread */
 };
 
 #define PSB_CODEDBUF_SLICE_NUM_MASK (0xff)
@@ -497,6 +533,7 @@ struct object_buffer_s {
     object_context_p context;
     VABufferType type;
     uint32_t last_used;
+    int pooled; /* on the unused list of its context */
 
     /* for VAEncCodedBufferType */
     VACodedBufferSegment codedbuf_mapinfo[PSB_CODEDBUF_SEGMENT_MAX];
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <dlfcn.h>
 
 #include <sys/ioctl.h>
@@ -48,6 +49,7 @@
 #include "psb_surface_ext.h"
 #include "psb_drv_debug.h"
 #include "pnw_rotate.h"
+#include "ved_execbuf.h"
 
 #define INIT_DRIVER_DATA        psb_driver_data_p driver_data = (psb_driver_data_p) ctx->pDriverData;
 
@@ -388,6 +390,9 @@ VAStatus psb_DeriveImage(
 
     CHECK_SURFACE(obj_surface);
     CHECK_INVALID_PARAM(image == NULL);
+    /* the image maps the surface buffer, the decode must be on its way */
+    if (ved_surface_flush(obj_surface) == -EBUSY)
+        return VA_STATUS_ERROR_SURFACE_BUSY;
     /* Can't derive image from reconstrued frame which is in tiled format */
     if (obj_surface->is_ref_surface == 1 || obj_surface->is_ref_surface == 2) {
 	if (getenv("PSB_VIDEO_IGNORE_TILED_FORMAT")) {
@@ -586,6 +591,8 @@ VAStatus psb_PutImage2(
 
     object_surface_p obj_surface = SURFACE(surface);
     CHECK_SURFACE(obj_surface);
+    if (ved_surface_flush(obj_surface) == -EBUSY)
+        return VA_STATUS_ERROR_SURFACE_BUSY;
 
     if (obj_image->image.format.fourcc != VA_FOURCC_NV12) {
         drv_debug_msg(VIDEO_DEBUG_ERROR, "target VAImage fourcc should be NV12 or IYUV\n");
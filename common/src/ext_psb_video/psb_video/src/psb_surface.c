@@ -190,19 +190,28 @@ VAStatus psb_surface_set_chroma(psb_surface_p psb_surface, int chroma)
  */
 void psb_surface_destroy(psb_surface_p psb_surface)
 {
+    if (psb_surface->fence) {
+        drm_ipvr_gem_bo_unreference(psb_surface->fence);
+        psb_surface->fence = NULL;
+    }
     drm_ipvr_gem_bo_unreference(psb_surface->buf);
 }
 
+/*
+ * Waits for the decode into the surface. Later frames may still read the
+ * surface as a reference, so wait for the submission that wrote it rather
+ * than for the surface buffer itself.
+ */
 VAStatus psb_surface_sync(psb_surface_p psb_surface)
 {
-    drm_ipvr_gem_bo_wait(psb_surface->buf);
+    drm_ipvr_gem_bo_wait(psb_surface->fence ? psb_surface->fence : psb_surface->buf);
     return VA_STATUS_SUCCESS;
 }
 
 VAStatus psb_surface_query_status(psb_surface_p psb_surface, VASurfaceStatus *status)
 {
     // query decode status in VED (not in I915 rendering side)
-    if (drm_ipvr_gem_bo_busy(psb_surface->buf))
+    if (drm_ipvr_gem_bo_busy(psb_surface->fence ? psb_surface->fence : psb_surface->buf))
         *status = VASurfaceRendering;
     else
         *status = VASurfaceReady;
@@ -58,6 +58,7 @@ typedef struct psb_surface_s *psb_surface_p;
 
 struct psb_surface_s {
     drm_ipvr_bo *buf;
+    drm_ipvr_bo *fence; /* control buffer of the submission that decoded into buf */
     drm_ipvr_bo *in_loop_buf;
     drm_ipvr_bo *ref_buf;
 
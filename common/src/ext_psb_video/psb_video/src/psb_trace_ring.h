@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Layout of the binary trace file written by psb_drv_debug.c and read by
+ * tools/psb_trace_decode.c. This header is shared by both, so it must not
+ * depend on anything but stdint.h.
+ *
+ * The file is mapped shared by the driver and written in place: a header,
+ * a table of event names, then one ring of records per thread. Each ring
+ * has a single writer, so records are published without locks: the
+ * writer fills a record, stores its sequence number and then advances
+ * the ring head. A reader copies a record and keeps it only if the
+ * sequence number still matches, which makes it safe to decode the file
+ * while the traced process is running.
+ *
+ * A thread gives its ring back when it exits and a later thread may take
+ * it over. The new owner sets "start" to the head it took the ring at
+ * before it sets "tid", so records from "start" on are the ones of "tid";
+ * a reader that sees either change during its copy starts over.
+ *
+ * A name table entry is claimed through "claimed", filled in, and then
+ * published by storing its key, so a reader that sees the key also sees
+ * the whole name.
+ */
+
+#ifndef _PSB_TRACE_RING_H_
+#define _PSB_TRACE_RING_H_
+
+#include <stdint.h>
+
+#define PSB_TRACE_MAGIC         "PSBTRING"
+#define PSB_TRACE_VERSION       2
+
+#define PSB_TRACE_RINGS         32      /* live threads beyond this are dropped */
+#define PSB_TRACE_RING_RECORDS  2048    /* power of two */
+#define PSB_TRACE_NAMES         256
+#define PSB_TRACE_NAME_LEN      52
+
+/* psb_trace_ring.state */
+#define PSB_TRACE_RING_FREE     0
+#define PSB_TRACE_RING_OWNED    1
+
+/* psb_trace_record.type */
+#define PSB_TRACE_ENTER         1
+#define PSB_TRACE_EXIT          2
+#define PSB_TRACE_MARK          3
+
+typedef struct psb_trace_record_s {
+    uint32_t seq;               /* record index + 1, once complete */
+    uint16_t event;             /* index into the name table */
+    uint8_t type;
+    uint8_t pad;
+    uint64_t timestamp;         /* CLOCK_MONOTONIC, ns */
+    uint32_t context_id;
+    uint32_t surface_id;
+    uint32_t args[4];
+} psb_trace_record;
+
+typedef struct psb_trace_name_s {
+    uint64_t key;               /* writer's string address, 0 until published */
+    uint32_t claimed;           /* set by the writer filling in the entry */
+    char name[PSB_TRACE_NAME_LEN];
+} psb_trace_name;
+
+typedef struct psb_trace_ring_s {
+    uint32_t tid;               /* current owner */
+    uint32_t state;
+    uint64_t head;              /* records written so far */
+    uint64_t start;             /* head when "tid" took the ring over */
+    uint64_t reserved[5];       /* keep the records off the head's line */
+    psb_trace_record records[PSB_TRACE_RING_RECORDS];
+} psb_trace_ring;
+
+typedef struct psb_trace_file_s {
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    uint32_t rings_used;
+    uint32_t rings_dropped;     /* threads that found no free ring */
+    uint32_t names_dropped;     /* events recorded without a name */
+    uint32_t rings_reused;      /* rings taken over from exited threads */
+    uint64_t reserved[4];
+    psb_trace_name names[PSB_TRACE_NAMES];
+    psb_trace_ring rings[PSB_TRACE_RINGS];
+} psb_trace_file;
+
+#endif /* _PSB_TRACE_RING_H_ */
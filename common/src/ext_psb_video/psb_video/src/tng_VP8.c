@@ -46,6 +46,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 
 #include "pnw_rotate.h"
 
@@ -242,6 +243,16 @@ const uint32_t	CABAC_LSR_CoefficientProb_Stride    = 12;
 const uint32_t	CABAC_LSR_CoefficientProb_Valid     = 11;
 const uint32_t CABAC_LSR_CoefficientProb_ToIdxMap[] = {0, 1, 2, 3, 4, 6, 0/*ignored value here*/, 5, 7, 8, 9, 10};
 
+/* Size of each probability data buffer and the lines it is uploaded in */
+#define VP8_PROBS_DATA_SIZE	1200
+#define VP8_PROBS_DWORDS	(VP8_PROBS_DATA_SIZE / 4)
+#define VP8_PROBS_LINE_DWORDS	16
+
+/* Layout held by context_VP8_s.probs_1st_part */
+#define VP8_PROBS_LAYOUT_NONE		0
+#define VP8_PROBS_LAYOUT_KEY_FRAME	1
+#define VP8_PROBS_LAYOUT_INTER_FRAME	2
+
 
 typedef enum
 {
@@ -328,6 +339,33 @@ struct context_VP8_s {
 
     drm_ipvr_bo     *intra_buffer;
 
+    /* Recycled sets of the buffers above, see tng__VP8_get_scratch() */
+    struct {
+        drm_ipvr_bo *cur_pic_buffer;
+        drm_ipvr_bo *buffer_1st_part;
+        drm_ipvr_bo *segID_buffer;
+        drm_ipvr_bo *MB_flags_buffer;
+        drm_ipvr_bo *probability_data_1st_part;
+        drm_ipvr_bo *probability_data_2nd_part;
+        drm_ipvr_bo *intra_buffer;
+        /* last contents of the probability buffers, valid if probs_valid */
+        uint32_t probs_1st_part[VP8_PROBS_DWORDS];
+        uint32_t probs_2nd_part[VP8_PROBS_DWORDS];
+        int probs_valid;
+    } scratch[VLD_DEC_SCRATCH_SLOTS];
+    uint32_t scratch_used[VLD_DEC_SCRATCH_SLOTS];
+    int scratch_slot;
+
+    /* picture commands are built here, see tng__VP8_process_slice_data() */
+    ved_cmd_template_t cmd_template;
+
+    /* Compiled probability tables, see tng__VP8_set_probility_reg() */
+    uint32_t probs_1st_part[VP8_PROBS_DWORDS];
+    uint32_t probs_1st_layout;
+    uint32_t probs_2nd_part[VP8_PROBS_DWORDS];
+    int probs_2nd_valid;
+    /* coefficient probabilities probs_2nd_part was compiled from */
+    uint8_t dct_coeff_probs[4][8][3][11];
 };
 
 typedef struct context_VP8_s	*context_VP8_p;
@@ -416,7 +454,7 @@ static VAStatus tng_VP8_ValidateConfig(
 
 static void tng_VP8_DestroyContext(object_context_p obj_context);
 
-static void tng__VP8_process_slice_data(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param);
+static VAStatus tng__VP8_process_slice_data(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param);
 static void tng__VP8_end_slice(context_DEC_p dec_ctx);
 static void tng__VP8_begin_slice(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param);
 static VAStatus tng_VP8_process_buffer(context_DEC_p dec_ctx, object_buffer_p buffer);
@@ -454,8 +492,8 @@ static VAStatus tng_VP8_CreateContext(
     ctx->segid_size = total_mbs / 4;      // 2 bits per MB
     ctx->segid_size = (ctx->segid_size + 0xfff) & ~0xfff;
     /* calculate the size of prbability buffer size for both the partitions */
-    ctx->probability_data_1st_part_size = 1200;
-    ctx->probability_data_2nd_part_size = 1200;
+    ctx->probability_data_1st_part_size = VP8_PROBS_DATA_SIZE;
+    ctx->probability_data_2nd_part_size = VP8_PROBS_DATA_SIZE;
 
     if (vaStatus == VA_STATUS_SUCCESS) {
         vaStatus = vld_dec_CreateContext(&ctx->dec_ctx, obj_context);
@@ -469,9 +507,15 @@ static VAStatus tng_VP8_CreateContext(
     return vaStatus;
 }
 
+static void tng__VP8_free_scratch(context_VP8_p ctx, int slot);
+
 static void tng_VP8_DestroyContext(
     object_context_p obj_context) {
     INIT_CONTEXT_VP8
+    int i;
+
+    for (i = 0; i < VLD_DEC_SCRATCH_SLOTS; i++)
+        tng__VP8_free_scratch(ctx, i);
 
     vld_dec_DestroyContext(&ctx->dec_ctx);
     if (ctx->pic_params) {
@@ -504,6 +548,7 @@ static void tng__VP8_trace_slc_params(VASliceParameterBufferVP8 *p) {
 
 static VAStatus tng__VP8_process_picture_param(context_VP8_p ctx, object_buffer_p obj_buffer) {
     psb_surface_p target_surface = ctx->obj_context->current_render_target->psb_surface;
+    int ret;
 
     ASSERT(obj_buffer->type == VAPictureParameterBufferType);
     ASSERT(obj_buffer->num_elements == 1);
@@ -569,6 +614,15 @@ static VAStatus tng__VP8_process_picture_param(context_VP8_p ctx, object_buffer_
         return VA_STATUS_ERROR_INVALID_SURFACE;
     }
 
+    /* references decoded by another context must be submitted before this frame */
+    ret = ved_context_depend_surface(ctx->obj_context, ctx->last_ref_picture);
+    if (!ret)
+        ret = ved_context_depend_surface(ctx->obj_context, ctx->golden_ref_picture);
+    if (!ret)
+        ret = ved_context_depend_surface(ctx->obj_context, ctx->alt_ref_picture);
+    if (ret)
+        return (ret == -EBUSY) ? VA_STATUS_ERROR_SURFACE_BUSY : VA_STATUS_ERROR_UNKNOWN;
+
     return VA_STATUS_SUCCESS;
 }
 
@@ -1152,13 +1206,29 @@ tng_InterFrame_MVContextProbsDataCompile(uint8_t* ui8_probs_to_write, uint32_t*
     }
 }
 
+/***********************************************************************************
+* Description        : Write one coefficient probability entry according to MSVDX setting.
+************************************************************************************/
+static void
+tng_DCT_Coefficient_ProbsEntryCompile(const Probability* ui8_probs_to_write, uint32_t* ui32_probs_buffer) {
+    uint32_t i, j = 0;
+
+    for (i =0 ; i < CABAC_LSR_CoefficientProb_Stride ; i += 4) {
+        *(ui32_probs_buffer + j++ ) =
+              (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i]]
+            | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+1]] << 8
+            | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+2]] << 16
+            | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+3]] << 24;
+    }
+}
+
 /***********************************************************************************
 * Description        : Write probability data in buffer according to MSVDX setting.
 ************************************************************************************/
 static void
-tng_DCT_Coefficient_ProbsDataCompile(Probability* ui8_probs_to_write, uint32_t* ui32_probs_buffer) {
+tng_DCT_Coefficient_ProbsDataCompile(const Probability* ui8_probs_to_write, uint32_t* ui32_probs_buffer) {
     uint32_t dim0, dim1, dim2;
-    uint32_t i, j, address;
+    uint32_t address;
     uint32_t src_tab_offset = 0;
 
     address = 0;
@@ -1166,15 +1236,8 @@ tng_DCT_Coefficient_ProbsDataCompile(Probability* ui8_probs_to_write, uint32_t*
     for(dim2 = 0; dim2 < 4; dim2++) {
         for(dim1 = 0; dim1 < 8; dim1++) {
             for(dim0 = 0; dim0 < 3; dim0++) { 
-                j =0;
-                for (i =0 ; i < CABAC_LSR_CoefficientProb_Stride ; i += 4) {
-                    *(ui32_probs_buffer + address + j++ ) =
-                          (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i] + src_tab_offset]
-                        | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+1] + src_tab_offset] << 8
-                        | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+2] + src_tab_offset] << 16
-                        | (uint32_t)ui8_probs_to_write[CABAC_LSR_CoefficientProb_ToIdxMap[i+3] + src_tab_offset] << 24;
-                    
-                }
+                tng_DCT_Coefficient_ProbsEntryCompile(ui8_probs_to_write + src_tab_offset,
+                                                      ui32_probs_buffer + address);
                 /* increment the address by the stride */
                 address +=  (CABAC_LSR_CoefficientProb_Stride >> 2);
                 /* increment source table offset */
@@ -1184,51 +1247,127 @@ tng_DCT_Coefficient_ProbsDataCompile(Probability* ui8_probs_to_write, uint32_t*
     }
 }
 
+/***********************************************************************************
+* Description        : Bring the cached first partition table up to date.
+************************************************************************************/
+static void tng__VP8_compile_probs_1st_part(context_VP8_p ctx) {
+    uint32_t *probs = ctx->probs_1st_part;
+
+    if(ctx->pic_params->pic_fields.bits.key_frame == 0) {
+        /* b_mode_prob is constant, so is the key frame table */
+        if (ctx->probs_1st_layout == VP8_PROBS_LAYOUT_KEY_FRAME)
+            return;
+        memset(probs, 0, sizeof(ctx->probs_1st_part));
+        tng_KeyFrame_BModeProbsDataCompile((const Probability*)b_mode_prob, probs);
+        ctx->probs_1st_layout = VP8_PROBS_LAYOUT_KEY_FRAME;
+        return;
+    }
+
+    if (ctx->probs_1st_layout != VP8_PROBS_LAYOUT_INTER_FRAME) {
+        memset(probs, 0, sizeof(ctx->probs_1st_part));
+        ctx->probs_1st_layout = VP8_PROBS_LAYOUT_INTER_FRAME;
+    }
+    /* a dozen dwords, cheaper to rebuild than to compare */
+    tng_InterFrame_YModeProbsDataCompile(ctx->pic_params->y_mode_probs, probs);
+
+    probs += ( CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
+    tng_InterFrame_UVModeProbsDataCompile(ctx->pic_params->uv_mode_probs, probs);
+
+    probs += (CABAC_LSR_InterFrame_MVContextProb_Address >>2) - ( CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
+    tng_InterFrame_MVContextProbsDataCompile((unsigned char*)ctx->pic_params->mv_probs, probs);
+}
+
+/***********************************************************************************
+* Description        : Bring the cached coefficient table up to date, recompiling
+*                      only the entries whose probabilities changed.
+************************************************************************************/
+static void tng__VP8_compile_probs_2nd_part(context_VP8_p ctx) {
+    const Probability *src = (const Probability *)ctx->probs_params->dct_coeff_probs;
+    const Probability *last = (const Probability *)ctx->dct_coeff_probs;
+    uint32_t n, address = 0, src_tab_offset = 0;
+
+    if (!ctx->probs_2nd_valid) {
+        memset(ctx->probs_2nd_part, 0, sizeof(ctx->probs_2nd_part));
+        tng_DCT_Coefficient_ProbsDataCompile(src, ctx->probs_2nd_part);
+        memcpy(ctx->dct_coeff_probs, src, sizeof(ctx->dct_coeff_probs));
+        ctx->probs_2nd_valid = 1;
+        return;
+    }
+
+    /* frames without coefficient updates are the common case */
+    if (!memcmp(last, src, sizeof(ctx->dct_coeff_probs)))
+        return;
+
+    for (n = 0; n < 4 * 8 * 3; n++) {
+        if (memcmp(last + src_tab_offset, src + src_tab_offset, CABAC_LSR_CoefficientProb_Valid))
+            tng_DCT_Coefficient_ProbsEntryCompile(src + src_tab_offset,
+                                                  ctx->probs_2nd_part + address);
+        address += (CABAC_LSR_CoefficientProb_Stride >> 2);
+        src_tab_offset += CABAC_LSR_CoefficientProb_Valid;
+    }
+    memcpy(ctx->dct_coeff_probs, src, sizeof(ctx->dct_coeff_probs));
+}
+
+/*
+ * Copy the lines of a compiled table that differ from what the buffer holds.
+ * The buffers are write-combined, so their last contents are kept in cached
+ * memory rather than read back, and the buffer is not mapped at all when
+ * nothing changed.
+ */
+static int tng__VP8_upload_probs(drm_ipvr_bo *bo, uint32_t *written,
+                                 const uint32_t *probs, int valid)
+{
+    uint32_t *dst = NULL;
+    uint32_t i, n;
+
+    for (i = 0; i < VP8_PROBS_DWORDS; i += VP8_PROBS_LINE_DWORDS) {
+        n = VP8_PROBS_DWORDS - i;
+        if (n > VP8_PROBS_LINE_DWORDS)
+            n = VP8_PROBS_LINE_DWORDS;
+        if (valid && !memcmp(written + i, probs + i, n * sizeof(uint32_t)))
+            continue;
+
+        if (NULL == dst) {
+            drm_ipvr_gem_bo_map(bo, 1);
+            dst = bo->virt;
+            if (NULL == dst)
+                return -1;
+        }
+        memcpy(dst + i, probs + i, n * sizeof(uint32_t));
+        memcpy(written + i, probs + i, n * sizeof(uint32_t));
+    }
+
+    if (dst)
+        drm_ipvr_gem_bo_unmap(bo);
+    return 0;
+}
+
 /***********************************************************************************
 * Description        : programme the DMA to send probability data.
 ************************************************************************************/
 static void tng__VP8_set_probility_reg(context_VP8_p ctx) {
     ipvr_execbuffer_p execbuf = ctx->obj_context->execbuf;
-    uint32_t *probs_buffer_1stPart , *probs_buffer_2ndPart;
+    int slot = ctx->scratch_slot;
 
     /* First write the data for the first partition */
-    /* Write the probability data in the probability data buffer */
-    drm_ipvr_gem_bo_map(ctx->probability_data_1st_part, 1);
-    probs_buffer_1stPart = ctx->probability_data_1st_part->virt;
-    if(NULL == probs_buffer_1stPart) {
+    tng__VP8_compile_probs_1st_part(ctx);
+    if (tng__VP8_upload_probs(ctx->probability_data_1st_part, ctx->scratch[slot].probs_1st_part,
+                              ctx->probs_1st_part, ctx->scratch[slot].probs_valid)) {
         drv_debug_msg(VIDEO_DEBUG_GENERAL, "tng__VP8_set_probility_reg: map buffer fail\n");
         return;
     }
-        memset(probs_buffer_1stPart, 0, ctx->probability_data_1st_part_size);
-        if(ctx->pic_params->pic_fields.bits.key_frame == 0) {
-            tng_KeyFrame_BModeProbsDataCompile((const Probability*)b_mode_prob, probs_buffer_1stPart);
-        } else {
-            tng_InterFrame_YModeProbsDataCompile(ctx->pic_params->y_mode_probs, probs_buffer_1stPart);
-
-            probs_buffer_1stPart += ( CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
-            tng_InterFrame_UVModeProbsDataCompile(ctx->pic_params->uv_mode_probs, probs_buffer_1stPart);
-
-            probs_buffer_1stPart += (CABAC_LSR_InterFrame_MVContextProb_Address >>2) - ( CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
-            tng_InterFrame_MVContextProbsDataCompile((unsigned char*)ctx->pic_params->mv_probs, probs_buffer_1stPart);
-        }
-        drm_ipvr_gem_bo_unmap(ctx->probability_data_1st_part);
-        ved_execbuf_dma_write_execbuf(execbuf, ctx->probability_data_1st_part, 0,
-                                    ctx->probability_data_1st_part_size, 0,
-                                    DMA_TYPE_PROBABILITY_DATA);
-    
-	/* Write the probability data for the second partition and create a linked list */
-	drm_ipvr_gem_bo_map(ctx->probability_data_2nd_part, 1);
-	probs_buffer_2ndPart = ctx->probability_data_2nd_part->virt;
-	if(NULL == probs_buffer_2ndPart) {
-	    drv_debug_msg(VIDEO_DEBUG_GENERAL, "tng__VP8_set_probility_reg: map buffer fail\n");
-	    return;
-	}
-
-        memset(probs_buffer_2ndPart, 0, ctx->probability_data_2nd_part_size);
-        /* for any other partition */
-        tng_DCT_Coefficient_ProbsDataCompile((Probability*)ctx->probs_params->dct_coeff_probs, probs_buffer_2ndPart);
-
-        drm_ipvr_gem_bo_unmap(ctx->probability_data_2nd_part);
+    ved_execbuf_dma_write_execbuf(execbuf, ctx->probability_data_1st_part, 0,
+                                ctx->probability_data_1st_part_size, 0,
+                                DMA_TYPE_PROBABILITY_DATA);
+
+    /* Write the probability data for the second partition and create a linked list */
+    tng__VP8_compile_probs_2nd_part(ctx);
+    if (tng__VP8_upload_probs(ctx->probability_data_2nd_part, ctx->scratch[slot].probs_2nd_part,
+                              ctx->probs_2nd_part, ctx->scratch[slot].probs_valid)) {
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "tng__VP8_set_probility_reg: map buffer fail\n");
+        return;
+    }
+    ctx->scratch[slot].probs_valid = 1;
 }
 
 static void tng__VP8_begin_slice(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param)
@@ -1241,10 +1380,13 @@ static void tng__VP8_begin_slice(context_DEC_p dec_ctx, VASliceParameterBufferBa
     /* dec_ctx->SR_flags = 0; */
 }
 
-static void tng__VP8_process_slice_data(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param)
+static VAStatus tng__VP8_process_slice_data(context_DEC_p dec_ctx, VASliceParameterBufferBase *vld_slice_param)
 {
     context_VP8_p ctx = (context_VP8_p)dec_ctx;
+    ipvr_execbuffer_p execbuf = ctx->obj_context->execbuf;
 
+    /* built in cached memory, then copied to the control buffer in one go */
+    ved_execbuf_template_begin(execbuf, &ctx->cmd_template);
     tng__CMDS_registers_write(ctx);
     tng__VP8_FE_Registers_Write(ctx);
     tng__VP8_BE_Registers_Write(ctx);
@@ -1253,6 +1395,12 @@ static void tng__VP8_process_slice_data(context_DEC_p dec_ctx, VASliceParameterB
     tng__VP8_set_target_picture(ctx);
     tng__VP8_set_reference_picture(ctx);
     tng__VP8_set_bool_coder_context(ctx);
+    /* nothing reached the execbuf, the picture cannot be decoded */
+    if (ved_execbuf_template_end(execbuf, &ctx->cmd_template)) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "%s: failed to write the picture commands\n", __func__);
+        return VA_STATUS_ERROR_UNKNOWN;
+    }
+    return VA_STATUS_SUCCESS;
 }
 
 static void tng__VP8_end_slice(context_DEC_p dec_ctx)
@@ -1268,113 +1416,171 @@ static void tng__VP8_end_slice(context_DEC_p dec_ctx)
     ctx->obj_context->last_mb = (*(ctx->dec_ctx.slice_first_pic_last) & 0xffff);
 }
 
-static VAStatus tng_VP8_BeginPicture(
-    object_context_p obj_context) {
-    INIT_CONTEXT_VP8
-
-    VAStatus st = VA_STATUS_ERROR_ALLOCATION_FAILED;
-    if (ctx->pic_params) {
-        free(ctx->pic_params);
-        ctx->pic_params = NULL;
-    }
+#define VP8_FREE_SCRATCH(bo) \
+    do { \
+        if (bo) { \
+            drm_ipvr_gem_bo_unreference(bo); \
+            bo = NULL; \
+        } \
+    } while (0)
 
-    if (ctx->probs_params) {
-        free(ctx->probs_params);
-        ctx->probs_params = NULL;
-    }
+static void tng__VP8_free_scratch(context_VP8_p ctx, int slot)
+{
+    VP8_FREE_SCRATCH(ctx->scratch[slot].cur_pic_buffer);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].buffer_1st_part);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].segID_buffer);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].MB_flags_buffer);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].probability_data_1st_part);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].probability_data_2nd_part);
+    VP8_FREE_SCRATCH(ctx->scratch[slot].intra_buffer);
+    ctx->scratch[slot].probs_valid = 0;
+}
 
-    if (ctx->iq_params) {
-        free(ctx->iq_params);
-        ctx->iq_params = NULL;
-    }
-    /* ctx->table_stats[VP8_VLC_NUM_TABLES-1].size = 16; */
-    ctx->slice_count = 0;
+static VAStatus tng__VP8_alloc_scratch(context_VP8_p ctx, int slot)
+{
+    drm_ipvr_bufmgr *bufmgr = ctx->obj_context->driver_data->bufmgr;
+    drm_ipvr_context *ipvr_ctx = ctx->obj_context->ipvr_ctx;
 
     /* Create mem resource for current picture macroblock data to be stored */
-    ctx->cur_pic_buffer = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-cur_pic_buffer", ctx->buffer_size,
-        0, IPVR_CACHE_UNCACHED);
-    if (!ctx->cur_pic_buffer)
+    ctx->scratch[slot].cur_pic_buffer = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-cur_pic_buffer", ctx->buffer_size, 0, IPVR_CACHE_UNCACHED);
+    if (!ctx->scratch[slot].cur_pic_buffer)
         goto err;
 
     /* Create mem resource for storing 1st partition .*/
-    ctx->buffer_1st_part = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-buffer_1st_part", ctx->buffer_size,
-        0, IPVR_CACHE_UNCACHED);
-    if (!ctx->buffer_1st_part)
+    ctx->scratch[slot].buffer_1st_part = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-buffer_1st_part", ctx->buffer_size, 0, IPVR_CACHE_UNCACHED);
+    if (!ctx->scratch[slot].buffer_1st_part)
         goto err;
 
-    ctx->segID_buffer = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-segID_buffer", ctx->segid_size, 0,
-        IPVR_CACHE_UNCACHED);
-    if (!ctx->segID_buffer)
+    ctx->scratch[slot].segID_buffer = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-segID_buffer", ctx->segid_size, 0, IPVR_CACHE_UNCACHED);
+    if (!ctx->scratch[slot].segID_buffer)
         goto err;
 
     /* Create mem resource for PIC MB Flags .*/
     /* one MB would take 2 bits to store Y2 flag and mb_skip_coeff flag, so size would be same as ui32segidsize */
-    ctx->MB_flags_buffer = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-MB_flags_buffer", ctx->segid_size, 0,
-        IPVR_CACHE_UNCACHED);
-    if (!ctx->MB_flags_buffer)
+    ctx->scratch[slot].MB_flags_buffer = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-MB_flags_buffer", ctx->segid_size, 0, IPVR_CACHE_UNCACHED);
+    if (!ctx->scratch[slot].MB_flags_buffer)
         goto err;
 
     /* allocate device memory for prbability table for the both the partitions.*/
-    ctx->probability_data_1st_part = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-probability_data_1st_part",
+    ctx->scratch[slot].probability_data_1st_part = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-probability_data_1st_part",
         ctx->probability_data_1st_part_size, 0, IPVR_CACHE_WRITECOMBINE);
-    if (!ctx->probability_data_1st_part)
+    if (!ctx->scratch[slot].probability_data_1st_part)
         goto err;
 
-    /* allocate device memory for prbability table for the both the partitions.*/
-    ctx->probability_data_2nd_part = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-probability_data_2nd_part",
+    ctx->scratch[slot].probability_data_2nd_part = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-probability_data_2nd_part",
         ctx->probability_data_2nd_part_size, 0, IPVR_CACHE_WRITECOMBINE);
-    if (!ctx->probability_data_2nd_part)
+    if (!ctx->scratch[slot].probability_data_2nd_part)
         goto err;
 
-    ctx->intra_buffer = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-VP8-intra_buffer", INTRA_BUFFER_SIZE,
-        0, IPVR_CACHE_UNCACHED);
-    if (!ctx->intra_buffer)
+    ctx->scratch[slot].intra_buffer = drm_ipvr_gem_bo_alloc(bufmgr, ipvr_ctx,
+        "VED-VP8-intra_buffer", INTRA_BUFFER_SIZE, 0, IPVR_CACHE_UNCACHED);
+    if (!ctx->scratch[slot].intra_buffer)
         goto err;
 
-    st = vld_dec_BeginPicture(&ctx->dec_ctx, obj_context);
-    if (st != VA_STATUS_SUCCESS)
-        goto err;
-
-    ctx->dec_ctx.preload_buffer = ctx->probability_data_2nd_part;
     return VA_STATUS_SUCCESS;
 err:
-    if (ctx->cur_pic_buffer) {
-        drm_ipvr_gem_bo_unreference(ctx->cur_pic_buffer);
-        ctx->cur_pic_buffer = NULL;
-    }
-    if (ctx->buffer_1st_part) {
-        drm_ipvr_gem_bo_unreference(ctx->buffer_1st_part);
-        ctx->buffer_1st_part = NULL;
-    }
-    if (ctx->segID_buffer) {
-        drm_ipvr_gem_bo_unreference(ctx->segID_buffer);
-        ctx->segID_buffer = NULL;
+    tng__VP8_free_scratch(ctx, slot);
+    return VA_STATUS_ERROR_ALLOCATION_FAILED;
+}
+
+/*
+ * Hand out a set of per-picture buffers, reusing one the VED has finished
+ * with. All buffers of a set go out in the same execbuffer, so the set is
+ * idle when its cur_pic_buffer is.
+ */
+static VAStatus tng__VP8_get_scratch(context_VP8_p ctx)
+{
+    drm_ipvr_bo *bufs[VLD_DEC_SCRATCH_SLOTS];
+    VAStatus st;
+    int i, slot;
+
+    for (i = 0; i < VLD_DEC_SCRATCH_SLOTS; i++)
+        bufs[i] = ctx->scratch[i].cur_pic_buffer;
+    slot = vld_dec_pick_scratch_slot(ctx->obj_context, bufs, ctx->scratch_used,
+        VLD_DEC_SCRATCH_SLOTS);
+
+    if (ctx->scratch[slot].cur_pic_buffer &&
+        ctx->scratch[slot].cur_pic_buffer->size < ctx->buffer_size)
+        tng__VP8_free_scratch(ctx, slot);
+
+    if (!ctx->scratch[slot].cur_pic_buffer) {
+        st = tng__VP8_alloc_scratch(ctx, slot);
+        if (st != VA_STATUS_SUCCESS)
+            return st;
+    } else {
+        /* a fresh segment map reads as all zero, keep it that way */
+        drm_ipvr_gem_bo_map(ctx->scratch[slot].segID_buffer, 1);
+        if (ctx->scratch[slot].segID_buffer->virt) {
+            memset(ctx->scratch[slot].segID_buffer->virt, 0, ctx->segid_size);
+            drm_ipvr_gem_bo_unmap(ctx->scratch[slot].segID_buffer);
+        }
     }
-    if (ctx->MB_flags_buffer) {
-        drm_ipvr_gem_bo_unreference(ctx->MB_flags_buffer);
-        ctx->MB_flags_buffer = NULL;
+    ved_context_hold_scratch(ctx->obj_context, &ctx->scratch_used[slot]);
+    ctx->scratch_slot = slot;
+
+    ctx->cur_pic_buffer = ctx->scratch[slot].cur_pic_buffer;
+    ctx->buffer_1st_part = ctx->scratch[slot].buffer_1st_part;
+    ctx->segID_buffer = ctx->scratch[slot].segID_buffer;
+    ctx->MB_flags_buffer = ctx->scratch[slot].MB_flags_buffer;
+    ctx->probability_data_1st_part = ctx->scratch[slot].probability_data_1st_part;
+    ctx->probability_data_2nd_part = ctx->scratch[slot].probability_data_2nd_part;
+    ctx->intra_buffer = ctx->scratch[slot].intra_buffer;
+    return VA_STATUS_SUCCESS;
+}
+
+static void tng__VP8_put_scratch(context_VP8_p ctx)
+{
+    /* the buffers stay in ctx->scratch for a later picture */
+    ctx->cur_pic_buffer = NULL;
+    ctx->buffer_1st_part = NULL;
+    ctx->segID_buffer = NULL;
+    ctx->MB_flags_buffer = NULL;
+    ctx->probability_data_1st_part = NULL;
+    ctx->probability_data_2nd_part = NULL;
+    ctx->intra_buffer = NULL;
+    ctx->dec_ctx.preload_buffer = NULL;
+}
+
+static VAStatus tng_VP8_BeginPicture(
+    object_context_p obj_context) {
+    INIT_CONTEXT_VP8
+
+    VAStatus st;
+    if (ctx->pic_params) {
+        free(ctx->pic_params);
+        ctx->pic_params = NULL;
     }
-    if (ctx->probability_data_1st_part) {
-        drm_ipvr_gem_bo_unreference(ctx->probability_data_1st_part);
-        ctx->probability_data_1st_part = NULL;
+
+    if (ctx->probs_params) {
+        free(ctx->probs_params);
+        ctx->probs_params = NULL;
     }
-    if (ctx->probability_data_2nd_part) {
-        drm_ipvr_gem_bo_unreference(ctx->probability_data_2nd_part);
-        ctx->probability_data_2nd_part = NULL;
+
+    if (ctx->iq_params) {
+        free(ctx->iq_params);
+        ctx->iq_params = NULL;
     }
-    if (ctx->intra_buffer) {
-        drm_ipvr_gem_bo_unreference(ctx->intra_buffer);
-        ctx->intra_buffer = NULL;
+    /* ctx->table_stats[VP8_VLC_NUM_TABLES-1].size = 16; */
+    ctx->slice_count = 0;
+
+    st = tng__VP8_get_scratch(ctx);
+    if (st != VA_STATUS_SUCCESS)
+        return st;
+
+    st = vld_dec_BeginPicture(&ctx->dec_ctx, obj_context);
+    if (st != VA_STATUS_SUCCESS) {
+        tng__VP8_put_scratch(ctx);
+        return st;
     }
-    ctx->dec_ctx.preload_buffer = NULL;
-    return st;
+
+    ctx->dec_ctx.preload_buffer = ctx->probability_data_2nd_part;
+    return VA_STATUS_SUCCESS;
 }
 
 #ifdef PSBVIDEO_MSVDX_EC
@@ -1474,25 +1680,11 @@ static VAStatus tng_VP8_EndPicture(
     }
 #endif
 
-	if (ipvr_execbuffer_run(obj_context->execbuf)) {
+	if (ved_context_queue_frame(obj_context)) {
         return VA_STATUS_ERROR_UNKNOWN;
     }
     vld_dec_EndPicture(&ctx->dec_ctx);
-    drm_ipvr_gem_bo_unreference(ctx->cur_pic_buffer);
-    drm_ipvr_gem_bo_unreference(ctx->buffer_1st_part);
-    drm_ipvr_gem_bo_unreference(ctx->segID_buffer);
-    drm_ipvr_gem_bo_unreference(ctx->MB_flags_buffer);
-    drm_ipvr_gem_bo_unreference(ctx->probability_data_1st_part);
-    drm_ipvr_gem_bo_unreference(ctx->probability_data_2nd_part);
-    drm_ipvr_gem_bo_unreference(ctx->intra_buffer);
-    ctx->cur_pic_buffer = NULL;
-    ctx->buffer_1st_part = NULL;
-    ctx->segID_buffer = NULL;
-    ctx->MB_flags_buffer = NULL;
-    ctx->probability_data_1st_part = NULL;
-    ctx->probability_data_2nd_part = NULL;
-    ctx->intra_buffer = NULL;
-    ctx->dec_ctx.preload_buffer = NULL;
+    tng__VP8_put_scratch(ctx);
 
     if (ctx->pic_params) {
         free(ctx->pic_params);
@@ -250,7 +250,12 @@ VAStatus vld_dec_process_slice(context_DEC_p ctx,
             ASSERT(ctx->split_buffer_pending);
         }
 
-        ctx->process_slice(ctx, slice_param);
+        vaStatus = ctx->process_slice(ctx, slice_param);
+        if (vaStatus != VA_STATUS_SUCCESS) {
+            ctx->split_buffer_pending = FALSE;
+            DEBUG_FAILURE;
+            return vaStatus;
+        }
         vld_dec_write_kick(ctx->obj_context);
 
         ctx->split_buffer_pending = FALSE;
@@ -267,8 +272,8 @@ VAStatus vld_dec_process_slice(context_DEC_p ctx,
             vaStatus = VA_STATUS_ERROR_UNKNOWN;
         }
         if (ipvr_execbuffer_full(ctx->obj_context->execbuf)) {
-            ipvr_execbuffer_run(ctx->obj_context->execbuf);
-            ipvr_execbuffer_put(ctx->obj_context->execbuf);
+            /* the rest of the frame goes on in the next execbuf, its scratch buffers are tagged with that one */
+            ved_context_flush_execbuf(ctx->obj_context);
             if (ved_context_get_execbuf(ctx->obj_context)) {
                 vaStatus = VA_STATUS_ERROR_UNKNOWN;
                 DEBUG_FAILURE;
@@ -337,16 +342,56 @@ drm_ipvr_bo* vld_dec_lookup_colocated_buffer(context_DEC_p ctx, psb_surface_p su
     return ctx->colocated_buffers[index-1]; /* 0 means unset, index is offset by 1 */
 }
 
+/*
+ * Choose which of count scratch slots the next picture uses. bufs[i] is a
+ * buffer of slot i, NULL if the slot was never filled, and used[i] the
+ * execbuf_seqno of the execbuf its picture went into. An idle slot is
+ * preferred, then an empty one; otherwise wait for the least recently used
+ * slot to go idle. A slot of the execbuf still open is not busy yet, but in
+ * use all the same.
+ */
+int vld_dec_pick_scratch_slot(object_context_p obj_context, drm_ipvr_bo **bufs, uint32_t *used, int count)
+{
+    int i, empty = -1, oldest = 0;
+
+    for (i = 0; i < count; i++) {
+        if (!bufs[i]) {
+            if (empty < 0)
+                empty = i;
+            continue;
+        }
+        if (used[i] != obj_context->execbuf_seqno && !drm_ipvr_gem_bo_busy(bufs[i]))
+            return i;
+        if ((int32_t)(used[i] - used[oldest]) < 0 || !bufs[oldest])
+            oldest = i;
+    }
+    if (empty >= 0)
+        return empty;
+
+    if (used[oldest] == obj_context->execbuf_seqno)
+        ved_context_flush_execbuf(obj_context);
+    drm_ipvr_gem_bo_wait(bufs[oldest]);
+    return oldest;
+}
+
 VAStatus vld_dec_BeginPicture(
     context_DEC_p ctx, object_context_p obj_context)
 {
-    int ret;
-    ctx->aux_line_buffer_vld = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
-        ctx->obj_context->ipvr_ctx, "VED-aux_line_buffer_vld",
-        AUX_LINE_BUFFER_VLD_SIZE, 0, IPVR_CACHE_UNCACHED);
-    if (!ctx->aux_line_buffer_vld) {
-        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    int ret, slot;
+
+    slot = vld_dec_pick_scratch_slot(obj_context, ctx->aux_line_buffers,
+        ctx->aux_line_buffers_used, VLD_DEC_SCRATCH_SLOTS);
+    if (!ctx->aux_line_buffers[slot]) {
+        ctx->aux_line_buffers[slot] = drm_ipvr_gem_bo_alloc(obj_context->driver_data->bufmgr,
+            ctx->obj_context->ipvr_ctx, "VED-aux_line_buffer_vld",
+            AUX_LINE_BUFFER_VLD_SIZE, 0, IPVR_CACHE_UNCACHED);
+        if (!ctx->aux_line_buffers[slot]) {
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        }
     }
+    ved_context_hold_scratch(obj_context, &ctx->aux_line_buffers_used[slot]);
+    ctx->aux_line_buffer_vld = ctx->aux_line_buffers[slot];
+
     ret = ved_context_get_execbuf(obj_context);
     if (ret) {
         return VA_STATUS_ERROR_HW_BUSY;
@@ -357,9 +402,9 @@ VAStatus vld_dec_BeginPicture(
 VAStatus vld_dec_EndPicture(
     context_DEC_p ctx)
 {
-    ipvr_execbuffer_put(ctx->obj_context->execbuf);
-    if (ctx->aux_line_buffer_vld)
-        drm_ipvr_gem_bo_unreference(ctx->aux_line_buffer_vld);
+    /* the execbuf was submitted or stays open with the frame queued */
+    /* stays in aux_line_buffers for a later picture */
+    ctx->aux_line_buffer_vld = NULL;
     return VA_STATUS_SUCCESS;
 }
 
@@ -430,6 +475,14 @@ void vld_dec_DestroyContext(context_DEC_p ctx)
         free(ctx->colocated_buffers);
         ctx->colocated_buffers = NULL;
     }
+
+    for (i = 0; i < VLD_DEC_SCRATCH_SLOTS; ++i) {
+        if (ctx->aux_line_buffers[i]) {
+            drm_ipvr_gem_bo_unreference(ctx->aux_line_buffers[i]);
+            ctx->aux_line_buffers[i] = NULL;
+        }
+    }
+    ctx->aux_line_buffer_vld = NULL;
     ipvr_execbuffer_put(obj_context->execbuf);
 
     free(obj_context->execbuf);
@@ -33,6 +33,14 @@
 #include <img_types.h>
 #include "ved_execbuf.h"
 
+/*
+ * Per-picture scratch buffers are recycled from a small per-context ring;
+ * a slot is reused once the VED has finished the picture it last went
+ * out with. With decode ahead one execbuf full of pictures runs while the
+ * next one is built.
+ */
+#define VLD_DEC_SCRATCH_SLOTS           (2 * PSB_MAX_DECODE_AHEAD + 1)
+
 struct context_DEC_s {
     object_context_p obj_context; /* back reference */
 
@@ -60,13 +68,16 @@ struct context_DEC_s {
     unsigned int SR_flags;
 
     void (*begin_slice)(struct context_DEC_s *, VASliceParameterBufferBase *);
-    void (*process_slice)(struct context_DEC_s *, VASliceParameterBufferBase *);
+    VAStatus (*process_slice)(struct context_DEC_s *, VASliceParameterBufferBase *);
     void (*end_slice)(struct context_DEC_s *);
     VAStatus (*process_buffer)(struct context_DEC_s *, object_buffer_p);
 
     drm_ipvr_bo **colocated_buffers;
     int colocated_buffers_size;
     int colocated_buffers_idx;
+
+    drm_ipvr_bo *aux_line_buffers[VLD_DEC_SCRATCH_SLOTS];
+    uint32_t aux_line_buffers_used[VLD_DEC_SCRATCH_SLOTS];
     context_yuv_processor_p yuv_ctx;
 #ifdef SLICE_HEADER_PARSING
     uint32_t parse_enabled;
@@ -87,6 +98,7 @@ void vld_dec_setup_alternative_frame(object_context_p);
 VAStatus vld_dec_process_slice_data(context_DEC_p, object_buffer_p);
 VAStatus vld_dec_add_slice_param(context_DEC_p, object_buffer_p);
 VAStatus vld_dec_allocate_colocated_buffer(context_DEC_p, object_surface_p, uint32_t);
+int vld_dec_pick_scratch_slot(object_context_p, drm_ipvr_bo **, uint32_t *, int);
 VAStatus vld_dec_BeginPicture(context_DEC_p, object_context_p);
 VAStatus vld_dec_EndPicture(context_DEC_p);
 VAStatus vld_dec_CreateContext(context_DEC_p, object_context_p);
@@ -324,7 +324,7 @@ static VAStatus tng_yuv_processor_EndPicture(
     context_DEC_p dec_ctx = (context_DEC_p) obj_context->format_data;
     context_yuv_processor_p ctx = dec_ctx->yuv_ctx;
 
-    if (ipvr_execbuffer_run(obj_context->execbuf)) {
+    if (ved_context_queue_frame(obj_context)) {
         return VA_STATUS_ERROR_UNKNOWN;
     }
 
@@ -27,6 +27,7 @@
  *
  */
 #include "ved_execbuf.h"
+#include "psb_surface.h"
 #include <unistd.h>
 #include <stdio.h>
 
@@ -83,6 +84,9 @@ typedef struct ved_execbuf_private_s {
 
     uint16_t *last_decode_flags;
 
+    /* Template the commands are built in, NULL when they go to the execbuf */
+    ved_cmd_template_p tmpl;
+
     unsigned long cur_offset;
     unsigned long start_offset;
 } ved_execbuf_private_t, *ved_execbuf_private_p;
@@ -111,10 +115,17 @@ int ved_context_get_execbuf(object_context_p obj_context)
     if (!obj_context->execbuf)
         return -EINVAL;
 
-    ASSERT(!obj_context->execbuf->valid);
-
-    ret = ved_execbuffer_get(obj_context->driver_data->bufmgr, obj_context->ipvr_ctx,
-        obj_context->execbuf, "VED-CtrlAlloc", CMD_SIZE);
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    obj_context->frame_open = 1;
+    /* Still open with queued frames, the next frame goes behind them */
+    if (obj_context->execbuf->valid) {
+        ASSERT(obj_context->frames_queued);
+        ret = 0;
+    } else {
+        ret = ved_execbuffer_get(obj_context->driver_data->bufmgr, obj_context->ipvr_ctx,
+            obj_context->execbuf, "VED-CtrlAlloc", CMD_SIZE);
+    }
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
 
     return ret;
 }
@@ -461,6 +472,78 @@ void ved_execbuf_skip_end_block(ipvr_execbuffer_p execbuf)
 }
 
 
+static int
+ved__template_reloc(ipvr_execbuffer_p execbuf, drm_ipvr_bo *target_bo,
+    unsigned long offset, unsigned long delta, uint32_t flags)
+{
+    ved_execbuf_private_p execbuf_priv = (ved_execbuf_private_p)execbuf->priv;
+    ved_cmd_template_p tmpl = execbuf_priv->tmpl;
+
+    if (tmpl->num_relocs == VED_CMD_TEMPLATE_RELOCS || offset + 4 > VED_CMD_TEMPLATE_SIZE) {
+        tmpl->error = -ENOMEM;
+        return -ENOMEM;
+    }
+    tmpl->relocs[tmpl->num_relocs].bo = target_bo;
+    tmpl->relocs[tmpl->num_relocs].offset = offset;
+    tmpl->relocs[tmpl->num_relocs].delta = delta;
+    tmpl->relocs[tmpl->num_relocs].flags = flags;
+    tmpl->num_relocs++;
+    *(uint32_t*)(execbuf->vaddr + offset) = target_bo->offset + delta;
+    return 0;
+}
+
+void ved_execbuf_template_begin(ipvr_execbuffer_p execbuf, ved_cmd_template_p tmpl)
+{
+    ved_execbuf_private_p execbuf_priv = (ved_execbuf_private_p)execbuf->priv;
+    ASSERT(NULL == execbuf_priv->tmpl);
+
+    tmpl->vaddr = execbuf->vaddr;
+    tmpl->cur_offset = execbuf->cur_offset;
+    tmpl->reloc = execbuf->reloc;
+    tmpl->num_relocs = 0;
+    tmpl->error = 0;
+
+    execbuf->vaddr = (unsigned char *)tmpl->cmds;
+    execbuf->cur_offset = 0;
+    execbuf->reloc = ved__template_reloc;
+    execbuf_priv->tmpl = tmpl;
+}
+
+int ved_execbuf_template_end(ipvr_execbuffer_p execbuf, ved_cmd_template_p tmpl)
+{
+    ved_execbuf_private_p execbuf_priv = (ved_execbuf_private_p)execbuf->priv;
+    unsigned long size = execbuf->cur_offset;
+    int i, ret;
+
+    ASSERT(tmpl == execbuf_priv->tmpl);
+    ASSERT(NULL == execbuf_priv->rendec_chunk_start);
+    ASSERT(NULL == execbuf_priv->skip_block_start);
+
+    execbuf->vaddr = tmpl->vaddr;
+    execbuf->cur_offset = tmpl->cur_offset;
+    execbuf->reloc = tmpl->reloc;
+    execbuf_priv->tmpl = NULL;
+
+    if (tmpl->error || size > VED_CMD_TEMPLATE_SIZE ||
+        execbuf->cur_offset + size > execbuf->bo->size) {
+        drv_debug_msg(VIDEO_DEBUG_ERROR, "%s: %lu bytes with %d relocations do not fit\n",
+            __func__, size, tmpl->num_relocs);
+        return -ENOMEM;
+    }
+
+    memcpy(execbuf->vaddr + execbuf->cur_offset, tmpl->cmds, size);
+    for (i = 0; i < tmpl->num_relocs; i++) {
+        ret = execbuf->reloc(execbuf, tmpl->relocs[i].bo,
+            execbuf->cur_offset + tmpl->relocs[i].offset,
+            tmpl->relocs[i].delta, tmpl->relocs[i].flags);
+        if (ret)
+            return ret;
+    }
+    execbuf->cur_offset += size;
+    return 0;
+}
+
+
 static void
 ved__execbuffer_put(ipvr_execbuffer_p execbuf)
 {
@@ -470,6 +553,7 @@ ved__execbuffer_put(ipvr_execbuffer_p execbuf)
         drm_ipvr_gem_bo_unreference(execbuf_priv->bo);
         execbuf_priv->bo = NULL;
     }
+    free(execbuf_priv);
     if (execbuf->bo) {
         drm_ipvr_gem_bo_unmap(execbuf->bo);
         drm_ipvr_gem_bo_unreference(execbuf->bo);
@@ -526,6 +610,188 @@ ved__execbuffer_run(ipvr_execbuffer_p execbuf)
     return ret;
 }
 
+/*
+ * A frame open across the flush goes on in the next execbuf: the scratch
+ * buffers it holds and the buffers released while it was built are in use
+ * until that one is retired
+ */
+static void ved__context_retag_frame(object_context_p obj_context, uint32_t from)
+{
+    object_buffer_p obj_buffer;
+    int i;
+
+    for (i = 0; i < obj_context->frame_scratch_count; i++) {
+        if (*obj_context->frame_scratch[i] == from)
+            *obj_context->frame_scratch[i] = obj_context->execbuf_seqno;
+    }
+    for (i = 0; i < PSB_MAX_BUFFERTYPES; i++) {
+        for (obj_buffer = obj_context->buffers_unused[i]; obj_buffer; obj_buffer = obj_buffer->ptr_next) {
+            if (obj_buffer->last_used == from)
+                obj_buffer->last_used = obj_context->execbuf_seqno;
+        }
+    }
+}
+
+/* Submits the open execbuf, with execbuf_mutex held */
+static int ved__context_flush_locked(object_context_p obj_context)
+{
+    ipvr_execbuffer_p execbuf = obj_context->execbuf;
+    psb_surface_p psb_surface;
+    int i, ret;
+
+    obj_context->flush_pending = 0;
+    if (!execbuf || !execbuf->valid)
+        return 0;
+
+    ret = ipvr_execbuffer_run(execbuf);
+
+    /*
+     * All frames of one submission complete together, the control buffer
+     * goes idle with them while the surfaces may still be read as
+     * references by later submissions
+     */
+    for (i = 0; i < obj_context->frames_queued; i++) {
+        if (!obj_context->queued_surfaces[i])
+            continue;
+        psb_surface = obj_context->queued_surfaces[i]->psb_surface;
+        drm_ipvr_gem_bo_reference(execbuf->bo);
+        if (psb_surface->fence)
+            drm_ipvr_gem_bo_unreference(psb_surface->fence);
+        psb_surface->fence = execbuf->bo;
+        /* publishes the fence to threads that find the surface unqueued */
+        __atomic_store_n(&obj_context->queued_surfaces[i]->queued_context, NULL, __ATOMIC_RELEASE);
+        obj_context->queued_surfaces[i] = NULL;
+    }
+    obj_context->frames_queued = 0;
+    obj_context->execbuf_seqno++;
+    if (obj_context->frame_open)
+        ved__context_retag_frame(obj_context, obj_context->execbuf_seqno - 1);
+
+    ipvr_execbuffer_put(execbuf);
+    return ret;
+}
+
+int ved_context_flush_execbuf(object_context_p obj_context)
+{
+    int ret;
+
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    ret = ved__context_flush_locked(obj_context);
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+    return ret;
+}
+
+void ved_context_hold_scratch(object_context_p obj_context, uint32_t *used)
+{
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    obj_context->frame_open = 1;
+    *used = obj_context->execbuf_seqno;
+    ASSERT(obj_context->frame_scratch_count < PSB_MAX_FRAME_SCRATCH);
+    if (obj_context->frame_scratch_count < PSB_MAX_FRAME_SCRATCH)
+        obj_context->frame_scratch[obj_context->frame_scratch_count++] = used;
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+}
+
+/* Closes the frame being built, with execbuf_mutex held */
+static void ved__context_close_frame(object_context_p obj_context)
+{
+    obj_context->frame_open = 0;
+    obj_context->frame_scratch_count = 0;
+}
+
+int ved_context_queue_frame(object_context_p obj_context)
+{
+    object_surface_p obj_surface = obj_context->current_render_target;
+    int ret = 0;
+
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    ved__context_close_frame(obj_context);
+    if (!obj_context->execbuf || !obj_context->execbuf->valid) {
+        pthread_mutex_unlock(&obj_context->execbuf_mutex);
+        return -EINVAL;
+    }
+
+    ASSERT(obj_context->frames_queued < PSB_MAX_DECODE_AHEAD);
+    obj_context->queued_surfaces[obj_context->frames_queued++] = obj_surface;
+    if (obj_surface)
+        __atomic_store_n(&obj_surface->queued_context, obj_context, __ATOMIC_RELEASE);
+
+    if (obj_context->frames_queued >= obj_context->driver_data->decode_ahead ||
+        obj_context->flush_pending || ipvr_execbuffer_full(obj_context->execbuf))
+        ret = ved__context_flush_locked(obj_context);
+    else
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: %d frames queued\n", __func__, obj_context->frames_queued);
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+    return ret;
+}
+
+void ved_context_end_frame(object_context_p obj_context)
+{
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    ved__context_close_frame(obj_context);
+    if (obj_context->flush_pending)
+        ved__context_flush_locked(obj_context);
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+}
+
+/*
+ * Submits the execbuf "obj_surface" is queued in from outside the thread
+ * building its context's frames. A frame in the middle of being built is
+ * never submitted: the flush is left to the frame's end.
+ */
+static int ved__surface_flush_queued(object_surface_p obj_surface)
+{
+    object_context_p obj_context = __atomic_load_n(&obj_surface->queued_context, __ATOMIC_ACQUIRE);
+    int ret = 0;
+
+    if (!obj_context)
+        return 0;
+
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    /* submitted meanwhile */
+    if (obj_surface->queued_context != obj_context)
+        ret = 0;
+    else if (obj_context->frame_open) {
+        drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s: context %08x is mid-frame, flush deferred\n",
+            __func__, obj_context->context_id);
+        obj_context->flush_pending = 1;
+        ret = -EBUSY;
+    } else
+        ret = ved__context_flush_locked(obj_context);
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+    return ret;
+}
+
+int ved_context_depend_surface(object_context_p obj_context, object_surface_p obj_surface)
+{
+    if (!obj_surface ||
+        __atomic_load_n(&obj_surface->queued_context, __ATOMIC_ACQUIRE) == obj_context)
+        return 0;
+    return ved__surface_flush_queued(obj_surface);
+}
+
+int ved_surface_flush(object_surface_p obj_surface)
+{
+    return ved__surface_flush_queued(obj_surface);
+}
+
+void ved_surface_unqueue(object_surface_p obj_surface)
+{
+    object_context_p obj_context = __atomic_load_n(&obj_surface->queued_context, __ATOMIC_ACQUIRE);
+    int i;
+
+    if (!obj_context)
+        return;
+
+    pthread_mutex_lock(&obj_context->execbuf_mutex);
+    for (i = 0; i < obj_context->frames_queued; i++) {
+        if (obj_context->queued_surfaces[i] == obj_surface)
+            obj_context->queued_surfaces[i] = NULL;
+    }
+    __atomic_store_n(&obj_surface->queued_context, NULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&obj_context->execbuf_mutex);
+}
+
 static int ved_execbuffer_get(drm_ipvr_bufmgr *bufmgr, drm_ipvr_context *ctx,
                  ipvr_execbuffer_p execbuf, const char *name,
                  size_t buf_size)
@@ -535,18 +801,24 @@ static int ved_execbuffer_get(drm_ipvr_bufmgr *bufmgr, drm_ipvr_context *ctx,
     if (ret) {
         return -ENOMEM;
     }
-    static ved_execbuf_private_t execbuf_priv;
-    memset(&execbuf_priv, 0, sizeof(execbuf_priv));
-    execbuf_priv.bo = drm_ipvr_gem_bo_alloc(bufmgr, ctx, "VED-MtxMessage",
+    /* one per execbuf: execbufs of several contexts can be open at once */
+    ved_execbuf_private_p execbuf_priv = calloc(1, sizeof(*execbuf_priv));
+    if (!execbuf_priv) {
+        ipvr_execbuffer_put(execbuf);
+        return -ENOMEM;
+    }
+    execbuf_priv->bo = drm_ipvr_gem_bo_alloc(bufmgr, ctx, "VED-MtxMessage",
         MTXMSG_SIZE, 0, IPVR_CACHE_WRITECOMBINE);
-    if (!execbuf_priv.bo) {
+    if (!execbuf_priv->bo) {
+        free(execbuf_priv);
         ipvr_execbuffer_put(execbuf);
         drv_debug_msg(VIDEO_DEBUG_ERROR, "%s failed to allocate CMD buf\n", __func__);
         return -ENOMEM;
     }
-    ret = drm_ipvr_gem_bo_map(execbuf_priv.bo, 1);
+    ret = drm_ipvr_gem_bo_map(execbuf_priv->bo, 1);
     if (ret) {
-        drm_ipvr_gem_bo_unreference(execbuf_priv.bo);
+        drm_ipvr_gem_bo_unreference(execbuf_priv->bo);
+        free(execbuf_priv);
         ipvr_execbuffer_put(execbuf);
         drv_debug_msg(VIDEO_DEBUG_ERROR, "%s failed to map CMD buf\n", __func__);
         return -ENOMEM;
@@ -559,9 +831,9 @@ static int ved_execbuffer_get(drm_ipvr_bufmgr *bufmgr, drm_ipvr_context *ctx,
     execbuf->full = ved__execbuffer_full;
     execbuf->ready = ved__execbuffer_ready;
     execbuf->add_command = ved__execbuffer_add_command;
-    execbuf->priv = &execbuf_priv;
+    execbuf->priv = execbuf_priv;
     drv_debug_msg(VIDEO_DEBUG_GENERAL, "%s got cmd %p, mtxmsg %p, ctx %u\n",
-        __func__, execbuf->vaddr, execbuf_priv.bo->virt, execbuf->ctx->ctx_id);
+        __func__, execbuf->vaddr, execbuf_priv->bo->virt, execbuf->ctx->ctx_id);
     execbuf->valid = 1;
     return 0;
 }
@@ -89,11 +89,64 @@ int ved_context_submit_hw_deblock(object_context_p obj_context,
 int ved_context_submit_execbuf(object_context_p obj_context, ipvr_execbuffer_p mtxmsg);
 
 /*
- * Flushes the pending execbuf
+ * Flushes the pending execbuf, submitting the frames queued in it. Only
+ * for the thread building the context's frames: a frame being built
+ * continues in the next execbuf, and the scratch buffers it holds are
+ * tagged with that one.
  *
  * Return 0 on success
  */
-int ved_context_flush_execbuf(object_context_p obj_context, ipvr_execbuffer_p mtxmsg);
+int ved_context_flush_execbuf(object_context_p obj_context);
+
+/*
+ * Tags a scratch buffer slot as used by the frame being built: "*used"
+ * gets the execbuf_seqno of the execbuf the frame goes into, and follows
+ * the frame into the next execbuf should it spill over. Opens the frame,
+ * see object_context_s.execbuf_mutex.
+ */
+void ved_context_hold_scratch(object_context_p obj_context, uint32_t *used);
+
+/*
+ * Queues the frame just built in the current execbuf and closes it. The
+ * execbuf is submitted once driver_data->decode_ahead frames are queued,
+ * it is full or another thread waits for one of its frames, until then it
+ * stays open for the next frames.
+ *
+ * Return 0 on success
+ */
+int ved_context_queue_frame(object_context_p obj_context);
+
+/*
+ * Closes a frame that was not queued, after an error, and carries out a
+ * flush asked for while it was open
+ */
+void ved_context_end_frame(object_context_p obj_context);
+
+/*
+ * Makes the picture being built on "obj_context" see the decode into
+ * "obj_surface". Frames of one context run in submission order, so only a
+ * frame still queued on another context needs to be submitted first.
+ *
+ * Return 0 on success, -EBUSY if that context is in the middle of a frame:
+ * the queued frames are then submitted at its end.
+ */
+int ved_context_depend_surface(object_context_p obj_context, object_surface_p obj_surface);
+
+/*
+ * Submits the frame queued to decode into "obj_surface", if any, so the CPU
+ * can wait for it. The frames queued with it are submitted too and complete
+ * together with it.
+ *
+ * Return 0 on success, -EBUSY if its context is in the middle of a frame:
+ * the queued frames are then submitted at its end.
+ */
+int ved_surface_flush(object_surface_p obj_surface);
+
+/*
+ * Takes "obj_surface", about to be destroyed, off the queue of the execbuf
+ * it could not be flushed from; its frame is still decoded
+ */
+void ved_surface_unqueue(object_surface_p obj_surface);
 
 
 int
@@ -190,4 +243,47 @@ void ved_execbuf_rendec_end(ipvr_execbuffer_p execbuf);
 
 void *ved_execbuf_alloc_space(ipvr_execbuffer_p execbuf, uint32_t byte_size);
 
+/* One frame's worth of commands, the space ved__execbuffer_full() keeps free */
+#define VED_CMD_TEMPLATE_SIZE           (0x0400)
+#define VED_CMD_TEMPLATE_RELOCS         32
+
+/*
+ * Cached memory a context builds a block of commands in, kept from frame to
+ * frame. The control buffer is write-combined, and the register and RENDEC
+ * block headers are updated in place as values are added, so building there
+ * reads back uncached memory on every register.
+ */
+typedef struct ved_cmd_template_s {
+    uint32_t cmds[VED_CMD_TEMPLATE_SIZE / 4];
+    struct {
+        drm_ipvr_bo *bo;
+        uint32_t offset;        /* in bytes from cmds */
+        uint32_t delta;
+        uint32_t flags;
+    } relocs[VED_CMD_TEMPLATE_RELOCS];
+    int num_relocs;
+    int error;
+
+    /* the execbuf as it was before the template was opened */
+    unsigned char *vaddr;
+    unsigned long cur_offset;
+    int (*reloc)(ipvr_execbuffer_p execbuf, drm_ipvr_bo *target_bo,
+                 unsigned long offset, unsigned long target_offset, uint32_t flags);
+} ved_cmd_template_t, *ved_cmd_template_p;
+
+/*
+ * Redirects the commands written to "execbuf" into "tmpl" and records their
+ * relocations, until ved_execbuf_template_end(). Blocks opened in the
+ * template must be closed in it.
+ */
+void ved_execbuf_template_begin(ipvr_execbuffer_p execbuf, ved_cmd_template_p tmpl);
+
+/*
+ * Copies the commands built in "tmpl" into "execbuf" at once and emits
+ * their relocations there
+ *
+ * Return 0 on success
+ */
+int ved_execbuf_template_end(ipvr_execbuffer_p execbuf, ved_cmd_template_p tmpl);
+
 #endif
@@ -0,0 +1,300 @@
+/*
+ * CPU time of building a VP8 picture's commands, see
+ * ved_execbuf_template_begin(), against the stub VED in ipvr_stub.c.
+ *
+ *   make -C tools check
+ *   cmd_template_bench [frames] [wc_read_ns]
+ *
+ * The block has the shape tng__VP8_process_slice_data() writes: RENDEC
+ * blocks of one to six dwords, runs of registers and 14 relocations. It is
+ * built straight into the control buffer, as before, and in a template.
+ *
+ * On the VED the control buffer is write-combined: the writes are combined
+ * and cheap, but every header updated in place, a register run growing by
+ * one or a RENDEC block being closed, is read back uncached. The stub's
+ * buffers are cached memory, so those read-backs are counted as
+ * ved_execbuf.c makes them and charged wc_read_ns each on top of the time
+ * measured. The template is read back in cached memory and copied out with
+ * writes only.
+ *
+ * Both builds must give the same commands, and a block too big for the
+ * template must fail and leave the control buffer as it was.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "ved_execbuf.h"
+#include "psb_drv_debug.h"
+#include "ipvr_stub.h"
+
+#define BENCH_BOS       8
+
+/* what ved_execbuf.c and ipvr_execbuf.c need from the rest of the driver */
+psb_trace_file *psb_video_trace_ring;
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+}
+
+void psb__dump_va_buffers_verbose(object_buffer_p obj_buffer)
+{
+}
+
+void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
+{
+    va_list args;
+
+    if (debug_level != VIDEO_DEBUG_ERROR)
+        return;
+    va_start(args, msg);
+    vfprintf(stderr, msg, args);
+    va_end(args);
+}
+
+static int frames = 20000;
+static int wc_read_ns = 150;
+
+static struct psb_driver_data_s driver_data;
+static struct object_context_s obj_context;
+static ipvr_execbuffer_t execbuf_storage;
+static drm_ipvr_bo *bos[BENCH_BOS];
+
+/* Header read-backs of the block, see ved_execbuf_reg_set() and ved_execbuf_rendec_end() */
+static int readbacks;
+static int reg_run;
+static uint32_t reg_next;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void reg_start(ipvr_execbuffer_p execbuf)
+{
+    ved_execbuf_reg_start_block(execbuf, 0);
+    reg_run = 0;
+}
+
+static void reg_count(uint32_t reg)
+{
+    if (reg_run && reg == reg_next)
+        readbacks++;
+    reg_run = 1;
+    reg_next = reg + 4;
+}
+
+static void reg_set(ipvr_execbuffer_p execbuf, uint32_t reg, uint32_t val)
+{
+    reg_count(reg);
+    ved_execbuf_reg_set(execbuf, reg, val);
+}
+
+static void reg_set_address(ipvr_execbuffer_p execbuf, uint32_t reg, drm_ipvr_bo *bo, uint32_t offset)
+{
+    reg_count(reg);
+    ved_execbuf_reg_set_address(execbuf, reg, bo, offset);
+}
+
+static void rendec_end(ipvr_execbuffer_p execbuf)
+{
+    readbacks++;
+    ved_execbuf_rendec_end(execbuf);
+}
+
+static void build_picture(ipvr_execbuffer_p execbuf, int n)
+{
+    int i;
+
+    /* picture size, loop filter and cache registers */
+    for (i = 0; i < 8; i++) {
+        ved_execbuf_rendec_start(execbuf, 0x0100 + i * 0x10);
+        ved_execbuf_rendec_write(execbuf, n * 3 + i);
+        if (i < 2)
+            ved_execbuf_rendec_write(execbuf, n ^ i);
+        rendec_end(execbuf);
+    }
+    ved_execbuf_rendec_start(execbuf, 0x0300);
+    ved_execbuf_rendec_write_address(execbuf, bos[0], 0, 0);
+    rendec_end(execbuf);
+
+    /* front end registers */
+    reg_start(execbuf);
+    reg_set(execbuf, 0x0840, 1);
+    ved_execbuf_reg_end_block(execbuf);
+    reg_start(execbuf);
+    for (i = 0; i < 5; i++)
+        reg_set(execbuf, 0x0900 + 4 * i, n + i);
+    ved_execbuf_reg_end_block(execbuf);
+    for (i = 1; i < 4; i++) {
+        reg_start(execbuf);
+        reg_set_address(execbuf, 0x0a00 + 4 * i, bos[i], (n & 0xff) * 16);
+        ved_execbuf_reg_end_block(execbuf);
+    }
+
+    /* back end registers */
+    for (i = 0; i < 6; i++) {
+        ved_execbuf_rendec_start(execbuf, 0x0400 + i * 0x10);
+        if (i < 4)
+            ved_execbuf_rendec_write(execbuf, n + i);
+        else
+            ved_execbuf_rendec_write_address(execbuf, bos[i], 0, 0);
+        rendec_end(execbuf);
+    }
+
+    /* target and reference pictures */
+    ved_execbuf_rendec_start(execbuf, 0x0500);
+    for (i = 0; i < 2; i++)
+        ved_execbuf_rendec_write_address(execbuf, bos[6], i * 0x1000, 0);
+    rendec_end(execbuf);
+    ved_execbuf_rendec_start(execbuf, 0x0600);
+    for (i = 0; i < 6; i++)
+        ved_execbuf_rendec_write_address(execbuf, bos[7], i * 0x1000, 1);
+    rendec_end(execbuf);
+}
+
+static ipvr_execbuffer_p get_execbuf(void)
+{
+    if (ved_context_get_execbuf(&obj_context)) {
+        fprintf(stderr, "cannot get an execbuf\n");
+        exit(1);
+    }
+    return obj_context.execbuf;
+}
+
+/* Builds picture "n", returns the bytes written to the control buffer */
+static unsigned long build(ved_cmd_template_p tmpl, int n)
+{
+    ipvr_execbuffer_p execbuf = obj_context.execbuf;
+    unsigned long start = execbuf->cur_offset;
+
+    if (tmpl)
+        ved_execbuf_template_begin(execbuf, tmpl);
+    build_picture(execbuf, n);
+    if (tmpl && ved_execbuf_template_end(execbuf, tmpl)) {
+        fprintf(stderr, "template does not fit\n");
+        exit(1);
+    }
+    return execbuf->cur_offset - start;
+}
+
+static double bench(ved_cmd_template_p tmpl, double *per_frame_readbacks)
+{
+    double t, total = 0;
+    int i;
+
+    readbacks = 0;
+    for (i = 0; i < frames; i++) {
+        get_execbuf();
+        t = now();
+        build(tmpl, i);
+        total += now() - t;
+        ipvr_execbuffer_put(obj_context.execbuf);
+    }
+    /* the template's read-backs hit cached memory */
+    *per_frame_readbacks = tmpl ? 0 : (double)readbacks / frames;
+    return total;
+}
+
+/* The template gives the commands the direct build does */
+static void check_same_commands(ved_cmd_template_p tmpl)
+{
+    unsigned char *direct;
+    unsigned long size, templated_size;
+
+    get_execbuf();
+    size = build(NULL, 7);
+    direct = malloc(size);
+    if (!direct) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(direct, obj_context.execbuf->vaddr, size);
+    ipvr_execbuffer_put(obj_context.execbuf);
+
+    get_execbuf();
+    templated_size = build(tmpl, 7);
+    if (templated_size != size || memcmp(direct, obj_context.execbuf->vaddr, size)) {
+        fprintf(stderr, "the template gives other commands than the direct build\n");
+        exit(1);
+    }
+    ipvr_execbuffer_put(obj_context.execbuf);
+    free(direct);
+}
+
+/* Too many relocations for the template: nothing reaches the execbuf */
+static void check_overflow(ved_cmd_template_p tmpl)
+{
+    ipvr_execbuffer_p execbuf = get_execbuf();
+    unsigned char *vaddr = execbuf->vaddr;
+    unsigned long cur_offset = execbuf->cur_offset;
+    int i;
+
+    ved_execbuf_template_begin(execbuf, tmpl);
+    ved_execbuf_rendec_start(execbuf, 0x0600);
+    for (i = 0; i <= VED_CMD_TEMPLATE_RELOCS; i++)
+        ved_execbuf_rendec_write_address(execbuf, bos[i % BENCH_BOS], 0, 0);
+    ved_execbuf_rendec_end(execbuf);
+    if (!ved_execbuf_template_end(execbuf, tmpl) ||
+        execbuf->vaddr != vaddr || execbuf->cur_offset != cur_offset) {
+        fprintf(stderr, "an overflowing template was not refused cleanly\n");
+        exit(1);
+    }
+    ipvr_execbuffer_put(execbuf);
+}
+
+int main(int argc, char **argv)
+{
+    static ved_cmd_template_t tmpl;
+    double direct, templated, direct_readbacks, templated_readbacks;
+    int i;
+
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (argc > 2)
+        wc_read_ns = atoi(argv[2]);
+
+    driver_data.bufmgr = drm_ipvr_gem_bufmgr_init(-1);
+    obj_context.driver_data = &driver_data;
+    obj_context.execbuf = &execbuf_storage;
+    pthread_mutex_init(&obj_context.execbuf_mutex, NULL);
+    obj_context.ipvr_ctx = drm_ipvr_gem_context_create(driver_data.bufmgr,
+        IPVR_CONTEXT_TYPE_VED, 0, 0);
+    for (i = 0; i < BENCH_BOS; i++) {
+        bos[i] = drm_ipvr_gem_bo_alloc(driver_data.bufmgr, obj_context.ipvr_ctx,
+            "bench", 0x10000, 0, IPVR_CACHE_WRITECOMBINE);
+        if (!bos[i]) {
+            fprintf(stderr, "cannot allocate buffers\n");
+            return 1;
+        }
+    }
+
+    check_same_commands(&tmpl);
+    check_overflow(&tmpl);
+
+    direct = bench(NULL, &direct_readbacks);
+    templated = bench(&tmpl, &templated_readbacks);
+    printf("%d frames, %d ns per write-combined read:\n", frames, wc_read_ns);
+    printf("%-28s %8s %10s %14s\n", "", "reads", "ns/frame", "ns/frame on WC");
+    printf("%-28s %8.0f %10.1f %14.1f\n", "into the control buffer", direct_readbacks,
+        direct * 1e9 / frames, direct * 1e9 / frames + direct_readbacks * wc_read_ns);
+    printf("%-28s %8.0f %10.1f %14.1f\n", "through a template", templated_readbacks,
+        templated * 1e9 / frames, templated * 1e9 / frames + templated_readbacks * wc_read_ns);
+
+    for (i = 0; i < BENCH_BOS; i++)
+        drm_ipvr_gem_bo_unreference(bos[i]);
+    drm_ipvr_gem_context_destroy(obj_context.ipvr_ctx);
+    pthread_mutex_destroy(&obj_context.execbuf_mutex);
+    if (ipvr_stub_stats.live) {
+        fprintf(stderr, "%lu buffers leaked\n", ipvr_stub_stats.live);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,368 @@
+/*
+ * Decode ahead (PSB_VIDEO_DECODE_AHEAD) through src/ved_execbuf.c and
+ * src/psb_surface.c, against the stub VED in ipvr_stub.c.
+ *
+ *   make -C tools check
+ *   decode_ahead_bench [frames] [latency]
+ *
+ * Each frame goes through vld_dec_BeginPicture(), puts its aux line buffer
+ * and render target in the execbuf, is queued with ved_context_queue_frame()
+ * and closed with ved_context_end_frame(), as psb_EndPicture() does. The
+ * application syncs the surface it rendered "lag" frames before, the way a
+ * player keeps a few surfaces in flight ahead of display, with
+ * ved_surface_flush() and psb_surface_sync() as psb_SyncSurface(). The VED
+ * keeps "latency" submissions in flight. For every depth and lag the
+ * submissions, the syncs that had to submit their surface, the waits and
+ * the CPU time per frame are reported; a synced surface must be neither
+ * queued nor busy.
+ *
+ * Then the rules for other threads are checked: a surface queued on a
+ * context in the middle of a frame is not submitted by ved_surface_flush()
+ * or ved_context_depend_surface() but at the frame's end, and a frame that
+ * spills into a second execbuf keeps its scratch buffers and the buffers
+ * released while it was built tagged with the execbuf it ends in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "tng_vld_dec.h"
+#include "psb_surface.h"
+#include "psb_drv_debug.h"
+#include "ipvr_stub.h"
+
+#define NUM_SURFACES    8
+#define MAX_LAG         4
+#define SURFACE_SIZE    4096
+
+/* what tng_vld_dec.c, ved_execbuf.c and ipvr_execbuf.c need from the rest of the driver */
+psb_trace_file *psb_video_trace_ring;
+struct format_vtable_s tng_yuv_processor_vtable;
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+}
+
+void psb__dump_va_buffers_verbose(object_buffer_p obj_buffer)
+{
+}
+
+void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
+{
+    va_list args;
+
+    if (debug_level != VIDEO_DEBUG_ERROR)
+        return;
+    va_start(args, msg);
+    vfprintf(stderr, msg, args);
+    va_end(args);
+}
+
+struct decoder {
+    struct object_context_s obj_context;
+    struct context_DEC_s dec_ctx;
+};
+
+static int frames = 10000;
+
+static struct psb_driver_data_s driver_data;
+static struct object_surface_s surfaces[NUM_SURFACES];
+static struct psb_surface_s psb_surfaces[NUM_SURFACES];
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fail(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+static void create_decoder(struct decoder *dec, int id)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->obj_context.driver_data = &driver_data;
+    dec->obj_context.context_id = id;
+    pthread_mutex_init(&dec->obj_context.execbuf_mutex, NULL);
+    dec->obj_context.ipvr_ctx = drm_ipvr_gem_context_create(driver_data.bufmgr,
+        IPVR_CONTEXT_TYPE_VED, 0, 0);
+    if (!dec->obj_context.ipvr_ctx ||
+        vld_dec_CreateContext(&dec->dec_ctx, &dec->obj_context) != VA_STATUS_SUCCESS)
+        fail("cannot create a context");
+}
+
+static void destroy_decoder(struct decoder *dec)
+{
+    ved_context_flush_execbuf(&dec->obj_context);
+    vld_dec_DestroyContext(&dec->dec_ctx);
+    drm_ipvr_gem_context_destroy(dec->obj_context.ipvr_ctx);
+    pthread_mutex_destroy(&dec->obj_context.execbuf_mutex);
+}
+
+static void create_surfaces(void)
+{
+    int i;
+
+    memset(surfaces, 0, sizeof(surfaces));
+    memset(psb_surfaces, 0, sizeof(psb_surfaces));
+    for (i = 0; i < NUM_SURFACES; i++) {
+        psb_surfaces[i].buf = drm_ipvr_gem_bo_alloc(driver_data.bufmgr, NULL,
+            "VASurface", SURFACE_SIZE, 0, IPVR_CACHE_UNCACHED);
+        if (!psb_surfaces[i].buf)
+            fail("cannot create a surface");
+        surfaces[i].psb_surface = &psb_surfaces[i];
+    }
+}
+
+static void destroy_surfaces(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_SURFACES; i++)
+        psb_surface_destroy(&psb_surfaces[i]);
+}
+
+/* vaBeginPicture up to the slice data */
+static void begin_frame(struct decoder *dec, object_surface_p target)
+{
+    dec->obj_context.current_render_target = target;
+    if (vld_dec_BeginPicture(&dec->dec_ctx, &dec->obj_context) != VA_STATUS_SUCCESS)
+        fail("vld_dec_BeginPicture failed");
+}
+
+/* The commands of a frame that send its buffers to the VED */
+static void build_frame(struct decoder *dec)
+{
+    ipvr_execbuffer_p execbuf = dec->obj_context.execbuf;
+    struct ved_fe_decode_arg arg;
+    uint32_t *cmd;
+
+    cmd = ved_execbuf_alloc_space(execbuf, 8);
+    RELOC(execbuf, cmd[0], 0, dec->dec_ctx.aux_line_buffer_vld, 0);
+    RELOC(execbuf, cmd[1], 0, dec->obj_context.current_render_target->psb_surface->buf, 0);
+    memset(&arg, 0, sizeof(arg));
+    if (ipvr_execbuffer_add_command(execbuf, VED_COMMAND_FE_DECODE, &arg, sizeof(arg)))
+        fail("cannot build a frame");
+}
+
+/* vaEndPicture */
+static void end_frame(struct decoder *dec)
+{
+    if (ved_context_queue_frame(&dec->obj_context))
+        fail("cannot queue a frame");
+    vld_dec_EndPicture(&dec->dec_ctx);
+    ved_context_end_frame(&dec->obj_context);
+    dec->obj_context.current_render_target = NULL;
+}
+
+/* vaSyncSurface, returns whether the surface had to be submitted */
+static int sync_surface(object_surface_p obj_surface)
+{
+    int queued = obj_surface->queued_context != NULL;
+
+    if (ved_surface_flush(obj_surface))
+        fail("ved_surface_flush failed between frames");
+    psb_surface_sync(obj_surface->psb_surface);
+    if (obj_surface->queued_context ||
+        drm_ipvr_gem_bo_busy(obj_surface->psb_surface->fence))
+        fail("a synced surface is still queued or busy");
+    return queued;
+}
+
+static double run(int depth, int lag, int *sync_flushes)
+{
+    struct decoder dec;
+    double start;
+    int i;
+
+    driver_data.decode_ahead = depth;
+    ipvr_stub_reset();
+    create_surfaces();
+    create_decoder(&dec, 1);
+    *sync_flushes = 0;
+
+    start = now();
+    for (i = 0; i < frames; i++) {
+        begin_frame(&dec, &surfaces[i % NUM_SURFACES]);
+        build_frame(&dec);
+        end_frame(&dec);
+        if (i >= lag)
+            *sync_flushes += sync_surface(&surfaces[(i - lag) % NUM_SURFACES]);
+    }
+    start = now() - start;
+
+    destroy_decoder(&dec);
+    destroy_surfaces();
+    return start;
+}
+
+static uint32_t submissions(void)
+{
+    return ipvr_stub_stats.submissions;
+}
+
+/*
+ * Another thread flushes a surface queued on a context: at once between
+ * frames, at the end of the frame otherwise
+ */
+static void check_deferred_flush(void)
+{
+    struct decoder a, b;
+    object_surface_p queued = &surfaces[0];
+    uint32_t before;
+
+    driver_data.decode_ahead = 4;
+    ipvr_stub_reset();
+    create_surfaces();
+    create_decoder(&a, 1);
+    create_decoder(&b, 2);
+
+    /* between frames */
+    begin_frame(&a, &surfaces[0]);
+    build_frame(&a);
+    end_frame(&a);
+    before = submissions();
+    if (ved_context_depend_surface(&b.obj_context, queued) ||
+        submissions() != before + 1 || queued->queued_context)
+        fail("a surface queued between frames was not submitted at once");
+
+    /* in the middle of a frame, queued at its end */
+    begin_frame(&a, &surfaces[0]);
+    build_frame(&a);
+    end_frame(&a);
+    begin_frame(&a, &surfaces[1]);
+    build_frame(&a);
+    before = submissions();
+    if (ved_context_depend_surface(&b.obj_context, queued) != -EBUSY ||
+        ved_surface_flush(queued) != -EBUSY || submissions() != before)
+        fail("a frame was submitted half built");
+    if (ved_context_depend_surface(&a.obj_context, queued))
+        fail("a context waited on itself");
+    end_frame(&a);
+    if (submissions() != before + 1 || queued->queued_context || surfaces[1].queued_context)
+        fail("the deferred flush was not made at the end of the frame");
+
+    /* in the middle of a frame that fails before it is queued */
+    begin_frame(&a, &surfaces[2]);
+    build_frame(&a);
+    end_frame(&a);
+    begin_frame(&a, &surfaces[3]);
+    before = submissions();
+    if (ved_surface_flush(&surfaces[2]) != -EBUSY || submissions() != before)
+        fail("a frame was submitted half built");
+    ved_context_end_frame(&a.obj_context);
+    if (submissions() != before + 1 || surfaces[2].queued_context)
+        fail("the deferred flush was not made when the frame failed");
+
+    /* a destroyed surface leaves the queue, its frame is still decoded */
+    begin_frame(&a, &surfaces[4]);
+    build_frame(&a);
+    end_frame(&a);
+    begin_frame(&a, &surfaces[5]);
+    if (ved_surface_flush(&surfaces[4]) != -EBUSY)
+        fail("a frame was submitted half built");
+    ved_surface_unqueue(&surfaces[4]);
+    build_frame(&a);
+    end_frame(&a);
+    if (surfaces[4].queued_context || a.obj_context.frames_queued ||
+        psb_surfaces[4].fence || !psb_surfaces[5].fence)
+        fail("an unqueued surface was left behind");
+
+    destroy_decoder(&b);
+    destroy_decoder(&a);
+    destroy_surfaces();
+}
+
+/*
+ * The execbuf fills up in the middle of a frame, as in
+ * vld_dec_process_slice(): the rest of the frame and its buffers go into
+ * the next one
+ */
+static void check_spilled_frame(void)
+{
+    struct decoder a;
+    struct object_buffer_s released;
+    uint32_t *aux_used;
+    int slot;
+
+    driver_data.decode_ahead = 2;
+    ipvr_stub_reset();
+    create_surfaces();
+    create_decoder(&a, 1);
+
+    begin_frame(&a, &surfaces[0]);
+    build_frame(&a);
+    end_frame(&a);
+
+    begin_frame(&a, &surfaces[1]);
+    for (slot = 0; slot < VLD_DEC_SCRATCH_SLOTS; slot++) {
+        if (a.dec_ctx.aux_line_buffers[slot] == a.dec_ctx.aux_line_buffer_vld)
+            break;
+    }
+    aux_used = &a.dec_ctx.aux_line_buffers_used[slot];
+    /* a slice data buffer destroyed after its slice was built */
+    memset(&released, 0, sizeof(released));
+    released.last_used = a.obj_context.execbuf_seqno;
+    a.obj_context.buffers_unused[VASliceDataBufferType] = &released;
+    build_frame(&a);
+
+    ved_context_flush_execbuf(&a.obj_context);
+    if (ved_context_get_execbuf(&a.obj_context))
+        fail("cannot get the next execbuf");
+    if (*aux_used != a.obj_context.execbuf_seqno ||
+        released.last_used != a.obj_context.execbuf_seqno)
+        fail("a spilled frame's buffers are not tagged with the execbuf it ends in");
+    if (surfaces[0].queued_context)
+        fail("the queued frame was not submitted with the full execbuf");
+
+    build_frame(&a);
+    end_frame(&a);
+    a.obj_context.buffers_unused[VASliceDataBufferType] = NULL;
+
+    destroy_decoder(&a);
+    destroy_surfaces();
+}
+
+int main(int argc, char **argv)
+{
+    struct ipvr_stub_stats stats;
+    double t;
+    int depth, lag, sync_flushes;
+
+    if (argc > 1)
+        frames = atoi(argv[1]);
+    if (argc > 2)
+        ipvr_stub_latency = atoi(argv[2]);
+
+    driver_data.bufmgr = drm_ipvr_gem_bufmgr_init(-1);
+
+    printf("%d frames, %d submissions in flight\n", frames, ipvr_stub_latency);
+    printf("depth lag  submits  sync submits  waits  us/frame\n");
+    for (depth = 1; depth <= PSB_MAX_DECODE_AHEAD; depth++) {
+        for (lag = 0; lag <= MAX_LAG; lag++) {
+            t = run(depth, lag, &sync_flushes);
+            stats = ipvr_stub_stats;
+            printf("%5d %3d %8lu %13d %6lu %9.2f\n", depth, lag, stats.submissions,
+                sync_flushes, stats.waits, t * 1e6 / frames);
+            if (stats.live) {
+                fprintf(stderr, "%lu buffers leaked\n", stats.live);
+                return 1;
+            }
+        }
+    }
+
+    check_deferred_flush();
+    check_spilled_frame();
+    printf("deferred flushes and spilled frames: ok\n");
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * A stand-in for libdrm_ipvr, with a VED that runs no commands.
+ *
+ * Buffers are plain malloc'ed memory at made up device addresses. A
+ * relocation makes the target part of whatever the buffer holding it is
+ * submitted with, so drm_ipvr_gem_bo_exec() marks the buffer, the buffers
+ * it points at and so on as busy with the new submission. Submissions
+ * then complete as described in ipvr_stub.h, which keeps the benchmarks
+ * repeatable: whether a buffer is busy only depends on the order of the
+ * calls made.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "ipvr_stub.h"
+
+int ipvr_stub_latency = 1;
+int ipvr_stub_alloc_us;
+struct ipvr_stub_stats ipvr_stub_stats;
+
+typedef struct stub_bo_s {
+    drm_ipvr_bo base;
+    int refs;
+    uint32_t seqno;             /* last submission using it, 0 if none */
+    struct stub_bo_s **relocs;
+    int num_relocs;
+    int max_relocs;
+} stub_bo_t;
+
+static drm_ipvr_bufmgr stub_bufmgr;
+static uint32_t submitted, completed;
+static uint32_t next_handle = 1;
+static uint64_t next_offset = 0x10000;
+
+static void stub_retire(void)
+{
+    if (submitted > completed + ipvr_stub_latency)
+        completed = submitted - ipvr_stub_latency;
+}
+
+static void stub_spin(int us)
+{
+    struct timespec start, t;
+
+    if (us <= 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+    } while ((t.tv_sec - start.tv_sec) * 1000000 + (t.tv_nsec - start.tv_nsec) / 1000 < us);
+}
+
+void ipvr_stub_reset(void)
+{
+    memset(&ipvr_stub_stats, 0, sizeof(ipvr_stub_stats));
+    completed = submitted;
+}
+
+drm_ipvr_bufmgr *drm_ipvr_gem_bufmgr_init(int fd)
+{
+    return &stub_bufmgr;
+}
+
+void drm_ipvr_gem_bufmgr_destroy(drm_ipvr_bufmgr *bufmgr)
+{
+}
+
+drm_ipvr_context *drm_ipvr_gem_context_create(drm_ipvr_bufmgr *bufmgr,
+            uint32_t ctx_type, uint32_t tiling_stride, uint32_t tiling_mode)
+{
+    static uint32_t next_ctx_id = 1;
+    drm_ipvr_context *ctx = calloc(1, sizeof(*ctx));
+
+    if (ctx) {
+        ctx->ctx_id = next_ctx_id++;
+        ctx->ctx_type = ctx_type;
+        ctx->bufmgr = bufmgr;
+    }
+    return ctx;
+}
+
+void drm_ipvr_gem_context_destroy(drm_ipvr_context *ctx)
+{
+    free(ctx);
+}
+
+drm_ipvr_bo *drm_ipvr_gem_bo_alloc(drm_ipvr_bufmgr *bufmgr, drm_ipvr_context *ctx,
+            const char *name, size_t size,
+            uint8_t tiling, uint8_t cache_level)
+{
+    stub_bo_t *bo = calloc(1, sizeof(*bo));
+
+    if (!bo)
+        return NULL;
+    size = (size + 4095) & ~(size_t)4095;
+    bo->base.virt = calloc(1, size);
+    if (!bo->base.virt) {
+        free(bo);
+        return NULL;
+    }
+    bo->base.size = size;
+    bo->base.handle = next_handle++;
+    bo->base.offset = next_offset;
+    bo->base.bufmgr = bufmgr;
+    bo->refs = 1;
+    next_offset += size;
+
+    stub_spin(ipvr_stub_alloc_us);
+    ipvr_stub_stats.allocs++;
+    ipvr_stub_stats.live++;
+    return &bo->base;
+}
+
+drm_ipvr_bo *drm_ipvr_gem_bo_create_from_prime(drm_ipvr_bufmgr *bufmgr,
+            drm_ipvr_context *ctx, const char *name, int prime_fd, size_t guessed_size)
+{
+    return drm_ipvr_gem_bo_alloc(bufmgr, ctx, name, guessed_size, 0, 0);
+}
+
+void drm_ipvr_gem_bo_reference(drm_ipvr_bo *bo)
+{
+    ((stub_bo_t *)bo)->refs++;
+}
+
+void drm_ipvr_gem_bo_unreference(drm_ipvr_bo *bo)
+{
+    stub_bo_t *stub = (stub_bo_t *)bo;
+    int i;
+
+    if (!bo || --stub->refs > 0)
+        return;
+    for (i = 0; i < stub->num_relocs; i++)
+        drm_ipvr_gem_bo_unreference(&stub->relocs[i]->base);
+    free(stub->relocs);
+    free(stub->base.virt);
+    free(stub);
+    ipvr_stub_stats.frees++;
+    ipvr_stub_stats.live--;
+}
+
+int drm_ipvr_gem_bo_map(drm_ipvr_bo *bo, int write_enable)
+{
+    return 0;
+}
+
+int drm_ipvr_gem_bo_unmap(drm_ipvr_bo *bo)
+{
+    return 0;
+}
+
+int drm_ipvr_gem_bo_busy(drm_ipvr_bo *bo)
+{
+    stub_retire();
+    return ((stub_bo_t *)bo)->seqno > completed;
+}
+
+void drm_ipvr_gem_bo_wait(drm_ipvr_bo *bo)
+{
+    stub_bo_t *stub = (stub_bo_t *)bo;
+
+    if (drm_ipvr_gem_bo_busy(bo)) {
+        ipvr_stub_stats.waits++;
+        completed = stub->seqno;
+    }
+}
+
+int drm_ipvr_gem_bo_emit_reloc(drm_ipvr_bo *bo, uint64_t offset,
+            drm_ipvr_bo *target_bo, uint64_t target_offset, uint8_t skip_fence)
+{
+    stub_bo_t *stub = (stub_bo_t *)bo;
+
+    if (offset + 4 > bo->size)
+        return EINVAL;
+    if (stub->num_relocs == stub->max_relocs) {
+        int max = stub->max_relocs ? 2 * stub->max_relocs : 16;
+        stub_bo_t **relocs = realloc(stub->relocs, max * sizeof(*relocs));
+
+        if (!relocs)
+            return ENOMEM;
+        stub->relocs = relocs;
+        stub->max_relocs = max;
+    }
+    drm_ipvr_gem_bo_reference(target_bo);
+    stub->relocs[stub->num_relocs++] = (stub_bo_t *)target_bo;
+    return 0;
+}
+
+static void stub_mark_busy(stub_bo_t *bo, uint32_t seqno)
+{
+    int i;
+
+    if (bo->seqno == seqno)
+        return;
+    bo->seqno = seqno;
+    for (i = 0; i < bo->num_relocs; i++)
+        stub_mark_busy(bo->relocs[i], seqno);
+}
+
+int drm_ipvr_gem_bo_exec(drm_ipvr_bo *bo, uint64_t offset, size_t len,
+            int fence_in, int *fence_out)
+{
+    if (offset + len > bo->size)
+        return EINVAL;
+    stub_mark_busy((stub_bo_t *)bo, ++submitted);
+    ipvr_stub_stats.submissions++;
+    if (fence_out)
+        *fence_out = -1;
+    return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * A stand-in for libdrm_ipvr and the VED behind it, so that the driver's
+ * buffer and execbuf code can be run by the benchmarks in this directory
+ * without the hardware. See ipvr_stub.c.
+ */
+
+#ifndef _IPVR_STUB_H_
+#define _IPVR_STUB_H_
+
+#include <stdint.h>
+#include <ipvr_bufmgr.h>
+
+/*
+ * Submissions complete in order. A submission is done once "latency"
+ * more have been made after it; waiting on one of its buffers completes
+ * it and everything before it at once.
+ */
+extern int ipvr_stub_latency;
+
+/* CPU time each buffer allocation takes, for the kernel's create and MMU bind */
+extern int ipvr_stub_alloc_us;
+
+struct ipvr_stub_stats {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long live;         /* buffers allocated and not yet freed */
+    unsigned long submissions;
+    unsigned long waits;        /* waits on a buffer that was still busy */
+};
+extern struct ipvr_stub_stats ipvr_stub_stats;
+
+/* Resets the statistics and retires every submission */
+void ipvr_stub_reset(void);
+
+#endif /* _IPVR_STUB_H_ */
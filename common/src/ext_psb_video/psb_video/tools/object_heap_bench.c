@@ -0,0 +1,201 @@
+/*
+ * Microbenchmark for src/object_heap.c.
+ *
+ *   make -C tools check
+ *   object_heap_bench [objects] [rounds] [threads]
+ *
+ * Times allocate, lookup and free of batches of VA buffer sized objects,
+ * the way a decoder creates and destroys its slice buffers every frame,
+ * then filling a new heap, which includes growing it, and last the same
+ * batches on a thread safe heap shared by several threads. Fails if a
+ * heap does not hold exactly OBJECT_HEAP_INDEX_MASK + 1 objects.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "object_heap.h"
+
+#define BENCH_ID_OFFSET         0x04000000
+
+struct bench_object_s {
+    struct object_base_s base;
+    char payload[248];          /* about the size of object_buffer_s */
+};
+
+static int objects = 1024;
+static int rounds = 2000;
+static int threads = 4;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *what, double seconds, long ops)
+{
+    printf("%-28s %8.1f ns/op\n", what, seconds * 1e9 / ops);
+}
+
+static void bench_single(void)
+{
+    struct object_heap_s heap;
+    int *ids = malloc(objects * sizeof(*ids));
+    double t_alloc = 0, t_lookup = 0, t_free = 0, t;
+    long sum = 0;
+    int r, i;
+
+    if (!ids || object_heap_init(&heap, sizeof(struct bench_object_s), BENCH_ID_OFFSET)) {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+
+    for (r = 0; r < rounds; r++) {
+        t = now();
+        for (i = 0; i < objects; i++)
+            ids[i] = object_heap_allocate(&heap);
+        t_alloc += now() - t;
+
+        t = now();
+        for (i = 0; i < objects; i++)
+            sum += ((struct bench_object_s *) object_heap_lookup(&heap, ids[i]))->payload[0];
+        t_lookup += now() - t;
+
+        t = now();
+        for (i = 0; i < objects; i++)
+            object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+        t_free += now() - t;
+    }
+
+    /* Stale IDs must not resolve */
+    if (object_heap_lookup(&heap, ids[0]) != NULL) {
+        fprintf(stderr, "stale ID %08x still looks up\n", ids[0]);
+        exit(1);
+    }
+
+    report("allocate", t_alloc, (long)rounds * objects);
+    report("lookup", t_lookup, (long)rounds * objects);
+    report("lookup + free", t_free, (long)rounds * objects);
+    object_heap_destroy(&heap);
+    free(ids);
+    if (sum)
+        printf("(%ld)\n", sum);
+}
+
+static void bench_grow(void)
+{
+    struct object_heap_s heap;
+    int *ids = malloc(objects * sizeof(*ids));
+    double t = now();
+    int r, i;
+
+    for (r = 0; r < rounds; r++) {
+        if (!ids || object_heap_init(&heap, sizeof(struct bench_object_s), BENCH_ID_OFFSET)) {
+            fprintf(stderr, "init failed\n");
+            exit(1);
+        }
+        for (i = 0; i < objects; i++)
+            ids[i] = object_heap_allocate(&heap);
+        for (i = 0; i < objects; i++)
+            object_heap_free(&heap, object_heap_lookup(&heap, ids[i]));
+        object_heap_destroy(&heap);
+    }
+    report("fill and empty a new heap", now() - t, (long)rounds * objects);
+    free(ids);
+}
+
+/* A heap takes as many objects as the index can address, and no more */
+static void check_limit(void)
+{
+    struct object_heap_s heap;
+    object_heap_iterator iter;
+    object_base_p obj;
+    int limit = OBJECT_HEAP_INDEX_MASK + 1;
+    int i;
+
+    if (object_heap_init(&heap, sizeof(struct bench_object_s), BENCH_ID_OFFSET)) {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+    for (i = 0; i < limit; i++) {
+        if (object_heap_allocate(&heap) == -1) {
+            fprintf(stderr, "the heap is full after %d objects, not %d\n", i, limit);
+            exit(1);
+        }
+    }
+    if (object_heap_allocate(&heap) != -1) {
+        fprintf(stderr, "the heap holds more than %d objects\n", limit);
+        exit(1);
+    }
+    for (obj = object_heap_first(&heap, &iter); obj; obj = object_heap_next(&heap, &iter))
+        object_heap_free(&heap, obj);
+    object_heap_destroy(&heap);
+}
+
+static struct object_heap_s shared_heap;
+
+static void *bench_thread(void *arg)
+{
+    int *ids = malloc(objects * sizeof(*ids));
+    int r, i;
+
+    for (r = 0; r < rounds && ids; r++) {
+        for (i = 0; i < objects; i++)
+            ids[i] = object_heap_allocate(&shared_heap);
+        for (i = 0; i < objects; i++) {
+            object_base_p obj = object_heap_lookup(&shared_heap, ids[i]);
+            if (!obj || obj->id != ids[i]) {
+                fprintf(stderr, "lookup of %08x failed\n", ids[i]);
+                exit(1);
+            }
+            object_heap_free(&shared_heap, obj);
+        }
+    }
+    free(ids);
+    return arg;
+}
+
+static void bench_threads(void)
+{
+    pthread_t *tid = malloc(threads * sizeof(*tid));
+    double t;
+    int i;
+
+    if (!tid || object_heap_init_threadsafe(&shared_heap, sizeof(struct bench_object_s), BENCH_ID_OFFSET)) {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+
+    t = now();
+    for (i = 0; i < threads; i++)
+        pthread_create(&tid[i], NULL, bench_thread, NULL);
+    for (i = 0; i < threads; i++)
+        pthread_join(tid[i], NULL);
+    t = now() - t;
+
+    printf("%d threads, thread safe heap:\n", threads);
+    report("allocate + lookup + free", t, (long)threads * rounds * objects);
+    object_heap_destroy(&shared_heap);
+    free(tid);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        objects = atoi(argv[1]);
+    if (argc > 2)
+        rounds = atoi(argv[2]);
+    if (argc > 3)
+        threads = atoi(argv[3]);
+
+    printf("%d objects x %d rounds:\n", objects, rounds);
+    bench_single();
+    bench_grow();
+    bench_threads();
+    check_limit();
+    return 0;
+}
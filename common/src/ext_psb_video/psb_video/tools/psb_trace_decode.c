@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2014 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Decoder for the psb_video binary trace ring (PSB_VIDEO_TRACE_RING).
+ *
+ *   make -C tools psb_trace_decode
+ *   psb_trace_decode [-j trace.json] /dev/shm/psb_trace.<pid>
+ *
+ * Prints a latency histogram for every traced call and, with -j, writes
+ * the calls as a Chrome trace (chrome://tracing or ui.perfetto.dev). The
+ * file may be decoded while the traced process is still running. Only the
+ * latest thread to own a ring is shown for it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../src/psb_trace_ring.h"
+
+#define STACK_DEPTH     64
+#define HIST_BUCKETS    40      /* log2 of ns, up to ~18 minutes */
+
+typedef struct {
+    uint32_t tid;
+    psb_trace_record rec;
+} trace_entry;
+
+typedef struct {
+    uint16_t event;
+    uint32_t tid;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t context_id;
+    uint32_t surface_id;
+    uint32_t args[4];           /* from the enter record */
+    uint32_t result[4];         /* from the exit record */
+} trace_call;
+
+typedef struct {
+    uint64_t *durations;
+    uint32_t count;
+    uint32_t size;
+    uint64_t total;
+    uint32_t buckets[HIST_BUCKETS];
+} trace_stats;
+
+static const psb_trace_file *file;
+
+static const char *event_name(uint16_t event)
+{
+    /* the key is published once the name is complete */
+    if (event >= PSB_TRACE_NAMES ||
+        __atomic_load_n(&file->names[event].key, __ATOMIC_ACQUIRE) == 0 ||
+        file->names[event].name[0] == '\0')
+        return "?";
+    return file->names[event].name;
+}
+
+/*
+ * Copy the records still held by a ring. A record is only kept if its
+ * sequence number is the expected one both before and after the copy, so
+ * records the writer is overwriting are skipped rather than torn. Records
+ * of a thread that has since given the ring to another are left out, and
+ * a copy that raced with such a hand over is done again.
+ */
+static uint32_t read_ring(const psb_trace_ring *ring, trace_entry *out)
+{
+    const psb_trace_record *rec;
+    uint64_t head, start, idx;
+    uint32_t tid, seq, n;
+
+retry:
+    tid = __atomic_load_n(&ring->tid, __ATOMIC_ACQUIRE);
+    start = __atomic_load_n(&ring->start, __ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    idx = head > PSB_TRACE_RING_RECORDS ? head - PSB_TRACE_RING_RECORDS : 0;
+    if (idx < start)
+        idx = start;
+
+    for (n = 0; idx < head; idx++) {
+        rec = &ring->records[idx & (PSB_TRACE_RING_RECORDS - 1)];
+        seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        if (seq != (uint32_t)(idx + 1))
+            continue;
+        memcpy(&out[n].rec, rec, sizeof(*rec));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != seq)
+            continue;
+        out[n].tid = tid;
+        n++;
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&ring->tid, __ATOMIC_RELAXED) != tid ||
+        __atomic_load_n(&ring->start, __ATOMIC_RELAXED) != start)
+        goto retry;
+    return n;
+}
+
+/* Match enter and exit records of one thread into calls */
+static uint32_t pair_calls(const trace_entry *entries, uint32_t count, trace_call *out)
+{
+    trace_call stack[STACK_DEPTH];
+    uint32_t depth = 0, n = 0, i;
+    int j;
+
+    for (i = 0; i < count; i++) {
+        const psb_trace_record *rec = &entries[i].rec;
+
+        if (rec->type == PSB_TRACE_ENTER) {
+            /* an enter without exit (early return) eventually falls off */
+            if (depth == STACK_DEPTH) {
+                memmove(&stack[0], &stack[1], sizeof(stack[0]) * (STACK_DEPTH - 1));
+                depth--;
+            }
+            stack[depth].event = rec->event;
+            stack[depth].tid = entries[i].tid;
+            stack[depth].start = rec->timestamp;
+            stack[depth].context_id = rec->context_id;
+            stack[depth].surface_id = rec->surface_id;
+            memcpy(stack[depth].args, rec->args, sizeof(rec->args));
+            depth++;
+        } else if (rec->type == PSB_TRACE_EXIT) {
+            for (j = depth - 1; j >= 0; j--)
+                if (stack[j].event == rec->event)
+                    break;
+            /* exits whose enter was overwritten are dropped */
+            if (j < 0)
+                continue;
+            out[n] = stack[j];
+            out[n].duration = rec->timestamp - stack[j].start;
+            memcpy(out[n].result, rec->args, sizeof(rec->args));
+            n++;
+            depth = j;
+        }
+    }
+    return n;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_timestamp(const void *a, const void *b)
+{
+    uint64_t x = ((const trace_call *)a)->start, y = ((const trace_call *)b)->start;
+    return x < y ? -1 : x > y;
+}
+
+static void stats_add(trace_stats *st, uint64_t duration)
+{
+    uint32_t b = 0;
+
+    if (st->count == st->size) {
+        st->size = st->size ? st->size * 2 : 256;
+        st->durations = realloc(st->durations, st->size * sizeof(uint64_t));
+        if (st->durations == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    st->durations[st->count++] = duration;
+    st->total += duration;
+    while (b < HIST_BUCKETS - 1 && (duration >> (b + 1)))
+        b++;
+    st->buckets[b]++;
+}
+
+static void print_ns(uint64_t ns)
+{
+    if (ns < 10000)
+        printf(" %7lluns", (unsigned long long)ns);
+    else if (ns < 10000000)
+        printf(" %7.1fus", ns / 1000.0);
+    else
+        printf(" %7.1fms", ns / 1000000.0);
+}
+
+static void print_histograms(trace_stats *stats)
+{
+    uint32_t e, b, width, max;
+
+    printf("%-32s %8s %9s %9s %9s %9s %9s %9s\n", "call", "count",
+           "total", "min", "p50", "p90", "p99", "max");
+    for (e = 0; e < PSB_TRACE_NAMES + 1; e++) {
+        trace_stats *st = &stats[e];
+        if (st->count == 0)
+            continue;
+        qsort(st->durations, st->count, sizeof(uint64_t), compare_u64);
+        printf("%-32s %8u", e < PSB_TRACE_NAMES ? event_name(e) : "?", st->count);
+        print_ns(st->total);
+        print_ns(st->durations[0]);
+        print_ns(st->durations[st->count / 2]);
+        print_ns(st->durations[(uint64_t)st->count * 90 / 100]);
+        print_ns(st->durations[(uint64_t)st->count * 99 / 100]);
+        print_ns(st->durations[st->count - 1]);
+        printf("\n");
+    }
+
+    for (e = 0; e < PSB_TRACE_NAMES + 1; e++) {
+        trace_stats *st = &stats[e];
+        if (st->count == 0)
+            continue;
+        printf("\n%s\n", e < PSB_TRACE_NAMES ? event_name(e) : "?");
+        max = 0;
+        for (b = 0; b < HIST_BUCKETS; b++)
+            if (st->buckets[b] > max)
+                max = st->buckets[b];
+        for (b = 0; b < HIST_BUCKETS; b++) {
+            if (st->buckets[b] == 0)
+                continue;
+            printf("  <");
+            print_ns(2ull << b);
+            width = (uint32_t)((uint64_t)st->buckets[b] * 50 / max);
+            printf(" %8u ", st->buckets[b]);
+            while (width--)
+                putchar('#');
+            putchar('\n');
+        }
+    }
+}
+
+static void write_chrome_trace(const char *path, const trace_call *calls,
+                               uint32_t count, uint64_t base)
+{
+    FILE *fp = fopen(path, "w");
+    uint32_t i;
+
+    if (fp == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (i = 0; i < count; i++) {
+        const trace_call *c = &calls[i];
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%u,\"tid\":%u,"
+                "\"ts\":%.3f,", i ? ",\n" : "", event_name(c->event),
+                c->duration == UINT64_MAX ? "i" : "X", file->pid, c->tid,
+                (c->start - base) / 1000.0);
+        if (c->duration == UINT64_MAX)
+            fprintf(fp, "\"s\":\"t\",");
+        else
+            fprintf(fp, "\"dur\":%.3f,", c->duration / 1000.0);
+        fprintf(fp, "\"args\":{\"context\":%u,\"surface\":%u,"
+                "\"args\":[%u,%u,%u,%u],\"result\":[%u,%u,%u,%u]}}",
+                c->context_id, c->surface_id,
+                c->args[0], c->args[1], c->args[2], c->args[3],
+                c->result[0], c->result[1], c->result[2], c->result[3]);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+}
+
+int main(int argc, char **argv)
+{
+    const char *json = NULL, *path;
+    trace_entry *entries;
+    trace_call *calls;
+    trace_stats *stats;
+    uint32_t rings, r, i, n, total = 0;
+    uint64_t base = UINT64_MAX;
+    struct stat sb;
+    int fd, opt;
+
+    while ((opt = getopt(argc, argv, "j:")) != -1) {
+        if (opt == 'j')
+            json = optarg;
+        else
+            goto usage;
+    }
+    if (optind + 1 != argc)
+        goto usage;
+    path = argv[optind];
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)sb.st_size < sizeof(*file)) {
+        fprintf(stderr, "%s: too short for a trace file\n", path);
+        return 1;
+    }
+    file = mmap(NULL, sizeof(*file), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    if (memcmp(file->magic, PSB_TRACE_MAGIC, sizeof(file->magic)) != 0 ||
+        file->version != PSB_TRACE_VERSION) {
+        fprintf(stderr, "%s: not a version %d trace file\n", path, PSB_TRACE_VERSION);
+        return 1;
+    }
+
+    entries = malloc(sizeof(*entries) * PSB_TRACE_RING_RECORDS);
+    calls = malloc(sizeof(*calls) * PSB_TRACE_RING_RECORDS * PSB_TRACE_RINGS);
+    stats = calloc(PSB_TRACE_NAMES + 1, sizeof(*stats));
+    if (entries == NULL || calls == NULL || stats == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    rings = file->rings_used < PSB_TRACE_RINGS ? file->rings_used : PSB_TRACE_RINGS;
+    for (r = 0; r < rings; r++) {
+        n = read_ring(&file->rings[r], entries);
+        for (i = 0; i < n; i++) {
+            if (entries[i].rec.timestamp < base)
+                base = entries[i].rec.timestamp;
+            /* marks go to the timeline as instant events */
+            if (entries[i].rec.type == PSB_TRACE_MARK) {
+                trace_call *c = &calls[total++];
+                memset(c, 0, sizeof(*c));
+                c->event = entries[i].rec.event;
+                c->tid = entries[i].tid;
+                c->start = entries[i].rec.timestamp;
+                c->duration = UINT64_MAX;
+                c->context_id = entries[i].rec.context_id;
+                c->surface_id = entries[i].rec.surface_id;
+                memcpy(c->args, entries[i].rec.args, sizeof(c->args));
+            }
+        }
+        total += pair_calls(entries, n, calls + total);
+    }
+
+    printf("pid %u: %u threads traced, %u without a ring, %u unnamed events\n\n",
+           file->pid, rings + file->rings_reused, file->rings_dropped, file->names_dropped);
+    for (i = 0; i < total; i++) {
+        if (calls[i].duration == UINT64_MAX)
+            continue;
+        stats_add(&stats[calls[i].event < PSB_TRACE_NAMES ?
+                         calls[i].event : PSB_TRACE_NAMES], calls[i].duration);
+    }
+    print_histograms(stats);
+
+    if (json) {
+        qsort(calls, total, sizeof(*calls), compare_timestamp);
+        write_chrome_trace(json, calls, total, base);
+    }
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-j trace.json] <trace file>\n", argv[0]);
+    return 1;
+}
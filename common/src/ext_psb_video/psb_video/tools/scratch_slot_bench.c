@@ -0,0 +1,218 @@
+/*
+ * Buffer allocations of the per-picture scratch slots, see
+ * vld_dec_pick_scratch_slot(), against the stub VED in ipvr_stub.c.
+ *
+ *   make -C tools check
+ *   scratch_slot_bench [pictures] [alloc_us]
+ *
+ * Each picture goes through vld_dec_BeginPicture(), puts its aux line
+ * buffer in the execbuf, is queued with ved_context_queue_frame() and
+ * ends with vld_dec_EndPicture(), for every decode ahead depth and for
+ * VEDs that keep zero to six submissions in flight. Every picture must get
+ * a buffer that is neither busy nor used by another picture of the open
+ * execbuf. The allocations, waits and CPU time per picture are reported
+ * next to those of allocating and freeing the buffer for every picture,
+ * as vld_dec did before. alloc_us is the CPU time an allocation takes in
+ * the stub, for the kernel's create and MMU bind.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "tng_vld_dec.h"
+#include "psb_drv_debug.h"
+#include "ipvr_stub.h"
+
+#define MAX_LATENCY     6
+
+/* what tng_vld_dec.c, ved_execbuf.c and ipvr_execbuf.c need from the rest of the driver */
+psb_trace_file *psb_video_trace_ring;
+struct format_vtable_s tng_yuv_processor_vtable;
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+}
+
+void psb__dump_va_buffers_verbose(object_buffer_p obj_buffer)
+{
+}
+
+void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
+{
+    va_list args;
+
+    if (debug_level != VIDEO_DEBUG_ERROR)
+        return;
+    va_start(args, msg);
+    vfprintf(stderr, msg, args);
+    va_end(args);
+}
+
+static int pictures = 10000;
+
+static struct psb_driver_data_s driver_data;
+static struct object_context_s obj_context;
+static struct context_DEC_s dec_ctx;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void setup(int depth, int latency)
+{
+    memset(&obj_context, 0, sizeof(obj_context));
+    memset(&dec_ctx, 0, sizeof(dec_ctx));
+    driver_data.decode_ahead = depth;
+    obj_context.driver_data = &driver_data;
+    pthread_mutex_init(&obj_context.execbuf_mutex, NULL);
+    obj_context.ipvr_ctx = drm_ipvr_gem_context_create(driver_data.bufmgr,
+        IPVR_CONTEXT_TYPE_VED, 0, 0);
+    if (!obj_context.ipvr_ctx || vld_dec_CreateContext(&dec_ctx, &obj_context) != VA_STATUS_SUCCESS) {
+        fprintf(stderr, "cannot create a context\n");
+        exit(1);
+    }
+    ipvr_stub_latency = latency;
+    ipvr_stub_reset();
+}
+
+static void teardown(void)
+{
+    ved_context_flush_execbuf(&obj_context);
+    vld_dec_DestroyContext(&dec_ctx);
+    drm_ipvr_gem_context_destroy(obj_context.ipvr_ctx);
+    pthread_mutex_destroy(&obj_context.execbuf_mutex);
+}
+
+/* The part of a picture that sends the aux line buffer to the VED */
+static void queue_picture(drm_ipvr_bo *buf)
+{
+    ipvr_execbuffer_p execbuf = obj_context.execbuf;
+    struct ved_fe_decode_arg arg;
+    uint32_t *cmd;
+
+    cmd = ved_execbuf_alloc_space(execbuf, 4);
+    RELOC(execbuf, *cmd, 0, buf, 0);
+    memset(&arg, 0, sizeof(arg));
+    if (ipvr_execbuffer_add_command(execbuf, VED_COMMAND_FE_DECODE, &arg, sizeof(arg)) ||
+        ved_context_queue_frame(&obj_context)) {
+        fprintf(stderr, "cannot queue a picture\n");
+        exit(1);
+    }
+}
+
+static int filled_slots(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < VLD_DEC_SCRATCH_SLOTS; i++)
+        n += dec_ctx.aux_line_buffers[i] != NULL;
+    return n;
+}
+
+static double run_slots(int depth, int latency, int *allocs)
+{
+    drm_ipvr_bo *open_bufs[PSB_MAX_DECODE_AHEAD];
+    drm_ipvr_bo *buf;
+    double t = 0, start;
+    int i, j;
+
+    setup(depth, latency);
+    *allocs = 0;
+    for (i = 0; i < pictures; i++) {
+        *allocs -= filled_slots();
+        start = now();
+        if (vld_dec_BeginPicture(&dec_ctx, &obj_context) != VA_STATUS_SUCCESS) {
+            fprintf(stderr, "vld_dec_BeginPicture failed\n");
+            exit(1);
+        }
+        t += now() - start;
+        *allocs += filled_slots();
+
+        buf = dec_ctx.aux_line_buffer_vld;
+        if (drm_ipvr_gem_bo_busy(buf)) {
+            fprintf(stderr, "depth %d latency %d: picture %d got a busy buffer\n",
+                depth, latency, i);
+            exit(1);
+        }
+        for (j = 0; j < obj_context.frames_queued; j++) {
+            if (open_bufs[j] == buf) {
+                fprintf(stderr, "depth %d latency %d: picture %d got the buffer of "
+                    "picture %d, queued in the same execbuf\n",
+                    depth, latency, i, i - obj_context.frames_queued + j);
+                exit(1);
+            }
+        }
+        open_bufs[obj_context.frames_queued] = buf;
+
+        queue_picture(buf);
+        vld_dec_EndPicture(&dec_ctx);
+    }
+    teardown();
+    return t;
+}
+
+/* vld_dec as it was: a new buffer for every picture, freed at its end */
+static double run_alloc(int depth, int latency)
+{
+    drm_ipvr_bo *buf;
+    double t = 0, start;
+    int i;
+
+    setup(depth, latency);
+    for (i = 0; i < pictures; i++) {
+        start = now();
+        buf = drm_ipvr_gem_bo_alloc(driver_data.bufmgr, obj_context.ipvr_ctx,
+            "VED-aux_line_buffer_vld", AUX_LINE_BUFFER_VLD_SIZE, 0, IPVR_CACHE_UNCACHED);
+        if (!buf || ved_context_get_execbuf(&obj_context)) {
+            fprintf(stderr, "cannot allocate\n");
+            exit(1);
+        }
+        t += now() - start;
+
+        queue_picture(buf);
+        drm_ipvr_gem_bo_unreference(buf);
+    }
+    teardown();
+    return t;
+}
+
+int main(int argc, char **argv)
+{
+    struct ipvr_stub_stats stats;
+    double slots, alloc;
+    int depth, latency, allocs;
+
+    if (argc > 1)
+        pictures = atoi(argv[1]);
+    if (argc > 2)
+        ipvr_stub_alloc_us = atoi(argv[2]);
+
+    driver_data.bufmgr = drm_ipvr_gem_bufmgr_init(-1);
+
+    printf("%d pictures, %d us per allocation, %d scratch slots\n",
+        pictures, ipvr_stub_alloc_us, VLD_DEC_SCRATCH_SLOTS);
+    printf("depth latency  allocs  waits  submits  us/picture  (alloc per picture: us/picture)\n");
+    for (depth = 1; depth <= PSB_MAX_DECODE_AHEAD; depth++) {
+        for (latency = 0; latency <= MAX_LATENCY; latency++) {
+            alloc = run_alloc(depth, latency);
+            slots = run_slots(depth, latency, &allocs);
+            stats = ipvr_stub_stats;
+            printf("%5d %7d %7d %6lu %8lu %11.2f  (%.2f)\n", depth, latency,
+                allocs, stats.waits, stats.submissions,
+                slots * 1e6 / pictures, alloc * 1e6 / pictures);
+            if (stats.live) {
+                fprintf(stderr, "%lu buffers leaked\n", stats.live);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Checks the incremental compile and upload of the VP8 probability tables,
+ * see tng__VP8_set_probility_reg(), against compiling both tables from
+ * scratch for every frame as the driver did before.
+ *
+ *   make -C tools check
+ *   vp8_probs_test [seeds] [frames]
+ *
+ * tng_VP8.c is included so that its static functions can be called. Each
+ * frame picks the next of three buffer sets, like pictures in flight do,
+ * and changes the probabilities as streams do: most frames not at all,
+ * others in a single entry, scattered entries or the whole table, with
+ * key frames in between. Now and then a buffer set is freed and allocated
+ * again with stale contents. After every frame both probability buffers
+ * must hold exactly what the full compile produces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "../src/tng_VP8.c"
+#include "ipvr_stub.h"
+
+#define BUFFER_SETS     3
+
+/* what the driver sources linked in need from the rest of the driver */
+psb_trace_file *psb_video_trace_ring;
+struct format_vtable_s tng_yuv_processor_vtable;
+
+void psb__trace_ring_record(int type, int *event, const char *name,
+                            uint32_t context_id, uint32_t surface_id,
+                            uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+}
+
+void psb__dump_va_buffers_verbose(object_buffer_p obj_buffer)
+{
+}
+
+void drv_debug_msg(DEBUG_LEVEL debug_level, const char *msg, ...)
+{
+    va_list args;
+
+    if (debug_level != VIDEO_DEBUG_ERROR)
+        return;
+    va_start(args, msg);
+    vfprintf(stderr, msg, args);
+    va_end(args);
+}
+
+static struct psb_driver_data_s driver_data;
+static struct object_context_s obj_context;
+static struct context_VP8_s vp8_ctx;
+static VAPictureParameterBufferVP8 pic_params;
+static VAProbabilityDataBufferVP8 probs_params;
+
+/* The tables as tng__VP8_set_probility_reg() wrote them before */
+static void full_compile(uint32_t *probs_1st_part, uint32_t *probs_2nd_part)
+{
+    uint32_t *probs = probs_1st_part;
+
+    memset(probs, 0, VP8_PROBS_DATA_SIZE);
+    if (pic_params.pic_fields.bits.key_frame == 0) {
+        tng_KeyFrame_BModeProbsDataCompile((const Probability*)b_mode_prob, probs);
+    } else {
+        tng_InterFrame_YModeProbsDataCompile(pic_params.y_mode_probs, probs);
+        probs += (CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
+        tng_InterFrame_UVModeProbsDataCompile(pic_params.uv_mode_probs, probs);
+        probs += (CABAC_LSR_InterFrame_MVContextProb_Address >> 2) - (CABAC_LSR_InterFrame_UVModeProb_Address >> 2);
+        tng_InterFrame_MVContextProbsDataCompile((unsigned char*)pic_params.mv_probs, probs);
+    }
+
+    memset(probs_2nd_part, 0, VP8_PROBS_DATA_SIZE);
+    tng_DCT_Coefficient_ProbsDataCompile((Probability*)probs_params.dct_coeff_probs, probs_2nd_part);
+}
+
+static void randomize(unsigned char *p, size_t size)
+{
+    while (size--)
+        *p++ = rand();
+}
+
+static void next_frame(void)
+{
+    unsigned char *coeffs = (unsigned char *)probs_params.dct_coeff_probs;
+    int i, n;
+
+    /* one in ten frames is a key frame, which keeps the mode probabilities */
+    pic_params.pic_fields.bits.key_frame = rand() % 10 != 0;
+    if (pic_params.pic_fields.bits.key_frame && rand() % 4 == 0) {
+        randomize(pic_params.y_mode_probs, sizeof(pic_params.y_mode_probs));
+        randomize(pic_params.uv_mode_probs, sizeof(pic_params.uv_mode_probs));
+        pic_params.mv_probs[rand() % 2][rand() % 19] = rand();
+    }
+
+    switch (rand() % 8) {
+    case 0:
+        coeffs[rand() % sizeof(probs_params.dct_coeff_probs)] = rand();
+        break;
+    case 1:
+        n = 1 + rand() % 32;
+        for (i = 0; i < n; i++)
+            coeffs[rand() % sizeof(probs_params.dct_coeff_probs)] = rand();
+        break;
+    case 2:
+        randomize(coeffs, sizeof(probs_params.dct_coeff_probs));
+        break;
+    default:
+        break;
+    }
+}
+
+static int alloc_buffer_set(int slot)
+{
+    if (tng__VP8_alloc_scratch(&vp8_ctx, slot) != VA_STATUS_SUCCESS)
+        return -1;
+    /* a new buffer may hold anything */
+    memset(vp8_ctx.scratch[slot].probability_data_1st_part->virt, 0xa5, VP8_PROBS_DATA_SIZE);
+    memset(vp8_ctx.scratch[slot].probability_data_2nd_part->virt, 0x5a, VP8_PROBS_DATA_SIZE);
+    return 0;
+}
+
+static int run(unsigned int seed, int frames)
+{
+    uint32_t probs_1st_part[VP8_PROBS_DWORDS];
+    uint32_t probs_2nd_part[VP8_PROBS_DWORDS];
+    int frame, slot;
+
+    srand(seed);
+    memset(&vp8_ctx, 0, sizeof(vp8_ctx));
+    memset(&obj_context, 0, sizeof(obj_context));
+    randomize((unsigned char *)&pic_params, sizeof(pic_params));
+    randomize((unsigned char *)&probs_params, sizeof(probs_params));
+
+    obj_context.driver_data = &driver_data;
+    pthread_mutex_init(&obj_context.execbuf_mutex, NULL);
+    obj_context.ipvr_ctx = drm_ipvr_gem_context_create(driver_data.bufmgr,
+        IPVR_CONTEXT_TYPE_VED, 0, 0);
+    if (!obj_context.ipvr_ctx ||
+        vld_dec_CreateContext(&vp8_ctx.dec_ctx, &obj_context) != VA_STATUS_SUCCESS)
+        return -1;
+    vp8_ctx.obj_context = &obj_context;
+    vp8_ctx.pic_params = &pic_params;
+    vp8_ctx.probs_params = &probs_params;
+    vp8_ctx.buffer_size = 4096;
+    vp8_ctx.segid_size = 4096;
+    vp8_ctx.probability_data_1st_part_size = VP8_PROBS_DATA_SIZE;
+    vp8_ctx.probability_data_2nd_part_size = VP8_PROBS_DATA_SIZE;
+    for (slot = 0; slot < BUFFER_SETS; slot++) {
+        if (alloc_buffer_set(slot))
+            return -1;
+    }
+
+    for (frame = 0; frame < frames; frame++) {
+        slot = frame % BUFFER_SETS;
+        if (rand() % 100 == 0) {
+            tng__VP8_free_scratch(&vp8_ctx, slot);
+            if (alloc_buffer_set(slot))
+                return -1;
+        }
+        if (ved_context_get_execbuf(&obj_context))
+            return -1;
+
+        next_frame();
+        vp8_ctx.scratch_slot = slot;
+        vp8_ctx.probability_data_1st_part = vp8_ctx.scratch[slot].probability_data_1st_part;
+        vp8_ctx.probability_data_2nd_part = vp8_ctx.scratch[slot].probability_data_2nd_part;
+        tng__VP8_set_probility_reg(&vp8_ctx);
+        ved_context_flush_execbuf(&obj_context);
+
+        full_compile(probs_1st_part, probs_2nd_part);
+        if (memcmp(vp8_ctx.probability_data_1st_part->virt, probs_1st_part, VP8_PROBS_DATA_SIZE) ||
+            memcmp(vp8_ctx.probability_data_2nd_part->virt, probs_2nd_part, VP8_PROBS_DATA_SIZE)) {
+            fprintf(stderr, "seed %u frame %d: the %s partition table differs from a full compile\n",
+                seed, frame,
+                memcmp(vp8_ctx.probability_data_1st_part->virt, probs_1st_part,
+                       VP8_PROBS_DATA_SIZE) ? "first" : "second");
+            return 1;
+        }
+    }
+
+    for (slot = 0; slot < BUFFER_SETS; slot++)
+        tng__VP8_free_scratch(&vp8_ctx, slot);
+    vld_dec_DestroyContext(&vp8_ctx.dec_ctx);
+    drm_ipvr_gem_context_destroy(obj_context.ipvr_ctx);
+    pthread_mutex_destroy(&obj_context.execbuf_mutex);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int seeds = 50, frames = 2000;
+    int seed, ret;
+
+    if (argc > 1)
+        seeds = atoi(argv[1]);
+    if (argc > 2)
+        frames = atoi(argv[2]);
+
+    driver_data.bufmgr = drm_ipvr_gem_bufmgr_init(-1);
+    driver_data.decode_ahead = 1;
+    ipvr_stub_reset();
+
+    for (seed = 1; seed <= seeds; seed++) {
+        ret = run(seed, frames);
+        if (ret < 0)
+            fprintf(stderr, "seed %d: cannot set up the context\n", seed);
+        if (ret)
+            return 1;
+    }
+    if (ipvr_stub_stats.live) {
+        fprintf(stderr, "%lu buffers leaked\n", ipvr_stub_stats.live);
+        return 1;
+    }
+    printf("%d seeds of %d frames match the full compile\n", seeds, frames);
+    return 0;
+}
@@ -50,14 +50,34 @@
 
 static struct vawr_driver_data *vawr = NULL;
 
-#define WRAPPER_LOCK(mutex) \
+/*
+ * Locking: i965 is thread safe and is called without wrapper locks, PSB
+ * is not and calls into it hold its drv_mutex. The exceptions are
+ * vaSyncSurface and vaQuerySurfaceStatus: PSB looks surfaces up without
+ * locks and flushes the surface's context under that context's
+ * execbuf_mutex, so a thread waiting for a frame does not stall decoding
+ * on other threads. table_lock protects the surface, image and context
+ * tables. Entry points taking a surface hold it only to translate the
+ * id, never across a backend call that may wait for the hardware, so
+ * vaSyncSurface does not hold off vaDestroySurfaces; a surface destroyed
+ * before the backend looks it up is rejected there, destroying the very
+ * surface another thread syncs is the application's race. Picture
+ * submission holds the context's own lock, and the context's entry is
+ * referenced meanwhile. Lock order: context lock, table_lock, drv_mutex.
+ */
+#define WRAPPER_RDLOCK(vawr) \
+do { \
+    pthread_rwlock_rdlock(&(vawr)->table_lock); \
+} while (0)
+
+#define WRAPPER_WRLOCK(vawr) \
 do { \
-    pthread_mutex_lock(mutex); \
+    pthread_rwlock_wrlock(&(vawr)->table_lock); \
 } while (0)
 
-#define WRAPPER_UNLOCK(mutex) \
+#define WRAPPER_UNLOCK(vawr) \
 do { \
-    pthread_mutex_unlock(mutex); \
+    pthread_rwlock_unlock(&(vawr)->table_lock); \
 } while (0)
 
 void vawr_errorMessage(const char *msg, ...)
@@ -188,34 +208,272 @@ static VAStatus vawr_openDriver(VADriverContextP ctx, char *driver_name)
     return vaStatus;
 }
 
+
+#define VAWR_SURFACE_MAP_MIN_BITS	6
+
+static unsigned int
+vawr_surface_map_hash(const struct vawr_surface_map *map, VASurfaceID key)
+{
+    /* Fibonacci hashing, driver ids are mostly sequential */
+    return (key * 2654435761u) >> (32 - map->bits);
+}
+
+static vawr_surface_lookup_t *
+vawr_surface_map_find(const struct vawr_surface_map *map, VASurfaceID key)
+{
+    unsigned int mask, i;
+
+    if (!map->slots)
+        return NULL;
+
+    mask = (1u << map->bits) - 1;
+    for (i = vawr_surface_map_hash(map, key); map->slots[i].surface; i = (i + 1) & mask) {
+        if (map->slots[i].key == key)
+            return map->slots[i].surface;
+    }
+    return NULL;
+}
+
+static int
+vawr_surface_map_resize(struct vawr_surface_map *map, unsigned int bits)
+{
+    struct vawr_surface_map old = *map;
+    unsigned int mask = (1u << bits) - 1, i, j;
+
+    map->slots = calloc(1u << bits, sizeof(*map->slots));
+    if (!map->slots) {
+        *map = old;
+        return -1;
+    }
+    map->bits = bits;
+
+    for (i = 0; old.slots && i < (1u << old.bits); i++) {
+        if (!old.slots[i].surface)
+            continue;
+        for (j = vawr_surface_map_hash(map, old.slots[i].key); map->slots[j].surface; j = (j + 1) & mask)
+            ;
+        map->slots[j] = old.slots[i];
+    }
+    free(old.slots);
+
+    return 0;
+}
+
+/* Returns 0 on success, -1 if the table cannot grow */
+static int
+vawr_surface_map_insert(struct vawr_surface_map *map, VASurfaceID key,
+                        vawr_surface_lookup_t *surface)
+{
+    unsigned int mask, i;
+
+    if (!map->slots || (map->count + 1) * 2 > (1u << map->bits)) {
+        if (vawr_surface_map_resize(map, map->slots ? map->bits + 1 : VAWR_SURFACE_MAP_MIN_BITS))
+            return -1;
+    }
+
+    mask = (1u << map->bits) - 1;
+    for (i = vawr_surface_map_hash(map, key); map->slots[i].surface; i = (i + 1) & mask) {
+        if (map->slots[i].key == key) {
+            map->slots[i].surface = surface;
+            return 0;
+        }
+    }
+    map->slots[i].key = key;
+    map->slots[i].surface = surface;
+    map->count++;
+
+    return 0;
+}
+
+static void
+vawr_surface_map_remove(struct vawr_surface_map *map, VASurfaceID key)
+{
+    unsigned int mask, i, j, home;
+
+    if (!map->slots)
+        return;
+
+    mask = (1u << map->bits) - 1;
+    for (i = vawr_surface_map_hash(map, key); map->slots[i].surface; i = (i + 1) & mask) {
+        if (map->slots[i].key == key)
+            break;
+    }
+    if (!map->slots[i].surface)
+        return;
+
+    /* Shift back the entries of the probe run so no tombstone is needed */
+    for (j = (i + 1) & mask; map->slots[j].surface; j = (j + 1) & mask) {
+        home = vawr_surface_map_hash(map, map->slots[j].key);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].surface = NULL;
+    map->count--;
+}
+
+static void
+vawr_surface_map_free(struct vawr_surface_map *map)
+{
+    free(map->slots);
+    memset(map, 0, sizeof(*map));
+}
+
+/*
+ * The id to hand backend "drv" for an application surface id: i965's ids
+ * are its own, PSB's are checked against the surface table.
+ */
+static VASurfaceID
+vawr_lookupSurface(int drv, VASurfaceID surface)
+{
+    vawr_surface_lookup_t *surface_lookup;
+    VASurfaceID id = VA_INVALID_SURFACE;
+
+    if (drv != PSB_DRV)
+        return surface;
+
+    WRAPPER_RDLOCK(vawr);
+    surface_lookup = vawr_surface_map_find(&vawr->pvr_surfaces, surface);
+    if (surface_lookup)
+        id = surface_lookup->pvr_surface;
+    WRAPPER_UNLOCK(vawr);
+
+    return id;
+}
+
+/* Same for i965, which displays PSB's surfaces through their export */
+static VASurfaceID
+vawr_lookupSurfaceI965(int drv, VASurfaceID surface)
+{
+    vawr_surface_lookup_t *surface_lookup;
+    VASurfaceID id = VA_INVALID_SURFACE;
+
+    if (drv != PSB_DRV)
+        return surface;
+
+    WRAPPER_RDLOCK(vawr);
+    surface_lookup = vawr_surface_map_find(&vawr->pvr_surfaces, surface);
+    if (surface_lookup)
+        id = surface_lookup->i965_surface;
+    WRAPPER_UNLOCK(vawr);
+
+    return id;
+}
+
+/*
+ * Per context state, NULL if the context is unknown to the wrapper. The
+ * entry is referenced until vawr_putContext(), so that a racing
+ * vaDestroyContext cannot free it under the caller.
+ */
+static vawr_context_lookup_t *
+vawr_lookupContext(VAContextID context)
+{
+    vawr_context_lookup_t *context_lookup = NULL, *found = NULL;
+
+    WRAPPER_RDLOCK(vawr);
+    LIST_FOR_EACH_ENTRY(context_lookup, &vawr->contexts, link) {
+        if (context_lookup->context == context) {
+            found = context_lookup;
+            __atomic_add_fetch(&found->refcount, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    WRAPPER_UNLOCK(vawr);
+
+    return found;
+}
+
+static void
+vawr_putContext(vawr_context_lookup_t *context_lookup)
+{
+    if (!context_lookup ||
+        __atomic_sub_fetch(&context_lookup->refcount, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    pthread_mutex_destroy(&context_lookup->lock);
+    free(context_lookup);
+}
+
+/* Load psb_drv_video into its own driver context, table_lock held for writing */
+static VAStatus
+vawr_loadPsbDriver(void)
+{
+    VAStatus vaStatus;
+    struct VADriverVTable *psb_vtable = NULL;
+    VADriverContextP psb_ctx = DRV_CTX(vawr, PSB_DRV);
+    char *driver_name = "pvr";
+
+    psb_vtable = calloc(1, sizeof(*psb_vtable));
+    if (!psb_vtable)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    /* Start from what i965 was initialized with (display, versions...) */
+    *psb_ctx = *DRV_CTX(vawr, I965_DRV);
+    psb_ctx->pDriverData = NULL;
+    psb_ctx->vtable = psb_vtable;
+
+    /*  drm_state will be freed at vawr_vaTerminate */
+    psb_ctx->drm_state = calloc(1, sizeof(struct drm_state));
+    if (!psb_ctx->drm_state) {
+        free(psb_vtable);
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    }
+
+    vaStatus = vawr_openDriver(psb_ctx, driver_name);
+    if (VA_STATUS_SUCCESS != vaStatus) {
+        /*
+        * if open driver failed, context is invaild, cannot continue,
+        * return error
+        */
+        free(psb_ctx->drm_state);
+        free(psb_vtable);
+        memset(psb_ctx, 0, sizeof(*psb_ctx));
+        return VA_STATUS_ERROR_UNKNOWN;
+    }
+
+    /* We have successfully initialized psb video driver */
+    vawr->drv_vtable[PSB_DRV] = psb_vtable;
+
+    return VA_STATUS_SUCCESS;
+}
+
 VAStatus
 vawr_Terminate(VADriverContextP ctx)
 {
     VAStatus vaStatus;
     vawr_handle_lookup_t *handle_lookup = NULL, *temp = NULL;
+    vawr_context_lookup_t *context_lookup = NULL, *context_temp = NULL;
+    int i;
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
+    WRAPPER_WRLOCK(vawr);
     /*
-    * assume surface list and image list all free by destroy surface and destroy image
+    * assume surfaces and image list all free by destroy surface and destroy image
     */
-    if (vawr->profile == VAProfileVP8Version0_3) {
-        RESTORE_PSBDATA(ctx, vawr);
-        vaStatus = vawr->drv_vtable[PSB_DRV]->vaTerminate(ctx);
-
-        RESTORE_I965DATA(ctx, vawr);
-        vaStatus = vawr->drv_vtable[I965_DRV]->vaTerminate(ctx);
-
-        free(vawr->drm_state[PSB_DRV]);
-    } else {
-        RESTORE_I965DATA(ctx, vawr);
-        vaStatus = vawr->drv_vtable[I965_DRV]->vaTerminate(ctx);
+    if (vawr->drv_vtable[PSB_DRV]) {
+        CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaTerminate(DRV_CTX(vawr, PSB_DRV)));
+        free(DRV_CTX(vawr, PSB_DRV)->drm_state);
     }
+    CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaTerminate(DRV_CTX(vawr, I965_DRV)));
 
     free(vawr->drv_vtable[PSB_DRV]);
     free(vawr->drv_vtable[I965_DRV]);
 
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-    pthread_mutex_destroy(&vawr->vaapi_mutex);
+    LIST_FOR_EACH_ENTRY_SAFE(context_lookup, context_temp, &vawr->contexts, link) {
+        LIST_DEL(&context_lookup->link);
+        pthread_mutex_destroy(&context_lookup->lock);
+        free(context_lookup);
+    }
+
+    for (i = 0; vawr->pvr_surfaces.slots && i < (1 << vawr->pvr_surfaces.bits); i++)
+        free(vawr->pvr_surfaces.slots[i].surface);
+    vawr_surface_map_free(&vawr->pvr_surfaces);
+    vawr_surface_map_free(&vawr->i965_surfaces);
+
+    WRAPPER_UNLOCK(vawr);
+    pthread_rwlock_destroy(&vawr->table_lock);
+    for (i = 0; i < MAX_NUM_DRV; i++)
+        pthread_mutex_destroy(&vawr->drv_mutex[i]);
 
     /* handle is Stored when open driver */
     LIST_FOR_EACH_ENTRY_SAFE(handle_lookup, temp, &vawr->handles, link) {
@@ -226,15 +484,9 @@ vawr_Terminate(VADriverContextP ctx)
         free(handle_lookup);
     }
 
-    /*
-    * for va_DisplayContextDestroy will called in vaTerminater after vawr_Terminate
-    * restore the drm_state
-    * vaTerminate do more thing than other vaapi, need to look out
-    */
-    ctx->drm_state = vawr->drm_state[I965_DRV];
-
     /* free private driver data */
     free(vawr);
+    vawr = NULL;
     ctx->pDriverData = NULL;
 
     return vaStatus;
@@ -246,14 +498,10 @@ vawr_QueryConfigProfiles(VADriverContextP ctx,
                          int *num_profiles)             /* out */
 {
     VAStatus vaStatus;
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQueryConfigProfiles(DRV_CTX(vawr, drv), profile_list, num_profiles));
 
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQueryConfigProfiles(ctx, profile_list, num_profiles));
-    RESTORE_VAWRDATA(ctx, vawr);
-
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
     /* PSB_DRV has not published VP8 profile in QueryConfigProfiles yet,
      * that means we have to do it here.
      */
@@ -269,20 +517,17 @@ vawr_QueryConfigEntrypoints(VADriverContextP ctx,
                             int *num_entrypoints)               /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
+    int drv = VAWR_DRV(vawr);
+
     /* PSB_DRV currently only supports VLD entry point for VP8 */
     if (profile == VAProfileVP8Version0_3) {
-	*entrypoint_list = VAEntrypointVLD;
-	*num_entrypoints = 1;
-	WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return VA_STATUS_SUCCESS;
+        *entrypoint_list = VAEntrypointVLD;
+        *num_entrypoints = 1;
+        return VA_STATUS_SUCCESS;
     }
 
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQueryConfigEntrypoints(ctx, profile, entrypoint_list, num_entrypoints));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQueryConfigEntrypoints(DRV_CTX(vawr, drv), profile, entrypoint_list, num_entrypoints));
+    return vaStatus;
 }
 
 VAStatus
@@ -293,29 +538,26 @@ vawr_GetConfigAttributes(VADriverContextP ctx,
                          int num_attribs)
 {
     VAStatus vaStatus;
+    int drv = VAWR_DRV(vawr);
     int i;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
+
     /* PSB_DRV currently only supports VAConfigAttribRTFormat attribute type */
     if (profile == VAProfileVP8Version0_3) {
         for (i = 0; i < num_attribs; i++) {
-		switch (attrib_list[i].type) {
-		case VAConfigAttribRTFormat:
-			attrib_list[i].value = VA_RT_FORMAT_YUV420;
-			break;
-		default:
-			attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
-			break;
-		}
+            switch (attrib_list[i].type) {
+            case VAConfigAttribRTFormat:
+                attrib_list[i].value = VA_RT_FORMAT_YUV420;
+                break;
+            default:
+                attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
+                break;
+            }
         }
-        WRAPPER_UNLOCK(&vawr->vaapi_mutex);
         return VA_STATUS_SUCCESS;
     }
 
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaGetConfigAttributes(ctx, profile, entrypoint, attrib_list, num_attribs));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaGetConfigAttributes(DRV_CTX(vawr, drv), profile, entrypoint, attrib_list, num_attribs));
+    return vaStatus;
 }
 
 VAStatus
@@ -327,14 +569,10 @@ vawr_CreateConfig(VADriverContextP ctx,
                   VAConfigID *config_id)		/* out */
 {
     VAStatus vaStatus;
-    struct VADriverVTable *psb_vtable = NULL;
-    struct VADriverVTable * const vtable = ctx->vtable;
-    char *driver_name = "pvr";
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    if (profile == VAProfileVP8Version0_3) {
-	    vawr->profile = VAProfileVP8Version0_3;
+    int drv;
 
-    	/* This is the first time we learn about the config profile,
+    if (profile == VAProfileVP8Version0_3) {
+        /* This is the first time we learn about the config profile,
         * and we have to load psb_drv_video here if
         * a VP8 config is to be created.
         * Is this a good place to load psb_drv_video? We can
@@ -342,70 +580,31 @@ vawr_CreateConfig(VADriverContextP ctx,
         * but it could slow down init for process that doesn't
         * require VP8.
         */
-        psb_vtable = calloc(1, sizeof(*psb_vtable));
-        if (!psb_vtable) {
-            WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-            return VA_STATUS_ERROR_ALLOCATION_FAILED;
-        }
-
-        ctx->vtable = psb_vtable;
-
-        /*  drm_state will be freed at vawr_vaTerminate */
-        ctx->drm_state = malloc(sizeof(struct drm_state));
-        if (!(ctx->drm_state)) {
-		free(psb_vtable);
-		WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-            return VA_STATUS_ERROR_ALLOCATION_FAILED;
-        }
-        memset(ctx->drm_state, 0, sizeof(struct drm_state));
-
-        vaStatus = vawr_openDriver(ctx, driver_name);
-        if (VA_STATUS_SUCCESS == vaStatus) {
-            /* We have successfully initialized i965 video driver,
-             * Let's store i965's private driver data and vtable.
-             */
-            vawr->drv_data[PSB_DRV] = (void *)ctx->pDriverData;
-            vawr->drv_vtable[PSB_DRV] = psb_vtable;
-            vawr->drm_state[PSB_DRV] = ctx->drm_state;
-
-            /* Also restore the va's vtable */
-            ctx->vtable = vtable;
-
-            /* TODO: Shall we backup ctx structure? Some members like versions, max_num_profiles
-             * will be overwritten but are they still important? Most likely not.
-             * Let's not do it for now.
-             */
-        } else {
-            /*
-            * if open driver failed, context is invaild, cannot continue,
-            * restore ctx and return error
-            */
-            ctx->pDriverData = vawr->drv_data[I965_DRV];
-            ctx->vtable = vawr->drv_vtable[I965_DRV];
-            ctx->drm_state = vawr->drm_state[I965_DRV];
-            WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-            return VA_STATUS_ERROR_UNKNOWN;
+        WRAPPER_WRLOCK(vawr);
+        if (!vawr->drv_vtable[PSB_DRV]) {
+            vaStatus = vawr_loadPsbDriver();
+            if (VA_STATUS_SUCCESS != vaStatus) {
+                WRAPPER_UNLOCK(vawr);
+                return vaStatus;
+            }
         }
-
+        VAWR_SET_PROFILE(vawr, VAProfileVP8Version0_3);
+        WRAPPER_UNLOCK(vawr);
     }
 
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaCreateConfig(ctx, profile, entrypoint, attrib_list, num_attribs, config_id));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    drv = VAWR_DRV(vawr);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaCreateConfig(DRV_CTX(vawr, drv), profile, entrypoint, attrib_list, num_attribs, config_id));
+    return vaStatus;
 }
 
 VAStatus
 vawr_DestroyConfig(VADriverContextP ctx, VAConfigID config_id)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDestroyConfig(ctx, config_id));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDestroyConfig(DRV_CTX(vawr, drv), config_id));
+    return vaStatus;
 }
 
 VAStatus vawr_QueryConfigAttributes(VADriverContextP ctx,
@@ -416,12 +615,10 @@ VAStatus vawr_QueryConfigAttributes(VADriverContextP ctx,
                                     int *num_attribs)                   /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQueryConfigAttributes(ctx, config_id, profile, entrypoint, attrib_list, num_attribs));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQueryConfigAttributes(DRV_CTX(vawr, drv), config_id, profile, entrypoint, attrib_list, num_attribs));
+    return vaStatus;
 }
 
 VAStatus
@@ -435,19 +632,63 @@ vawr_CreateSurfaces(VADriverContextP ctx,
                     //unsigned int        num_attribs)      /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
+    vawr_surface_lookup_t *surface;
+    int i;
+
     // XXX, assume we have already got correct profile (vaCreateConfig is called before vaCreateSurface)
-    if (vawr->profile == VAProfileVP8Version0_3) {
-        RESTORE_PSBDATA(ctx, vawr);
-        vaStatus = vawr->drv_vtable[PSB_DRV]->vaCreateSurfaces2(ctx, format, width, height, surfaces, num_surfaces, NULL, 0);
-    } else {
-    RESTORE_I965DATA(ctx, vawr);
-    vaStatus = vawr->drv_vtable[I965_DRV]->vaCreateSurfaces(ctx, width, height, format, num_surfaces, surfaces);
+    if (VAWR_DRV(vawr) != PSB_DRV) {
+        CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaCreateSurfaces(DRV_CTX(vawr, I965_DRV), width, height, format, num_surfaces, surfaces));
+        return vaStatus;
+    }
+
+    CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaCreateSurfaces2(DRV_CTX(vawr, PSB_DRV), format, width, height, surfaces, num_surfaces, NULL, 0));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
+    /* The i965 side of a surface is only created when it is first displayed */
+    WRAPPER_WRLOCK(vawr);
+    for (i = 0; i < num_surfaces; i++) {
+        surface = calloc(1, sizeof *surface);
+        if (!surface || vawr_surface_map_insert(&vawr->pvr_surfaces, surfaces[i], surface)) {
+            free(surface);
+            vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
+            break;
+        }
+        surface->i965_surface = VA_INVALID_SURFACE;
+        surface->pvr_surface = surfaces[i];
+        surface->export_image = VA_INVALID_ID;
+        surface->width = width;
+        surface->height = height;
+    }
+    if (vaStatus != VA_STATUS_SUCCESS) {
+        while (i--) {
+            surface = vawr_surface_map_find(&vawr->pvr_surfaces, surfaces[i]);
+            vawr_surface_map_remove(&vawr->pvr_surfaces, surfaces[i]);
+            free(surface);
+        }
+        CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaDestroySurfaces(DRV_CTX(vawr, PSB_DRV), surfaces, num_surfaces));
+        vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
     }
+    WRAPPER_UNLOCK(vawr);
 
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    return vaStatus;
+}
+
+/* Drop the i965 import of a pvr surface, table_lock held for writing */
+static void
+vawr_unexportSurface(vawr_surface_lookup_t *surface)
+{
+    VAStatus vaStatus;
+
+    if (surface->i965_surface != VA_INVALID_SURFACE) {
+        vawr_surface_map_remove(&vawr->i965_surfaces, surface->i965_surface);
+        CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaDestroySurfaces(DRV_CTX(vawr, I965_DRV), &surface->i965_surface, 1));
+        surface->i965_surface = VA_INVALID_SURFACE;
+    }
+    if (surface->export_image != VA_INVALID_ID) {
+        CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaDestroyImage(DRV_CTX(vawr, PSB_DRV), surface->export_image));
+        surface->export_image = VA_INVALID_ID;
+    }
 }
 
 VAStatus
@@ -456,41 +697,134 @@ vawr_DestroySurfaces(VADriverContextP ctx,
                      int num_surfaces)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
-    vawr_surface_lookup_t *surface = NULL, *temp = NULL;
+    vawr_surface_lookup_t *surface = NULL;
     int i;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    if (vawr->profile == VAProfileVP8Version0_3) {
-        /* First destroy the PVR surfaces */
+
+    if (VAWR_DRV(vawr) == PSB_DRV) {
+        WRAPPER_WRLOCK(vawr);
         for (i=0; i<num_surfaces; i++) {
-            LIST_FOR_EACH_ENTRY_SAFE(surface, temp, &vawr->surfaces, link) {
-                if (surface->pvr_surface == surface_list[i]) {
-                    /* Restore the PVR's context for DestroySurfaces purpose */
-                    ctx->pDriverData = vawr->drv_data[PSB_DRV];
-                    vaStatus = vawr->drv_vtable[PSB_DRV]->vaDestroySurfaces(ctx, &surface->pvr_surface, 1);
-                    ctx->pDriverData = vawr->drv_data[I965_DRV];
-                    vaStatus = vawr->drv_vtable[I965_DRV]->vaDestroySurfaces(ctx, &surface->i965_surface, 1);
-                    surface->i965_surface = 0;
-                    surface->pvr_surface = 0;
-                    LIST_DEL(&surface->link);
-                    free(surface); /* surface will not be used, should be freed */
-                }
+            surface = vawr_surface_map_find(&vawr->pvr_surfaces, surface_list[i]);
+            if (surface) {
+                /* First drop the i965 import, then destroy the PVR surface */
+                vawr_unexportSurface(surface);
+                vawr_surface_map_remove(&vawr->pvr_surfaces, surface_list[i]);
+                free(surface); /* surface will not be used, should be freed */
             }
+            CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaDestroySurfaces(DRV_CTX(vawr, PSB_DRV), &surface_list[i], 1));
         }
-        RESTORE_VAWRDATA(ctx, vawr);
+        WRAPPER_UNLOCK(vawr);
     } else {
         /* destroy the i965 surfaces */
-        RESTORE_I965DATA(ctx, vawr);
-        vaStatus = vawr->drv_vtable[0]->vaDestroySurfaces(ctx, surface_list, num_surfaces);
-        RESTORE_VAWRDATA(ctx, vawr);
+        CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaDestroySurfaces(DRV_CTX(vawr, I965_DRV), surface_list, num_surfaces));
+    }
+    return vaStatus;
+}
+
+/*
+ * Export a PVR render target and import it into i965, so that i965 can
+ * display what PVR decodes, and record the surface id mapping.
+ * table_lock held for writing.
+ */
+static VAStatus
+vawr_exportSurface(vawr_surface_lookup_t *surface)
+{
+    VAStatus vaStatus;
+    VAStatus status;
+    VADriverContextP psb_ctx = DRV_CTX(vawr, PSB_DRV);
+    VADriverContextP i965_ctx = DRV_CTX(vawr, I965_DRV);
+    VAImage export_img;
+    VABufferInfo export_buf_info;
+    VASurfaceID surface_965;
+    VASurfaceAttrib surf_attr[2];
+    VASurfaceAttribExternalBuffers ext_buf;
+    unsigned long buffer;
+
+    CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaDeriveImage(psb_ctx, surface->pvr_surface, &export_img));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+    export_buf_info.mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
+    CALL_DRVVTABLE(vawr, PSB_DRV, vaStatus, vaAcquireBufferHandle(psb_ctx, export_img.buf, &export_buf_info));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        goto err;
+    buffer = export_buf_info.handle;
+
+    memset(&ext_buf, 0, sizeof(ext_buf));
+    ext_buf.buffers = &buffer;
+    ext_buf.data_size = export_img.data_size;
+    ext_buf.height = export_img.height;
+    ext_buf.width = export_img.width;
+    ext_buf.num_buffers = 1;
+    ext_buf.num_planes = export_img.num_planes;
+    ext_buf.pitches[0] = export_img.pitches[0];
+    ext_buf.pitches[1] = export_img.pitches[1];
+    ext_buf.pitches[2] = export_img.pitches[2];
+    ext_buf.pitches[3] = 0;
+    ext_buf.offsets[0] = export_img.offsets[0];
+    ext_buf.offsets[1] = export_img.offsets[1];
+    ext_buf.offsets[2] = export_img.offsets[2];
+    ext_buf.offsets[3] = 0;
+    ext_buf.pixel_format = export_img.format.fourcc;
+    surf_attr[0].type = VASurfaceAttribMemoryType;
+    surf_attr[0].flags = VA_SURFACE_ATTRIB_SETTABLE;
+    surf_attr[0].value.type = VAGenericValueTypeInteger;
+    surf_attr[0].value.value.i = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
+    surf_attr[1].type = VASurfaceAttribExternalBufferDescriptor;
+    surf_attr[1].flags = VA_SURFACE_ATTRIB_SETTABLE;
+    surf_attr[1].value.type = VAGenericValueTypePointer;
+    surf_attr[1].value.value.p = (void*)&ext_buf;
+
+    /* import 965 fd and create ipvr surface */
+    CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaCreateSurfaces2(
+        i965_ctx,
+        VA_RT_FORMAT_YUV420, export_img.width, VAWR_EXPORT_HEIGHT(export_img.height),
+        &surface_965, 1,
+        surf_attr, 2
+    ));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        goto err;
+
+    /* Find a way to store the returned surface_id with correct mapping of i965's surface_id,
+     * since all future surface_id communicated between application and wrappre is i965's
+     * while one communicated between wrapper and pvr driver is pvr's.
+     */
+    if (vawr_surface_map_insert(&vawr->i965_surfaces, surface_965, surface)) {
+        CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaDestroySurfaces(i965_ctx, &surface_965, 1));
+        vaStatus = VA_STATUS_ERROR_ALLOCATION_FAILED;
+        goto err;
     }
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
+    surface->i965_surface = surface_965;
+    surface->export_image = export_img.image_id;
+
+    return VA_STATUS_SUCCESS;
+
+err:
+    CALL_DRVVTABLE(vawr, PSB_DRV, status, vaDestroyImage(psb_ctx, export_img.image_id));
     return vaStatus;
 }
 
-VAImage * m_export_img = NULL;
-VABufferInfo * m_export_buf_info = NULL;
-VASurfaceID	surface_id = 0;
-VASurfaceID*  m_Surfaces_965 = NULL;
+/* Make sure a PVR surface has its i965 counterpart, on first display */
+static VAStatus
+vawr_importSurface(VASurfaceID pvr_surface)
+{
+    VAStatus vaStatus = VA_STATUS_SUCCESS;
+    vawr_surface_lookup_t *surface;
+    int imported;
+
+    WRAPPER_RDLOCK(vawr);
+    surface = vawr_surface_map_find(&vawr->pvr_surfaces, pvr_surface);
+    imported = !surface || surface->i965_surface != VA_INVALID_SURFACE;
+    WRAPPER_UNLOCK(vawr);
+    if (imported)
+        return VA_STATUS_SUCCESS;
+
+    WRAPPER_WRLOCK(vawr);
+    surface = vawr_surface_map_find(&vawr->pvr_surfaces, pvr_surface);
+    if (surface && surface->i965_surface == VA_INVALID_SURFACE)
+        vaStatus = vawr_exportSurface(surface);
+    WRAPPER_UNLOCK(vawr);
+
+    return vaStatus;
+}
 
 VAStatus
 vawr_CreateContext(VADriverContextP ctx,
@@ -503,168 +837,81 @@ vawr_CreateContext(VADriverContextP ctx,
                    VAContextID *context)                /* out */
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_targets[num_render_targets];
+    vawr_context_lookup_t *context_lookup;
+    vawr_surface_lookup_t *surface;
+    int drv = VAWR_DRV(vawr);
     int i;
 
-
-	//int rendertarget_i;
-	VASurfaceAttrib surf_attr[2];
-	VASurfaceAttribExternalBuffers ext_buf;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    /* If config profile is VP8, we have to map the render targets into pvr driver's TTM
-     * Since config_id is opague to wrapper (at least for now), we can only check vawr->profile
+    /* If config profile is VP8, the render targets are exported to i965 lazily,
+     * see vawr_importSurface(). Exports are kept across context re-creation,
+     * unless the resolution changes. Heights are compared as exported, so
+     * a 1920x1088 context keeps the export of a 1920x1080 surface.
      */
-	if (vawr->profile == VAProfileVP8Version0_3) {
-		vawr_surface_lookup_t *surface;
-		LIST_INIT(&vawr->surfaces);
-
-		ext_buf.buffers = malloc((num_render_targets) * sizeof(unsigned long));
-		m_export_img = malloc((num_render_targets) * sizeof(VAImage));
-		m_export_buf_info = malloc((num_render_targets) * sizeof(VABufferInfo));
-		if (ext_buf.buffers == NULL || m_export_img == NULL || m_export_buf_info == NULL) {
-			if (ext_buf.buffers) free(ext_buf.buffers);
-			if (m_export_img) free(m_export_img);
-			if (m_export_buf_info) free(m_export_buf_info);
-			RESTORE_VAWRDATA(ctx, vawr);
-			WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-			return VA_STATUS_ERROR_ALLOCATION_FAILED;
-		}
-
-		RESTORE_PSBDATA(ctx, vawr);
-		for (i=0; i<num_render_targets; i++)
-		{
-			    vaStatus = vawr->drv_vtable[PSB_DRV]->vaDeriveImage(ctx, render_targets[i], &m_export_img[i]);
-			    if (vaStatus != VA_STATUS_SUCCESS) {
-				free(ext_buf.buffers);
-				free(m_export_img);
-				free(m_export_buf_info);
-				RESTORE_VAWRDATA(ctx, vawr);
-				WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-
-					return vaStatus;
-			    }
-			    m_export_buf_info[i].mem_type = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
-			    vaStatus = vawr->drv_vtable[PSB_DRV]->vaAcquireBufferHandle(ctx, m_export_img[i].buf, &m_export_buf_info[i]);
-			    if (vaStatus != VA_STATUS_SUCCESS) {
-				free(ext_buf.buffers);
-				free(m_export_img);
-				free(m_export_buf_info);
-				RESTORE_VAWRDATA(ctx, vawr);
-				WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-
-					return vaStatus;
-				}
-			    ext_buf.buffers[i] = m_export_buf_info[i].handle;
-
-		}
-
-		ext_buf.data_size = m_export_img[0].data_size;
-		printf("exported data size is 0x%x\n", ext_buf.data_size);
-		ext_buf.height = m_export_img[0].height;
-		ext_buf.width = m_export_img[0].width;
-		ext_buf.num_buffers = num_render_targets;
-		ext_buf.num_planes = m_export_img[0].num_planes;
-		ext_buf.pitches[0] = m_export_img[0].pitches[0];
-		ext_buf.pitches[1] = m_export_img[0].pitches[1];
-		ext_buf.pitches[2] = m_export_img[0].pitches[2];
-		ext_buf.pitches[3] = 0;
-		ext_buf.offsets[0] = m_export_img[0].offsets[0];
-		ext_buf.offsets[1] = m_export_img[0].offsets[1];
-		ext_buf.offsets[2] = m_export_img[0].offsets[2];
-		ext_buf.offsets[3] = 0;
-		ext_buf.pixel_format = m_export_img[0].format.fourcc;
-		surf_attr[0].type = VASurfaceAttribMemoryType;
-		surf_attr[0].flags = VA_SURFACE_ATTRIB_SETTABLE;
-		surf_attr[0].value.type = VAGenericValueTypeInteger;
-		surf_attr[0].value.value.i = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
-		surf_attr[1].type = VASurfaceAttribExternalBufferDescriptor;
-		surf_attr[1].flags = VA_SURFACE_ATTRIB_SETTABLE;
-		surf_attr[1].value.type = VAGenericValueTypePointer;
-		surf_attr[1].value.value.p = (void*)&ext_buf;
-
-		/* import 965 fd and create ipvr surface */
-		RESTORE_I965DATA(ctx, vawr);
-
-		m_Surfaces_965 = malloc((num_render_targets) * sizeof(VASurfaceID));
-		if (m_Surfaces_965 == NULL) {
-			free(ext_buf.buffers);
-			free(m_export_img);
-			free(m_export_buf_info);
-			RESTORE_VAWRDATA(ctx, vawr);
-			WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-			return VA_STATUS_ERROR_ALLOCATION_FAILED;
-		}
-
-		vaStatus = vawr->drv_vtable[I965_DRV]->vaCreateSurfaces2(
-		    ctx,
-		    VA_RT_FORMAT_YUV420, m_export_img[0].width, ((m_export_img[0].height + 32 - 1) & ~(32 - 1)),
-		    //&surface_id, 1,
-		    m_Surfaces_965, num_render_targets,
-		    surf_attr, 2
-		);
-
-		free(ext_buf.buffers);
-		free(m_export_img);
-		free(m_export_buf_info);
-
-		if (vaStatus == VA_STATUS_SUCCESS)
-		{
-			for (i=0; i<num_render_targets; i++)
-			{
-
-				/* Find a way to store the returned surface_id with correct mapping of i965's surface_id,
-				 * since all future surface_id communicated between application and wrappre is i965's
-				 * while one communicated between wrapper and pvr driver is pvr's.
-				 */
-				surface = calloc(1, sizeof *surface);
-				if (!surface) {
-				    RESTORE_VAWRDATA(ctx, vawr);
-					    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-					return VA_STATUS_ERROR_ALLOCATION_FAILED;
-				}
-
-				surface->i965_surface = m_Surfaces_965[i];
-				surface->pvr_surface =  render_targets[i];
-				LIST_ADD(&surface->link,&vawr->surfaces);
-
-				/* render_targets is pvr's surface_id from here on */
-				vawr_render_targets[i] = render_targets[i];
-			}
-
-			free(m_Surfaces_965);
-		}
-		else
-		{
-		    free(m_Surfaces_965);
-		    RESTORE_VAWRDATA(ctx, vawr);
-		    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-			return vaStatus;
-		}
-	}
-
-	RESTORE_DRVDATA(ctx, vawr);
-
-	if (vawr->profile == VAProfileVP8Version0_3) {
-	    CALL_DRVVTABLE(vawr, vaStatus, vaCreateContext(ctx, config_id, picture_width, picture_height, flag, vawr_render_targets, num_render_targets, context));
-	} else {
-	    CALL_DRVVTABLE(vawr, vaStatus, vaCreateContext(ctx, config_id, picture_width, picture_height, flag, render_targets, num_render_targets, context));
-	}
-
-	RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    if (drv == PSB_DRV) {
+        WRAPPER_WRLOCK(vawr);
+        for (i=0; i<num_render_targets; i++) {
+            surface = vawr_surface_map_find(&vawr->pvr_surfaces, render_targets[i]);
+            if (!surface)
+                continue;
+            if (surface->width != picture_width ||
+                VAWR_EXPORT_HEIGHT(surface->height) != VAWR_EXPORT_HEIGHT(picture_height)) {
+                vawr_unexportSurface(surface);
+                surface->width = picture_width;
+                surface->height = picture_height;
+            }
+        }
+        WRAPPER_UNLOCK(vawr);
+    }
+
+    /* render_targets is pvr's surface_id from here on */
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaCreateContext(DRV_CTX(vawr, drv), config_id, picture_width, picture_height, flag, render_targets, num_render_targets, context));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
+    context_lookup = calloc(1, sizeof *context_lookup);
+    if (!context_lookup) {
+        CALL_DRVVTABLE(vawr, drv, vaStatus, vaDestroyContext(DRV_CTX(vawr, drv), *context));
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    }
+    context_lookup->context = *context;
+    context_lookup->refcount = 1;
+    pthread_mutex_init(&context_lookup->lock, NULL);
+
+    WRAPPER_WRLOCK(vawr);
+    LIST_ADD(&context_lookup->link, &vawr->contexts);
+    WRAPPER_UNLOCK(vawr);
+
+    return vaStatus;
 }
 
 VAStatus
 vawr_DestroyContext(VADriverContextP ctx, VAContextID context)
 {
     VAStatus vaStatus;
+    vawr_context_lookup_t *context_lookup = NULL, *found = NULL;
+    int drv = VAWR_DRV(vawr);
+
+    WRAPPER_WRLOCK(vawr);
+    LIST_FOR_EACH_ENTRY(context_lookup, &vawr->contexts, link) {
+        if (context_lookup->context == context) {
+            found = context_lookup;
+            LIST_DEL(&found->link);
+            break;
+        }
+    }
+    WRAPPER_UNLOCK(vawr);
+
+    /* let a picture still being submitted on the context finish */
+    if (found)
+        pthread_mutex_lock(&found->lock);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDestroyContext(DRV_CTX(vawr, drv), context));
+    if (found) {
+        pthread_mutex_unlock(&found->lock);
+        /* the contexts list's reference */
+        vawr_putContext(found);
+    }
 
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDestroyContext(ctx, context));
-    RESTORE_VAWRDATA(ctx, vawr);
-
-	return vaStatus;
+    return vaStatus;
 }
 
 VAStatus
@@ -677,23 +924,26 @@ vawr_CreateBuffer(VADriverContextP ctx,
                   VABufferID *buf_id)           /* out */
 {
     VAStatus vaStatus;
+    vawr_context_lookup_t *context_lookup;
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaCreateBuffer(ctx, context, type, size, num_elements, data, buf_id));
-    RESTORE_VAWRDATA(ctx, vawr);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaCreateBuffer(DRV_CTX(vawr, drv), context, type, size, num_elements, data, buf_id));
 
     /* For now, let's track the VP8's VAPictureParameterBufferType buf_id so that we can overwrite the
      * i965's VASurfaceID embedded in the picture parameter with pvr's. This is a dirty hack until we
      * find a better way to deal with surface_id.
      */
-	if (vawr->profile == VAProfileVP8Version0_3) {
-		if (type == VAPictureParameterBufferType) {
-			vawr->pic_param_buf_id = *buf_id;
-		}
-	}
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    if (drv == PSB_DRV && type == VAPictureParameterBufferType &&
+        vaStatus == VA_STATUS_SUCCESS) {
+        context_lookup = vawr_lookupContext(context);
+        if (context_lookup) {
+            pthread_mutex_lock(&context_lookup->lock);
+            context_lookup->pic_param_buf_id = *buf_id;
+            pthread_mutex_unlock(&context_lookup->lock);
+            vawr_putContext(context_lookup);
+        }
+    }
+    return vaStatus;
 }
 
 VAStatus
@@ -702,12 +952,10 @@ vawr_BufferSetNumElements(VADriverContextP ctx,
                           unsigned int num_elements)   /* in */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaBufferSetNumElements(ctx, buf_id, num_elements));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaBufferSetNumElements(DRV_CTX(vawr, drv), buf_id, num_elements));
+    return vaStatus;
 }
 
 VAStatus
@@ -718,11 +966,9 @@ vawr_BufferInfo(VADriverContextP ctx,
     unsigned int *num_elements) /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaBufferInfo(ctx, buf_id, type, size, num_elements));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaBufferInfo(DRV_CTX(vawr, drv), buf_id, type, size, num_elements));
     return vaStatus;
 }
 
@@ -732,38 +978,30 @@ vawr_MapBuffer(VADriverContextP ctx,
                void **pbuf)             /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaMapBuffer(ctx, buf_id, pbuf));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaMapBuffer(DRV_CTX(vawr, drv), buf_id, pbuf));
+    return vaStatus;
 }
 
 VAStatus
 vawr_UnmapBuffer(VADriverContextP ctx, VABufferID buf_id)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaUnmapBuffer(ctx, buf_id));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaUnmapBuffer(DRV_CTX(vawr, drv), buf_id));
+    return vaStatus;
 }
 
 VAStatus
 vawr_DestroyBuffer(VADriverContextP ctx, VABufferID buffer_id)
 {
     VAStatus vaStatus;
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDestroyBuffer(ctx, buffer_id));
-    RESTORE_VAWRDATA(ctx, vawr);
-
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDestroyBuffer(DRV_CTX(vawr, drv), buffer_id));
+    return vaStatus;
 }
 
 VAStatus
@@ -772,18 +1010,21 @@ vawr_BeginPicture(VADriverContextP ctx,
                   VASurfaceID render_target)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
+    VASurfaceID vawr_render_target;
+    vawr_context_lookup_t *context_lookup = vawr_lookupContext(context);
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, render_target, vawr_render_target);
+    if (context_lookup)
+        pthread_mutex_lock(&context_lookup->lock);
+    vawr_render_target = vawr_lookupSurface(drv, render_target);
     //vawr_infoMessage("vawr_BeginPicture: render_target %d\n", render_target);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaBeginPicture(ctx, context, vawr_render_target));
-    RESTORE_VAWRDATA(ctx, vawr);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaBeginPicture(DRV_CTX(vawr, drv), context, vawr_render_target));
+    if (context_lookup) {
+        pthread_mutex_unlock(&context_lookup->lock);
+        vawr_putContext(context_lookup);
+    }
 
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    return vaStatus;
 }
 
 VAStatus
@@ -793,52 +1034,63 @@ vawr_RenderPicture(VADriverContextP ctx,
                    int num_buffers)
 {
     VAStatus vaStatus;
-    VAPictureParameterBufferVP8 * const pic_param;
+    VAPictureParameterBufferVP8 * pic_param;
+    vawr_context_lookup_t *context_lookup = vawr_lookupContext(context);
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
+    if (context_lookup)
+        pthread_mutex_lock(&context_lookup->lock);
 
     /* For now, let's track the VP8's VAPictureParameterBufferType buf_id so that we can overwrite the
      * i965's VASurfaceID embedded in the picture parameter with pvr's. This is a dirty hack until we
      * find a better way to deal with surface_id.
      */
-	if (vawr->profile == VAProfileVP8Version0_3) {
-	    if (vawr->pic_param_buf_id) {
-	        vawr_surface_lookup_t *surface_lookup = NULL;
-
-		CALL_DRVVTABLE(vawr, vaStatus, vaMapBuffer(ctx, vawr->pic_param_buf_id, (void **)&pic_param));
-		/* Ok we have the picture parameter, let's translate parameters with surface_id */
-			LIST_FOR_EACH_ENTRY(surface_lookup, &vawr->surfaces, link) {
-					if (surface_lookup->i965_surface == pic_param->last_ref_frame)
-						pic_param->last_ref_frame = surface_lookup->pvr_surface;
-					if (surface_lookup->i965_surface == pic_param->golden_ref_frame)
-						pic_param->golden_ref_frame = surface_lookup->pvr_surface;
-					if (surface_lookup->i965_surface == pic_param->alt_ref_frame)
-						pic_param->alt_ref_frame = surface_lookup->pvr_surface;
-			}
-		CALL_DRVVTABLE(vawr, vaStatus, vaUnmapBuffer(ctx, vawr->pic_param_buf_id));
-		vawr->pic_param_buf_id = 0;
-	    }
-	}
-    CALL_DRVVTABLE(vawr, vaStatus, vaRenderPicture(ctx, context, buffers, num_buffers));
-    RESTORE_VAWRDATA(ctx, vawr);
-
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    if (drv == PSB_DRV && context_lookup && context_lookup->pic_param_buf_id) {
+        vawr_surface_lookup_t *surface_lookup = NULL;
+
+        CALL_DRVVTABLE(vawr, drv, vaStatus, vaMapBuffer(DRV_CTX(vawr, drv), context_lookup->pic_param_buf_id, (void **)&pic_param));
+        if (vaStatus == VA_STATUS_SUCCESS) {
+            /* Ok we have the picture parameter, let's translate parameters with surface_id */
+            WRAPPER_RDLOCK(vawr);
+            surface_lookup = vawr_surface_map_find(&vawr->i965_surfaces, pic_param->last_ref_frame);
+            if (surface_lookup)
+                pic_param->last_ref_frame = surface_lookup->pvr_surface;
+            surface_lookup = vawr_surface_map_find(&vawr->i965_surfaces, pic_param->golden_ref_frame);
+            if (surface_lookup)
+                pic_param->golden_ref_frame = surface_lookup->pvr_surface;
+            surface_lookup = vawr_surface_map_find(&vawr->i965_surfaces, pic_param->alt_ref_frame);
+            if (surface_lookup)
+                pic_param->alt_ref_frame = surface_lookup->pvr_surface;
+            WRAPPER_UNLOCK(vawr);
+            CALL_DRVVTABLE(vawr, drv, vaStatus, vaUnmapBuffer(DRV_CTX(vawr, drv), context_lookup->pic_param_buf_id));
+        }
+        context_lookup->pic_param_buf_id = 0;
+    }
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaRenderPicture(DRV_CTX(vawr, drv), context, buffers, num_buffers));
+
+    if (context_lookup) {
+        pthread_mutex_unlock(&context_lookup->lock);
+        vawr_putContext(context_lookup);
+    }
+    return vaStatus;
 }
 
 VAStatus
 vawr_EndPicture(VADriverContextP ctx, VAContextID context)
 {
     VAStatus vaStatus;
+    vawr_context_lookup_t *context_lookup = vawr_lookupContext(context);
+    int drv = VAWR_DRV(vawr);
+
+    if (context_lookup)
+        pthread_mutex_lock(&context_lookup->lock);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaEndPicture(DRV_CTX(vawr, drv), context));
+    if (context_lookup) {
+        pthread_mutex_unlock(&context_lookup->lock);
+        vawr_putContext(context_lookup);
+    }
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaEndPicture(ctx, context));
-    RESTORE_VAWRDATA(ctx, vawr);
-
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    return vaStatus;
 }
 
 VAStatus
@@ -846,17 +1098,13 @@ vawr_SyncSurface(VADriverContextP ctx,
                  VASurfaceID render_target)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
+    VASurfaceID vawr_render_target;
+    int drv = VAWR_DRV(vawr);
 
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, render_target, vawr_render_target);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSyncSurface(ctx, vawr_render_target));
-    RESTORE_VAWRDATA(ctx, vawr);
+    vawr_render_target = vawr_lookupSurface(drv, render_target);
+    CALL_DRVVTABLE_UNLOCKED(vawr, drv, vaStatus, vaSyncSurface(DRV_CTX(vawr, drv), vawr_render_target));
 
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    return vaStatus;
 }
 
 VAStatus
@@ -865,15 +1113,13 @@ vawr_QuerySurfaceStatus(VADriverContextP ctx,
                         VASurfaceStatus *status)        /* out */
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, render_target, vawr_render_target);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQuerySurfaceStatus(ctx, vawr_render_target, status));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    VASurfaceID vawr_render_target;
+    int drv = VAWR_DRV(vawr);
+
+    vawr_render_target = vawr_lookupSurface(drv, render_target);
+    CALL_DRVVTABLE_UNLOCKED(vawr, drv, vaStatus, vaQuerySurfaceStatus(DRV_CTX(vawr, drv), vawr_render_target, status));
+
+    return vaStatus;
 }
 
 VAStatus
@@ -893,19 +1139,21 @@ vawr_PutSurface(VADriverContextP ctx,
                 unsigned int flags) /* de-interlacing flags */
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID_I965(vawr, surface_lookup, render_target, vawr_render_target);
-
-	/* Rendering should always be done via i965 *//* change to psb surface  */
-	ctx->pDriverData = vawr->drv_data[I965_DRV];
-	ctx->drm_state = vawr->drm_state[I965_DRV];
-	vaStatus = vawr->drv_vtable[0]->vaPutSurface(ctx, vawr_render_target, draw, srcx, srcy, srcw, srch, destx, desty, destw, desth, cliprects, number_cliprects, flags);
-    RESTORE_VAWRDATA(ctx, vawr);
-
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    VASurfaceID vawr_render_target;
+    int drv = VAWR_DRV(vawr);
+
+    if (drv == PSB_DRV) {
+        vaStatus = vawr_importSurface(render_target);
+        if (vaStatus != VA_STATUS_SUCCESS)
+            return vaStatus;
+    }
+
+    vawr_render_target = vawr_lookupSurfaceI965(drv, render_target);
+
+    /* Rendering should always be done via i965 *//* change to psb surface  */
+    CALL_DRVVTABLE(vawr, I965_DRV, vaStatus, vaPutSurface(DRV_CTX(vawr, I965_DRV), vawr_render_target, draw, srcx, srcy, srcw, srch, destx, desty, destw, desth, cliprects, number_cliprects, flags));
+
+    return vaStatus;
 }
 
 VAStatus
@@ -914,45 +1162,50 @@ vawr_QueryImageFormats(VADriverContextP ctx,
                        int *num_formats)                /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQueryImageFormats(ctx, format_list, num_formats));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQueryImageFormats(DRV_CTX(vawr, drv), format_list, num_formats));
+    return vaStatus;
 }
 
-VAStatus
-vawr_CreateImage(VADriverContextP ctx,
-                 VAImageFormat *format,
-                 int width,
-                 int height,
-                 VAImage *out_image)        /* out */
+/* Remember which backend owns an image, so that it is destroyed there */
+static VAStatus
+vawr_addImage(VAImageID image_id, int owner)
 {
-    VAStatus vaStatus;
     vawr_image_lookup_t *image;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaCreateImage(ctx, format, width, height, out_image));
 
     /* Find a way to store the returned image with who create it,
      * the image should be destroied by who create it
      * avoid that image created by i965 but destroied by psb
      */
     image = calloc(1, sizeof *image);
-    if (!image) {
-        RESTORE_VAWRDATA(ctx, vawr);
-        WRAPPER_UNLOCK(&vawr->vaapi_mutex);
+    if (!image)
         return VA_STATUS_ERROR_ALLOCATION_FAILED;
-    }
 
-    image->image = out_image->image_id;
-    image->owner =  ((vawr->profile == VAProfileVP8Version0_3) ? PSB_DRV : I965_DRV);
+    image->image = image_id;
+    image->owner = owner;
+    WRAPPER_WRLOCK(vawr);
     LIST_ADD(&image->link,&vawr->images);
+    WRAPPER_UNLOCK(vawr);
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+vawr_CreateImage(VADriverContextP ctx,
+                 VAImageFormat *format,
+                 int width,
+                 int height,
+                 VAImage *out_image)        /* out */
+{
+    VAStatus vaStatus;
+    int drv = VAWR_DRV(vawr);
 
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaCreateImage(DRV_CTX(vawr, drv), format, width, height, out_image));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
+    return vawr_addImage(out_image->image_id, drv);
 }
 
 VAStatus vawr_DeriveImage(VADriverContextP ctx,
@@ -960,48 +1213,39 @@ VAStatus vawr_DeriveImage(VADriverContextP ctx,
                           VAImage *out_image)        /* out */
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_surface = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    vawr_image_lookup_t *image;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, surface, vawr_surface);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDeriveImage(ctx, vawr_surface, out_image));
+    VASurfaceID vawr_surface;
+    int drv = VAWR_DRV(vawr);
 
-    image = calloc(1, sizeof *image);
-    if (!image) {
-        RESTORE_VAWRDATA(ctx, vawr);
-        WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-        return VA_STATUS_ERROR_ALLOCATION_FAILED;
-    }
+    vawr_surface = vawr_lookupSurface(drv, surface);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDeriveImage(DRV_CTX(vawr, drv), vawr_surface, out_image));
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
 
-    image->image = out_image->image_id;
-    image->owner =  ((vawr->profile == VAProfileVP8Version0_3) ? PSB_DRV : I965_DRV);
-    LIST_ADD(&image->link,&vawr->images);
-
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-    return vaStatus;
+    return vawr_addImage(out_image->image_id, drv);
 }
 
 VAStatus
 vawr_DestroyImage(VADriverContextP ctx, VAImageID image)
 {
     VAStatus vaStatus = VA_STATUS_SUCCESS;
-    vawr_image_lookup_t *image_lookup = NULL, *temp = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    LIST_FOR_EACH_ENTRY_SAFE(image_lookup, temp, &vawr->images, link) {
+    vawr_image_lookup_t *image_lookup = NULL, *found = NULL;
+
+    WRAPPER_WRLOCK(vawr);
+    LIST_FOR_EACH_ENTRY(image_lookup, &vawr->images, link) {
         if (image_lookup->image == image) {
-            /* Restore the PVR's context for DestroyImage purpose */
-            ctx->pDriverData = vawr->drv_data[image_lookup->owner];
-            vaStatus = vawr->drv_vtable[image_lookup->owner]->vaDestroyImage(ctx, image);
-            LIST_DEL(&image_lookup->link);
-            free(image_lookup);
+            found = image_lookup;
+            LIST_DEL(&found->link);
+            break;
         }
     }
+    WRAPPER_UNLOCK(vawr);
+
+    if (found) {
+        /* the image should be destroied by who create it */
+        CALL_DRVVTABLE(vawr, found->owner, vaStatus, vaDestroyImage(DRV_CTX(vawr, found->owner), image));
+        free(found);
+    }
 
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
     return vaStatus;
 }
 
@@ -1011,12 +1255,10 @@ vawr_SetImagePalette(VADriverContextP ctx,
                      unsigned char *palette)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSetImagePalette(ctx, image, palette));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaSetImagePalette(DRV_CTX(vawr, drv), image, palette));
+    return vaStatus;
 }
 
 VAStatus
@@ -1029,15 +1271,12 @@ vawr_GetImage(VADriverContextP ctx,
               VAImageID image)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_surface = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, surface, vawr_surface);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaGetImage(ctx, vawr_surface, x, y, width, height, image));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    VASurfaceID vawr_surface;
+    int drv = VAWR_DRV(vawr);
+
+    vawr_surface = vawr_lookupSurface(drv, surface);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaGetImage(DRV_CTX(vawr, drv), vawr_surface, x, y, width, height, image));
+    return vaStatus;
 }
 
 VAStatus
@@ -1054,15 +1293,12 @@ vawr_PutImage(VADriverContextP ctx,
               unsigned int dest_height)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_surface = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, surface, vawr_surface);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaPutImage(ctx, vawr_surface, image, src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    VASurfaceID vawr_surface;
+    int drv = VAWR_DRV(vawr);
+
+    vawr_surface = vawr_lookupSurface(drv, surface);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaPutImage(DRV_CTX(vawr, drv), vawr_surface, image, src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height));
+    return vaStatus;
 }
 
 VAStatus
@@ -1072,12 +1308,10 @@ vawr_QuerySubpictureFormats(VADriverContextP ctx,
                             unsigned int *num_formats)          /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQuerySubpictureFormats(ctx, format_list, flags, num_formats));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQuerySubpictureFormats(DRV_CTX(vawr, drv), format_list, flags, num_formats));
+    return vaStatus;
 }
 
 VAStatus
@@ -1086,12 +1320,10 @@ vawr_CreateSubpicture(VADriverContextP ctx,
                       VASubpictureID *subpicture)         /* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaCreateSubpicture(ctx, image, subpicture));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaCreateSubpicture(DRV_CTX(vawr, drv), image, subpicture));
+    return vaStatus;
 }
 
 VAStatus
@@ -1099,12 +1331,10 @@ vawr_DestroySubpicture(VADriverContextP ctx,
                        VASubpictureID subpicture)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDestroySubpicture(ctx, subpicture));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDestroySubpicture(DRV_CTX(vawr, drv), subpicture));
+    return vaStatus;
 }
 
 VAStatus
@@ -1113,12 +1343,10 @@ vawr_SetSubpictureImage(VADriverContextP ctx,
                         VAImageID image)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSetSubpictureImage(ctx, subpicture, image));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaSetSubpictureImage(DRV_CTX(vawr, drv), subpicture, image));
+    return vaStatus;
 }
 
 VAStatus
@@ -1129,12 +1357,10 @@ vawr_SetSubpictureChromakey(VADriverContextP ctx,
                             unsigned int chromakey_mask)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSetSubpictureChromakey(ctx, subpicture, chromakey_min, chromakey_max, chromakey_mask));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaSetSubpictureChromakey(DRV_CTX(vawr, drv), subpicture, chromakey_min, chromakey_max, chromakey_mask));
+    return vaStatus;
 }
 
 VAStatus
@@ -1143,12 +1369,10 @@ vawr_SetSubpictureGlobalAlpha(VADriverContextP ctx,
                               float global_alpha)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSetSubpictureGlobalAlpha(ctx, subpicture, global_alpha));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaSetSubpictureGlobalAlpha(DRV_CTX(vawr, drv), subpicture, global_alpha));
+    return vaStatus;
 }
 
 VAStatus
@@ -1171,12 +1395,10 @@ vawr_AssociateSubpicture(VADriverContextP ctx,
                          unsigned int flags)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaAssociateSubpicture(ctx, subpicture, target_surfaces, num_surfaces, src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height, flags));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaAssociateSubpicture(DRV_CTX(vawr, drv), subpicture, target_surfaces, num_surfaces, src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height, flags));
+    return vaStatus;
 }
 
 VAStatus
@@ -1186,12 +1408,10 @@ vawr_DeassociateSubpicture(VADriverContextP ctx,
                            int num_surfaces)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaDeassociateSubpicture(ctx, subpicture, target_surfaces, num_surfaces));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
+
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaDeassociateSubpicture(DRV_CTX(vawr, drv), subpicture, target_surfaces, num_surfaces));
+    return vaStatus;
 }
 
 VAStatus
@@ -1200,13 +1420,10 @@ vawr_QueryDisplayAttributes(VADriverContextP ctx,
                             int *num_attributes)		/* out */
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaQueryDisplayAttributes(ctx, attr_list, num_attributes));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
 
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaQueryDisplayAttributes(DRV_CTX(vawr, drv), attr_list, num_attributes));
+    return vaStatus;
 }
 
 VAStatus
@@ -1215,13 +1432,10 @@ vawr_GetDisplayAttributes(VADriverContextP ctx,
                           int num_attributes)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaGetDisplayAttributes(ctx, attr_list, num_attributes));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
 
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaGetDisplayAttributes(DRV_CTX(vawr, drv), attr_list, num_attributes));
+    return vaStatus;
 }
 
 VAStatus
@@ -1230,13 +1444,10 @@ vawr_SetDisplayAttributes(VADriverContextP ctx,
                           int num_attributes)
 {
     VAStatus vaStatus;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaSetDisplayAttributes(ctx, attr_list, num_attributes));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
-	return vaStatus;
+    int drv = VAWR_DRV(vawr);
 
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaSetDisplayAttributes(DRV_CTX(vawr, drv), attr_list, num_attributes));
+    return vaStatus;
 }
 
 VAStatus vawr_LockSurface(VADriverContextP ctx,
@@ -1252,15 +1463,11 @@ VAStatus vawr_LockSurface(VADriverContextP ctx,
     void **buffer)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, surface, vawr_render_target);
-
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaLockSurface(ctx, vawr_render_target, fourcc, luma_stride, chroma_u_stride, chroma_v_stride, luma_offset, chroma_u_offset, chroma_v_offset, buffer_name, buffer));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
+    VASurfaceID vawr_render_target;
+    int drv = VAWR_DRV(vawr);
+
+    vawr_render_target = vawr_lookupSurface(drv, surface);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaLockSurface(DRV_CTX(vawr, drv), vawr_render_target, fourcc, luma_stride, chroma_u_stride, chroma_v_stride, luma_offset, chroma_u_offset, chroma_v_offset, buffer_name, buffer));
     return vaStatus;
 }
 
@@ -1269,15 +1476,11 @@ VAStatus vawr_UnlockSurface(VADriverContextP ctx,
     VASurfaceID surface)
 {
     VAStatus vaStatus;
-    VASurfaceID vawr_render_target = 0;
-    vawr_surface_lookup_t *surface_lookup = NULL;
-    WRAPPER_LOCK(&vawr->vaapi_mutex);
-    GET_SURFACEID(vawr, surface_lookup, surface, vawr_render_target);
-
-    RESTORE_DRVDATA(ctx, vawr);
-    CALL_DRVVTABLE(vawr, vaStatus, vaUnlockSurface( ctx, vawr_render_target));
-    RESTORE_VAWRDATA(ctx, vawr);
-    WRAPPER_UNLOCK(&vawr->vaapi_mutex);
+    VASurfaceID vawr_render_target;
+    int drv = VAWR_DRV(vawr);
+
+    vawr_render_target = vawr_lookupSurface(drv, surface);
+    CALL_DRVVTABLE(vawr, drv, vaStatus, vaUnlockSurface(DRV_CTX(vawr, drv), vawr_render_target));
     return vaStatus;
 }
 
@@ -1291,7 +1494,9 @@ __vaDriverInit_0_37(  VADriverContextP ctx )
     VAStatus vaStatus;
     struct VADriverVTable *i965_vtable = NULL;
     struct VADriverVTable * const vtable = ctx->vtable;
+    VADriverContextP i965_ctx;
     char *driver_name = "i965";
+    int i;
 
     if (!vawr)
         vawr = calloc(1, sizeof(*vawr));
@@ -1299,32 +1504,38 @@ __vaDriverInit_0_37(  VADriverContextP ctx )
 	return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
     LIST_INIT(&vawr->handles);
+    LIST_INIT(&vawr->images);
+    LIST_INIT(&vawr->contexts);
+
+    pthread_rwlock_init(&vawr->table_lock, NULL);
+    for (i = 0; i < MAX_NUM_DRV; i++)
+        pthread_mutex_init(&vawr->drv_mutex[i], NULL);
+    /* psb_drv_video's object heaps are not locked, i965's are */
+    vawr->drv_serialize[PSB_DRV] = 1;
 
     i965_vtable = calloc(1, sizeof(*i965_vtable));
     if (!i965_vtable)
         return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
-    /* Store i965_ctx into wrapper's private driver data
-     * It will later be used when i965 VA API is called
+    /* By default we should load and initialize OTC's i965 video driver,
+     * in a copy of the driver context that keeps i965's private driver
+     * data and vtable. It will later be used when i965 VA API is called.
      */
-
-    /* By default we should load and initialize OTC's i965 video driver */
-
-    /* First, hook i965_vtable to ctx so that i965_drv_video uses it. */
-    ctx->vtable = i965_vtable;
-
-    vawr->drm_state[I965_DRV] = ctx->drm_state;
+    i965_ctx = DRV_CTX(vawr, I965_DRV);
+    *i965_ctx = *ctx;
+    i965_ctx->vtable = i965_vtable;
 
     /* Then, load the i965 driver */
-    vaStatus = vawr_openDriver(ctx, driver_name);
+    vaStatus = vawr_openDriver(i965_ctx, driver_name);
 
     if (VA_STATUS_SUCCESS == vaStatus) {
 	/* We have successfully initialized i965 video driver,
-	 * Let's store i965's private driver data and vtable.
+	 * Let's store i965's vtable and report what it filled in.
 	 */
-        vawr->drv_data[I965_DRV] = (void *)ctx->pDriverData;
         vawr->drv_vtable[I965_DRV] = i965_vtable;
-        vawr->profile = VAProfileNone;
+        VAWR_SET_PROFILE(vawr, VAProfileNone);
+
+        *ctx = *i965_ctx;
 
         /* Also restore the va's vtable */
         ctx->vtable = vtable;
@@ -1380,10 +1591,6 @@ __vaDriverInit_0_37(  VADriverContextP ctx )
         vtable->vaUnlockSurface= vawr_UnlockSurface;
     }
 
-    LIST_INIT(&vawr->images);
-
-    pthread_mutex_init(&vawr->vaapi_mutex, NULL);
-
     /* Store wrapper's private driver data*/
     ctx->pDriverData = (void *)vawr;
 
@@ -43,23 +43,48 @@
 
 
 
-#define RESTORE_I965DATA(ctx, vawr) \
-	do { \
-		ctx->pDriverData = vawr->drv_data[I965_DRV]; \
-		ctx->drm_state = vawr->drm_state[I965_DRV]; \
-	} while(0)
-#define RESTORE_PSBDATA(ctx, vawr)	\
+/*
+ * Profile of the wrapper: VAProfileNone until the first VP8 config switches
+ * it to PSB for good. It is read without locks, so it is only accessed
+ * atomically and stored once the PSB backend is loaded.
+ */
+#define VAWR_PROFILE(vawr) \
+	__atomic_load_n(&(vawr)->profile, __ATOMIC_ACQUIRE)
+#define VAWR_SET_PROFILE(vawr, p) \
+	__atomic_store_n(&(vawr)->profile, (p), __ATOMIC_RELEASE)
+
+/* Backend serving the current profile */
+#define VAWR_DRV(vawr) \
+	(VAWR_PROFILE(vawr) == VAProfileVP8Version0_3 ? PSB_DRV : I965_DRV)
+
+/* The backend's own VADriverContext, see __vaDriverInit_0_37() */
+#define DRV_CTX(vawr, drv)	(&(vawr)->drv_ctx[drv])
+
+#define VAWR_DRV_LOCK(vawr, drv) \
 	do { \
-		ctx->pDriverData = vawr->drv_data[PSB_DRV]; \
-		ctx->drm_state = vawr->drm_state[PSB_DRV]; \
-	} while(0)
-#define RESTORE_DRVDATA(ctx, vawr)	\
+		if ((vawr)->drv_serialize[drv]) \
+			pthread_mutex_lock(&(vawr)->drv_mutex[drv]); \
+	} while (0)
+#define VAWR_DRV_UNLOCK(vawr, drv) \
 	do { \
-		ctx->pDriverData = vawr->profile == VAProfileVP8Version0_3 ? vawr->drv_data[PSB_DRV] : vawr->drv_data[I965_DRV]; \
-		ctx->drm_state = vawr->profile == VAProfileVP8Version0_3 ? vawr->drm_state[PSB_DRV] : vawr->drm_state[I965_DRV]; \
-	} while(0)
+		if ((vawr)->drv_serialize[drv]) \
+			pthread_mutex_unlock(&(vawr)->drv_mutex[drv]); \
+	} while (0)
+
+/* i965 imports a pvr surface with its height aligned to 32 lines */
+#define VAWR_EXPORT_HEIGHT(height)	(((height) + 31) & ~31)
 
-#define CALL_DRVVTABLE(vawr, status, param) status = ((vawr->profile == VAProfileVP8Version0_3) ? vawr->drv_vtable[PSB_DRV]->param : vawr->drv_vtable[I965_DRV]->param)
+#define CALL_DRVVTABLE(vawr, drv, status, param) \
+	do { \
+		VAWR_DRV_LOCK(vawr, drv); \
+		status = (vawr)->drv_vtable[drv]->param; \
+		VAWR_DRV_UNLOCK(vawr, drv); \
+	} while (0)
+/* For the calls PSB makes thread safe itself, see wrapper_drv_video.c */
+#define CALL_DRVVTABLE_UNLOCKED(vawr, drv, status, param) \
+	do { \
+		status = (vawr)->drv_vtable[drv]->param; \
+	} while (0)
 #define CHECK_INVALID_PARAM(param) \
     do { \
         if (param) { \
@@ -68,21 +93,6 @@
             return vaStatus; \
         } \
     } while (0)
-#define GET_SURFACEID(vawr, surface_lookup, surface, surface_out)	\
-	if (vawr->profile == VAProfileVP8Version0_3) {	\
-		LIST_FOR_EACH_ENTRY(surface_lookup, &vawr->surfaces, link) 	\
-				if (surface_lookup->pvr_surface == surface) 	\
-					surface_out = surface_lookup->pvr_surface;	\
-	} else 	\
-		surface_out = surface
-
-#define GET_SURFACEID_I965(vawr, surface_lookup, surface, surface_out)	\
-	if (vawr->profile == VAProfileVP8Version0_3) {	\
-		LIST_FOR_EACH_ENTRY(surface_lookup, &vawr->surfaces, link) 	\
-				if (surface_lookup->pvr_surface == surface) 	\
-					surface_out = surface_lookup->i965_surface;	\
-	} else 	\
-		surface_out = surface
 
 /* Linked list macro to list.h */
 #define LIST list
@@ -95,26 +105,55 @@
 #define LIST_FOR_EACH_ENTRY_SAFE list_for_each_entry_safe
 
 
+typedef struct vawr_surface_lookup
+{
+	VASurfaceID	i965_surface;	/* VA_INVALID_SURFACE until exported */
+	VASurfaceID pvr_surface;
+	VAImageID export_image;	/* pvr image the i965 surface was imported from */
+	int width;
+	int height;
+}vawr_surface_lookup_t;
+
+/*
+ * Open addressed (linear probing) surface id map, the table size is a
+ * power of two and kept at most half full.
+ */
+struct vawr_surface_map_slot
+{
+	VASurfaceID key;
+	vawr_surface_lookup_t *surface;	/* NULL if the slot is free */
+};
+
+struct vawr_surface_map
+{
+	struct vawr_surface_map_slot *slots;
+	unsigned int bits;
+	unsigned int count;
+};
+
 struct vawr_driver_data
 {
-	void *drv_data[MAX_NUM_DRV];
 	struct VADriverVTable *drv_vtable[MAX_NUM_DRV];
-	void * drm_state[MAX_NUM_DRV];
-	struct LIST surfaces;	/* surface_id lookup table */
+	/*
+	 * Each backend is initialized with and always called through its own
+	 * copy of the VADriverContext, so the context libva hands us is never
+	 * switched between backends and threads need not serialize on it.
+	 */
+	struct VADriverContext drv_ctx[MAX_NUM_DRV];
+	/* held around calls into a backend that is not thread safe */
+	pthread_mutex_t drv_mutex[MAX_NUM_DRV];
+	int drv_serialize[MAX_NUM_DRV];
+	/* surface_id lookup tables, by pvr's and by i965's surface_id */
+	struct vawr_surface_map pvr_surfaces;
+	struct vawr_surface_map i965_surfaces;
 	struct LIST images; /* image id lookup table */
+	struct LIST contexts; /* per context state */
 	struct LIST handles; /* va driver lib handle */
-	VAProfile profile;
-	VABufferID pic_param_buf_id;
-	pthread_mutex_t vaapi_mutex;
+	/* protects the lookup tables and loading the PSB backend */
+	pthread_rwlock_t table_lock;
+	VAProfile profile;	/* see VAWR_PROFILE() */
 };
 
-typedef struct vawr_surface_lookup
-{
-	VASurfaceID	i965_surface;
-	VASurfaceID pvr_surface;
-	struct LIST link;
-}vawr_surface_lookup_t;
-
 typedef struct vawr_image_lookup
 {
 	VAImageID	image;
@@ -122,11 +161,20 @@ typedef struct vawr_image_lookup
 	struct LIST link;
 }vawr_image_lookup_t;
 
+typedef struct vawr_context_lookup
+{
+	VAContextID context;
+	/* the contexts list's and one per vawr_lookupContext() */
+	int refcount;
+	/* serializes picture submission on this context */
+	pthread_mutex_t lock;
+	VABufferID pic_param_buf_id;
+	struct LIST link;
+}vawr_context_lookup_t;
+
 typedef struct vawr_handle_lookup
 {
 	void * handle;
 	struct LIST link;
 }vawr_handle_lookup_t;
 
-#define GET_VAWRDATA(ctx)    ctx->pDriverData
-#define RESTORE_VAWRDATA(ctx, vawr)	ctx->pDriverData = vawr
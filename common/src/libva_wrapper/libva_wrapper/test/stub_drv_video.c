@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2014 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Stand-in for the i965 and pvr backends the wrapper loads, built once
+ * as i965_drv_video.so and once with -DSTUB_PVR as pvr_drv_video.so.
+ *
+ * Every entry point checks that it is called with the backend's own
+ * driver data, and the pvr build that it is never entered by two threads
+ * at once, as psb_drv_video is not thread safe. vaSyncSurface and
+ * vaQuerySurfaceStatus are the exception, psb_drv_video makes them safe
+ * to call alongside anything else. Surface, context and
+ * buffer ids are handed out from separate ranges per backend, so an id
+ * of the other backend shows up as a bad id. The counts are read by
+ * vawr_stress through dlsym().
+ *
+ * $STUB_SYNC_US makes vaSyncSurface sleep, $STUB_WORK_NS makes every
+ * call spin for that long.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <va/va.h>
+#include <va/va_backend.h>
+#include <va/va_dec_vp8.h>
+
+#ifdef STUB_PVR
+#define STUB_ID_BASE    0x10000
+#else
+#define STUB_ID_BASE    0x100
+#endif
+#define STUB_BUFFERS    (1 << 16)
+
+int stub_violations;            /* wrong driver data, or concurrent pvr entry */
+int stub_bad_ids;               /* ids this backend did not hand out */
+int stub_derives;
+int stub_sync_overlaps;         /* pvr calls made while a sync was waiting */
+
+static int stub_driver_data;
+static unsigned int stub_next_id = STUB_ID_BASE;
+#ifdef STUB_PVR
+static int stub_inside;
+static int stub_syncing;
+#endif
+static int stub_sync_us, stub_work_ns;
+static VAPictureParameterBufferVP8 stub_buffers[STUB_BUFFERS];
+
+static void stub_spin(int ns)
+{
+    struct timespec start, t;
+
+    if (ns <= 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+    } while ((t.tv_sec - start.tv_sec) * 1000000000L + (t.tv_nsec - start.tv_nsec) < ns);
+}
+
+static void stub_enter(VADriverContextP ctx)
+{
+    if (ctx->pDriverData != &stub_driver_data)
+        __atomic_add_fetch(&stub_violations, 1, __ATOMIC_RELAXED);
+#ifdef STUB_PVR
+    if (__atomic_add_fetch(&stub_inside, 1, __ATOMIC_SEQ_CST) != 1)
+        __atomic_add_fetch(&stub_violations, 1, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&stub_syncing, __ATOMIC_SEQ_CST))
+        __atomic_add_fetch(&stub_sync_overlaps, 1, __ATOMIC_RELAXED);
+#endif
+    stub_spin(stub_work_ns);
+}
+
+/* For the calls that may run alongside any other */
+static void stub_enter_sync(VADriverContextP ctx)
+{
+    if (ctx->pDriverData != &stub_driver_data)
+        __atomic_add_fetch(&stub_violations, 1, __ATOMIC_RELAXED);
+#ifdef STUB_PVR
+    __atomic_add_fetch(&stub_syncing, 1, __ATOMIC_SEQ_CST);
+#endif
+    stub_spin(stub_work_ns);
+}
+
+static VAStatus stub_leave(void)
+{
+#ifdef STUB_PVR
+    __atomic_sub_fetch(&stub_inside, 1, __ATOMIC_SEQ_CST);
+#endif
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus stub_leave_sync(void)
+{
+#ifdef STUB_PVR
+    __atomic_sub_fetch(&stub_syncing, 1, __ATOMIC_SEQ_CST);
+#endif
+    return VA_STATUS_SUCCESS;
+}
+
+static unsigned int stub_new_id(void)
+{
+    return __atomic_fetch_add(&stub_next_id, 1, __ATOMIC_RELAXED);
+}
+
+static void stub_check_id(unsigned int id)
+{
+    if (id < STUB_ID_BASE || id >= __atomic_load_n(&stub_next_id, __ATOMIC_RELAXED))
+        __atomic_add_fetch(&stub_bad_ids, 1, __ATOMIC_RELAXED);
+}
+
+static VAStatus stub_Terminate(VADriverContextP ctx)
+{
+    stub_enter(ctx);
+    return stub_leave();
+}
+
+static VAStatus stub_QueryConfigProfiles(VADriverContextP ctx, VAProfile *profile_list,
+                                         int *num_profiles)
+{
+    stub_enter(ctx);
+    profile_list[0] = VAProfileH264High;
+    *num_profiles = 1;
+    return stub_leave();
+}
+
+static VAStatus stub_CreateConfig(VADriverContextP ctx, VAProfile profile,
+                                  VAEntrypoint entrypoint, VAConfigAttrib *attrib_list,
+                                  int num_attribs, VAConfigID *config_id)
+{
+    stub_enter(ctx);
+    *config_id = stub_new_id();
+    return stub_leave();
+}
+
+static VAStatus stub_CreateSurfaces(VADriverContextP ctx, int width, int height,
+                                    int format, int num_surfaces, VASurfaceID *surfaces)
+{
+    int i;
+
+    stub_enter(ctx);
+    for (i = 0; i < num_surfaces; i++)
+        surfaces[i] = stub_new_id();
+    return stub_leave();
+}
+
+static VAStatus stub_CreateSurfaces2(VADriverContextP ctx, unsigned int format,
+                                     unsigned int width, unsigned int height,
+                                     VASurfaceID *surfaces, unsigned int num_surfaces,
+                                     VASurfaceAttrib *attrib_list, unsigned int num_attribs)
+{
+    unsigned int i;
+
+    stub_enter(ctx);
+    for (i = 0; i < num_surfaces; i++)
+        surfaces[i] = stub_new_id();
+    return stub_leave();
+}
+
+static VAStatus stub_DestroySurfaces(VADriverContextP ctx, VASurfaceID *surface_list,
+                                     int num_surfaces)
+{
+    int i;
+
+    stub_enter(ctx);
+    for (i = 0; i < num_surfaces; i++)
+        stub_check_id(surface_list[i]);
+    return stub_leave();
+}
+
+static VAStatus stub_DeriveImage(VADriverContextP ctx, VASurfaceID surface, VAImage *image)
+{
+    stub_enter(ctx);
+    __atomic_add_fetch(&stub_derives, 1, __ATOMIC_RELAXED);
+    stub_check_id(surface);
+    memset(image, 0, sizeof(*image));
+    image->image_id = stub_new_id();
+    image->buf = stub_new_id();
+    image->width = 64;
+    image->height = 64;
+    image->num_planes = 2;
+    return stub_leave();
+}
+
+static VAStatus stub_AcquireBufferHandle(VADriverContextP ctx, VABufferID buf_id,
+                                         VABufferInfo *buf_info)
+{
+    stub_enter(ctx);
+    buf_info->handle = buf_id;
+    return stub_leave();
+}
+
+static VAStatus stub_DestroyImage(VADriverContextP ctx, VAImageID image)
+{
+    stub_enter(ctx);
+    stub_check_id(image);
+    return stub_leave();
+}
+
+static VAStatus stub_CreateContext(VADriverContextP ctx, VAConfigID config_id,
+                                   int picture_width, int picture_height, int flag,
+                                   VASurfaceID *render_targets, int num_render_targets,
+                                   VAContextID *context)
+{
+    int i;
+
+    stub_enter(ctx);
+    for (i = 0; i < num_render_targets; i++)
+        stub_check_id(render_targets[i]);
+    *context = stub_new_id();
+    return stub_leave();
+}
+
+static VAStatus stub_DestroyContext(VADriverContextP ctx, VAContextID context)
+{
+    stub_enter(ctx);
+    stub_check_id(context);
+    return stub_leave();
+}
+
+static VAStatus stub_CreateBuffer(VADriverContextP ctx, VAContextID context,
+                                  VABufferType type, unsigned int size,
+                                  unsigned int num_elements, void *data, VABufferID *buf_id)
+{
+    stub_enter(ctx);
+    *buf_id = stub_new_id();
+    if (data && size <= sizeof(stub_buffers[0]))
+        memcpy(&stub_buffers[*buf_id % STUB_BUFFERS], data, size);
+    return stub_leave();
+}
+
+static VAStatus stub_MapBuffer(VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+    stub_enter(ctx);
+    *pbuf = &stub_buffers[buf_id % STUB_BUFFERS];
+    return stub_leave();
+}
+
+static VAStatus stub_UnmapBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    stub_enter(ctx);
+    return stub_leave();
+}
+
+static VAStatus stub_DestroyBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    stub_enter(ctx);
+    stub_check_id(buf_id);
+    return stub_leave();
+}
+
+static VAStatus stub_BeginPicture(VADriverContextP ctx, VAContextID context,
+                                  VASurfaceID render_target)
+{
+    stub_enter(ctx);
+    stub_check_id(context);
+    stub_check_id(render_target);
+    return stub_leave();
+}
+
+static VAStatus stub_RenderPicture(VADriverContextP ctx, VAContextID context,
+                                   VABufferID *buffers, int num_buffers)
+{
+#ifdef STUB_PVR
+    VAPictureParameterBufferVP8 *pic_param = &stub_buffers[buffers[0] % STUB_BUFFERS];
+#endif
+
+    stub_enter(ctx);
+#ifdef STUB_PVR
+    /* the wrapper translates the reference frames to pvr's ids */
+    stub_check_id(pic_param->last_ref_frame);
+    stub_check_id(pic_param->golden_ref_frame);
+    stub_check_id(pic_param->alt_ref_frame);
+#endif
+    return stub_leave();
+}
+
+static VAStatus stub_EndPicture(VADriverContextP ctx, VAContextID context)
+{
+    stub_enter(ctx);
+    stub_check_id(context);
+    return stub_leave();
+}
+
+static VAStatus stub_SyncSurface(VADriverContextP ctx, VASurfaceID render_target)
+{
+    stub_enter_sync(ctx);
+    stub_check_id(render_target);
+    if (stub_sync_us)
+        usleep(stub_sync_us);
+    return stub_leave_sync();
+}
+
+static VAStatus stub_QuerySurfaceStatus(VADriverContextP ctx, VASurfaceID render_target,
+                                        VASurfaceStatus *status)
+{
+    stub_enter_sync(ctx);
+    stub_check_id(render_target);
+    *status = VASurfaceReady;
+    return stub_leave_sync();
+}
+
+static VAStatus stub_PutSurface(VADriverContextP ctx, VASurfaceID surface, void *draw,
+                                short srcx, short srcy, unsigned short srcw, unsigned short srch,
+                                short destx, short desty, unsigned short destw, unsigned short desth,
+                                VARectangle *cliprects, unsigned int number_cliprects,
+                                unsigned int flags)
+{
+    stub_enter(ctx);
+    stub_check_id(surface);
+    return stub_leave();
+}
+
+VAStatus __vaDriverInit_0_37(VADriverContextP ctx)
+{
+    struct VADriverVTable *vtable = ctx->vtable;
+
+    if (getenv("STUB_SYNC_US"))
+        stub_sync_us = atoi(getenv("STUB_SYNC_US"));
+    if (getenv("STUB_WORK_NS"))
+        stub_work_ns = atoi(getenv("STUB_WORK_NS"));
+
+    ctx->pDriverData = &stub_driver_data;
+    ctx->max_profiles = 4;
+    ctx->max_entrypoints = 4;
+
+    vtable->vaTerminate = stub_Terminate;
+    vtable->vaQueryConfigProfiles = stub_QueryConfigProfiles;
+    vtable->vaCreateConfig = stub_CreateConfig;
+    vtable->vaCreateSurfaces = stub_CreateSurfaces;
+    vtable->vaCreateSurfaces2 = stub_CreateSurfaces2;
+    vtable->vaDestroySurfaces = stub_DestroySurfaces;
+    vtable->vaDeriveImage = stub_DeriveImage;
+    vtable->vaAcquireBufferHandle = stub_AcquireBufferHandle;
+    vtable->vaDestroyImage = stub_DestroyImage;
+    vtable->vaCreateContext = stub_CreateContext;
+    vtable->vaDestroyContext = stub_DestroyContext;
+    vtable->vaCreateBuffer = stub_CreateBuffer;
+    vtable->vaMapBuffer = stub_MapBuffer;
+    vtable->vaUnmapBuffer = stub_UnmapBuffer;
+    vtable->vaDestroyBuffer = stub_DestroyBuffer;
+    vtable->vaBeginPicture = stub_BeginPicture;
+    vtable->vaRenderPicture = stub_RenderPicture;
+    vtable->vaEndPicture = stub_EndPicture;
+    vtable->vaSyncSurface = stub_SyncSurface;
+    vtable->vaQuerySurfaceStatus = stub_QuerySurfaceStatus;
+    vtable->vaPutSurface = stub_PutSurface;
+    return VA_STATUS_SUCCESS;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2014 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Decodes from several threads at once through the wrapper, against the
+ * stub backends in stub_drv_video.c, while another thread keeps creating
+ * and destroying surfaces and contexts.
+ *
+ *   make check
+ *   vawr_stress [threads] [frames] [recreate]
+ *
+ * The H.264 phase only reaches i965. The VP8 phase goes through pvr and
+ * exports every surface to i965; each thread destroys and creates its
+ * context every [recreate] frames, as a seek does, giving the coded
+ * instead of the display height. The test fails if a backend is entered
+ * with the wrong driver data, pvr is entered by two threads at once
+ * other than to sync a surface, a
+ * backend sees an id it did not hand out, the wrapper's own driver data
+ * is overwritten, or a surface is exported to i965 more than once
+ * although its aligned size did not change.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <va/va.h>
+#include <va/va_backend.h>
+#include <va/va_dec_vp8.h>
+#include <va/va_drmcommon.h>
+
+#define MAX_THREADS     64
+#define NUM_SURFACES    4
+#define WIDTH           64
+#define HEIGHT          60
+#define CODED_HEIGHT    64      /* the same once aligned, see VAWR_EXPORT_HEIGHT() */
+
+#define CHECK(call)                                                         \
+    do {                                                                    \
+        VAStatus status_ = (call);                                          \
+        if (status_ != VA_STATUS_SUCCESS) {                                 \
+            fprintf(stderr, "%s failed: %d\n", #call, status_);             \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+VAStatus __vaDriverInit_0_37(VADriverContextP ctx);
+
+static struct VADriverContext ctx;
+static struct drm_state drm_state;
+static struct VADriverVTable vtable;
+static VAConfigID config;
+static int num_threads = 8, num_frames = 2000, recreate = 50;
+static int vp8, stop;
+static long frames_done;
+
+static void *decode_thread(void *arg)
+{
+    VASurfaceID surfaces[NUM_SURFACES];
+    VAPictureParameterBufferVP8 pic_param;
+    VASurfaceStatus surface_status;
+    VAContextID context;
+    VABufferID buffer;
+    VASurfaceID target;
+    int i;
+
+    CHECK(vtable.vaCreateSurfaces(&ctx, WIDTH, HEIGHT, VA_RT_FORMAT_YUV420, NUM_SURFACES, surfaces));
+    CHECK(vtable.vaCreateContext(&ctx, config, WIDTH, HEIGHT, 0, surfaces, NUM_SURFACES, &context));
+    for (i = 0; i < num_frames; i++) {
+        target = surfaces[i % NUM_SURFACES];
+        memset(&pic_param, 0, sizeof(pic_param));
+        pic_param.last_ref_frame = surfaces[(i + 1) % NUM_SURFACES];
+        pic_param.golden_ref_frame = surfaces[(i + 2) % NUM_SURFACES];
+        pic_param.alt_ref_frame = surfaces[(i + 3) % NUM_SURFACES];
+
+        CHECK(vtable.vaBeginPicture(&ctx, context, target));
+        CHECK(vtable.vaCreateBuffer(&ctx, context, VAPictureParameterBufferType,
+                                    sizeof(pic_param), 1, &pic_param, &buffer));
+        CHECK(vtable.vaRenderPicture(&ctx, context, &buffer, 1));
+        CHECK(vtable.vaEndPicture(&ctx, context));
+        CHECK(vtable.vaDestroyBuffer(&ctx, buffer));
+        CHECK(vtable.vaSyncSurface(&ctx, target));
+        CHECK(vtable.vaQuerySurfaceStatus(&ctx, target, &surface_status));
+        CHECK(vtable.vaPutSurface(&ctx, target, NULL, 0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, NULL, 0, 0));
+
+        /* a seek, with the coded height this time */
+        if (vp8 && recreate && i % recreate == recreate - 1) {
+            CHECK(vtable.vaDestroyContext(&ctx, context));
+            CHECK(vtable.vaCreateContext(&ctx, config, WIDTH, CODED_HEIGHT, 0, surfaces, NUM_SURFACES, &context));
+        }
+        __atomic_add_fetch(&frames_done, 1, __ATOMIC_RELAXED);
+    }
+    CHECK(vtable.vaDestroyContext(&ctx, context));
+    CHECK(vtable.vaDestroySurfaces(&ctx, surfaces, NUM_SURFACES));
+    return NULL;
+}
+
+static void *churn_thread(void *arg)
+{
+    VASurfaceID surfaces[NUM_SURFACES];
+    VAContextID context;
+    long n = 0;
+
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        CHECK(vtable.vaCreateSurfaces(&ctx, WIDTH, HEIGHT, VA_RT_FORMAT_YUV420, NUM_SURFACES, surfaces));
+        CHECK(vtable.vaCreateContext(&ctx, config, WIDTH, HEIGHT, 0, surfaces, NUM_SURFACES, &context));
+        CHECK(vtable.vaDestroyContext(&ctx, context));
+        CHECK(vtable.vaDestroySurfaces(&ctx, surfaces, NUM_SURFACES));
+        n++;
+    }
+    return (void *)n;
+}
+
+/* A counter of a stub backend the wrapper has loaded, -1 if not loaded */
+static int stub_counter(const char *driver, const char *name)
+{
+    const char *path = getenv("LIBVA_DRIVERS_PATH");
+    char file[1024];
+    void *handle;
+    int *counter = NULL;
+
+    snprintf(file, sizeof(file), "%s/%s_drv_video.so", path ? path : VA_DRIVERS_PATH, driver);
+    handle = dlopen(file, RTLD_NOW | RTLD_NOLOAD);
+    if (handle) {
+        counter = dlsym(handle, name);
+        dlclose(handle);
+    }
+    return counter ? *counter : -1;
+}
+
+static int run(int use_vp8)
+{
+    pthread_t threads[MAX_THREADS], churn;
+    struct timespec start, end;
+    void *wrapper_data, *churned;
+    int pvr_violations, pvr_bad_ids, i965_violations, i965_bad_ids;
+    int pvr_derives, pvr_derives_before, exports, sync_overlaps;
+    double seconds;
+    long i;
+
+    vp8 = use_vp8;
+    frames_done = 0;
+    __atomic_store_n(&stop, 0, __ATOMIC_RELEASE);
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&vtable, 0, sizeof(vtable));
+    ctx.vtable = &vtable;
+    ctx.drm_state = &drm_state;
+    CHECK(__vaDriverInit_0_37(&ctx));
+    wrapper_data = ctx.pDriverData;
+    pvr_derives_before = stub_counter("pvr", "stub_derives");
+    if (pvr_derives_before < 0)
+        pvr_derives_before = 0;
+    CHECK(vtable.vaCreateConfig(&ctx, vp8 ? VAProfileVP8Version0_3 : VAProfileH264High,
+                                VAEntrypointVLD, NULL, 0, &config));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, decode_thread, (void *)i);
+    pthread_create(&churn, NULL, churn_thread, NULL);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    pthread_join(churn, &churned);
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    pvr_violations = stub_counter("pvr", "stub_violations");
+    pvr_bad_ids = stub_counter("pvr", "stub_bad_ids");
+    i965_violations = stub_counter("i965", "stub_violations");
+    i965_bad_ids = stub_counter("i965", "stub_bad_ids");
+    pvr_derives = stub_counter("pvr", "stub_derives");
+    sync_overlaps = stub_counter("pvr", "stub_sync_overlaps");
+    printf("%s: %d threads, %ld frames, %ld churned, %.0f frames/s, "
+           "pvr %d violations %d bad ids %d calls during a sync, "
+           "i965 %d violations %d bad ids\n",
+           vp8 ? "vp8" : "h264", num_threads, frames_done, (long)churned,
+           frames_done / seconds, pvr_violations, pvr_bad_ids, sync_overlaps,
+           i965_violations, i965_bad_ids);
+
+    if (ctx.pDriverData != wrapper_data) {
+        fprintf(stderr, "the wrapper's driver data was overwritten\n");
+        return 1;
+    }
+    CHECK(vtable.vaTerminate(&ctx));
+
+    /* a counter of -1 means the stub was never loaded */
+    if (i965_violations < 0 || (vp8 && pvr_violations < 0)) {
+        fprintf(stderr, "the stub backends were not loaded\n");
+        return 1;
+    }
+    /* only the decoders display, each of their surfaces once */
+    exports = pvr_derives - pvr_derives_before;
+    if (vp8 && exports != num_threads * NUM_SURFACES) {
+        fprintf(stderr, "%d exports to i965, expected %d\n",
+                exports, num_threads * NUM_SURFACES);
+        return 1;
+    }
+    return pvr_violations > 0 || pvr_bad_ids > 0 || i965_violations || i965_bad_ids;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        num_threads = atoi(argv[1]);
+    if (argc > 2)
+        num_frames = atoi(argv[2]);
+    if (argc > 3)
+        recreate = atoi(argv[3]);
+    if (num_threads < 1 || num_threads > MAX_THREADS) {
+        fprintf(stderr, "1 to %d threads\n", MAX_THREADS);
+        return 1;
+    }
+
+    if (run(0) || run(1))
+        return 1;
+    return 0;
+}
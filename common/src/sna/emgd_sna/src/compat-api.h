@@ -130,6 +130,7 @@
 #define RegionEmpty(r) REGION_EMPTY(NULL, r)
 #define RegionEqual(a, b) REGION_EQUAL(NULL, a, b)
 #define RegionDestroy(r) REGION_DESTROY(NULL, r)
+#define RegionFromRects(n, r, c) RECTS_TO_REGION(NULL, n, r, c)
 #else
 #define region_from_bitmap BitmapToRegion
 #endif
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* Compile every WM kernel variant of the gen4-gen7 render backends the way
+ * genN_wm_kernel_prepare() does on first use, without a GPU, and report
+ * the general state built at init against building every kernel up front.
+ *
+ * For each generation the kernels are compiled twice: all of them in
+ * wm_kernels[] order, as init used to, and only the copy/fill kernel
+ * followed by the rest one at a time in a shuffled order, as they would
+ * be requested. Each lazily compiled kernel must fit in the block that
+ * sna_static_stream_compile_wm() reserves and be identical to its eager
+ * compilation although it lands at a different offset.
+ *
+ * The kernel tables and dispatch widths are those of genN_render.c, from
+ * the genN_wm_kernels.h headers. The general state bo is modelled as
+ * sna_static_stream_commit() manages it: new state is written into the
+ * tail of the bo while it fits and the bo is only replaced, a quarter
+ * larger, when it does not, each replacement costing a batch submission.
+ *
+ * Only the kernels and the gen4/5 WM unit states are counted, not the
+ * sampler and blend states that init builds alongside them. With seed 1
+ * on a Xeon this reports, in bytes and microseconds:
+ *
+ *            eager eager us     init  init us  init bo all lazy  lazy bo  grown
+ * gen4       55680     14.4     4544      0.9     8192    55680    65536      5
+ * g4x        55040     12.4     4480      0.8     8192    55040    69632      6
+ * gen5       54208     11.6     4416      0.7     8192    54208    57344      5
+ * gen6        6336     13.1      320      0.7     4096     6320     8192      1
+ * gen7        7168     13.2      320      0.7     4096     7120     8192      1
+ * gen7.5      7168     13.2      320      0.7     4096     7120     8192      1
+ */
+
+#include "brw.h"
+#include "sna/gen4_wm_kernels.h"
+#include "sna/gen5_wm_kernels.h"
+#include "sna/gen6_wm_kernels.h"
+#include "sna/gen7_wm_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
+#endif
+#define ALIGN(i,m) (((i) + (m) - 1) & ~((m) - 1))
+
+#define WM_BLOCK (256*sizeof(uint32_t))	/* sna_static_stream_compile_wm() */
+#define GEN4_SAMPLER_COUNT 64		/* sna_render.h */
+#define GEN4_WM_STATE_SIZE 64		/* struct gen4_wm_unit_state_padded */
+#define PAGE_SIZE 4096			/* kgem_create_linear() */
+#define REPEAT 20
+
+struct wm_kernel {
+	const char *name;
+	bool (*compile)(struct brw_compile *, int);
+	const void *data;
+	unsigned size;
+};
+
+#define NOKERNEL(kernel_enum, func, arg) { #kernel_enum, func, NULL, 0 }
+#define KERNEL(kernel_enum, program, arg) \
+	{ #kernel_enum, NULL, program, sizeof(program) }
+
+static const struct wm_kernel gen4_kernels[] = { GEN4_WM_KERNELS };
+static const struct wm_kernel gen5_kernels[] = { GEN5_WM_KERNELS };
+static const struct wm_kernel gen6_kernels[] = { GEN6_WM_KERNELS };
+static const struct wm_kernel gen7_kernels[] = { GEN7_WM_KERNELS };
+
+#define GEN4_WIDTHS (GEN4_WM_DISPATCH_WIDTH == 8 ? 1 : \
+		     GEN4_WM_DISPATCH_WIDTH == 16 ? 2 : 4)
+#define GEN5_WIDTHS (GEN5_WM_DISPATCH_WIDTH == 8 ? 1 : \
+		     GEN5_WM_DISPATCH_WIDTH == 16 ? 2 : 4)
+#define GEN6_WIDTHS (GEN6_USE_8_PIXEL_DISPATCH << 0 | \
+		     GEN6_USE_16_PIXEL_DISPATCH << 1 | \
+		     GEN6_USE_32_PIXEL_DISPATCH << 2)
+#define GEN7_WIDTHS (GEN7_USE_8_PIXEL_DISPATCH << 0 | \
+		     GEN7_USE_16_PIXEL_DISPATCH << 1 | \
+		     GEN7_USE_32_PIXEL_DISPATCH << 2)
+
+static const struct backend {
+	const char *name;
+	int gen;
+	unsigned widths;	/* bit n: 8 << n pixel dispatch */
+	bool wm_units;		/* gen4/5 build a WM unit state per sampler pair */
+	const struct wm_kernel *kernels;
+	int count;
+} backends[] = {
+	{ "gen4", 040, GEN4_WIDTHS, true, gen4_kernels, ARRAY_SIZE(gen4_kernels) },
+	{ "g4x", 045, GEN4_WIDTHS, true, gen4_kernels, ARRAY_SIZE(gen4_kernels) },
+	{ "gen5", 050, GEN5_WIDTHS, true, gen5_kernels, ARRAY_SIZE(gen5_kernels) },
+	{ "gen6", 060, GEN6_WIDTHS, false, gen6_kernels, ARRAY_SIZE(gen6_kernels) },
+	{ "gen7", 070, GEN7_WIDTHS, false, gen7_kernels, ARRAY_SIZE(gen7_kernels) },
+	{ "gen7.5", 075, GEN7_WIDTHS, false, gen7_kernels, ARRAY_SIZE(gen7_kernels) },
+};
+
+/* The general state stream, only ever appended to */
+struct stream {
+	uint32_t used;
+	uint8_t data[256*1024];
+};
+
+struct compiled {
+	uint32_t offset[3];
+	uint32_t size[3];
+};
+
+static uint32_t stream_alloc(struct stream *s, uint32_t len, uint32_t align)
+{
+	uint32_t offset = ALIGN(s->used, align);
+
+	if (offset + len > sizeof(s->data)) {
+		fprintf(stderr, "general state stream overflow\n");
+		exit(1);
+	}
+
+	s->used = offset + len;
+	memset(s->data + offset, 0, len);
+	return offset;
+}
+
+static int failures;
+
+static bool compile_kernel(const struct backend *b, struct stream *s,
+			   int k, struct compiled *c)
+{
+	const struct wm_kernel *kernel = &b->kernels[k];
+	bool ok = false;
+	int n;
+
+	memset(c, 0, sizeof(*c));
+	if (kernel->data) {
+		c->offset[1] = stream_alloc(s, kernel->size, 64);
+		c->size[1] = kernel->size;
+		memcpy(s->data + c->offset[1], kernel->data, kernel->size);
+		ok = true;
+	} else for (n = 0; n < 3; n++) {
+		struct brw_compile p;
+		uint32_t offset;
+
+		if ((b->widths & (1 << n)) == 0)
+			continue;
+
+		offset = stream_alloc(s, WM_BLOCK, 64);
+		brw_compile_init(&p, b->gen, s->data + offset);
+		if (!kernel->compile(&p, 8 << n)) {
+			s->used = offset;
+			continue;
+		}
+
+		if (p.nr_insn * sizeof(struct brw_instruction) > WM_BLOCK) {
+			printf("%s %s/%d: %d instructions overrun the %d byte block\n",
+			       b->name, kernel->name, 8 << n,
+			       p.nr_insn, (int)WM_BLOCK);
+			failures++;
+		}
+
+		s->used = offset + p.nr_insn * sizeof(struct brw_instruction);
+		c->offset[n] = offset;
+		c->size[n] = p.nr_insn * sizeof(struct brw_instruction);
+		ok = true;
+	}
+
+	if (ok && b->wm_units)
+		stream_alloc(s, GEN4_WM_STATE_SIZE * GEN4_SAMPLER_COUNT, 64);
+
+	return ok;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void test_backend(const struct backend *b, unsigned seed)
+{
+	static struct stream eager, lazy;
+	struct compiled all[16], one;
+	int order[16];
+	double t, t_eager, t_init;
+	uint32_t init_used, init_bo, bo;
+	int i, j, n, grown;
+
+	/* as init used to: every kernel up front, best of a few runs */
+	t_eager = t_init = 1e9;
+	for (n = 0; n < REPEAT; n++) {
+		t = now();
+		eager.used = 64; /* null_create() */
+		for (i = 0; i < b->count; i++) {
+			if (!compile_kernel(b, &eager, i, &all[i]) && n == 0) {
+				printf("%s %s: failed to compile\n",
+				       b->name, b->kernels[i].name);
+				failures++;
+			}
+		}
+		t = now() - t;
+		if (t < t_eager)
+			t_eager = t;
+
+		/* as init does now: only the copy/fill kernel */
+		t = now();
+		lazy.used = 64;
+		compile_kernel(b, &lazy, 0, &one);
+		t = now() - t;
+		if (t < t_init)
+			t_init = t;
+	}
+	init_used = lazy.used;
+	init_bo = bo = ALIGN(init_used, PAGE_SIZE);
+	grown = 0;
+
+	/* and the others on first use, in any order */
+	for (i = 0; i < b->count - 1; i++)
+		order[i] = i + 1;
+	srand(seed);
+	for (i = b->count - 2; i > 0; i--) {
+		j = rand() % (i + 1);
+		n = order[i]; order[i] = order[j]; order[j] = n;
+	}
+	for (i = 0; i < b->count - 1; i++) {
+		const struct compiled *ref = &all[order[i]];
+
+		if (!compile_kernel(b, &lazy, order[i], &one)) {
+			printf("%s %s: failed to compile on first use\n",
+			       b->name, b->kernels[order[i]].name);
+			failures++;
+			continue;
+		}
+
+		/* written in place, or into a bo a quarter larger */
+		if (lazy.used > bo) {
+			bo = ALIGN(lazy.used + lazy.used / 4, PAGE_SIZE);
+			grown++;
+		}
+
+		for (n = 0; n < 3; n++) {
+			if (one.size[n] != ref->size[n] ||
+			    memcmp(lazy.data + one.offset[n],
+				   eager.data + ref->offset[n],
+				   one.size[n])) {
+				printf("%s %s/%d: differs when compiled on first use\n",
+				       b->name, b->kernels[order[i]].name, 8 << n);
+				failures++;
+			}
+		}
+	}
+
+	printf("%-7s %8u %8.1f %8u %8.1f %8u %8u %8u %6d\n",
+	       b->name, eager.used, t_eager * 1e6,
+	       init_used, t_init * 1e6, init_bo,
+	       lazy.used, bo, grown);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seed = argc > 1 ? atoi(argv[1]) : 1;
+	int i;
+
+	printf("WM kernels and their state in the general state bo, bytes and us\n");
+	printf("%-7s %8s %8s %8s %8s %8s %8s %8s %6s\n",
+	       "", "eager", "eager us", "init", "init us", "init bo",
+	       "all lazy", "lazy bo", "grown");
+	for (i = 0; i < ARRAY_SIZE(backends); i++)
+		test_backend(&backends[i], seed);
+
+	if (failures)
+		printf("%d failures\n", failures);
+	return failures != 0;
+}
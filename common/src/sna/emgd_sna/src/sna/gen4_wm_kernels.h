@@ -0,0 +1,49 @@
+#ifndef GEN4_WM_KERNELS_H
+#define GEN4_WM_KERNELS_H
+
+/* The WM kernels of the gen4 render backend, shared by gen4_render.c and
+ * brw/brw_wm_kernels.c. Expand GEN4_WM_KERNELS with NOKERNEL(kernel_enum,
+ * func, has_mask) and KERNEL(kernel_enum, program, has_mask) defined, in
+ * the order of the WM_KERNEL enum.
+ */
+
+#include "brw/brw.h"
+
+#define GEN4_WM_DISPATCH_WIDTH 16
+
+static const uint32_t gen4_ps_kernel_packed[][4] = {
+#include "exa_wm_xy.g4b"
+#include "exa_wm_src_affine.g4b"
+#include "exa_wm_src_sample_argb.g4b"
+#include "exa_wm_yuv_rgb.g4b"
+#include "exa_wm_write.g4b"
+};
+
+static const uint32_t gen4_ps_kernel_planar[][4] = {
+#include "exa_wm_xy.g4b"
+#include "exa_wm_src_affine.g4b"
+#include "exa_wm_src_sample_planar.g4b"
+#include "exa_wm_yuv_rgb.g4b"
+#include "exa_wm_write.g4b"
+};
+
+#define GEN4_WM_KERNELS \
+	NOKERNEL(WM_KERNEL, brw_wm_kernel__affine, false), \
+	NOKERNEL(WM_KERNEL_P, brw_wm_kernel__projective, false), \
+	\
+	NOKERNEL(WM_KERNEL_MASK, brw_wm_kernel__affine_mask, true), \
+	NOKERNEL(WM_KERNEL_MASK_P, brw_wm_kernel__projective_mask, true), \
+	\
+	NOKERNEL(WM_KERNEL_MASKCA, brw_wm_kernel__affine_mask_ca, true), \
+	NOKERNEL(WM_KERNEL_MASKCA_P, brw_wm_kernel__projective_mask_ca, true), \
+	\
+	NOKERNEL(WM_KERNEL_MASKSA, brw_wm_kernel__affine_mask_sa, true), \
+	NOKERNEL(WM_KERNEL_MASKSA_P, brw_wm_kernel__projective_mask_sa, true), \
+	\
+	NOKERNEL(WM_KERNEL_OPACITY, brw_wm_kernel__affine_opacity, true), \
+	NOKERNEL(WM_KERNEL_OPACITY_P, brw_wm_kernel__projective_opacity, true), \
+	\
+	KERNEL(WM_KERNEL_VIDEO_PLANAR, gen4_ps_kernel_planar, false), \
+	KERNEL(WM_KERNEL_VIDEO_PACKED, gen4_ps_kernel_packed, false)
+
+#endif /* GEN4_WM_KERNELS_H */
@@ -42,6 +42,7 @@
 
 #include "brw/brw.h"
 #include "gen5_render.h"
+#include "gen5_wm_kernels.h"
 #include "gen4_source.h"
 #include "gen4_vertex.h"
 
@@ -86,22 +87,6 @@
 #define PS_KERNEL_NUM_GRF   32
 #define PS_MAX_THREADS	    72
 
-static const uint32_t ps_kernel_packed_static[][4] = {
-#include "exa_wm_xy.g5b"
-#include "exa_wm_src_affine.g5b"
-#include "exa_wm_src_sample_argb.g5b"
-#include "exa_wm_yuv_rgb.g5b"
-#include "exa_wm_write.g5b"
-};
-
-static const uint32_t ps_kernel_planar_static[][4] = {
-#include "exa_wm_xy.g5b"
-#include "exa_wm_src_affine.g5b"
-#include "exa_wm_src_sample_planar.g5b"
-#include "exa_wm_yuv_rgb.g5b"
-#include "exa_wm_write.g5b"
-};
-
 #define NOKERNEL(kernel_enum, func, masked) \
     [kernel_enum] = {func, 0, masked}
 #define KERNEL(kernel_enum, kernel, masked) \
@@ -111,23 +96,7 @@ static const struct wm_kernel_info {
 	unsigned int size;
 	bool has_mask;
 } wm_kernels[] = {
-	NOKERNEL(WM_KERNEL, brw_wm_kernel__affine, false),
-	NOKERNEL(WM_KERNEL_P, brw_wm_kernel__projective, false),
-
-	NOKERNEL(WM_KERNEL_MASK, brw_wm_kernel__affine_mask, true),
-	NOKERNEL(WM_KERNEL_MASK_P, brw_wm_kernel__projective_mask, true),
-
-	NOKERNEL(WM_KERNEL_MASKCA, brw_wm_kernel__affine_mask_ca, true),
-	NOKERNEL(WM_KERNEL_MASKCA_P, brw_wm_kernel__projective_mask_ca, true),
-
-	NOKERNEL(WM_KERNEL_MASKSA, brw_wm_kernel__affine_mask_sa, true),
-	NOKERNEL(WM_KERNEL_MASKSA_P, brw_wm_kernel__projective_mask_sa, true),
-
-	NOKERNEL(WM_KERNEL_OPACITY, brw_wm_kernel__affine_opacity, true),
-	NOKERNEL(WM_KERNEL_OPACITY_P, brw_wm_kernel__projective_opacity, true),
-
-	KERNEL(WM_KERNEL_VIDEO_PLANAR, ps_kernel_planar_static, false),
-	KERNEL(WM_KERNEL_VIDEO_PACKED, ps_kernel_packed_static, false),
+	GEN5_WM_KERNELS
 };
 #undef KERNEL
 
@@ -163,13 +132,17 @@ static const struct blendinfo {
 #define BLEND_OFFSET(s, d) \
 	(((s) * GEN5_BLENDFACTOR_COUNT + (d)) * 64)
 
-#define SAMPLER_OFFSET(sf, se, mf, me, k) \
-	((((((sf) * EXTEND_COUNT + (se)) * FILTER_COUNT + (mf)) * EXTEND_COUNT + (me)) * KERNEL_COUNT + (k)) * 64)
+#define SAMPLER_INDEX(sf, se, mf, me) \
+	((((sf) * EXTEND_COUNT + (se)) * FILTER_COUNT + (mf)) * EXTEND_COUNT + (me))
+#define SAMPLER_OFFSET(sf, se, mf, me) \
+	(SAMPLER_INDEX(sf, se, mf, me) * 64)
 
 static bool
 gen5_emit_pipelined_pointers(struct sna *sna,
 			     const struct sna_composite_op *op,
 			     int blend, int kernel);
+static bool
+gen5_wm_kernel_prepare(struct sna *sna, int kernel);
 
 #define OUT_BATCH(v) batch_emit(sna, v)
 #define OUT_VERTEX(x,y) vertex_emit_2s(sna, x,y)
@@ -834,11 +807,12 @@ gen5_emit_pipelined_pointers(struct sna *sna,
 	     kernel, blend, op->has_component_alpha, (int)op->dst.format));
 
 	sp = SAMPLER_OFFSET(op->src.filter, op->src.repeat,
-			    op->mask.filter, op->mask.repeat,
-			    kernel);
+			    op->mask.filter, op->mask.repeat);
 	bp = gen5_get_blend(blend, op->has_component_alpha, op->dst.format);
 
-	key = sp | (uint32_t)bp << 16 | (op->mask.bo != NULL) << 31;
+	assert(sna->render_state.gen5.wm[kernel]);
+	assert(sp < 1 << 12);
+	key = sp | kernel << 12 | (uint32_t)bp << 16 | (op->mask.bo != NULL) << 31;
 	DBG(("%s: sp=%d, bp=%d, key=%08x (current sp=%d, bp=%d, key=%08x)\n",
 	     __FUNCTION__, sp, bp, key,
 	     sna->render_state.gen5.last_pipelined_pointers & 0xffff,
@@ -852,7 +826,7 @@ gen5_emit_pipelined_pointers(struct sna *sna,
 	OUT_BATCH(GEN5_GS_DISABLE); /* passthrough */
 	OUT_BATCH(GEN5_CLIP_DISABLE); /* passthrough */
 	OUT_BATCH(sna->render_state.gen5.sf[op->mask.bo != NULL]);
-	OUT_BATCH(sna->render_state.gen5.wm + sp);
+	OUT_BATCH(sna->render_state.gen5.wm[kernel] + sp);
 	OUT_BATCH(sna->render_state.gen5.cc + bp);
 
 	bp = (sna->render_state.gen5.last_pipelined_pointers & 0x7fff0000) != ((uint32_t)bp << 16);
@@ -1375,6 +1349,9 @@ gen5_render_video(struct sna *sna,
 	tmp.floats_per_rect = 9;
 	tmp.priv = frame;
 
+	if (!gen5_wm_kernel_prepare(sna, tmp.u.gen5.wm_kernel))
+		return false;
+
 	if (!kgem_check_bo(&sna->kgem, tmp.dst.bo, frame->bo, NULL)) {
 		kgem_submit(&sna->kgem);
 		assert(kgem_check_bo(&sna->kgem, tmp.dst.bo, frame->bo, NULL));
@@ -1975,6 +1952,15 @@ gen5_render_composite(struct sna *sna,
 	}
 	tmp->done  = gen5_render_composite_done;
 
+	if (!gen5_wm_kernel_prepare(sna, tmp->u.gen5.wm_kernel))
+		goto cleanup_mask;
+	if (tmp->need_magic_ca_pass &&
+	    !gen5_wm_kernel_prepare(sna,
+				    gen5_choose_composite_kernel(PictOpAdd,
+								 true, true,
+								 tmp->is_affine)))
+		goto cleanup_mask;
+
 	if (!kgem_check_bo(&sna->kgem,
 			   tmp->dst.bo, tmp->src.bo, tmp->mask.bo, NULL)) {
 		kgem_submit(&sna->kgem);
@@ -2202,6 +2188,9 @@ gen5_render_composite_spans(struct sna *sna,
 		tmp->thread_boxes = gen5_render_composite_spans_boxes__thread;
 	tmp->done  = gen5_render_composite_spans_done;
 
+	if (!gen5_wm_kernel_prepare(sna, tmp->base.u.gen5.wm_kernel))
+		goto cleanup_src;
+
 	if (!kgem_check_bo(&sna->kgem,
 			   tmp->base.dst.bo, tmp->base.src.bo,
 			   NULL))  {
@@ -3092,6 +3081,7 @@ static void gen5_render_reset(struct sna *sna)
 static void gen5_render_fini(struct sna *sna)
 {
 	kgem_bo_destroy(&sna->kgem, sna->render_state.gen5.general_bo);
+	free(sna->render_state.gen5.general.data);
 }
 
 static uint32_t gen5_create_vs_unit_state(struct sna_static_stream *stream)
@@ -3240,79 +3230,131 @@ static uint32_t gen5_create_cc_unit_state(struct sna_static_stream *stream)
 	return sna_static_stream_offsetof(stream, base);
 }
 
-static bool gen5_render_setup(struct sna *sna)
+/* Compile the kernel and build its WM unit states, one for each pair of
+ * sampler states. Returns the offset of the block of WM states.
+ */
+static uint32_t gen5_create_wm_state(struct sna *sna,
+				     struct sna_static_stream *stream,
+				     int kernel)
 {
 	struct gen5_render_state *state = &sna->render_state.gen5;
-	struct sna_static_stream general;
 	struct gen5_wm_unit_state_padded *wm_state;
-	uint32_t sf[2], wm[KERNEL_COUNT];
-	int i, j, k, l, m;
+	uint32_t wm;
+	int i;
+
+	if (wm_kernels[kernel].size) {
+		wm = sna_static_stream_add(stream,
+					   wm_kernels[kernel].data,
+					   wm_kernels[kernel].size,
+					   64);
+	} else {
+		wm = sna_static_stream_compile_wm(sna, stream,
+						  wm_kernels[kernel].data,
+						  GEN5_WM_DISPATCH_WIDTH);
+	}
+	if (wm == 0)
+		return 0;
+
+	wm_state = sna_static_stream_map(stream,
+					 sizeof(*wm_state) * GEN4_SAMPLER_COUNT,
+					 64);
+	for (i = 0; i < GEN4_SAMPLER_COUNT; i++)
+		gen5_init_wm_state(&wm_state[i].state,
+				   wm_kernels[kernel].has_mask,
+				   wm, state->sampler[i]);
+
+	return sna_static_stream_offsetof(stream, wm_state);
+}
+
+static bool
+gen5_wm_kernel_prepare(struct sna *sna, int kernel)
+{
+	struct gen5_render_state *state = &sna->render_state.gen5;
+	struct kgem_bo *bo;
+	uint32_t used;
 
-	sna_static_stream_init(&general);
+	if (likely(state->wm[kernel]))
+		return true;
+
+	DBG(("%s: compiling kernel %d on first use\n", __FUNCTION__, kernel));
+
+	used = state->general.used;
+	state->wm[kernel] = gen5_create_wm_state(sna, &state->general, kernel);
+	if (state->wm[kernel] == 0)
+		goto err;
+
+	bo = sna_static_stream_commit(sna, &state->general, state->general_bo);
+	if (bo == NULL)
+		goto err;
+
+	if (bo != state->general_bo) {
+		/* The current batch has its base address pointing at the old bo */
+		if (!state->needs_invariant)
+			kgem_submit(&sna->kgem);
+
+		kgem_bo_destroy(&sna->kgem, state->general_bo);
+		state->general_bo = bo;
+	}
+	return true;
+
+err:
+	sna_static_stream_rewind(&state->general, used);
+	state->wm[kernel] = 0;
+	return false;
+}
+
+static bool gen5_render_setup(struct sna *sna)
+{
+	struct gen5_render_state *state = &sna->render_state.gen5;
+	struct sna_static_stream *general = &state->general;
+	uint32_t sf[2];
+	int i, j, k, l;
+
+	COMPILE_TIME_ASSERT(KERNEL_COUNT == GEN4_WM_KERNEL_COUNT);
+	COMPILE_TIME_ASSERT(FILTER_COUNT * EXTEND_COUNT *
+			    FILTER_COUNT * EXTEND_COUNT == GEN4_SAMPLER_COUNT);
+
+	sna_static_stream_init(general);
 
 	/* Zero pad the start. If you see an offset of 0x0 in the batchbuffer
 	 * dumps, you know it points to zero.
 	 */
-	null_create(&general);
+	null_create(general);
 
 	/* Set up the two SF states (one for blending with a mask, one without) */
-	sf[0] = sna_static_stream_compile_sf(sna, &general, brw_sf_kernel__nomask);
-	sf[1] = sna_static_stream_compile_sf(sna, &general, brw_sf_kernel__mask);
-
-	for (m = 0; m < KERNEL_COUNT; m++) {
-		if (wm_kernels[m].size) {
-			wm[m] = sna_static_stream_add(&general,
-						      wm_kernels[m].data,
-						      wm_kernels[m].size,
-						      64);
-		} else {
-			wm[m] = sna_static_stream_compile_wm(sna, &general,
-							     wm_kernels[m].data,
-							     16);
-		}
-		assert(wm[m]);
-	}
-
-	state->vs = gen5_create_vs_unit_state(&general);
+	sf[0] = sna_static_stream_compile_sf(sna, general, brw_sf_kernel__nomask);
+	sf[1] = sna_static_stream_compile_sf(sna, general, brw_sf_kernel__mask);
 
-	state->sf[0] = gen5_create_sf_state(&general, sf[0]);
-	state->sf[1] = gen5_create_sf_state(&general, sf[1]);
+	state->vs = gen5_create_vs_unit_state(general);
 
+	state->sf[0] = gen5_create_sf_state(general, sf[0]);
+	state->sf[1] = gen5_create_sf_state(general, sf[1]);
 
-	/* Set up the WM states: each filter/extend type for source and mask, per
-	 * kernel.
-	 */
-	wm_state = sna_static_stream_map(&general,
-					  sizeof(*wm_state) * KERNEL_COUNT *
-					  FILTER_COUNT * EXTEND_COUNT *
-					  FILTER_COUNT * EXTEND_COUNT,
-					  64);
-	state->wm = sna_static_stream_offsetof(&general, wm_state);
 	for (i = 0; i < FILTER_COUNT; i++) {
 		for (j = 0; j < EXTEND_COUNT; j++) {
 			for (k = 0; k < FILTER_COUNT; k++) {
 				for (l = 0; l < EXTEND_COUNT; l++) {
-					uint32_t sampler_state;
-
-					sampler_state =
-						gen5_create_sampler_state(&general,
+					state->sampler[SAMPLER_INDEX(i, j, k, l)] =
+						gen5_create_sampler_state(general,
 									  i, j,
 									  k, l);
-
-					for (m = 0; m < KERNEL_COUNT; m++) {
-						gen5_init_wm_state(&wm_state->state,
-								   wm_kernels[m].has_mask,
-								   wm[m], sampler_state);
-						wm_state++;
-					}
 				}
 			}
 		}
 	}
 
-	state->cc = gen5_create_cc_unit_state(&general);
+	/* Set up the WM states for each filter/extend type for source and
+	 * mask. Only those for copy and fill are built up front, the other
+	 * kernels are compiled by gen5_wm_kernel_prepare() on first use.
+	 */
+	memset(state->wm, 0, sizeof(state->wm));
+	state->wm[WM_KERNEL] = gen5_create_wm_state(sna, general, WM_KERNEL);
+	if (state->wm[WM_KERNEL] == 0)
+		return false;
+
+	state->cc = gen5_create_cc_unit_state(general);
 
-	state->general_bo = sna_static_stream_fini(sna, &general);
+	state->general_bo = sna_static_stream_upload(sna, general);
 	return state->general_bo != NULL;
 }
 
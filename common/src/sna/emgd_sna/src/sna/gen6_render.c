@@ -42,6 +42,7 @@
 
 #include "brw/brw.h"
 #include "gen6_render.h"
+#include "gen6_wm_kernels.h"
 #include "gen6_common.h"
 #include "gen4_source.h"
 #include "gen4_vertex.h"
@@ -58,14 +59,6 @@
 #define NO_RING_SWITCH 0
 #define PREFER_RENDER 0
 
-#define USE_8_PIXEL_DISPATCH 1
-#define USE_16_PIXEL_DISPATCH 1
-#define USE_32_PIXEL_DISPATCH 0
-
-#if !USE_8_PIXEL_DISPATCH && !USE_16_PIXEL_DISPATCH && !USE_32_PIXEL_DISPATCH
-#error "Must select at least 8, 16 or 32 pixel dispatch"
-#endif
-
 #define GEN6_MAX_SIZE 8192
 
 struct gt_info {
@@ -99,20 +92,6 @@ static const struct gt_info gt2_info = {
 	.gt = 2,
 };
 
-static const uint32_t ps_kernel_packed[][4] = {
-#include "exa_wm_src_affine.g6b"
-#include "exa_wm_src_sample_argb.g6b"
-#include "exa_wm_yuv_rgb.g6b"
-#include "exa_wm_write.g6b"
-};
-
-static const uint32_t ps_kernel_planar[][4] = {
-#include "exa_wm_src_affine.g6b"
-#include "exa_wm_src_sample_planar.g6b"
-#include "exa_wm_yuv_rgb.g6b"
-#include "exa_wm_write.g6b"
-};
-
 #define NOKERNEL(kernel_enum, func, ns) \
     [GEN6_WM_KERNEL_##kernel_enum] = {#kernel_enum, func, 0, ns}
 #define KERNEL(kernel_enum, kernel, ns) \
@@ -124,23 +103,7 @@ static const struct wm_kernel_info {
 	unsigned int size;
 	unsigned int num_surfaces;
 } wm_kernels[] = {
-	NOKERNEL(NOMASK, brw_wm_kernel__affine, 2),
-	NOKERNEL(NOMASK_P, brw_wm_kernel__projective, 2),
-
-	NOKERNEL(MASK, brw_wm_kernel__affine_mask, 3),
-	NOKERNEL(MASK_P, brw_wm_kernel__projective_mask, 3),
-
-	NOKERNEL(MASKCA, brw_wm_kernel__affine_mask_ca, 3),
-	NOKERNEL(MASKCA_P, brw_wm_kernel__projective_mask_ca, 3),
-
-	NOKERNEL(MASKSA, brw_wm_kernel__affine_mask_sa, 3),
-	NOKERNEL(MASKSA_P, brw_wm_kernel__projective_mask_sa, 3),
-
-	NOKERNEL(OPACITY, brw_wm_kernel__affine_opacity, 2),
-	NOKERNEL(OPACITY_P, brw_wm_kernel__projective_opacity, 2),
-
-	KERNEL(VIDEO_PLANAR, ps_kernel_planar, 7),
-	KERNEL(VIDEO_PACKED, ps_kernel_packed, 2),
+	GEN6_WM_KERNELS
 };
 #undef KERNEL
 
@@ -638,6 +601,7 @@ gen6_emit_wm(struct sna *sna, unsigned int kernel, bool has_mask)
 
 	sna->render_state.gen6.kernel = kernel;
 	kernels = sna->render_state.gen6.wm_kernel[kernel];
+	assert(kernels[0] | kernels[1] | kernels[2]);
 
 	DBG(("%s: switching to %s, num_surfaces=%d (8-pixel? %d, 16-pixel? %d,32-pixel? %d)\n",
 	     __FUNCTION__,
@@ -953,6 +917,84 @@ static void scratch_create(struct sna_static_stream *stream)
 	sna_static_stream_map(stream, 64, 64);
 }
 
+static bool
+gen6_compile_wm_kernel(struct sna *sna,
+		       struct sna_static_stream *stream,
+		       int m)
+{
+	uint32_t *kernels = sna->render_state.gen6.wm_kernel[m];
+
+	if (wm_kernels[m].size) {
+		kernels[1] = sna_static_stream_add(stream,
+						   wm_kernels[m].data,
+						   wm_kernels[m].size,
+						   64);
+	} else {
+		if (GEN6_USE_8_PIXEL_DISPATCH) {
+			kernels[0] =
+				sna_static_stream_compile_wm(sna, stream,
+							     wm_kernels[m].data, 8);
+		}
+
+		if (GEN6_USE_16_PIXEL_DISPATCH) {
+			kernels[1] =
+				sna_static_stream_compile_wm(sna, stream,
+							     wm_kernels[m].data, 16);
+		}
+
+		if (GEN6_USE_32_PIXEL_DISPATCH) {
+			kernels[2] =
+				sna_static_stream_compile_wm(sna, stream,
+							     wm_kernels[m].data, 32);
+		}
+	}
+	if ((kernels[0] | kernels[1] | kernels[2]) == 0) {
+		kernels[1] =
+			sna_static_stream_compile_wm(sna, stream,
+						     wm_kernels[m].data, 16);
+	}
+
+	return kernels[0] | kernels[1] | kernels[2];
+}
+
+static bool
+gen6_wm_kernel_prepare(struct sna *sna, int kernel)
+{
+	struct gen6_render_state *state = &sna->render_state.gen6;
+	uint32_t *kernels = state->wm_kernel[kernel];
+	struct kgem_bo *bo;
+	uint32_t used;
+
+	if (likely(kernels[0] | kernels[1] | kernels[2]))
+		return true;
+
+	DBG(("%s: compiling %s on first use\n",
+	     __FUNCTION__, wm_kernels[kernel].name));
+
+	used = state->general.used;
+	if (!gen6_compile_wm_kernel(sna, &state->general, kernel))
+		goto err;
+
+	bo = sna_static_stream_commit(sna, &state->general, state->general_bo);
+	if (bo == NULL)
+		goto err;
+
+	if (bo != state->general_bo) {
+		/* The current batch has its base address pointing at the old bo */
+		if (!state->needs_invariant)
+			kgem_submit(&sna->kgem);
+
+		kgem_bo_destroy(&sna->kgem, state->general_bo);
+		state->general_bo = bo;
+	}
+	return true;
+
+err:
+	sna_static_stream_rewind(&state->general, used);
+	kernels[0] = kernels[1] = kernels[2] = 0;
+	return false;
+}
+
 static void
 sampler_state_init(struct gen6_sampler_state *sampler_state,
 		   sampler_filter_t filter,
@@ -1637,6 +1679,9 @@ gen6_render_video(struct sna *sna,
 			       2);
 	tmp.priv = frame;
 
+	if (!gen6_wm_kernel_prepare(sna, GEN6_KERNEL(tmp.u.gen6.flags)))
+		return false;
+
 	kgem_set_mode(&sna->kgem, KGEM_RENDER, tmp.dst.bo);
 	if (!kgem_check_bo(&sna->kgem, tmp.dst.bo, frame->bo, NULL)) {
 		kgem_submit(&sna->kgem);
@@ -2264,6 +2309,15 @@ gen6_render_composite(struct sna *sna,
 	}
 	tmp->done  = gen6_render_composite_done;
 
+	if (!gen6_wm_kernel_prepare(sna, GEN6_KERNEL(tmp->u.gen6.flags)))
+		goto cleanup_mask;
+	if (tmp->need_magic_ca_pass &&
+	    !gen6_wm_kernel_prepare(sna,
+				    gen6_choose_composite_kernel(PictOpAdd,
+								 true, true,
+								 tmp->is_affine)))
+		goto cleanup_mask;
+
 	kgem_set_mode(&sna->kgem, KGEM_RENDER, tmp->dst.bo);
 	if (!kgem_check_bo(&sna->kgem,
 			   tmp->dst.bo, tmp->src.bo, tmp->mask.bo,
@@ -2497,6 +2551,9 @@ gen6_render_composite_spans(struct sna *sna,
 		tmp->thread_boxes = gen6_render_composite_spans_boxes__thread;
 	tmp->done  = gen6_render_composite_spans_done;
 
+	if (!gen6_wm_kernel_prepare(sna, GEN6_KERNEL(tmp->base.u.gen6.flags)))
+		goto cleanup_src;
+
 	kgem_set_mode(&sna->kgem, KGEM_RENDER, tmp->base.dst.bo);
 	if (!kgem_check_bo(&sna->kgem,
 			   tmp->base.dst.bo, tmp->base.src.bo,
@@ -3492,6 +3549,7 @@ static void gen6_render_reset(struct sna *sna)
 static void gen6_render_fini(struct sna *sna)
 {
 	kgem_bo_destroy(&sna->kgem, sna->render_state.gen6.general_bo);
+	free(sna->render_state.gen6.general.data);
 }
 
 static bool is_gt2(struct sna *sna, int devid)
@@ -3507,63 +3565,38 @@ static bool is_mobile(struct sna *sna, int devid)
 static bool gen6_render_setup(struct sna *sna, int devid)
 {
 	struct gen6_render_state *state = &sna->render_state.gen6;
-	struct sna_static_stream general;
+	struct sna_static_stream *general;
 	struct gen6_sampler_state *ss;
-	int i, j, k, l, m;
+	int i, j, k, l;
 
 	state->info = &gt1_info;
 	if (is_gt2(sna, devid))
 		state->info = &gt2_info; /* XXX requires GT_MODE WiZ disabled */
 	state->gt = state->info->gt;
 
-	sna_static_stream_init(&general);
+	general = &state->general;
+	sna_static_stream_init(general);
 
 	/* Zero pad the start. If you see an offset of 0x0 in the batchbuffer
 	 * dumps, you know it points to zero.
 	 */
-	null_create(&general);
-	scratch_create(&general);
-
-	for (m = 0; m < GEN6_KERNEL_COUNT; m++) {
-		if (wm_kernels[m].size) {
-			state->wm_kernel[m][1] =
-				sna_static_stream_add(&general,
-						      wm_kernels[m].data,
-						      wm_kernels[m].size,
-						      64);
-		} else {
-			if (USE_8_PIXEL_DISPATCH) {
-				state->wm_kernel[m][0] =
-					sna_static_stream_compile_wm(sna, &general,
-								     wm_kernels[m].data, 8);
-			}
-
-			if (USE_16_PIXEL_DISPATCH) {
-				state->wm_kernel[m][1] =
-					sna_static_stream_compile_wm(sna, &general,
-								     wm_kernels[m].data, 16);
-			}
+	null_create(general);
+	scratch_create(general);
 
-			if (USE_32_PIXEL_DISPATCH) {
-				state->wm_kernel[m][2] =
-					sna_static_stream_compile_wm(sna, &general,
-								     wm_kernels[m].data, 32);
-			}
-		}
-		if ((state->wm_kernel[m][0]|state->wm_kernel[m][1]|state->wm_kernel[m][2]) == 0) {
-			state->wm_kernel[m][1] =
-				sna_static_stream_compile_wm(sna, &general,
-							     wm_kernels[m].data, 16);
-		}
-	}
+	/* Only the kernel used by copy and fill is compiled up front, the
+	 * rest are built by gen6_wm_kernel_prepare() on first use.
+	 */
+	memset(state->wm_kernel, 0, sizeof(state->wm_kernel));
+	if (!gen6_compile_wm_kernel(sna, general, GEN6_WM_KERNEL_NOMASK))
+		return false;
 
-	ss = sna_static_stream_map(&general,
+	ss = sna_static_stream_map(general,
 				   2 * sizeof(*ss) *
 				   (2 +
 				    FILTER_COUNT * EXTEND_COUNT *
 				    FILTER_COUNT * EXTEND_COUNT),
 				   32);
-	state->wm_state = sna_static_stream_offsetof(&general, ss);
+	state->wm_state = sna_static_stream_offsetof(general, ss);
 	sampler_copy_init(ss); ss += 2;
 	sampler_fill_init(ss); ss += 2;
 	for (i = 0; i < FILTER_COUNT; i++) {
@@ -3577,9 +3610,9 @@ static bool gen6_render_setup(struct sna *sna, int devid)
 		}
 	}
 
-	state->cc_blend = gen6_composite_create_blend_state(&general);
+	state->cc_blend = gen6_composite_create_blend_state(general);
 
-	state->general_bo = sna_static_stream_fini(sna, &general);
+	state->general_bo = sna_static_stream_upload(sna, general);
 	return state->general_bo != NULL;
 }
 
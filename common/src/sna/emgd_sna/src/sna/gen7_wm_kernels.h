@@ -0,0 +1,69 @@
+#ifndef GEN7_WM_KERNELS_H
+#define GEN7_WM_KERNELS_H
+
+/* The WM kernels of the gen7 render backend, shared by gen7_render.c and
+ * brw/brw_wm_kernels.c. Expand GEN7_WM_KERNELS with NOKERNEL(kernel_enum,
+ * func, num_surfaces) and KERNEL(kernel_enum, program, num_surfaces)
+ * defined, in the order of the GEN7_WM_KERNEL enum. The compiled kernels
+ * are built for each of the selected dispatch widths.
+ */
+
+#include "brw/brw.h"
+
+#define GEN7_USE_8_PIXEL_DISPATCH 1
+#define GEN7_USE_16_PIXEL_DISPATCH 1
+#define GEN7_USE_32_PIXEL_DISPATCH 0
+
+#if !GEN7_USE_8_PIXEL_DISPATCH && !GEN7_USE_16_PIXEL_DISPATCH && !GEN7_USE_32_PIXEL_DISPATCH
+#error "Must select at least 8, 16 or 32 pixel dispatch"
+#endif
+
+static const uint32_t gen7_ps_kernel_packed[][4] = {
+#include "exa_wm_src_affine.g7b"
+#include "exa_wm_src_sample_argb.g7b"
+#include "exa_wm_yuv_rgb.g7b"
+#include "exa_wm_write.g7b"
+};
+
+static const uint32_t gen7_ps_kernel_planar[][4] = {
+#include "exa_wm_src_affine.g7b"
+#include "exa_wm_src_sample_planar.g7b"
+#include "exa_wm_yuv_rgb.g7b"
+#include "exa_wm_write.g7b"
+};
+
+static const uint32_t gen7_ps_kernel_yuv_packed[][4] = {
+#include "exa_wm_src_affine.g7b"
+#include "exa_wm_src_sample_argb.g7b"
+#include "exa_wm_write.g7b"
+};
+
+static const uint32_t gen7_ps_kernel_yuv_planar[][4] = {
+#include "exa_wm_src_affine.g7b"
+#include "exa_wm_src_sample_planar.g7b"
+#include "exa_wm_write.g7b"
+};
+
+#define GEN7_WM_KERNELS \
+	NOKERNEL(NOMASK, brw_wm_kernel__affine, 2), \
+	NOKERNEL(NOMASK_P, brw_wm_kernel__projective, 2), \
+	\
+	NOKERNEL(MASK, brw_wm_kernel__affine_mask, 3), \
+	NOKERNEL(MASK_P, brw_wm_kernel__projective_mask, 3), \
+	\
+	NOKERNEL(MASKCA, brw_wm_kernel__affine_mask_ca, 3), \
+	NOKERNEL(MASKCA_P, brw_wm_kernel__projective_mask_ca, 3), \
+	\
+	NOKERNEL(MASKSA, brw_wm_kernel__affine_mask_sa, 3), \
+	NOKERNEL(MASKSA_P, brw_wm_kernel__projective_mask_sa, 3), \
+	\
+	NOKERNEL(OPACITY, brw_wm_kernel__affine_opacity, 2), \
+	NOKERNEL(OPACITY_P, brw_wm_kernel__projective_opacity, 2), \
+	\
+	KERNEL(VIDEO_PLANAR, gen7_ps_kernel_planar, 7), \
+	KERNEL(VIDEO_PACKED, gen7_ps_kernel_packed, 2), \
+	\
+	KERNEL(YUV_VIDEO_PLANAR, gen7_ps_kernel_yuv_planar, 7), \
+	KERNEL(YUV_VIDEO_PACKED, gen7_ps_kernel_yuv_packed, 2)
+
+#endif /* GEN7_WM_KERNELS_H */
@@ -328,6 +328,18 @@ struct sna {
 	CloseScreenProcPtr CloseScreen;
 
 	PicturePtr clear;
+
+	/* Pre-expanded stipple and tile patterns, keyed by content. */
+	struct sna_pattern_cache {
+		struct list lru;
+		struct list hash[64];
+		int size;
+		int count;
+		unsigned hits;
+		unsigned misses;
+		unsigned evicts;
+	} pattern_cache;
+
 	struct {
 		uint32_t fill_bo;
 		uint32_t fill_pixel;
@@ -10782,6 +10782,259 @@ sna_pixmap_get_source_bo(PixmapPtr pixmap)
 	return kgem_bo_reference(priv->gpu_bo);
 }
 
+#define PATTERN_CACHE_MAX_BYTES (4 << 20)
+#define PATTERN_CACHE_MAX_KEY 4096
+
+enum {
+	PATTERN_TILE_8x8 = 0,
+	PATTERN_STIPPLE,
+};
+
+struct sna_pattern {
+	struct list lru;
+	struct list hash;
+	struct kgem_bo *bo;
+	uint32_t key;
+	uint16_t width, height;
+	uint8_t bpp, type;
+	uint16_t len;
+	uint8_t data[];
+};
+
+static uint32_t
+sna_pattern_hash(const uint8_t *src, int stride, int len, int height,
+		 uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+
+	do {
+		int i;
+
+		for (i = 0; i < len; i++)
+			hash = (hash ^ src[i]) * 16777619u;
+		src += stride;
+	} while (--height);
+
+	return hash;
+}
+
+static bool
+sna_pattern_equal(const struct sna_pattern *p, PixmapPtr src,
+		  int type, int len)
+{
+	const uint8_t *a = p->data, *b = src->devPrivate.ptr;
+	int h;
+
+	if (p->type != type ||
+	    p->width != src->drawable.width ||
+	    p->height != src->drawable.height ||
+	    p->bpp != src->drawable.bitsPerPixel ||
+	    p->len != len)
+		return false;
+
+	for (h = 0; h < p->height; h++) {
+		if (memcmp(a, b, len))
+			return false;
+		a += len;
+		b += src->devKind;
+	}
+
+	return true;
+}
+
+static void
+sna_pattern_free(struct sna *sna, struct sna_pattern *p)
+{
+	struct sna_pattern_cache *cache = &sna->pattern_cache;
+
+	cache->size -= kgem_bo_size(p->bo);
+	cache->count--;
+
+	list_del(&p->lru);
+	list_del(&p->hash);
+	kgem_bo_destroy(&sna->kgem, p->bo);
+	free(p);
+}
+
+static void sna_pattern_cache_init(struct sna *sna)
+{
+	struct sna_pattern_cache *cache = &sna->pattern_cache;
+	int i;
+
+	list_init(&cache->lru);
+	for (i = 0; i < ARRAY_SIZE(cache->hash); i++)
+		list_init(&cache->hash[i]);
+	cache->size = cache->count = 0;
+}
+
+static void sna_pattern_cache_fini(struct sna *sna)
+{
+	struct sna_pattern_cache *cache = &sna->pattern_cache;
+
+	DBG(("%s: %d patterns, %d bytes; hits=%u, misses=%u, evicts=%u\n",
+	     __FUNCTION__, cache->count, cache->size,
+	     cache->hits, cache->misses, cache->evicts));
+
+	while (!list_is_empty(&cache->lru))
+		sna_pattern_free(sna,
+				 list_first_entry(&cache->lru,
+						  struct sna_pattern, lru));
+	assert(cache->size == 0);
+}
+
+/* Look up the GPU copy of the pattern held in @src, uploading it on a
+ * miss. The key is the pixel content, not the pixmap, so the same
+ * stipple drawn through different GCs (or recreated by the client)
+ * shares a single bo. Returns a new reference, or NULL if the pattern
+ * is unsuitable for caching.
+ */
+static struct kgem_bo *
+sna_pattern_cache_get(struct sna *sna, PixmapPtr src, int type)
+{
+	struct sna_pattern_cache *cache = &sna->pattern_cache;
+	struct sna_pattern *p;
+	struct list *bucket;
+	uint32_t key;
+	int len, size;
+	uint8_t *dst;
+	void *ptr;
+	int h;
+
+	if (type == PATTERN_STIPPLE)
+		len = ALIGN((src->drawable.width + 7) / 8, 2);
+	else
+		len = src->drawable.width * src->drawable.bitsPerPixel / 8;
+	if (len * src->drawable.height > PATTERN_CACHE_MAX_KEY)
+		return NULL;
+
+	assert(src->devPrivate.ptr);
+	key = sna_pattern_hash(src->devPrivate.ptr, src->devKind,
+			       len, src->drawable.height,
+			       type << 24 | src->drawable.bitsPerPixel << 16 |
+			       src->drawable.width);
+	bucket = &cache->hash[key % ARRAY_SIZE(cache->hash)];
+
+	list_for_each_entry(p, bucket, hash) {
+		if (p->key == key && sna_pattern_equal(p, src, type, len)) {
+			DBG(("%s: hit %08x (%dx%d, type=%d)\n", __FUNCTION__,
+			     key, p->width, p->height, type));
+			cache->hits++;
+			list_move(&p->lru, &cache->lru);
+			return kgem_bo_reference(p->bo);
+		}
+	}
+
+	cache->misses++;
+
+	if (type == PATTERN_STIPPLE)
+		size = len * src->drawable.height;
+	else
+		size = 8 * src->drawable.bitsPerPixel;
+
+	p = malloc(sizeof(*p) + len * src->drawable.height);
+	if (p == NULL)
+		return NULL;
+
+	ptr = malloc(size);
+	if (ptr == NULL) {
+		free(p);
+		return NULL;
+	}
+
+	dst = ptr;
+	if (type == PATTERN_STIPPLE) {
+		const uint8_t *s = src->devPrivate.ptr;
+
+		/* XY_MONO_SRC_COPY wants the bits in the opposite order */
+		for (h = 0; h < src->drawable.height; h++) {
+			int i;
+
+			for (i = 0; i < len; i++)
+				dst[i] = byte_reverse(s[i]);
+			dst += len;
+			s += src->devKind;
+		}
+	} else {
+		int cpp = src->drawable.bitsPerPixel / 8;
+		int w;
+
+		/* Replicate the nxm tile to fill the 8x8 pattern */
+		assert(src->drawable.width <= 8 && src->drawable.height <= 8);
+		for (h = 0; h < src->drawable.height; h++) {
+			const uint8_t *s = (uint8_t *)src->devPrivate.ptr +
+				src->devKind * h;
+			uint8_t *d = dst + 8*cpp*h;
+
+			w = src->drawable.width * cpp;
+			memcpy(d, s, w);
+			while (w < 8*cpp) {
+				memcpy(d + w, d, w);
+				w *= 2;
+			}
+		}
+		w = 8*cpp;
+		while (h < 8) {
+			memcpy(dst + h*w, dst, h*w);
+			h *= 2;
+		}
+	}
+
+	p->bo = kgem_create_linear(&sna->kgem, size, 0);
+	if (p->bo == NULL) {
+		free(ptr);
+		free(p);
+		return NULL;
+	}
+	if (type == PATTERN_STIPPLE)
+		p->bo->pitch = len;
+	else
+		p->bo->pitch = 8 * src->drawable.bitsPerPixel / 8;
+	if (!kgem_bo_write(&sna->kgem, p->bo, ptr, size)) {
+		kgem_bo_destroy(&sna->kgem, p->bo);
+		free(ptr);
+		free(p);
+		return NULL;
+	}
+	free(ptr);
+
+	dst = p->data;
+	for (h = 0; h < src->drawable.height; h++) {
+		memcpy(dst,
+		       (uint8_t *)src->devPrivate.ptr + h * src->devKind,
+		       len);
+		dst += len;
+	}
+	p->key = key;
+	p->type = type;
+	p->width = src->drawable.width;
+	p->height = src->drawable.height;
+	p->bpp = src->drawable.bitsPerPixel;
+	p->len = len;
+
+	list_add(&p->lru, &cache->lru);
+	list_add(&p->hash, bucket);
+	cache->size += kgem_bo_size(p->bo);
+	cache->count++;
+
+	while (cache->size > PATTERN_CACHE_MAX_BYTES) {
+		struct sna_pattern *old;
+
+		old = list_last_entry(&cache->lru, struct sna_pattern, lru);
+		if (old == p)
+			break;
+
+		DBG(("%s: evicting %08x, cache size %d\n",
+		     __FUNCTION__, old->key, cache->size));
+		cache->evicts++;
+		sna_pattern_free(sna, old);
+	}
+
+	DBG(("%s: miss %08x (%dx%d, type=%d), cache count=%d, size=%d\n",
+	     __FUNCTION__, key, p->width, p->height, type,
+	     cache->count, cache->size));
+	return kgem_bo_reference(p->bo);
+}
+
 /*
 static bool
 tile(DrawablePtr drawable,
@@ -11118,16 +11371,20 @@ sna_poly_fill_rect_tiled_nxm_blt(DrawablePtr drawable,
 	if (!sna_pixmap_move_to_cpu(tile, MOVE_READ))
 		return false;
 
+	assert(tile->drawable.height && tile->drawable.height <= 8);
+	assert(tile->drawable.width && tile->drawable.width <= 8);
+	assert(has_coherent_ptr(sna_pixmap(tile)));
+
+	upload = sna_pattern_cache_get(sna, tile, PATTERN_TILE_8x8);
+	if (upload)
+		goto fill;
+
 	upload = kgem_create_buffer(&sna->kgem, 8*tile->drawable.bitsPerPixel,
 				    KGEM_BUFFER_WRITE_INPLACE,
 				    &ptr);
 	if (upload == NULL)
 		return false;
 
-	assert(tile->drawable.height && tile->drawable.height <= 8);
-	assert(tile->drawable.width && tile->drawable.width <= 8);
-	assert(has_coherent_ptr(sna_pixmap(tile)));
-
 	cpp = tile->drawable.bitsPerPixel/8;
 	for (h = 0; h < tile->drawable.height; h++) {
 		uint8_t *src = (uint8_t *)tile->devPrivate.ptr + tile->devKind*h;
@@ -11145,6 +11402,7 @@ sna_poly_fill_rect_tiled_nxm_blt(DrawablePtr drawable,
 		h *= 2;
 	}
 
+fill:
 	ret = sna_poly_fill_rect_tiled_8x8_blt(drawable, bo, damage,
 					       upload, gc, n, rect,
 					       extents, clipped);
@@ -11153,6 +11411,114 @@ sna_poly_fill_rect_tiled_nxm_blt(DrawablePtr drawable,
 	return ret;
 }
 
+/* Tiles the BLT cannot expand to an 8x8 pattern: a single RENDER
+ * composite with RepeatNormal fills every box, instead of a BLT copy per
+ * repeat of the tile. Only for GXcopy onto the GPU bo, and only when the
+ * fill is larger than the tile, otherwise the copy is a single blt.
+ */
+static bool
+sna_poly_fill_rect_tiled_composite(DrawablePtr drawable,
+				   struct kgem_bo *bo,
+				   struct sna_damage **damage,
+				   GCPtr gc, int n, xRectangle *rect,
+				   const BoxRec *extents, unsigned clipped)
+{
+	PixmapPtr pixmap = get_drawable_pixmap(drawable);
+	struct sna *sna = to_sna_from_pixmap(pixmap);
+	struct sna_pixmap *priv = sna_pixmap(pixmap);
+	PixmapPtr tile = gc->tile.pixmap;
+	ScreenPtr screen = pixmap->drawable.pScreen;
+	const DDXPointRec * const origin = &gc->patOrg;
+	struct sna_composite_op tmp;
+	PictFormatPtr format;
+	PicturePtr src, dst;
+	RegionPtr region;
+	RegionRec clip;
+	XID repeat = RepeatNormal;
+	int16_t dx, dy;
+	int error;
+	bool ret = false;
+
+	if (gc->alu != GXcopy || tile == pixmap ||
+	    priv == NULL || bo != priv->gpu_bo)
+		return false;
+
+	if (extents->x2 - extents->x1 <= tile->drawable.width &&
+	    extents->y2 - extents->y1 <= tile->drawable.height)
+		return false;
+
+	error = sna_render_format_for_depth(pixmap->drawable.depth);
+	format = PictureMatchFormat(screen, PIXMAN_FORMAT_DEPTH(error), error);
+	if (format == NULL)
+		return false;
+
+	region = RegionFromRects(n, rect, CT_UNSORTED);
+	if (region == NULL)
+		return false;
+	RegionTranslate(region, drawable->x, drawable->y);
+
+	region_set(&clip, extents);
+	if (clipped)
+		region_maybe_clip(&clip, gc->pCompositeClip);
+	RegionIntersect(region, region, &clip);
+	RegionUninit(&clip);
+	if (RegionNil(region)) {
+		ret = true;
+		goto free_region;
+	}
+
+	get_drawable_deltas(drawable, pixmap, &dx, &dy);
+	RegionTranslate(region, dx, dy);
+	assert_pixmap_contains_box(pixmap, RegionExtents(region));
+
+	src = CreatePicture(None, &tile->drawable, format,
+			    CPRepeat, &repeat, serverClient, &error);
+	if (src == NULL)
+		goto free_region;
+
+	dst = CreatePicture(None, &pixmap->drawable, format,
+			    0, NULL, serverClient, &error);
+	if (dst == NULL)
+		goto free_src;
+
+	ValidatePicture(src);
+	ValidatePicture(dst);
+
+	/* The tile origin is at patOrg in the drawable, RepeatNormal wraps */
+	if (!sna->render.composite(sna, PictOpSrc, src, NULL, dst,
+				   region->extents.x1 - dx - drawable->x - origin->x,
+				   region->extents.y1 - dy - drawable->y - origin->y,
+				   0, 0,
+				   region->extents.x1, region->extents.y1,
+				   region->extents.x2 - region->extents.x1,
+				   region->extents.y2 - region->extents.y1,
+				   memset(&tmp, 0, sizeof(tmp)))) {
+		DBG(("%s: unsupported composite\n", __FUNCTION__));
+		goto free_dst;
+	}
+
+	/* The caller accounts damage against its own choice of bo */
+	if (tmp.dst.bo == bo) {
+		DBG(("%s: %dx%d tile, %d boxes\n", __FUNCTION__,
+		     tile->drawable.width, tile->drawable.height,
+		     (int)RegionNumRects(region)));
+		tmp.boxes(sna, &tmp,
+			  RegionRects(region), RegionNumRects(region));
+		if (damage)
+			sna_damage_add(damage, region);
+		ret = true;
+	}
+	tmp.done(sna, &tmp);
+
+free_dst:
+	FreePicture(dst, None);
+free_src:
+	FreePicture(src, None);
+free_region:
+	RegionDestroy(region);
+	return ret;
+}
+
 static bool
 sna_poly_fill_rect_tiled_blt(DrawablePtr drawable,
 			     struct kgem_bo *bo,
@@ -11185,8 +11551,7 @@ sna_poly_fill_rect_tiled_blt(DrawablePtr drawable,
 	}
 
 	/* XXX [248]x[238] tiling can be reduced to a pattern fill.
-	 * Also we can do the lg2 reduction for BLT and use repeat modes for
-	 * RENDER.
+	 * Also we can do the lg2 reduction for BLT.
 	 */
 
 	if ((tile->drawable.width | tile->drawable.height) == 8) {
@@ -11214,6 +11579,11 @@ sna_poly_fill_rect_tiled_blt(DrawablePtr drawable,
 							gc, n, rect,
 							extents, clipped);
 
+	if (sna_poly_fill_rect_tiled_composite(drawable, bo, damage,
+					       gc, n, rect,
+					       extents, clipped))
+		return true;
+
 	tile_bo = sna_pixmap_get_source_bo(tile);
 	if (tile_bo == NULL) {
 		DBG(("%s: unable to move tile go GPU, fallback\n",
@@ -12326,6 +12696,14 @@ sna_poly_fill_rect_stippled_n_box(struct sna *sna,
 
 			use_tile = y2-y1 == h && x2-x1 == w;
 
+			/* Whole repeats of the stipple are sourced from the
+			 * cached upload, looked up on the first one we meet
+			 * so that partial repeats never pay for it.
+			 */
+			if (use_tile && *tile == NULL)
+				*tile = sna_pattern_cache_get(sna, gc->stipple,
+							      PATTERN_STIPPLE);
+
 			DBG(("%s: box((%d, %d)x(%d, %d)) origin=(%d, %d), pat=(%d, %d), up=(%d, %d), stipple=%dx%d, full tile?=%d\n",
 			     __FUNCTION__,
 			     x1, y1, x2-x1, y2-y1,
@@ -15352,6 +15730,12 @@ static void sna_accel_debug_memory(struct sna *sna)
 	ErrorF("Allocated CPU bo: %d, %ld bytes\n",
 	       sna->debug_memory.cpu_bo_allocs,
 	       (long)sna->debug_memory.cpu_bo_bytes);
+	ErrorF("Pattern cache: %d patterns, %d bytes; %u hits, %u misses, %u evictions\n",
+	       sna->pattern_cache.count,
+	       sna->pattern_cache.size,
+	       sna->pattern_cache.hits,
+	       sna->pattern_cache.misses,
+	       sna->pattern_cache.evicts);
 }
 
 #else
@@ -15672,6 +16056,8 @@ void sna_accel_create(struct sna *sna)
 {
 	DBG(("%s\n", __FUNCTION__));
 
+	sna_pattern_cache_init(sna);
+
 	if (!sna_glyphs_create(sna))
 		goto fail;
 
@@ -15714,6 +16100,7 @@ void sna_accel_close(struct sna *sna)
 	sna_composite_close(sna);
 	sna_gradients_close(sna);
 	sna_glyphs_close(sna);
+	sna_pattern_cache_fini(sna);
 
 	while (sna->freed_pixmap) {
 		PixmapPtr pixmap = sna->freed_pixmap;
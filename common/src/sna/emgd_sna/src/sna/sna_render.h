@@ -363,12 +363,35 @@ struct gen3_render_state {
 	uint32_t tex_delta[2];
 };
 
+/* Kernels already in the stream, by compile function and dispatch width */
+#define SNA_STATIC_STREAM_KERNELS 64
+
+struct sna_static_stream {
+	uint32_t size, used;
+	uint32_t uploaded;
+	uint8_t *data;
+
+	struct sna_static_kernel {
+		const void *compile;
+		uint32_t width;
+		uint32_t offset;
+	} kernels[SNA_STATIC_STREAM_KERNELS];
+};
+
+/* Must match KERNEL_COUNT, and (FILTER_COUNT * EXTEND_COUNT)^2,
+ * in gen4_render.h and gen5_render.h.
+ */
+#define GEN4_WM_KERNEL_COUNT 12
+#define GEN4_SAMPLER_COUNT 64
+
 struct gen4_render_state {
 	struct kgem_bo *general_bo;
+	struct sna_static_stream general;
 
 	uint32_t vs;
 	uint32_t sf;
-	uint32_t wm;
+	uint32_t wm[GEN4_WM_KERNEL_COUNT];
+	uint32_t sampler[GEN4_SAMPLER_COUNT];
 	uint32_t cc;
 
 	int ve_id;
@@ -385,10 +408,12 @@ struct gen4_render_state {
 
 struct gen5_render_state {
 	struct kgem_bo *general_bo;
+	struct sna_static_stream general;
 
 	uint32_t vs;
 	uint32_t sf[2];
-	uint32_t wm;
+	uint32_t wm[GEN4_WM_KERNEL_COUNT];
+	uint32_t sampler[GEN4_SAMPLER_COUNT];
 	uint32_t cc;
 
 	int ve_id;
@@ -427,6 +452,7 @@ struct gen6_render_state {
 	unsigned gt;
 	const struct gt_info *info;
 	struct kgem_bo *general_bo;
+	struct sna_static_stream general;
 
 	uint32_t vs_state;
 	uint32_t sf_state;
@@ -480,6 +506,7 @@ struct gen7_render_state {
 	unsigned gt;
 	const struct gt_info *info;
 	struct kgem_bo *general_bo;
+	struct sna_static_stream general;
 
 	uint32_t vs_state;
 	uint32_t sf_state;
@@ -505,11 +532,6 @@ struct gen7_render_state {
 	bool emit_flush;
 };
 
-struct sna_static_stream {
-	uint32_t size, used;
-	uint8_t *data;
-};
-
 int sna_static_stream_init(struct sna_static_stream *stream);
 uint32_t sna_static_stream_add(struct sna_static_stream *stream,
 			       const void *data, uint32_t len, uint32_t align);
@@ -525,6 +547,13 @@ unsigned sna_static_stream_compile_wm(struct sna *sna,
 				      struct sna_static_stream *stream,
 				      bool (*compile)(struct brw_compile *, int),
 				      int width);
+struct kgem_bo *sna_static_stream_upload(struct sna *sna,
+					 struct sna_static_stream *stream);
+struct kgem_bo *sna_static_stream_commit(struct sna *sna,
+					 struct sna_static_stream *stream,
+					 struct kgem_bo *bo);
+void sna_static_stream_rewind(struct sna_static_stream *stream,
+			      uint32_t used);
 struct kgem_bo *sna_static_stream_fini(struct sna *sna,
 				       struct sna_static_stream *stream);
 
@@ -32,7 +32,9 @@
 int sna_static_stream_init(struct sna_static_stream *stream)
 {
 	stream->used = 0;
+	stream->uploaded = 0;
 	stream->size = 64*1024;
+	memset(stream->kernels, 0, sizeof(stream->kernels));
 
 	stream->data = malloc(stream->size);
 	return stream->data != NULL;
@@ -76,19 +78,155 @@ uint32_t sna_static_stream_offsetof(struct sna_static_stream *stream, void *ptr)
 	return (uint8_t *)ptr - stream->data;
 }
 
-struct kgem_bo *sna_static_stream_fini(struct sna *sna,
-				       struct sna_static_stream *stream)
+static struct kgem_bo *
+__sna_static_stream_upload(struct sna *sna,
+			   struct sna_static_stream *stream,
+			   uint32_t size)
 {
 	struct kgem_bo *bo;
 
-	DBG(("uploaded %d bytes of static state\n", stream->used));
-
-	bo = kgem_create_linear(&sna->kgem, stream->used, 0);
+	bo = kgem_create_linear(&sna->kgem, size, 0);
 	if (bo && !kgem_bo_write(&sna->kgem, bo, stream->data, stream->used)) {
 		kgem_bo_destroy(&sna->kgem, bo);
 		return NULL;
 	}
 
+	if (bo) {
+		DBG(("uploaded %d bytes of static state into a %d byte bo\n",
+		     stream->used, kgem_bo_size(bo)));
+		stream->uploaded = stream->used;
+	}
+
+	return bo;
+}
+
+/* Upload the current contents of the stream, keeping the CPU copy so that
+ * state constructed on first use can be appended later. Offsets already
+ * handed out remain valid in the new bo as the stream only ever grows.
+ */
+struct kgem_bo *sna_static_stream_upload(struct sna *sna,
+					 struct sna_static_stream *stream)
+{
+	return __sna_static_stream_upload(sna, stream, stream->used);
+}
+
+/* Make the state appended since the last upload visible to the GPU.
+ *
+ * It is written into the tail of bo if it still fits. Nothing in flight
+ * has been given an offset that far in, so there is no need to wait.
+ * Otherwise the stream is copied into a new bo with a quarter again as
+ * much room, which is returned in place of bo; the batch being built still
+ * points at the old one through its base address and must be submitted
+ * before the new bo is used.
+ */
+struct kgem_bo *sna_static_stream_commit(struct sna *sna,
+					 struct sna_static_stream *stream,
+					 struct kgem_bo *bo)
+{
+	uint8_t *ptr;
+
+	assert(stream->uploaded <= stream->used);
+	if (stream->uploaded == stream->used)
+		return bo;
+
+	if (stream->used <= kgem_bo_size(bo)) {
+		ptr = kgem_bo_map__async(&sna->kgem, bo);
+		if (ptr) {
+			DBG(("wrote %d bytes of static state at %d\n",
+			     stream->used - stream->uploaded,
+			     stream->uploaded));
+			memcpy(ptr + stream->uploaded,
+			       stream->data + stream->uploaded,
+			       stream->used - stream->uploaded);
+			stream->uploaded = stream->used;
+			return bo;
+		}
+	}
+
+	return __sna_static_stream_upload(sna, stream,
+					  stream->used + stream->used / 4);
+}
+
+static unsigned kernel_hash(const void *compile, int width)
+{
+	uintptr_t v = (uintptr_t)compile ^ width;
+
+	v ^= v >> 16;
+	v *= 0x45d9f3b;
+	v ^= v >> 16;
+	return v & (SNA_STATIC_STREAM_KERNELS - 1);
+}
+
+static uint32_t kernel_lookup(struct sna_static_stream *stream,
+			      const void *compile, int width)
+{
+	unsigned n, i = kernel_hash(compile, width);
+
+	for (n = 0; n < SNA_STATIC_STREAM_KERNELS; n++) {
+		struct sna_static_kernel *k = &stream->kernels[i];
+
+		if (k->compile == NULL)
+			break;
+
+		if (k->compile == compile && k->width == width)
+			return k->offset;
+
+		i = (i + 1) & (SNA_STATIC_STREAM_KERNELS - 1);
+	}
+
+	return 0;
+}
+
+static void kernel_insert(struct sna_static_stream *stream,
+			  const void *compile, int width, uint32_t offset)
+{
+	unsigned n, i = kernel_hash(compile, width);
+
+	for (n = 0; n < SNA_STATIC_STREAM_KERNELS; n++) {
+		struct sna_static_kernel *k = &stream->kernels[i];
+
+		if (k->compile == NULL) {
+			k->compile = compile;
+			k->width = width;
+			k->offset = offset;
+			return;
+		}
+
+		i = (i + 1) & (SNA_STATIC_STREAM_KERNELS - 1);
+	}
+
+	/* Full, the kernel is just not shared */
+}
+
+/* Forget everything appended since used, e.g. when a kernel compiled on
+ * first use could not be uploaded.
+ */
+void sna_static_stream_rewind(struct sna_static_stream *stream,
+			      uint32_t used)
+{
+	struct sna_static_kernel kernels[SNA_STATIC_STREAM_KERNELS];
+	int n;
+
+	assert(used <= stream->used);
+	stream->used = used;
+	if (stream->uploaded > used)
+		stream->uploaded = used;
+
+	memcpy(kernels, stream->kernels, sizeof(kernels));
+	memset(stream->kernels, 0, sizeof(stream->kernels));
+	for (n = 0; n < SNA_STATIC_STREAM_KERNELS; n++) {
+		if (kernels[n].compile && kernels[n].offset < used)
+			kernel_insert(stream, kernels[n].compile,
+				      kernels[n].width, kernels[n].offset);
+	}
+}
+
+struct kgem_bo *sna_static_stream_fini(struct sna *sna,
+				       struct sna_static_stream *stream)
+{
+	struct kgem_bo *bo;
+
+	bo = sna_static_stream_upload(sna, stream);
 	free(stream->data);
 
 	return bo;
@@ -100,6 +238,11 @@ sna_static_stream_compile_sf(struct sna *sna,
 			     bool (*compile)(struct brw_compile *))
 {
 	struct brw_compile p;
+	uint32_t offset;
+
+	offset = kernel_lookup(stream, compile, 0);
+	if (offset)
+		return offset;
 
 	brw_compile_init(&p, sna->kgem.gen,
 			 sna_static_stream_map(stream,
@@ -113,7 +256,9 @@ sna_static_stream_compile_sf(struct sna *sna,
 	assert(p.nr_insn*sizeof(struct brw_instruction) <= 64*sizeof(uint32_t));
 
 	stream->used -= 64*sizeof(uint32_t) - p.nr_insn*sizeof(struct brw_instruction);
-	return sna_static_stream_offsetof(stream, p.store);
+	offset = sna_static_stream_offsetof(stream, p.store);
+	kernel_insert(stream, compile, 0, offset);
+	return offset;
 }
 
 unsigned
@@ -123,6 +268,11 @@ sna_static_stream_compile_wm(struct sna *sna,
 			     int dispatch_width)
 {
 	struct brw_compile p;
+	uint32_t offset;
+
+	offset = kernel_lookup(stream, compile, dispatch_width);
+	if (offset)
+		return offset;
 
 	brw_compile_init(&p, sna->kgem.gen,
 			 sna_static_stream_map(stream,
@@ -136,5 +286,7 @@ sna_static_stream_compile_wm(struct sna *sna,
 	assert(p.nr_insn*sizeof(struct brw_instruction) <= 256*sizeof(uint32_t));
 
 	stream->used -= 256*sizeof(uint32_t) - p.nr_insn*sizeof(struct brw_instruction);
-	return sna_static_stream_offsetof(stream, p.store);
+	offset = sna_static_stream_offsetof(stream, p.store);
+	kernel_insert(stream, compile, dispatch_width, offset);
+	return offset;
 }
@@ -1296,6 +1296,7 @@ I965DisplayVideoTextured(ScrnInfoPtr scrn,
 		/* If this command won't fit in the current batch, flush.
 		 * Assume that it does after being flushed.
 		 */
+		intel_batch_emit_queued(scrn);
 		if (drm_intel_bufmgr_check_aperture_space(bo_table,
 							  ARRAY_SIZE(bo_table))
 		    < 0) {
@@ -1923,6 +1924,7 @@ void Gen6DisplayVideoTextured(ScrnInfoPtr scrn,
 		/* If this command won't fit in the current batch, flush.
 		 * Assume that it does after being flushed.
 		 */
+		intel_batch_emit_queued(scrn);
 		if (drm_intel_bufmgr_check_aperture_space(bo_table, ARRAY_SIZE(bo_table)) < 0)
 			intel_batch_submit(scrn);
 
@@ -70,6 +70,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "intel_driver.h"
 #include "intel_options.h"
 #include "intel_list.h"
+#include "intel_batch_plan.h"
 #include "compat-api.h"
 
 #if HAVE_UDEV
@@ -188,6 +189,18 @@ typedef struct intel_screen_private {
 	/** Ending batch_used that was verified by intel_start_batch_atomic() */
 	int batch_atomic_limit;
 	struct list batch_pixmaps;
+	/** Blits waiting to be packed into the batch */
+	struct intel_batch_plan batch_plan;
+	/** Submission counters, reported at teardown */
+	struct {
+		unsigned int frames;
+		unsigned int batches;
+		unsigned int aperture_flushes;
+		unsigned int aperture_fallbacks;
+		unsigned int plan_flushes;
+		uint64_t bytes_used;
+		uint64_t bytes_available;
+	} batch_stats;
 	drm_intel_bo *wa_scratch_bo;
 	OsTimerPtr cache_expire;
 
@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "intel_batch_plan.h"
+
+/* A blit may only move ahead of the deferred ones if it neither writes
+ * a buffer they touch nor reads one they write.
+ */
+static int
+plan_conflicts(const struct intel_plan_op *op,
+	       drm_intel_bo **written, int num_written,
+	       drm_intel_bo **read, int num_read)
+{
+	int i;
+
+	for (i = 0; i < num_written; i++)
+		if (written[i] == op->dst || written[i] == op->src)
+			return 1;
+
+	for (i = 0; i < num_read; i++)
+		if (read[i] == op->dst)
+			return 1;
+
+	return 0;
+}
+
+int
+intel_batch_plan_select(struct intel_batch_plan *plan,
+			drm_intel_bo *batch_bo, int space, int empty,
+			struct intel_plan_op *out)
+{
+	drm_intel_bo *bo_table[1 + 2 * INTEL_PLAN_MAX_OPS];
+	drm_intel_bo *written[INTEL_PLAN_MAX_OPS];
+	drm_intel_bo *read[INTEL_PLAN_MAX_OPS];
+	int num_bos = 1, num_written = 0, num_read = 0;
+	int i, n = 0, kept = 0;
+
+	/* The working set is that of the batch so far plus every blit
+	 * taken on this pass; libdrm counts each buffer only once.
+	 */
+	bo_table[0] = batch_bo;
+
+	for (i = 0; i < plan->num_ops; i++) {
+		struct intel_plan_op *op = &plan->op[i];
+		int fits;
+
+		if (i == 0 && empty) {
+			fits = 1;
+		} else if (op->len > space ||
+			   plan_conflicts(op,
+					  written, num_written,
+					  read, num_read)) {
+			fits = 0;
+		} else {
+			int count = num_bos;
+
+			bo_table[count++] = op->dst;
+			if (op->src)
+				bo_table[count++] = op->src;
+			fits = drm_intel_bufmgr_check_aperture_space(bo_table,
+								     count) == 0;
+		}
+
+		if (fits) {
+			bo_table[num_bos++] = op->dst;
+			if (op->src)
+				bo_table[num_bos++] = op->src;
+			space -= op->len;
+			if (kept)
+				plan->reordered++;
+			out[n++] = *op;
+		} else {
+			written[num_written++] = op->dst;
+			if (op->src)
+				read[num_read++] = op->src;
+			plan->op[kept++] = *op;
+		}
+	}
+
+	plan->num_ops = kept;
+	return n;
+}
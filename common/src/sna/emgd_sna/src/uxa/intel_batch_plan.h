@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef _INTEL_BATCH_PLAN_H
+#define _INTEL_BATCH_PLAN_H
+
+#include <stdint.h>
+#include "intel_bufmgr.h"
+
+/*
+ * Fills and copies on the blitter are self-contained commands whose only
+ * dependencies are the buffers they read and write, so rather than being
+ * written straight into the batch they are queued here.  When the queue
+ * is emitted, the planner packs into the current batch every blit whose
+ * buffers still fit alongside the batch's working set, moving it ahead
+ * of earlier blits that would have forced a submission as long as the
+ * two share no buffer that either writes.  Whatever is left goes into
+ * the following batches, still in its original order.
+ */
+
+#define INTEL_PLAN_MAX_OPS	64
+#define INTEL_PLAN_MAX_DWORDS	8
+
+/* Dword positions of the relocations within a queued blit */
+#define INTEL_PLAN_DST_RELOC	4
+#define INTEL_PLAN_SRC_RELOC	7
+
+struct intel_pixmap;
+
+struct intel_plan_op {
+	drm_intel_bo *dst;
+	drm_intel_bo *src;	/* NULL for fills */
+	struct intel_pixmap *dst_priv, *src_priv;
+	uint32_t dw[INTEL_PLAN_MAX_DWORDS];
+	int len;
+};
+
+struct intel_batch_plan {
+	struct intel_plan_op op[INTEL_PLAN_MAX_OPS];
+	int num_ops;
+	/** Set while the queue is being written into the batch */
+	int emitting;
+	/** Blits queued, and those emitted ahead of an earlier one */
+	unsigned int queued;
+	unsigned int reordered;
+};
+
+/**
+ * Moves the queued blits that fit into the batch described by @batch_bo
+ * and @space (in dwords) into @out, in the order they are to be emitted,
+ * and returns how many there are.  The first blit is always taken when
+ * the batch is @empty, so that every call on a fresh batch makes progress.
+ */
+int intel_batch_plan_select(struct intel_batch_plan *plan,
+			    drm_intel_bo *batch_bo, int space, int empty,
+			    struct intel_plan_op *out);
+
+#endif /* _INTEL_BATCH_PLAN_H */
@@ -0,0 +1,351 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Runs the blit planner against a mock buffer manager: an aperture of a
+ * given size and a batch whose relocation tree is the set of buffers the
+ * blits emitted into it refer to.  Each blit is "executed" on emission
+ * by folding its source into its destination, so that any reordering
+ * across a dependency shows up as a different final value compared to
+ * running the same blits in the order they were queued.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "intel_batch_plan.h"
+
+#define NUM_BOS 8
+#define FILL_SOURCE 0x9e3779b9
+
+struct _drm_intel_bufmgr {
+	unsigned long aperture;
+};
+
+struct mock_bo {
+	drm_intel_bo base;
+	int counted;
+	uint32_t value;
+};
+
+static drm_intel_bufmgr bufmgr;
+static struct mock_bo bos[NUM_BOS];
+
+static struct mock_batch {
+	struct mock_bo bo;
+	struct mock_bo *tree[NUM_BOS];
+	int num_tree;
+	int num_ops;
+	int used, capacity;
+	int batches;
+} batch;
+
+static unsigned int emitted[INTEL_PLAN_MAX_OPS];
+
+int drm_intel_bufmgr_check_aperture_space(drm_intel_bo ** bo_array,
+					  int count)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct mock_bo *bo = (struct mock_bo *)bo_array[i];
+
+		if (bo == &batch.bo) {
+			int j;
+
+			for (j = 0; j < batch.num_tree; j++) {
+				if (!batch.tree[j]->counted) {
+					batch.tree[j]->counted = 1;
+					total += batch.tree[j]->base.size;
+				}
+			}
+		}
+
+		if (!bo->counted) {
+			bo->counted = 1;
+			total += bo->base.size;
+		}
+	}
+
+	batch.bo.counted = 0;
+	for (i = 0; i < NUM_BOS; i++)
+		bos[i].counted = 0;
+
+	return total > bufmgr.aperture ? -ENOSPC : 0;
+}
+
+static unsigned long batch_working_set(void)
+{
+	unsigned long total = batch.bo.base.size;
+	int i;
+
+	for (i = 0; i < batch.num_tree; i++)
+		total += batch.tree[i]->base.size;
+
+	return total;
+}
+
+static void batch_add_reloc(drm_intel_bo *target)
+{
+	struct mock_bo *bo = (struct mock_bo *)target;
+	int i;
+
+	for (i = 0; i < batch.num_tree; i++)
+		if (batch.tree[i] == bo)
+			return;
+
+	batch.tree[batch.num_tree++] = bo;
+}
+
+static void batch_submit(void)
+{
+	if (batch.used == 0)
+		return;
+
+	batch.num_tree = 0;
+	batch.num_ops = 0;
+	batch.used = 0;
+	batch.batches++;
+}
+
+static void batch_reset(unsigned long aperture, int capacity)
+{
+	memset(&batch, 0, sizeof(batch));
+	batch.bo.base.size = 1;
+	batch.capacity = capacity;
+	bufmgr.aperture = aperture;
+	memset(emitted, 0, sizeof(emitted));
+}
+
+static uint32_t run_op(uint32_t dst, uint32_t src, uint32_t id)
+{
+	return dst * 31 + src + id;
+}
+
+static void batch_emit(const struct intel_plan_op *op)
+{
+	struct mock_bo *dst = (struct mock_bo *)op->dst;
+	struct mock_bo *src = (struct mock_bo *)op->src;
+
+	dst->value = run_op(dst->value,
+			    src ? src->value : FILL_SOURCE,
+			    op->dw[0]);
+	emitted[op->dw[0]]++;
+
+	batch_add_reloc(op->dst);
+	if (op->src)
+		batch_add_reloc(op->src);
+	batch.used += op->len;
+	batch.num_ops++;
+}
+
+/* The loop of intel_batch_emit_queued(), checking every batch against
+ * the limits it was planned for.
+ */
+static int emit_queued(struct intel_batch_plan *plan)
+{
+	struct intel_plan_op op[INTEL_PLAN_MAX_OPS];
+	int n, i;
+
+	while (plan->num_ops) {
+		n = intel_batch_plan_select(plan, &batch.bo.base,
+					    batch.capacity - batch.used,
+					    batch.used == 0, op);
+		for (i = 0; i < n; i++)
+			batch_emit(&op[i]);
+
+		if (batch_working_set() > bufmgr.aperture) {
+			fprintf(stderr, "batch %d exceeds the aperture: %lu > %lu\n",
+				batch.batches, batch_working_set(),
+				bufmgr.aperture);
+			return 1;
+		}
+		if (batch.used > batch.capacity) {
+			fprintf(stderr, "batch %d overflows: %d > %d dwords\n",
+				batch.batches, batch.used, batch.capacity);
+			return 1;
+		}
+
+		if (plan->num_ops)
+			batch_submit();
+	}
+
+	return 0;
+}
+
+/* What intel_get_aperture_space() did before the planner: submit
+ * whenever the next blit does not fit with the batch so far.
+ */
+static int emit_in_order(const struct intel_plan_op *op, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		drm_intel_bo *bo_table[] = {
+			&batch.bo.base, op[i].dst, op[i].src
+		};
+
+		if (drm_intel_bufmgr_check_aperture_space(bo_table,
+							  op[i].src ? 3 : 2) ||
+		    batch.used + op[i].len > batch.capacity)
+			batch_submit();
+		batch_emit(&op[i]);
+	}
+	batch_submit();
+
+	return batch.batches;
+}
+
+static void queue_blt(struct intel_batch_plan *plan, int dst, int src)
+{
+	struct intel_plan_op *op = &plan->op[plan->num_ops];
+
+	memset(op, 0, sizeof(*op));
+	op->dst = &bos[dst].base;
+	op->src = src < 0 ? NULL : &bos[src].base;
+	op->len = src < 0 ? 6 : 8;
+	op->dw[0] = plan->num_ops++;
+}
+
+/* Large pixmaps alternating between two pairs, where each pair fills
+ * most of the aperture: in order every copy forces a submission.
+ */
+static int test_alternating(void)
+{
+	struct intel_batch_plan plan;
+	int in_order, planned, i;
+
+	for (i = 0; i < 4; i++) {
+		memset(&bos[i], 0, sizeof(bos[i]));
+		bos[i].base.size = 96;
+	}
+
+	memset(&plan, 0, sizeof(plan));
+	for (i = 0; i < 32; i++) {
+		if (i & 1)
+			queue_blt(&plan, 3, 2);
+		else
+			queue_blt(&plan, 1, 0);
+	}
+
+	batch_reset(256, 1024);
+	in_order = emit_in_order(plan.op, plan.num_ops);
+
+	batch_reset(256, 1024);
+	if (emit_queued(&plan))
+		return 1;
+	batch_submit();
+	planned = batch.batches;
+
+	printf("alternating copies: %d batches in order, %d planned, "
+	       "%u reordered\n", in_order, planned, plan.reordered);
+
+	if (in_order != 32 || planned != 2) {
+		fprintf(stderr, "alternating copies: expected 32 and 2 batches\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Random blits over a small set of buffers, checking that every blit is
+ * emitted exactly once, every batch fits, and that the buffers end up
+ * as if the blits had been run in the order they were queued.
+ */
+static int test_random(unsigned int seed)
+{
+	uint32_t expected[NUM_BOS];
+	struct intel_batch_plan plan;
+	unsigned long largest = 0;
+	int i, count;
+
+	srandom(seed);
+
+	for (i = 0; i < NUM_BOS; i++) {
+		memset(&bos[i], 0, sizeof(bos[i]));
+		bos[i].base.size = 1 + random() % 64;
+		bos[i].value = expected[i] = random();
+		if (bos[i].base.size > largest)
+			largest = bos[i].base.size;
+	}
+
+	memset(&plan, 0, sizeof(plan));
+	count = 1 + random() % INTEL_PLAN_MAX_OPS;
+	for (i = 0; i < count; i++) {
+		int dst = random() % NUM_BOS;
+		int src = random() % 4 == 0 ? -1 : random() % NUM_BOS;
+
+		queue_blt(&plan, dst, src);
+		expected[dst] = run_op(expected[dst],
+				       src < 0 ? FILL_SOURCE : expected[src],
+				       i);
+	}
+
+	/* Every blit fits on its own in an empty batch, as
+	 * intel_uxa_check_blt_aperture() guarantees.
+	 */
+	batch_reset(1 + 2 * largest + random() % 256, 8 + random() % 256);
+	if (emit_queued(&plan))
+		return 1;
+
+	for (i = 0; i < count; i++) {
+		if (emitted[i] != 1) {
+			fprintf(stderr, "seed %u: blit %d emitted %u times\n",
+				seed, i, emitted[i]);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < NUM_BOS; i++) {
+		if (bos[i].value != expected[i]) {
+			fprintf(stderr, "seed %u: bo %d is %08x, expected %08x\n",
+				seed, i, bos[i].value, expected[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int seed, iterations = 20000;
+	int ret = 0;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+
+	ret |= test_alternating();
+	for (seed = 0; seed < iterations && ret == 0; seed++)
+		ret |= test_random(seed);
+
+	if (ret == 0)
+		printf("%u random queues emitted in dependency order\n",
+		       iterations);
+
+	return ret;
+}
@@ -32,6 +32,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include "xf86.h"
@@ -112,11 +113,41 @@ void intel_batch_init(ScrnInfoPtr scrn)
 	intel->last_3d = LAST_3D_OTHER;
 }
 
+static void intel_batch_report_stats(ScrnInfoPtr scrn)
+{
+	intel_screen_private *intel = intel_get_screen_private(scrn);
+
+	if (intel->batch_stats.batches == 0)
+		return;
+
+	xf86DrvMsgVerb(scrn->scrnIndex, X_INFO, 3,
+		       "%u batches over %u frames (%.2f per frame), "
+		       "%.1f%% average fill, %u aperture flushes, "
+		       "%u aperture fallbacks, %u of %u blits reordered "
+		       "over %u planned splits\n",
+		       intel->batch_stats.batches,
+		       intel->batch_stats.frames,
+		       intel->batch_stats.frames ?
+		       (double)intel->batch_stats.batches /
+		       intel->batch_stats.frames : 0.,
+		       100. * intel->batch_stats.bytes_used /
+		       intel->batch_stats.bytes_available,
+		       intel->batch_stats.aperture_flushes,
+		       intel->batch_stats.aperture_fallbacks,
+		       intel->batch_plan.reordered,
+		       intel->batch_plan.queued,
+		       intel->batch_stats.plan_flushes);
+}
+
 void intel_batch_teardown(ScrnInfoPtr scrn)
 {
 	intel_screen_private *intel = intel_get_screen_private(scrn);
 	int i;
 
+	intel_batch_report_stats(scrn);
+	memset(&intel->batch_stats, 0, sizeof(intel->batch_stats));
+	memset(&intel->batch_plan, 0, sizeof(intel->batch_plan));
+
 	for (i = 0; i < ARRAY_SIZE(intel->last_batch_bo); i++) {
 		if (intel->last_batch_bo[i] != NULL) {
 			dri_bo_unreference(intel->last_batch_bo[i]);
@@ -219,6 +250,83 @@ void intel_batch_emit_flush(ScrnInfoPtr scrn)
 	intel_batch_do_flush(scrn);
 }
 
+static void intel_batch_emit_blt(ScrnInfoPtr scrn,
+				 const struct intel_plan_op *op)
+{
+	intel_screen_private *intel = intel_get_screen_private(scrn);
+	int i;
+
+	BEGIN_BATCH_BLT(op->len);
+	for (i = 0; i < op->len; i++) {
+		if (i == INTEL_PLAN_DST_RELOC) {
+			intel_batch_mark_pixmap_domains(intel, op->dst_priv,
+							I915_GEM_DOMAIN_RENDER,
+							I915_GEM_DOMAIN_RENDER);
+			OUT_RELOC_FENCED(op->dst,
+					 I915_GEM_DOMAIN_RENDER,
+					 I915_GEM_DOMAIN_RENDER,
+					 0);
+		} else if (i == INTEL_PLAN_SRC_RELOC && op->src) {
+			intel_batch_mark_pixmap_domains(intel, op->src_priv,
+							I915_GEM_DOMAIN_RENDER,
+							0);
+			OUT_RELOC_FENCED(op->src,
+					 I915_GEM_DOMAIN_RENDER, 0,
+					 0);
+		} else
+			OUT_BATCH(op->dw[i]);
+	}
+	ADVANCE_BATCH();
+}
+
+/* Room kept back from the planner for the context switch and the
+ * gen6+ clip workaround emitted around the blits.
+ */
+#define PLAN_RESERVED 8
+
+/**
+ * Writes the queued blits into the batch, as many per batch as fit in
+ * the aperture and the batch, submitting in between until none are
+ * left.  Called before anything else is emitted or submitted, and
+ * before the CPU or the render paths look at the batch's buffers.
+ */
+void intel_batch_emit_queued(ScrnInfoPtr scrn)
+{
+	intel_screen_private *intel = intel_get_screen_private(scrn);
+	struct intel_batch_plan *plan = &intel->batch_plan;
+	struct intel_plan_op op[INTEL_PLAN_MAX_OPS];
+	int n, i;
+
+	if (plan->emitting || plan->num_ops == 0)
+		return;
+
+	plan->emitting = TRUE;
+	while (plan->num_ops) {
+		n = intel_batch_plan_select(plan, intel->batch_bo,
+					    intel_batch_space(intel) / 4 -
+					    PLAN_RESERVED,
+					    intel->batch_used == 0,
+					    op);
+		for (i = 0; i < n; i++)
+			intel_batch_emit_blt(scrn, &op[i]);
+
+		if (n && (IS_GEN6(intel) || IS_GEN7(intel))) {
+			/* workaround a random BLT hang */
+			BEGIN_BATCH_BLT(3);
+			OUT_BATCH(XY_SETUP_CLIP_BLT_CMD);
+			OUT_BATCH(0);
+			OUT_BATCH(0);
+			ADVANCE_BATCH();
+		}
+
+		if (plan->num_ops) {
+			intel->batch_stats.plan_flushes++;
+			intel_batch_submit(scrn);
+		}
+	}
+	plan->emitting = FALSE;
+}
+
 void intel_batch_submit(ScrnInfoPtr scrn)
 {
 	intel_screen_private *intel = intel_get_screen_private(scrn);
@@ -226,6 +334,8 @@ void intel_batch_submit(ScrnInfoPtr scrn)
 
 	assert (!intel->in_batch_atomic);
 
+	intel_batch_emit_queued(scrn);
+
 	if (intel->vertex_flush)
 		intel->vertex_flush(intel);
 	intel_end_vertex(intel);
@@ -242,6 +352,10 @@ void intel_batch_submit(ScrnInfoPtr scrn)
 	if (intel->batch_used & 1)
 		OUT_BATCH(MI_NOOP);
 
+	intel->batch_stats.batches++;
+	intel->batch_stats.bytes_used += intel->batch_used * 4;
+	intel->batch_stats.bytes_available += intel->batch_bo->size;
+
 	if (DUMP_BATCHBUFFERS) {
 	    FILE *file = fopen(DUMP_BATCHBUFFERS, "a");
 	    if (file) {
@@ -37,6 +37,7 @@ void intel_batch_init(ScrnInfoPtr scrn);
 void intel_batch_teardown(ScrnInfoPtr scrn);
 void intel_batch_emit_flush(ScrnInfoPtr scrn);
 void intel_batch_submit(ScrnInfoPtr scrn);
+void intel_batch_emit_queued(ScrnInfoPtr scrn);
 
 static inline int intel_batch_space(intel_screen_private *intel)
 {
@@ -62,6 +63,9 @@ static inline void intel_batch_start_atomic(ScrnInfoPtr scrn, int sz)
 
 	assert(!intel->in_batch_atomic);
 
+	if (intel->batch_plan.num_ops)
+		intel_batch_emit_queued(scrn);
+
 	if (intel->current_batch != RENDER_BATCH) {
 		if (intel->current_batch && intel->context_switch)
 			intel->context_switch(intel, RENDER_BATCH);
@@ -152,6 +156,22 @@ intel_batch_emit_reloc_pixmap(intel_screen_private *intel, PixmapPtr pixmap,
 			       delta, needs_fence);
 }
 
+/**
+ * Returns a slot for a blit in the queue, writing the queue out first if
+ * it is full.  The caller fills in the commands and buffers.
+ */
+static inline struct intel_plan_op *
+intel_batch_queue_blt(ScrnInfoPtr scrn, intel_screen_private *intel)
+{
+	struct intel_batch_plan *plan = &intel->batch_plan;
+
+	if (plan->num_ops == INTEL_PLAN_MAX_OPS)
+		intel_batch_emit_queued(scrn);
+
+	plan->queued++;
+	return &plan->op[plan->num_ops++];
+}
+
 #define ALIGN_BATCH(align) intel_batch_align(intel, align);
 #define OUT_BATCH(dword) intel_batch_emit_dword(intel, dword)
 
@@ -184,6 +204,8 @@ do {									\
 		FatalError("%s: BEGIN_BATCH called without closing "	\
 			   "ADVANCE_BATCH\n", __FUNCTION__);		\
 	assert(!intel->in_batch_atomic);				\
+	if (intel->batch_plan.num_ops)					\
+		intel_batch_emit_queued(scrn);				\
 	if (intel->current_batch != batch_idx) {			\
 		if (intel->current_batch && intel->context_switch)	\
 			intel->context_switch(intel, batch_idx);	\
@@ -140,8 +140,25 @@ intel_get_aperture_space(ScrnInfoPtr scrn, drm_intel_bo ** bo_table,
 		return FALSE;
 	}
 
+	/* The check below is against the batch as it will be emitted. */
+	intel_batch_emit_queued(scrn);
+
 	bo_table[0] = intel->batch_bo;
 	if (drm_intel_bufmgr_check_aperture_space(bo_table, num_bos) != 0) {
+		/* Only split the batch if doing so lets this operation fit.
+		 * If its own buffers exceed the aperture, flushing just
+		 * throws away the working set accumulated so far and we
+		 * end up falling back anyway.
+		 */
+		if (drm_intel_bufmgr_check_aperture_space(bo_table + 1,
+							  num_bos - 1) != 0) {
+			intel->batch_stats.aperture_fallbacks++;
+			intel_debug_fallback(scrn, "BOs exceed aperture "
+					    "on their own\n");
+			return FALSE;
+		}
+
+		intel->batch_stats.aperture_flushes++;
 		intel_batch_submit(scrn);
 		bo_table[0] = intel->batch_bo;
 		if (drm_intel_bufmgr_check_aperture_space(bo_table, num_bos) !=
@@ -264,6 +281,30 @@ intel_uxa_check_solid(DrawablePtr drawable, int alu, Pixel planemask)
 	return TRUE;
 }
 
+/* Blits are queued and only packed into a batch once the planner knows
+ * what else is going in with them, so here we only need to know that
+ * the operation's own buffers can ever fit.
+ */
+static Bool
+intel_uxa_check_blt_aperture(ScrnInfoPtr scrn, drm_intel_bo ** bo_table,
+			     int num_bos)
+{
+	intel_screen_private *intel = intel_get_screen_private(scrn);
+
+	if (intel->batch_bo == NULL) {
+		intel_debug_fallback(scrn, "VT inactive\n");
+		return FALSE;
+	}
+
+	if (drm_intel_bufmgr_check_aperture_space(bo_table, num_bos) != 0) {
+		intel->batch_stats.aperture_fallbacks++;
+		intel_debug_fallback(scrn, "BOs exceed aperture "
+				    "on their own\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * Sets up hardware state for a series of solid fills.
  */
@@ -273,14 +314,14 @@ intel_uxa_prepare_solid(PixmapPtr pixmap, int alu, Pixel planemask, Pixel fg)
 	ScrnInfoPtr scrn = xf86ScreenToScrn(pixmap->drawable.pScreen);
 	intel_screen_private *intel = intel_get_screen_private(scrn);
 	drm_intel_bo *bo_table[] = {
-		NULL,		/* batch_bo */
 		intel_get_pixmap_bo(pixmap),
 	};
 
 	if (!intel_check_pitch_2d(pixmap))
 		return FALSE;
 
-	if (!intel_get_aperture_space(scrn, bo_table, ARRAY_SIZE(bo_table)))
+	if (!intel_uxa_check_blt_aperture(scrn, bo_table,
+					  ARRAY_SIZE(bo_table)))
 		return FALSE;
 
 	intel->BR[13] = (I830PatternROP[alu] & 0xff) << 16;
@@ -305,6 +346,7 @@ static void intel_uxa_solid(PixmapPtr pixmap, int x1, int y1, int x2, int y2)
 {
 	ScrnInfoPtr scrn = xf86ScreenToScrn(pixmap->drawable.pScreen);
 	intel_screen_private *intel = intel_get_screen_private(scrn);
+	struct intel_plan_op *op;
 	unsigned long pitch;
 	uint32_t cmd;
 
@@ -322,31 +364,36 @@ static void intel_uxa_solid(PixmapPtr pixmap, int x1, int y1, int x2, int y2)
 
 	pitch = intel_pixmap_pitch(pixmap);
 
-	{
-		BEGIN_BATCH_BLT(6);
-
-		cmd = XY_COLOR_BLT_CMD;
-
-		if (pixmap->drawable.bitsPerPixel == 32)
-			cmd |=
-			    XY_COLOR_BLT_WRITE_ALPHA | XY_COLOR_BLT_WRITE_RGB;
-
-		if (INTEL_INFO(intel)->gen >= 040 && intel_pixmap_tiled(pixmap)) {
-			assert((pitch % 512) == 0);
-			pitch >>= 2;
-			cmd |= XY_COLOR_BLT_TILED;
-		}
+	cmd = XY_COLOR_BLT_CMD;
 
-		OUT_BATCH(cmd);
+	if (pixmap->drawable.bitsPerPixel == 32)
+		cmd |= XY_COLOR_BLT_WRITE_ALPHA | XY_COLOR_BLT_WRITE_RGB;
 
-		OUT_BATCH(intel->BR[13] | pitch);
-		OUT_BATCH((y1 << 16) | (x1 & 0xffff));
-		OUT_BATCH((y2 << 16) | (x2 & 0xffff));
-		OUT_RELOC_PIXMAP_FENCED(pixmap, I915_GEM_DOMAIN_RENDER,
-					I915_GEM_DOMAIN_RENDER, 0);
-		OUT_BATCH(intel->BR[16]);
-		ADVANCE_BATCH();
+	if (INTEL_INFO(intel)->gen >= 040 && intel_pixmap_tiled(pixmap)) {
+		assert((pitch % 512) == 0);
+		pitch >>= 2;
+		cmd |= XY_COLOR_BLT_TILED;
 	}
+
+	op = intel_batch_queue_blt(scrn, intel);
+	op->dst_priv = intel_get_pixmap_private(pixmap);
+	op->dst = op->dst_priv->bo;
+	op->src_priv = NULL;
+	op->src = NULL;
+	op->len = 6;
+	op->dw[0] = cmd;
+	op->dw[1] = intel->BR[13] | pitch;
+	op->dw[2] = (y1 << 16) | (x1 & 0xffff);
+	op->dw[3] = (y2 << 16) | (x2 & 0xffff);
+	/* dw[4] is the destination relocation */
+	op->dw[5] = intel->BR[16];
+
+	/* Account for the blit now so that the pixmap is seen as busy
+	 * until the batch holding it is submitted.
+	 */
+	intel_batch_mark_pixmap_domains(intel, op->dst_priv,
+					I915_GEM_DOMAIN_RENDER,
+					I915_GEM_DOMAIN_RENDER);
 }
 
 /**
@@ -392,12 +439,12 @@ intel_uxa_prepare_copy(PixmapPtr source, PixmapPtr dest, int xdir,
 	ScrnInfoPtr scrn = xf86ScreenToScrn(dest->drawable.pScreen);
 	intel_screen_private *intel = intel_get_screen_private(scrn);
 	drm_intel_bo *bo_table[] = {
-		NULL,		/* batch_bo */
 		intel_get_pixmap_bo(source),
 		intel_get_pixmap_bo(dest),
 	};
 
-	if (!intel_get_aperture_space(scrn, bo_table, ARRAY_SIZE(bo_table)))
+	if (!intel_uxa_check_blt_aperture(scrn, bo_table,
+					  ARRAY_SIZE(bo_table)))
 		return FALSE;
 
 	intel->render_source = source;
@@ -423,6 +470,7 @@ intel_uxa_copy(PixmapPtr dest, int src_x1, int src_y1, int dst_x1,
 {
 	ScrnInfoPtr scrn = xf86ScreenToScrn(dest->drawable.pScreen);
 	intel_screen_private *intel = intel_get_screen_private(scrn);
+	struct intel_plan_op *op;
 	uint32_t cmd;
 	int dst_x2, dst_y2, src_x2, src_y2;
 	unsigned int dst_pitch, src_pitch;
@@ -460,63 +508,54 @@ intel_uxa_copy(PixmapPtr dest, int src_x1, int src_y1, int dst_x1,
 	dst_pitch = intel_pixmap_pitch(dest);
 	src_pitch = intel_pixmap_pitch(intel->render_source);
 
-	{
-		BEGIN_BATCH_BLT(8);
-
-		cmd = XY_SRC_COPY_BLT_CMD;
+	cmd = XY_SRC_COPY_BLT_CMD;
 
-		if (dest->drawable.bitsPerPixel == 32)
-			cmd |=
-			    XY_SRC_COPY_BLT_WRITE_ALPHA |
-			    XY_SRC_COPY_BLT_WRITE_RGB;
+	if (dest->drawable.bitsPerPixel == 32)
+		cmd |= XY_SRC_COPY_BLT_WRITE_ALPHA | XY_SRC_COPY_BLT_WRITE_RGB;
 
-		if (INTEL_INFO(intel)->gen >= 040) {
-			if (intel_pixmap_tiled(dest)) {
-				assert((dst_pitch % 512) == 0);
-				dst_pitch >>= 2;
-				cmd |= XY_SRC_COPY_BLT_DST_TILED;
-			}
-
-			if (intel_pixmap_tiled(intel->render_source)) {
-				assert((src_pitch % 512) == 0);
-				src_pitch >>= 2;
-				cmd |= XY_SRC_COPY_BLT_SRC_TILED;
-			}
+	if (INTEL_INFO(intel)->gen >= 040) {
+		if (intel_pixmap_tiled(dest)) {
+			assert((dst_pitch % 512) == 0);
+			dst_pitch >>= 2;
+			cmd |= XY_SRC_COPY_BLT_DST_TILED;
 		}
 
-		OUT_BATCH(cmd);
+		if (intel_pixmap_tiled(intel->render_source)) {
+			assert((src_pitch % 512) == 0);
+			src_pitch >>= 2;
+			cmd |= XY_SRC_COPY_BLT_SRC_TILED;
+		}
+	}
 
-		OUT_BATCH(intel->BR[13] | dst_pitch);
-		OUT_BATCH((dst_y1 << 16) | (dst_x1 & 0xffff));
-		OUT_BATCH((dst_y2 << 16) | (dst_x2 & 0xffff));
-		OUT_RELOC_PIXMAP_FENCED(dest,
+	op = intel_batch_queue_blt(scrn, intel);
+	op->dst_priv = intel_get_pixmap_private(dest);
+	op->dst = op->dst_priv->bo;
+	op->src_priv = intel_get_pixmap_private(intel->render_source);
+	op->src = op->src_priv->bo;
+	op->len = 8;
+	op->dw[0] = cmd;
+	op->dw[1] = intel->BR[13] | dst_pitch;
+	op->dw[2] = (dst_y1 << 16) | (dst_x1 & 0xffff);
+	op->dw[3] = (dst_y2 << 16) | (dst_x2 & 0xffff);
+	/* dw[4] is the destination relocation */
+	op->dw[5] = (src_y1 << 16) | (src_x1 & 0xffff);
+	op->dw[6] = src_pitch;
+	/* dw[7] is the source relocation */
+
+	intel_batch_mark_pixmap_domains(intel, op->dst_priv,
 					I915_GEM_DOMAIN_RENDER,
-					I915_GEM_DOMAIN_RENDER,
-					0);
-		OUT_BATCH((src_y1 << 16) | (src_x1 & 0xffff));
-		OUT_BATCH(src_pitch);
-		OUT_RELOC_PIXMAP_FENCED(intel->render_source,
-					I915_GEM_DOMAIN_RENDER, 0,
-					0);
-
-		ADVANCE_BATCH();
-	}
+					I915_GEM_DOMAIN_RENDER);
+	intel_batch_mark_pixmap_domains(intel, op->src_priv,
+					I915_GEM_DOMAIN_RENDER, 0);
 }
 
 static void intel_uxa_done(PixmapPtr pixmap)
 {
 	ScrnInfoPtr scrn = xf86ScreenToScrn(pixmap->drawable.pScreen);
-	intel_screen_private *intel = intel_get_screen_private(scrn);
-
-	if (IS_GEN6(intel) || IS_GEN7(intel)) {
-		/* workaround a random BLT hang */
-		BEGIN_BATCH_BLT(3);
-		OUT_BATCH(XY_SETUP_CLIP_BLT_CMD);
-		OUT_BATCH(0);
-		OUT_BATCH(0);
-		ADVANCE_BATCH();
-	}
 
+	/* The gen6+ clip workaround follows the blits once they are
+	 * written out of the queue, see intel_batch_emit_queued().
+	 */
 	intel_debug_flush(scrn);
 }
 
@@ -642,6 +681,10 @@ void intel_set_pixmap_bo(PixmapPtr pixmap, dri_bo * bo)
 		if (priv->bo == bo)
 			return;
 
+		/* Queued blits still refer to the private. */
+		if (!list_is_empty(&priv->batch))
+			intel_batch_emit_queued(xf86ScreenToScrn(pixmap->drawable.pScreen));
+
 		dri_bo_unreference(priv->bo);
 		list_del(&priv->batch);
 
@@ -702,7 +745,13 @@ static Bool intel_uxa_prepare_access(PixmapPtr pixmap, uxa_access_t access)
 
 	/* When falling back to swrast, flush all pending operations */
 	intel_glamor_flush(intel);
-	if (access == UXA_ACCESS_RW || priv->dirty)
+	/* Only pixmaps referenced by the outstanding batch need it
+	 * submitted before the CPU may touch them; anything else can be
+	 * mapped without breaking up the batch.
+	 */
+	if ((access == UXA_ACCESS_RW || priv->dirty) &&
+	    (!list_is_empty(&priv->batch) ||
+	     drm_intel_bo_references(intel->batch_bo, bo)))
 		intel_batch_submit(scrn);
 
 	assert(bo->size <= intel->max_gtt_map_size);
@@ -972,6 +1021,7 @@ static void intel_flush_rendering(intel_screen_private *intel)
 	if (intel->needs_flush == 0)
 		return;
 
+	intel->batch_stats.frames++;
 	if (intel->has_kernel_flush) {
 		intel_batch_submit(intel->scrn);
 		drm_intel_bo_busy(intel->front_buffer);
@@ -79,10 +79,34 @@
 #define GLYPH_MAX_SIZE 64
 #define GLYPH_CACHE_SIZE (CACHE_PICTURE_SIZE * CACHE_PICTURE_SIZE / (GLYPH_MIN_SIZE * GLYPH_MIN_SIZE))
 
+/* Number of randomly chosen blocks considered when looking for the least
+ * recently used one to evict.
+ */
+#define GLYPH_EVICT_CANDIDATES 8
+
+/* Glyphs missing from the cache are packed into a staging pixmap of at
+ * most this size and then copied into the cache together.
+ */
+#define GLYPH_STAGING_WIDTH 512
+#define GLYPH_STAGING_HEIGHT 256
+#define GLYPH_STAGING_COUNT 128
+
 struct uxa_glyph {
 	uxa_glyph_cache_t *cache;
 	uint16_t x, y;
 	uint16_t size, pos;
+	uint32_t serial;	/* last glyph run to use this glyph */
+};
+
+struct uxa_glyph_staging {
+	uxa_glyph_cache_t *cache;
+	int x, y, height;
+	int count;
+	struct uxa_glyph_upload {
+		GlyphPtr glyph;
+		struct uxa_glyph *priv;
+		int16_t x, y;
+	} upload[GLYPH_STAGING_COUNT];
 };
 
 #if HAS_DEVPRIVATEKEYREC
@@ -118,6 +142,10 @@ static void uxa_unrealize_glyph_caches(ScreenPtr pScreen)
 	for (i = 0; i < UXA_NUM_GLYPH_CACHE_FORMATS; i++) {
 		uxa_glyph_cache_t *cache = &uxa_screen->glyphCaches[i];
 
+		DBG_GLYPH_CACHE(("glyph cache %d: %u hits, %u misses, %u evictions, %u uploads\n",
+				 i, cache->stats.hits, cache->stats.misses,
+				 cache->stats.evictions, cache->stats.uploads));
+
 		if (cache->picture)
 			FreePicture(cache->picture, 0);
 
@@ -196,8 +224,6 @@ static Bool uxa_realize_glyph_caches(ScreenPtr pScreen)
 		cache->glyphs = calloc(sizeof(GlyphPtr), GLYPH_CACHE_SIZE);
 		if (!cache->glyphs)
 			goto bail;
-
-		cache->evict = rand() % GLYPH_CACHE_SIZE;
 	}
 	assert(i == UXA_NUM_GLYPH_CACHE_FORMATS);
 
@@ -588,92 +614,317 @@ uxa_glyph_size_to_mask(int size)
 	return uxa_glyph_count_to_mask(uxa_glyph_size_to_count(size));
 }
 
-static PicturePtr
-uxa_glyph_cache(ScreenPtr screen, GlyphPtr glyph, int *out_x, int *out_y)
+static void
+uxa_glyph_cache_evict(uxa_glyph_cache_t *cache, GlyphPtr glyph)
 {
-	uxa_screen_t *uxa_screen = uxa_get_screen(screen);
-	PicturePtr glyph_picture = GetGlyphPicture(glyph, screen);
-	uxa_glyph_cache_t *cache = &uxa_screen->glyphCaches[PICT_FORMAT_RGB(glyph_picture->format) != 0];
-	struct uxa_glyph *priv = NULL;
-	int size, mask, pos, s;
+	struct uxa_glyph *priv = uxa_glyph_get_private(glyph);
 
-	if (glyph->info.width > GLYPH_MAX_SIZE || glyph->info.height > GLYPH_MAX_SIZE)
-		return NULL;
+	cache->glyphs[priv->pos] = NULL;
+	uxa_glyph_set_private(glyph, NULL);
+	free(priv);
 
-	for (size = GLYPH_MIN_SIZE; size <= GLYPH_MAX_SIZE; size *= 2)
-		if (glyph->info.width <= size && glyph->info.height <= size)
-			break;
+	cache->stats.evictions++;
+}
+
+/* Returns the glyph occupying a larger block that contains pos, if any */
+static GlyphPtr
+uxa_glyph_cache_owner(uxa_glyph_cache_t *cache, int pos, int size)
+{
+	int s;
+
+	for (s = 2 * size; s <= GLYPH_MAX_SIZE; s *= 2) {
+		GlyphPtr glyph = cache->glyphs[pos & uxa_glyph_size_to_mask(s)];
+		if (glyph && uxa_glyph_get_private(glyph)->size >= s)
+			return glyph;
+	}
+
+	return NULL;
+}
+
+/* How many glyph runs ago the block at pos was last used; 0 if it holds
+ * a glyph from the current run, which must not be evicted.
+ */
+static uint32_t
+uxa_glyph_cache_block_age(uxa_glyph_cache_t *cache, int pos, int size)
+{
+	GlyphPtr owner;
+	uint32_t age = ~0U;
+	int i, count;
+
+	owner = uxa_glyph_cache_owner(cache, pos, size);
+	if (owner)
+		return cache->serial - uxa_glyph_get_private(owner)->serial;
+
+	count = uxa_glyph_size_to_count(size);
+	for (i = 0; i < count; i++) {
+		GlyphPtr glyph = cache->glyphs[pos + i];
+		uint32_t v;
+
+		if (glyph == NULL)
+			continue;
+
+		v = cache->serial - uxa_glyph_get_private(glyph)->serial;
+		if (v < age)
+			age = v;
+	}
+
+	return age;
+}
 
-	s = uxa_glyph_size_to_count(size);
-	mask = uxa_glyph_count_to_mask(s);
-	pos = (cache->count + s - 1) & mask;
+/* Find room for a glyph of the given size, evicting the least recently
+ * used of a few candidate blocks once the cache is full.
+ */
+static int
+uxa_glyph_cache_alloc(uxa_glyph_cache_t *cache, int size)
+{
+	int count = uxa_glyph_size_to_count(size);
+	int mask = uxa_glyph_count_to_mask(count);
+	uint32_t best_age = 0;
+	int pos, best = -1, i;
+	GlyphPtr owner;
+
+	pos = (cache->count + count - 1) & mask;
 	if (pos < GLYPH_CACHE_SIZE) {
-		cache->count = pos + s;
-	} else {
-		for (s = size; s <= GLYPH_MAX_SIZE; s *= 2) {
-			int i = cache->evict & uxa_glyph_size_to_mask(s);
-			GlyphPtr evicted = cache->glyphs[i];
-			if (evicted == NULL)
-				continue;
+		cache->count = pos + count;
+		return pos;
+	}
 
-			priv = uxa_glyph_get_private(evicted);
-			if (priv->size >= s) {
-				cache->glyphs[i] = NULL;
-				uxa_glyph_set_private(evicted, NULL);
-				pos = cache->evict & uxa_glyph_size_to_mask(size);
-			} else
-				priv = NULL;
-			break;
+	for (i = 0; i < GLYPH_EVICT_CANDIDATES; i++) {
+		uint32_t age;
+
+		pos = (rand() % GLYPH_CACHE_SIZE) & mask;
+		age = uxa_glyph_cache_block_age(cache, pos, size);
+		if (age > best_age) {
+			best_age = age;
+			best = pos;
+			if (age == ~0U)
+				break;
 		}
-		if (priv == NULL) {
-			int count = uxa_glyph_size_to_count(size);
-			mask = uxa_glyph_count_to_mask(count);
-			pos = cache->evict & mask;
-			for (s = 0; s < count; s++) {
-				GlyphPtr evicted = cache->glyphs[pos + s];
-				if (evicted != NULL) {
-					if (priv != NULL)
-						free(priv);
-
-					priv = uxa_glyph_get_private(evicted);
-					uxa_glyph_set_private(evicted, NULL);
-					cache->glyphs[pos + s] = NULL;
-				}
-			}
+	}
+	if (best < 0)
+		return -1;
+
+	owner = uxa_glyph_cache_owner(cache, best, size);
+	if (owner) {
+		uxa_glyph_cache_evict(cache, owner);
+	} else {
+		for (i = 0; i < count; i++) {
+			GlyphPtr evicted = cache->glyphs[best + i];
+			if (evicted != NULL)
+				uxa_glyph_cache_evict(cache, evicted);
 		}
+	}
+
+	return best;
+}
+
+/* The glyphs are rendered into the staging pixmap on the CPU and then
+ * copied into the cache with a single blit operation.
+ */
+static void
+uxa_glyph_staging_flush(ScreenPtr screen, struct uxa_glyph_staging *staging)
+{
+	uxa_screen_t *uxa_screen = uxa_get_screen(screen);
+	uxa_glyph_cache_t *cache = staging->cache;
+	PixmapPtr cache_pixmap = (PixmapPtr) cache->picture->pDrawable;
+	PixmapPtr pixmap;
+	PicturePtr picture = NULL;
+	int i, error;
+
+	if (staging->count == 0)
+		return;
+
+	pixmap = screen->CreatePixmap(screen,
+				      GLYPH_STAGING_WIDTH,
+				      staging->y + staging->height,
+				      cache_pixmap->drawable.depth,
+				      UXA_CREATE_PIXMAP_FOR_MAP);
+	if (pixmap) {
+		if (uxa_pixmap_is_offscreen(pixmap))
+			picture = CreatePicture(0, &pixmap->drawable,
+						PictureMatchFormat(screen,
+								   cache_pixmap->drawable.depth,
+								   cache->picture->format),
+						0, NULL,
+						serverClient, &error);
+		screen->DestroyPixmap(pixmap);
+	}
+	if (picture == NULL)
+		goto slow;
+
+	ValidatePicture(picture);
+	for (i = 0; i < staging->count; i++) {
+		struct uxa_glyph_upload *u = &staging->upload[i];
+
+		uxa_check_composite(PictOpSrc,
+				    GetGlyphPicture(u->glyph, screen), NULL, picture,
+				    0, 0,
+				    0, 0,
+				    u->x, u->y,
+				    u->glyph->info.width, u->glyph->info.height);
+	}
+
+	if ((uxa_screen->info->check_copy &&
+	     !uxa_screen->info->check_copy(pixmap, cache_pixmap, GXcopy, FB_ALLONES)) ||
+	    !uxa_screen->info->prepare_copy(pixmap, cache_pixmap,
+					    1, 1, GXcopy, FB_ALLONES)) {
+		FreePicture(picture, 0);
+		goto slow;
+	}
+
+	for (i = 0; i < staging->count; i++) {
+		struct uxa_glyph_upload *u = &staging->upload[i];
 
-		/* And pick a new eviction position */
-		cache->evict = rand() % GLYPH_CACHE_SIZE;
+		uxa_screen->info->copy(cache_pixmap,
+				       u->x, u->y,
+				       u->priv->x, u->priv->y,
+				       u->glyph->info.width,
+				       u->glyph->info.height);
 	}
+	uxa_screen->info->done_copy(cache_pixmap);
+	cache->stats.uploads++;
+
+	FreePicture(picture, 0);
+	goto done;
 
-	if (priv == NULL) {
-		priv = malloc(sizeof(struct uxa_glyph));
-		if (priv == NULL)
-			return NULL;
+slow:
+	for (i = 0; i < staging->count; i++) {
+		struct uxa_glyph_upload *u = &staging->upload[i];
+
+		uxa_glyph_cache_upload_glyph(screen, cache, u->glyph,
+					     u->priv->x, u->priv->y);
+		cache->stats.uploads++;
 	}
 
+done:
+	staging->count = 0;
+	staging->x = staging->y = staging->height = 0;
+}
+
+static void
+uxa_glyph_staging_add(ScreenPtr screen,
+		      struct uxa_glyph_staging *staging,
+		      GlyphPtr glyph, struct uxa_glyph *priv)
+{
+	int w = glyph->info.width, h = glyph->info.height;
+	struct uxa_glyph_upload *u;
+
+	if (staging->count == GLYPH_STAGING_COUNT)
+		uxa_glyph_staging_flush(screen, staging);
+
+	if (staging->x + w > GLYPH_STAGING_WIDTH) {
+		staging->x = 0;
+		staging->y += staging->height;
+		staging->height = 0;
+	}
+	if (staging->y + h > GLYPH_STAGING_HEIGHT)
+		uxa_glyph_staging_flush(screen, staging);
+
+	u = &staging->upload[staging->count++];
+	u->glyph = glyph;
+	u->priv = priv;
+	u->x = staging->x;
+	u->y = staging->y;
+
+	staging->x += w;
+	if (h > staging->height)
+		staging->height = h;
+}
+
+static void
+uxa_glyph_cache(ScreenPtr screen,
+		struct uxa_glyph_staging *staging,
+		GlyphPtr glyph)
+{
+	PicturePtr glyph_picture = GetGlyphPicture(glyph, screen);
+	struct uxa_glyph_staging *s = &staging[PICT_FORMAT_RGB(glyph_picture->format) != 0];
+	uxa_glyph_cache_t *cache = s->cache;
+	struct uxa_glyph *priv;
+	int size, pos, i;
+
+	if (glyph->info.width > GLYPH_MAX_SIZE || glyph->info.height > GLYPH_MAX_SIZE)
+		return;
+
+	cache->stats.misses++;
+
+	for (size = GLYPH_MIN_SIZE; size <= GLYPH_MAX_SIZE; size *= 2)
+		if (glyph->info.width <= size && glyph->info.height <= size)
+			break;
+
+	pos = uxa_glyph_cache_alloc(cache, size);
+	if (pos < 0)
+		return;
+
+	priv = malloc(sizeof(struct uxa_glyph));
+	if (priv == NULL)
+		return;
+
 	uxa_glyph_set_private(glyph, priv);
 	cache->glyphs[pos] = glyph;
 
 	priv->cache = cache;
 	priv->size = size;
 	priv->pos = pos;
-	s = pos / ((GLYPH_MAX_SIZE / GLYPH_MIN_SIZE) * (GLYPH_MAX_SIZE / GLYPH_MIN_SIZE));
-	priv->x = s % (CACHE_PICTURE_SIZE / GLYPH_MAX_SIZE) * GLYPH_MAX_SIZE;
-	priv->y = (s / (CACHE_PICTURE_SIZE / GLYPH_MAX_SIZE)) * GLYPH_MAX_SIZE;
-	for (s = GLYPH_MIN_SIZE; s < GLYPH_MAX_SIZE; s *= 2) {
+	priv->serial = cache->serial;
+	i = pos / ((GLYPH_MAX_SIZE / GLYPH_MIN_SIZE) * (GLYPH_MAX_SIZE / GLYPH_MIN_SIZE));
+	priv->x = i % (CACHE_PICTURE_SIZE / GLYPH_MAX_SIZE) * GLYPH_MAX_SIZE;
+	priv->y = (i / (CACHE_PICTURE_SIZE / GLYPH_MAX_SIZE)) * GLYPH_MAX_SIZE;
+	for (i = GLYPH_MIN_SIZE; i < GLYPH_MAX_SIZE; i *= 2) {
 		if (pos & 1)
-			priv->x += s;
+			priv->x += i;
 		if (pos & 2)
-			priv->y += s;
+			priv->y += i;
 		pos >>= 2;
 	}
 
-	uxa_glyph_cache_upload_glyph(screen, cache, glyph, priv->x, priv->y);
+	uxa_glyph_staging_add(screen, s, glyph, priv);
+}
+
+/* Make sure every glyph in the run is resident in the cache before we
+ * start rendering. Glyphs used by this run are stamped with its serial so
+ * that they cannot be evicted by later misses in the same run.
+ */
+static void
+uxa_glyphs_cache_run(ScreenPtr screen,
+		     int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+	uxa_screen_t *uxa_screen = uxa_get_screen(screen);
+	struct uxa_glyph_staging staging[UXA_NUM_GLYPH_CACHE_FORMATS];
+	int i, n;
+
+	if (!uxa_screen->glyph_cache_initialized)
+		return;
+
+	for (i = 0; i < UXA_NUM_GLYPH_CACHE_FORMATS; i++) {
+		staging[i].cache = &uxa_screen->glyphCaches[i];
+		staging[i].cache->serial++;
+		staging[i].x = staging[i].y = staging[i].height = 0;
+		staging[i].count = 0;
+	}
+
+	while (nlist--) {
+		n = list->len;
+		while (n--) {
+			GlyphPtr glyph = *glyphs++;
+			struct uxa_glyph *priv;
 
-	*out_x = priv->x;
-	*out_y = priv->y;
-	return cache->picture;
+			if (glyph->info.width == 0 || glyph->info.height == 0)
+				continue;
+
+			priv = uxa_glyph_get_private(glyph);
+			if (priv != NULL) {
+				priv->serial = priv->cache->serial;
+				priv->cache->stats.hits++;
+				continue;
+			}
+
+			uxa_glyph_cache(screen, staging, glyph);
+		}
+		list++;
+	}
+
+	for (i = 0; i < UXA_NUM_GLYPH_CACHE_FORMATS; i++)
+		uxa_glyph_staging_flush(screen, &staging[i]);
 }
 
 static void
@@ -832,16 +1083,9 @@ uxa_glyphs_via_mask(CARD8 op,
 				glyph_y = priv->y;
 				this_atlas = priv->cache->picture;
 			} else {
-				if (glyph_atlas) {
-					uxa_screen->info->done_composite(pixmap);
-					glyph_atlas = NULL;
-				}
-				this_atlas = uxa_glyph_cache(screen, glyph, &glyph_x, &glyph_y);
-				if (this_atlas == NULL) {
-					/* no cache for this glyph */
-					this_atlas = GetGlyphPicture(glyph, screen);
-					glyph_x = glyph_y = 0;
-				}
+				/* no cache for this glyph */
+				this_atlas = GetGlyphPicture(glyph, screen);
+				glyph_x = glyph_y = 0;
 			}
 
 			if (this_atlas != glyph_atlas) {
@@ -926,12 +1170,9 @@ uxa_glyphs_to_dst(CARD8 op,
 				glyph_y = priv->y;
 				glyph_atlas = priv->cache->picture;
 			} else {
-				glyph_atlas = uxa_glyph_cache(screen, glyph, &glyph_x, &glyph_y);
-				if (glyph_atlas == NULL) {
-					/* no cache for this glyph */
-					glyph_atlas = GetGlyphPicture(glyph, screen);
-					glyph_x = glyph_y = 0;
-				}
+				/* no cache for this glyph */
+				glyph_atlas = GetGlyphPicture(glyph, screen);
+				glyph_x = glyph_y = 0;
 			}
 
 			uxa_composite(op,
@@ -1014,6 +1255,8 @@ fallback:
 	ValidatePicture(pSrc);
 	ValidatePicture(pDst);
 
+	uxa_glyphs_cache_run(screen, nlist, list, glyphs);
+
 	if (!maskFormat) {
 		/* If we don't have a mask format but all the glyphs have the same format,
 		 * require ComponentAlpha and don't intersect, use the glyph format as mask
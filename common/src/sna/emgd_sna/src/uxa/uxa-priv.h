@@ -94,11 +94,23 @@ char uxa_drawable_location(DrawablePtr pDrawable);
 #define DBG_PIXMAP(a)
 #endif
 
+#if DEBUG_GLYPH_CACHE
+#define DBG_GLYPH_CACHE(a) ErrorF a
+#else
+#define DBG_GLYPH_CACHE(a)
+#endif
+
 typedef struct {
 	PicturePtr picture;	/* Where the glyphs of the cache are stored */
 	GlyphPtr *glyphs;
 	uint16_t count;
-	uint16_t evict;
+	uint32_t serial;	/* current glyph run, its glyphs are pinned */
+	struct {
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+		unsigned int uploads;
+	} stats;
 } uxa_glyph_cache_t;
 
 #define UXA_NUM_GLYPH_CACHE_FORMATS 2
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+/* A handful of patterns, recreated on every pass, so that repeated fills
+ * exercise both fresh uploads and reuse of identical stipple/tile content.
+ */
+static const struct {
+	int width, height;
+} sizes[] = {
+	{ 8, 8 },
+	{ 4, 2 },
+	{ 3, 5 },
+	{ 16, 16 },
+	{ 48, 40 },
+	{ 64, 33 },
+};
+
+static Pixmap create_stipple(struct test_display *t, Drawable d,
+			     int width, int height, unsigned seed)
+{
+	XGCValues val;
+	Pixmap stipple;
+	GC gc;
+	int x, y;
+
+	stipple = XCreatePixmap(t->dpy, d, width, height, 1);
+
+	val.foreground = 0;
+	gc = XCreateGC(t->dpy, stipple, GCForeground, &val);
+	XFillRectangle(t->dpy, stipple, gc, 0, 0, width, height);
+
+	XSetForeground(t->dpy, gc, 1);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			if ((x * 7 + y * 13 + seed) % 5 < 2)
+				XDrawPoint(t->dpy, stipple, gc, x, y);
+
+	XFreeGC(t->dpy, gc);
+	return stipple;
+}
+
+static Pixmap create_tile(struct test_display *t, Drawable d, int depth,
+			  int width, int height, unsigned seed)
+{
+	XGCValues val;
+	Pixmap tile;
+	GC gc;
+	int x, y;
+
+	tile = XCreatePixmap(t->dpy, d, width, height, depth);
+
+	gc = XCreateGC(t->dpy, tile, 0, &val);
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			XSetForeground(t->dpy, gc,
+				       (x * 0x1f3d + y * 0x7a1 + seed) * 0x9e3779b1);
+			XDrawPoint(t->dpy, tile, gc, x, y);
+		}
+	}
+
+	XFreeGC(t->dpy, gc);
+	return tile;
+}
+
+static void fill_rect(struct test_display *t, Drawable d,
+		      int style, Pixmap pattern, uint8_t alu,
+		      int ox, int oy,
+		      int x, int y, int w, int h,
+		      uint32_t fg, uint32_t bg)
+{
+	XGCValues val;
+	unsigned long mask;
+	GC gc;
+
+	val.function = alu;
+	val.foreground = fg;
+	val.background = bg;
+	val.fill_style = style;
+	val.ts_x_origin = ox;
+	val.ts_y_origin = oy;
+	mask = GCForeground | GCBackground | GCFunction | GCFillStyle |
+		GCTileStipXOrigin | GCTileStipYOrigin;
+	if (style == FillTiled) {
+		val.tile = pattern;
+		mask |= GCTile;
+	} else {
+		val.stipple = pattern;
+		mask |= GCStipple;
+	}
+
+	gc = XCreateGC(t->dpy, d, mask, &val);
+	XFillRectangle(t->dpy, d, gc, x, y, w, h);
+	XFreeGC(t->dpy, gc);
+}
+
+static void clear(struct test_display *dpy, struct test_target *tt)
+{
+	XRenderColor render_color = {0};
+	XRenderFillRectangle(dpy->dpy, PictOpClear, tt->picture, &render_color,
+			     0, 0, tt->width, tt->height);
+}
+
+static void pattern_tests(struct test *t, int style,
+			  int reps, int sets, enum target target)
+{
+	static const char *names[] = {
+		[FillTiled] = "tiled",
+		[FillStippled] = "stippled",
+		[FillOpaqueStippled] = "opaque stippled",
+	};
+	struct test_target real, ref;
+	int r, s;
+
+	printf("Testing %s fills (%s): ", names[style], test_target_name(target));
+	fflush(stdout);
+
+	test_target_create_render(&t->real, target, &real);
+	clear(&t->real, &real);
+
+	test_target_create_render(&t->ref, target, &ref);
+	clear(&t->ref, &ref);
+
+	for (s = 0; s < sets; s++) {
+		int i = rand() % (sizeof(sizes)/sizeof(sizes[0]));
+		unsigned seed = rand() % 3;
+		Pixmap real_pattern, ref_pattern;
+
+		if (style == FillTiled) {
+			real_pattern = create_tile(&t->real, real.draw, real.format->depth,
+						   sizes[i].width, sizes[i].height,
+						   seed);
+			ref_pattern = create_tile(&t->ref, ref.draw, ref.format->depth,
+						  sizes[i].width, sizes[i].height,
+						  seed);
+		} else {
+			real_pattern = create_stipple(&t->real, real.draw,
+						      sizes[i].width, sizes[i].height,
+						      seed);
+			ref_pattern = create_stipple(&t->ref, ref.draw,
+						     sizes[i].width, sizes[i].height,
+						     seed);
+		}
+
+		for (r = 0; r < reps; r++) {
+			int x = rand() % (2*real.width) - real.width;
+			int y = rand() % (2*real.height) - real.height;
+			int w = rand() % (2*real.width);
+			int h = rand() % (2*real.height);
+			int ox = rand() % 64 - 32;
+			int oy = rand() % 64 - 32;
+			uint8_t alu = rand() % (GXset + 1);
+			uint32_t fg = rand();
+			uint32_t bg = rand();
+
+			fill_rect(&t->real, real.draw, style, real_pattern, alu,
+				  ox, oy, x, y, w, h, fg, bg);
+			fill_rect(&t->ref, ref.draw, style, ref_pattern, alu,
+				  ox, oy, x, y, w, h, fg, bg);
+		}
+
+		XFreePixmap(t->real.dpy, real_pattern);
+		XFreePixmap(t->ref.dpy, ref_pattern);
+
+		test_compare(t,
+			     real.draw, real.format,
+			     ref.draw, ref.format,
+			     0, 0, real.width, real.height,
+			     "");
+	}
+
+	printf("passed [%d iterations x %d]\n", reps, sets);
+
+	test_target_destroy_render(&t->real, &real);
+	test_target_destroy_render(&t->ref, &ref);
+}
+
+int main(int argc, char **argv)
+{
+	struct test test;
+	int i;
+
+	test_init(&test, argc, argv);
+
+	for (i = 0; i <= DEFAULT_ITERATIONS; i++) {
+		int reps = 1 << i;
+		int sets = 1 << (12 - i);
+		enum target t;
+
+		if (sets < 2)
+			sets = 2;
+
+		for (t = TARGET_FIRST; t <= TARGET_LAST; t++) {
+			pattern_tests(&test, FillStippled, reps, sets, t);
+			pattern_tests(&test, FillOpaqueStippled, reps, sets, t);
+			pattern_tests(&test, FillTiled, reps, sets, t);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Times runs of glyphs through Render. "warm" redraws the same few glyphs
+ * and so measures the cached path, "cold" walks over a glyph set larger
+ * than the driver's glyph cache so that nearly every run has misses to
+ * upload. Run against a server with acceleration disabled to measure the
+ * CPU fallback.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "test.h"
+
+#define NUM_GLYPHS 4096
+#define RUN_LENGTH 64
+
+static const struct format {
+	const char *name;
+	int pict_format;
+	int bpp;
+} formats[] = {
+	{ "a8", PictStandardA8, 1 },
+	{ "a8r8g8b8", PictStandardARGB32, 4 },
+};
+
+static GlyphSet create_glyphs(struct test_display *t, const struct format *f)
+{
+	GlyphSet glyphset;
+	int i;
+
+	glyphset = XRenderCreateGlyphSet(t->dpy,
+					 XRenderFindStandardFormat(t->dpy, f->pict_format));
+
+	for (i = 0; i < NUM_GLYPHS; i++) {
+		Glyph id = i;
+		XGlyphInfo info;
+		int stride, x, y;
+		char *data;
+
+		info.width = 4 + i % 29;
+		info.height = 6 + i % 23;
+		info.x = 0;
+		info.y = info.height;
+		info.xOff = info.width + 1;
+		info.yOff = 0;
+
+		stride = (info.width * f->bpp + 3) & ~3;
+		data = malloc(stride * info.height);
+		for (y = 0; y < info.height; y++)
+			for (x = 0; x < stride; x++)
+				data[y * stride + x] = (x * 7 + y * 13 + i) & 0xff;
+
+		XRenderAddGlyphs(t->dpy, glyphset, &id, &info, 1,
+				 data, stride * info.height);
+		free(data);
+	}
+
+	return glyphset;
+}
+
+static double _bench(struct test_display *t, enum target target_type,
+		     const struct format *f, int cold, int loops)
+{
+	XRenderColor render_color = { 0x8000, 0x8000, 0x8000, 0x8000 };
+	struct test_target target;
+	GlyphSet glyphset;
+	Picture src;
+	unsigned int run[RUN_LENGTH];
+	struct timespec tv;
+	double elapsed;
+	int next = 0;
+
+	test_target_create_render(t, target_type, &target);
+	XRenderFillRectangle(t->dpy, PictOpClear, target.picture, &render_color,
+			     0, 0, target.width, target.height);
+
+	src = XRenderCreateSolidFill(t->dpy, &render_color);
+	glyphset = create_glyphs(t, f);
+
+	test_timer_start(t, &tv);
+	while (loops--) {
+		int i;
+
+		for (i = 0; i < RUN_LENGTH; i++)
+			run[i] = cold ? next++ % NUM_GLYPHS : i;
+
+		XRenderCompositeString32(t->dpy, PictOpOver,
+					 src, target.picture, NULL,
+					 glyphset, 0, 0,
+					 loops % target.width,
+					 32 + loops % (target.height - 32),
+					 run, RUN_LENGTH);
+	}
+	elapsed = test_timer_stop(t, &tv);
+
+	XRenderFreeGlyphSet(t->dpy, glyphset);
+	XRenderFreePicture(t->dpy, src);
+	test_target_destroy_render(t, &target);
+
+	return elapsed;
+}
+
+static void bench(struct test *t, enum target target, int f, int cold)
+{
+	double real, ref;
+
+	ref = _bench(&t->ref, target, &formats[f], cold, 2000);
+	real = _bench(&t->real, target, &formats[f], cold, 2000);
+
+	fprintf (stdout, "Testing %s glyphs (%s, %s): ref=%f, real=%f\n",
+		 formats[f].name, cold ? "cold" : "warm",
+		 test_target_name(target), ref, real);
+}
+
+int main(int argc, char **argv)
+{
+	struct test test;
+	int f;
+
+	test_init(&test, argc, argv);
+
+	for (f = 0; f < sizeof(formats)/sizeof(formats[0]); f++) {
+		bench(&test, PIXMAP, f, 0);
+		bench(&test, PIXMAP, f, 1);
+	}
+
+	return 0;
+}
@@ -77,6 +77,8 @@ Bool intelInitBatchBuffer(void)
 	xvmc_driver->batch.size = BATCH_SIZE;
 	xvmc_driver->batch.space = BATCH_SIZE;
 	xvmc_driver->batch.ptr = xvmc_driver->batch.init_ptr;
+	xvmc_driver->batch.submitted_bytes = 0;
+	xvmc_driver->batch.submitted_batches = 0;
 	return True;
 }
 
@@ -96,6 +98,9 @@ void intelFlushBatch(Bool refill)
 	drm_intel_bo_exec(xvmc_driver->batch.buf,
 			  xvmc_driver->batch.ptr - xvmc_driver->batch.init_ptr,
 			  0, 0, 0);
+	xvmc_driver->batch.submitted_bytes +=
+	    xvmc_driver->batch.ptr - xvmc_driver->batch.init_ptr;
+	xvmc_driver->batch.submitted_batches++;
 
 	drm_intel_bo_unreference(xvmc_driver->batch.buf);
 	if ((xvmc_driver->batch.buf =
@@ -118,6 +118,18 @@ void UNLOCK_HARDWARE(drm_context_t ctx)
 	PPTHREAD_MUTEX_UNLOCK();
 }
 
+/* Drivers may queue rendering across calls; submit it before the surface
+ * is handed to anyone else.
+ */
+static void intel_xvmc_flush_surface(Display * display, XvMCSurface * surface)
+{
+	intel_xvmc_surface_ptr intel_surf = surface->privData;
+
+	if (xvmc_driver && xvmc_driver->flush_surface &&
+	    intel_surf && intel_surf->context)
+		xvmc_driver->flush_surface(display, intel_surf->context);
+}
+
 static int
 dri2_connect(Display *display)
 {
@@ -653,6 +665,7 @@ _X_EXPORT Status XvMCPutSurface(Display * display, XvMCSurface * surface,
 	}
 	intel_surf->last_draw = draw;
 
+	intel_xvmc_flush_surface(display, surface);
 	drm_intel_bo_flink(intel_surf->bo, &intel_surf->gem_handle);
 
 	ret = XvPutImage(display, context->port, draw, intel_surf->gc,
@@ -672,6 +685,8 @@ _X_EXPORT Status XvMCSyncSurface(Display * display, XvMCSurface * surface)
 	if (!display || !surface)
 		return XvMCBadSurface;
 
+	intel_xvmc_flush_surface(display, surface);
+
 	return Success;
 }
 
@@ -690,6 +705,8 @@ _X_EXPORT Status XvMCFlushSurface(Display * display, XvMCSurface * surface)
 	if (!display || !surface)
 		return XvMCBadSurface;
 
+	intel_xvmc_flush_surface(display, surface);
+
 	return Success;
 }
 
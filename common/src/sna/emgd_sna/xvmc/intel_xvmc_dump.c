@@ -156,3 +156,13 @@ void intel_xvmc_dump_render(XvMCContext * context,
 	}
 
 }
+
+void intel_xvmc_dump_batch(unsigned int frame, unsigned long bytes,
+			   unsigned int batches)
+{
+	if (!xvmc_dump)
+		return;
+
+	fprintf(fp, "frame %u: %lu batch bytes in %u submissions\n",
+		frame, bytes, batches);
+}
@@ -136,6 +136,8 @@ typedef struct _intel_xvmc_driver {
 		unsigned char *ptr;
 		unsigned char *init_ptr;
 		dri_bo *buf;
+		unsigned long submitted_bytes;
+		unsigned int submitted_batches;
 	} batch;
 
 	struct {
@@ -186,6 +188,8 @@ typedef struct _intel_xvmc_driver {
 			     unsigned char *slice, int bytes);
 	 Status(*put_slice2) (Display * display, XvMCContext * context,
 			      unsigned char *slice, int bytes, int slice_code);
+	/* optional, submits any rendering still queued for the context */
+	 Status(*flush_surface) (Display * display, XvMCContext * context);
 
 } intel_xvmc_driver_t, *intel_xvmc_driver_ptr;
 
@@ -243,6 +247,8 @@ extern unsigned int mb_bytes_420[64];
 /* dump function */
 extern void intel_xvmc_dump_open(void);
 extern void intel_xvmc_dump_close(void);
+extern void intel_xvmc_dump_batch(unsigned int frame, unsigned long bytes,
+				  unsigned int batches);
 extern void intel_xvmc_dump_render(XvMCContext * context,
 				   unsigned int picture_structure,
 				   XvMCSurface * target_surface,
@@ -308,31 +308,40 @@ struct interface_descriptor_obj {
 };
 
 struct vfe_state_obj {
-	dri_bo *bo;
+	dri_bo *bo[2];		/* indexed by VFE_GENERIC_MODE / VFE_VLD_MODE */
 	struct interface_descriptor_obj interface;
 };
 
 struct vld_state_obj {
 	dri_bo *bo;
+	struct brw_vld_state state;
 };
 
-struct surface_obj {
-	dri_bo *bo;
-};
-
-struct surface_state_obj {
-	struct surface_obj surface;
-	dri_bo *bo;
-};
-
+/* The binding table and the surface states it points to share a single
+ * bo that is rebuilt for each picture. STATE_BASE_ADDRESS points the
+ * surface state base at it, so that neither the binding table nor the
+ * (invariant) interface descriptors need relocations of their own.
+ */
 #define MAX_SURFACES 12
+#define SURFACE_STATE_PADDED_SIZE	32
+#define SURFACE_STATE_OFFSET(index) \
+	(64 + (index) * SURFACE_STATE_PADDED_SIZE)
+#define SURFACE_STATE_BO_SIZE	SURFACE_STATE_OFFSET(MAX_SURFACES)
 struct binding_table_obj {
 	dri_bo *bo;
-	struct surface_state_obj surface_states[MAX_SURFACES];
 };
 
+/* Slices are packed into one buffer and submitted together, with the
+ * media pipeline state emitted once per batch rather than once per slice.
+ */
+#define SLICE_BUFFER_SIZE	(1024 * 1024)
+#define SLICE_ALIGN		64
+#define VLD_STATE_DWORDS	32
+#define VLD_SLICE_DWORDS	6
+#define VLD_BATCH_RESERVE	((VLD_STATE_DWORDS + VLD_SLICE_DWORDS + 2) * 4)
 struct slice_data_obj {
 	dri_bo *bo;
+	unsigned int used;
 };
 
 struct mb_data_obj {
@@ -341,6 +350,8 @@ struct mb_data_obj {
 
 struct cs_state_obj {
 	dri_bo *bo;
+	dri_bo *idct_bo;
+	unsigned char qmatrix[128];
 };
 
 static struct media_state {
@@ -350,8 +361,20 @@ static struct media_state {
 	struct cs_state_obj cs_object;
 	struct slice_data_obj slice_data;
 	struct mb_data_obj mb_data;
+	Bool need_state;	/* VLD state must be emitted before the next slice */
+	int num_slices;		/* slices queued in the current batch */
+	struct {
+		unsigned int frames;
+		unsigned int batches;
+		unsigned long bytes;
+	} stats;
 } media_state;
 
+/* media_state is shared by all the contexts of the process, it is built
+ * by the first to be created and freed with the last to be destroyed.
+ */
+static int media_state_users;
+
 /* XvMCQMatrix * 2 + idct_table + 8 * kernel offset pointer */
 #define CS_OBJECT_SIZE (32*20 + sizeof(unsigned int) * 8)
 static void free_object(struct media_state *s)
@@ -360,35 +383,51 @@ static void free_object(struct media_state *s)
 #define FREE_ONE_BO(bo) \
     if (bo) \
         drm_intel_bo_unreference(bo)
-	FREE_ONE_BO(s->vfe_state.bo);
+	FREE_ONE_BO(s->vfe_state.bo[VFE_GENERIC_MODE]);
+	FREE_ONE_BO(s->vfe_state.bo[VFE_VLD_MODE]);
 	FREE_ONE_BO(s->vfe_state.interface.bo);
 	for (i = 0; i < MEDIA_KERNEL_NUM; i++)
 		FREE_ONE_BO(s->vfe_state.interface.kernels[i].bo);
 	FREE_ONE_BO(s->binding_table.bo);
-	for (i = 0; i < MAX_SURFACES; i++)
-		FREE_ONE_BO(s->binding_table.surface_states[i].bo);
 	FREE_ONE_BO(s->slice_data.bo);
 	FREE_ONE_BO(s->mb_data.bo);
 	FREE_ONE_BO(s->cs_object.bo);
+	FREE_ONE_BO(s->cs_object.idct_bo);
 	FREE_ONE_BO(s->vld_state.bo);
+	memset(s, 0, sizeof(*s));
 }
 
-static int alloc_object(struct media_state *s)
+/* Submit the slices queued so far; called with the hardware lock held */
+static void vld_flush(void)
 {
-	int i;
+	if (media_state.num_slices)
+		intelFlushBatch(TRUE);
 
-	for (i = 0; i < MAX_SURFACES; i++) {
-		s->binding_table.surface_states[i].bo =
-		    drm_intel_bo_alloc(xvmc_driver->bufmgr, "surface_state",
-				       sizeof(struct brw_surface_state),
-				       0x1000);
-		if (!s->binding_table.surface_states[i].bo)
-			goto out;
+	if (media_state.slice_data.bo) {
+		drm_intel_gem_bo_unmap_gtt(media_state.slice_data.bo);
+		drm_intel_bo_unreference(media_state.slice_data.bo);
+		media_state.slice_data.bo = NULL;
 	}
-	return 0;
-out:
-	free_object(s);
-	return BadAlloc;
+
+	media_state.num_slices = 0;
+	media_state.need_state = TRUE;
+}
+
+/* Record the batch bytes and submissions used by the previous picture */
+static void vld_frame_stats(void)
+{
+	unsigned long bytes = xvmc_driver->batch.submitted_bytes +
+	    (xvmc_driver->batch.ptr - xvmc_driver->batch.init_ptr);
+	unsigned int batches = xvmc_driver->batch.submitted_batches;
+
+	if (media_state.stats.frames)
+		intel_xvmc_dump_batch(media_state.stats.frames,
+				      bytes - media_state.stats.bytes,
+				      batches - media_state.stats.batches);
+
+	media_state.stats.frames++;
+	media_state.stats.bytes = bytes;
+	media_state.stats.batches = batches;
 }
 
 static void flush()
@@ -418,20 +457,19 @@ static Status vfe_state(int vfe_mode)
 	vfe_state->vfe2.interface_descriptor_base =
 	    media_state.vfe_state.interface.bo->offset >> 4;
 
-	if (media_state.vfe_state.bo)
-		drm_intel_bo_unreference(media_state.vfe_state.bo);
+	if (media_state.vfe_state.bo[vfe_mode])
+		drm_intel_bo_unreference(media_state.vfe_state.bo[vfe_mode]);
 
-	media_state.vfe_state.bo = drm_intel_bo_alloc(xvmc_driver->bufmgr,
-						      "vfe state",
-						      sizeof(struct
-							     brw_vfe_state),
-						      0x1000);
-	if (!media_state.vfe_state.bo)
+	media_state.vfe_state.bo[vfe_mode] =
+	    drm_intel_bo_alloc(xvmc_driver->bufmgr, "vfe state",
+			       sizeof(struct brw_vfe_state), 0x1000);
+	if (!media_state.vfe_state.bo[vfe_mode])
 		return BadAlloc;
 
-	drm_intel_bo_subdata(media_state.vfe_state.bo, 0, sizeof(tmp), &tmp);
+	drm_intel_bo_subdata(media_state.vfe_state.bo[vfe_mode], 0,
+			     sizeof(tmp), &tmp);
 
-	drm_intel_bo_emit_reloc(media_state.vfe_state.bo,
+	drm_intel_bo_emit_reloc(media_state.vfe_state.bo[vfe_mode],
 				offsetof(struct brw_vfe_state, vfe2),
 				media_state.vfe_state.interface.bo, 0,
 				I915_GEM_DOMAIN_INSTRUCTION, 0);
@@ -462,9 +500,9 @@ static Status interface_descriptor()
 		desc->desc1.const_urb_entry_read_offset = 0;
 		desc->desc1.const_urb_entry_read_len = 30;
 
+		/* relative to the surface state base, see setup_surface() */
 		desc->desc3.binding_table_entry_count = MAX_SURFACES - 1;
-		desc->desc3.binding_table_pointer =
-		    media_state.binding_table.bo->offset >> 5;
+		desc->desc3.binding_table_pointer = 0;
 
 		drm_intel_bo_subdata(media_state.vfe_state.interface.bo,
 				     i * sizeof(tmp), sizeof(tmp), desc);
@@ -477,14 +515,6 @@ static Status interface_descriptor()
 					interface.kernels[i].bo,
 					desc->desc0.grf_reg_blocks,
 					I915_GEM_DOMAIN_INSTRUCTION, 0);
-
-		drm_intel_bo_emit_reloc(media_state.vfe_state.interface.bo,
-					i * sizeof(*desc) + offsetof(struct
-								     brw_interface_descriptor,
-								     desc3),
-					media_state.binding_table.bo,
-					desc->desc3.binding_table_entry_count,
-					I915_GEM_DOMAIN_INSTRUCTION, 0);
 	}
 	return Success;
 }
@@ -527,47 +557,18 @@ out:
 	return BadAlloc;
 }
 
-static Status binding_tables()
-{
-	unsigned int table[MAX_SURFACES];
-	int i;
-
-	if (media_state.binding_table.bo)
-		drm_intel_bo_unreference(media_state.binding_table.bo);
-	media_state.binding_table.bo =
-	    drm_intel_bo_alloc(xvmc_driver->bufmgr, "binding_table",
-			       MAX_SURFACES * 4, 0x1000);
-	if (!media_state.binding_table.bo)
-		return BadAlloc;
-
-	for (i = 0; i < MAX_SURFACES; i++) {
-		table[i] =
-		    media_state.binding_table.surface_states[i].bo->offset;
-		drm_intel_bo_emit_reloc(media_state.binding_table.bo,
-					i * sizeof(unsigned int),
-					media_state.
-					binding_table.surface_states[i].bo, 0,
-					I915_GEM_DOMAIN_INSTRUCTION, 0);
-	}
-
-	drm_intel_bo_subdata(media_state.binding_table.bo, 0, sizeof(table),
-			     table);
-	return Success;
-}
-
-static Status cs_init(int interface_offset)
+static Status cs_init(dri_bo ** bo, int interface_offset)
 {
 	char buf[CS_OBJECT_SIZE];
 	unsigned int *lib_reloc;
 	int i;
 
-	if (media_state.cs_object.bo)
-		drm_intel_bo_unreference(media_state.cs_object.bo);
+	if (*bo)
+		drm_intel_bo_unreference(*bo);
 
-	media_state.cs_object.bo =
-	    drm_intel_bo_alloc(xvmc_driver->bufmgr, "cs object", CS_OBJECT_SIZE,
-			       64);
-	if (!media_state.cs_object.bo)
+	*bo = drm_intel_bo_alloc(xvmc_driver->bufmgr, "cs object",
+				 CS_OBJECT_SIZE, 64);
+	if (!*bo)
 		return BadAlloc;
 
 	memcpy(buf + 32 * 4, idct_table, sizeof(idct_table));
@@ -578,11 +579,11 @@ static Status cs_init(int interface_offset)
 		    media_state.vfe_state.interface.kernels[LIB_INTERFACE +
 							    interface_offset].bo->
 		    offset;
-	drm_intel_bo_subdata(media_state.cs_object.bo, 32 * 4,
+	drm_intel_bo_subdata(*bo, 32 * 4,
 			     32 * 16 + 8 * sizeof(unsigned int), buf + 32 * 4);
 
 	for (i = 0; i < 8; i++)
-		drm_intel_bo_emit_reloc(media_state.cs_object.bo,
+		drm_intel_bo_emit_reloc(*bo,
 					32 * 20 + sizeof(unsigned int) * i,
 					media_state.vfe_state.
 					interface.kernels[LIB_INTERFACE +
@@ -592,6 +593,25 @@ static Status cs_init(int interface_offset)
 	return Success;
 }
 
+/* The interface descriptors, VFE states and the IDCT constant buffer only
+ * depend upon the kernels, so build them once with the kernels.
+ */
+static Status setup_invariant_state(void)
+{
+	Status ret;
+
+	ret = interface_descriptor();
+	if (ret != Success)
+		return ret;
+	ret = vfe_state(VFE_VLD_MODE);
+	if (ret != Success)
+		return ret;
+	ret = vfe_state(VFE_GENERIC_MODE);
+	if (ret != Success)
+		return ret;
+	return cs_init(&media_state.cs_object.idct_bo, INTERFACE_NUM);
+}
+
 #define STRIDE(w)               (w)
 #define SIZE_YUV420(w, h)       (h * (STRIDE(w) + STRIDE(w >> 1)))
 static Status create_context(Display * display, XvMCContext * context,
@@ -609,11 +629,16 @@ static Status create_context(Display * display, XvMCContext * context,
 	intel_ctx->surface_bo_size
 		= SIZE_YUV420(context->width, context->height);
 
-	if (alloc_object(&media_state))
-		return BadAlloc;
+	if (media_state_users == 0) {
+		if (setup_media_kernels(hw_ctx))
+			return BadAlloc;
 
-	if (setup_media_kernels(hw_ctx))
-		return BadAlloc;
+		if (setup_invariant_state() != Success) {
+			free_object(&media_state);
+			return BadAlloc;
+		}
+	}
+	media_state_users++;
 	return Success;
 }
 
@@ -621,6 +646,14 @@ static Status destroy_context(Display * display, XvMCContext * context)
 {
 	struct intel_xvmc_context *intel_ctx;
 	intel_ctx = context->privData;
+
+	LOCK_HARDWARE(intel_ctx->hw_context);
+	vld_flush();
+	vld_frame_stats();
+	UNLOCK_HARDWARE(intel_ctx->hw_context);
+	if (--media_state_users == 0)
+		free_object(&media_state);
+
 	free(intel_ctx->hw);
 	free(intel_ctx);
 	return Success;
@@ -629,15 +662,23 @@ static Status destroy_context(Display * display, XvMCContext * context)
 static Status load_qmatrix(Display * display, XvMCContext * context,
 			   const XvMCQMatrix * qmx)
 {
+	unsigned char *qmatrix = media_state.cs_object.qmatrix;
 	Status ret;
-	ret = cs_init(0);
+
+	/* Streams reload the same matrices with every picture */
+	if (media_state.cs_object.bo &&
+	    memcmp(qmatrix, qmx->intra_quantiser_matrix, 64) == 0 &&
+	    memcmp(qmatrix + 64, qmx->non_intra_quantiser_matrix, 64) == 0)
+		return Success;
+
+	ret = cs_init(&media_state.cs_object.bo, 0);
 	if (ret != Success)
 		return ret;
-	drm_intel_bo_subdata(media_state.cs_object.bo, 0, 64,
-			     qmx->intra_quantiser_matrix);
-	drm_intel_bo_subdata(media_state.cs_object.bo, 64, 64,
-			     qmx->non_intra_quantiser_matrix);
+	memcpy(qmatrix, qmx->intra_quantiser_matrix, 64);
+	memcpy(qmatrix + 64, qmx->non_intra_quantiser_matrix, 64);
+	drm_intel_bo_subdata(media_state.cs_object.bo, 0, 128, qmatrix);
 
+	media_state.need_state = TRUE;
 	return Success;
 }
 
@@ -645,16 +686,6 @@ static Status vld_state(const XvMCMpegControl * control)
 {
 	struct brw_vld_state tmp, *vld = &tmp;
 
-	if (media_state.vld_state.bo)
-		drm_intel_bo_unreference(media_state.vld_state.bo);
-	media_state.vld_state.bo = drm_intel_bo_alloc(xvmc_driver->bufmgr,
-						      "vld state",
-						      sizeof(struct
-							     brw_vld_state),
-						      64);
-	if (!media_state.vld_state.bo)
-		return BadAlloc;
-
 	memset(vld, 0, sizeof(*vld));
 	vld->vld0.f_code_0_0 = control->FHMV_range + 1;
 	vld->vld0.f_code_0_1 = control->FVMV_range + 1;
@@ -691,16 +722,34 @@ static Status vld_state(const XvMCMpegControl * control)
 	vld->desc_remap_table1.index_14 = FRAME_FRAME_PRED_BIDIRECT;
 	vld->desc_remap_table1.index_15 = FRAME_FIELD_PRED_BIDIRECT;
 
+	/* Only pictures of a different type need a new state */
+	if (media_state.vld_state.bo &&
+	    memcmp(&media_state.vld_state.state, vld, sizeof(*vld)) == 0)
+		return Success;
+
+	if (media_state.vld_state.bo)
+		drm_intel_bo_unreference(media_state.vld_state.bo);
+	media_state.vld_state.bo = drm_intel_bo_alloc(xvmc_driver->bufmgr,
+						      "vld state",
+						      sizeof(struct
+							     brw_vld_state),
+						      64);
+	if (!media_state.vld_state.bo)
+		return BadAlloc;
+
 	drm_intel_bo_subdata(media_state.vld_state.bo, 0, sizeof(tmp), vld);
+	media_state.vld_state.state = tmp;
 	return Success;
 }
 
-static Status setup_media_surface(int index, dri_bo * bo,
-				  unsigned long offset, int w, int h,
-				  Bool write)
+static void setup_media_surface(uint32_t * state, int index, dri_bo * bo,
+				unsigned long offset, int w, int h,
+				Bool write)
 {
-	struct brw_surface_state tmp, *ss = &tmp;
-	memset(ss, 0, sizeof(*ss));
+	struct brw_surface_state *ss =
+	    (struct brw_surface_state *)((char *)state +
+					 SURFACE_STATE_OFFSET(index));
+
 	ss->ss0.surface_type = BRW_SURFACE_2D;
 	ss->ss0.surface_format = BRW_SURFACEFORMAT_R8_SINT;
 	ss->ss1.base_addr = offset + bo->offset;
@@ -708,73 +757,59 @@ static Status setup_media_surface(int index, dri_bo * bo,
 	ss->ss2.height = h - 1;
 	ss->ss3.pitch = w - 1;
 
-	if (media_state.binding_table.surface_states[index].bo)
-		drm_intel_bo_unreference(media_state.
-					 binding_table.surface_states[index].
-					 bo);
-
-	media_state.binding_table.surface_states[index].bo =
-	    drm_intel_bo_alloc(xvmc_driver->bufmgr, "surface_state",
-			       sizeof(struct brw_surface_state), 0x1000);
-	if (!media_state.binding_table.surface_states[index].bo)
-		return BadAlloc;
-
-	drm_intel_bo_subdata(media_state.binding_table.surface_states[index].bo,
-			     0, sizeof(*ss), ss);
-	drm_intel_bo_emit_reloc(media_state.binding_table.
-				surface_states[index].bo,
+	drm_intel_bo_emit_reloc(media_state.binding_table.bo,
+				SURFACE_STATE_OFFSET(index) +
 				offsetof(struct brw_surface_state, ss1), bo,
 				offset, I915_GEM_DOMAIN_RENDER,
 				write ? I915_GEM_DOMAIN_RENDER : 0);
-	return Success;
 }
 
 static Status setup_surface(struct intel_xvmc_surface *target,
 			    struct intel_xvmc_surface *past,
 			    struct intel_xvmc_surface *future, int w, int h)
 {
-	Status ret;
-	ret = setup_media_surface(0, target->bo, 0, w, h, TRUE);
-	if (ret != Success)
-		return ret;
-	ret = setup_media_surface(1, target->bo, w * h, w / 2, h / 2, TRUE);
-	if (ret != Success)
-		return ret;
-	ret =
-	    setup_media_surface(2, target->bo, w * h + w * h / 4, w / 2, h / 2,
-				TRUE);
-	if (ret != Success)
-		return ret;
+	uint32_t state[SURFACE_STATE_BO_SIZE / sizeof(uint32_t)];
+	int i;
+
+	assert(MAX_SURFACES * sizeof(uint32_t) <= SURFACE_STATE_OFFSET(0));
+	assert(sizeof(struct brw_surface_state) <= SURFACE_STATE_PADDED_SIZE);
+
+	if (media_state.binding_table.bo)
+		drm_intel_bo_unreference(media_state.binding_table.bo);
+	media_state.binding_table.bo =
+	    drm_intel_bo_alloc(xvmc_driver->bufmgr, "surface state",
+			       SURFACE_STATE_BO_SIZE, 0x1000);
+	if (!media_state.binding_table.bo)
+		return BadAlloc;
+
+	memset(state, 0, sizeof(state));
+	for (i = 0; i < MAX_SURFACES; i++)
+		state[i] = SURFACE_STATE_OFFSET(i);
+
+	setup_media_surface(state, 0, target->bo, 0, w, h, TRUE);
+	setup_media_surface(state, 1, target->bo, w * h, w / 2, h / 2, TRUE);
+	setup_media_surface(state, 2, target->bo, w * h + w * h / 4,
+			    w / 2, h / 2, TRUE);
 	if (past) {
-		ret = setup_media_surface(4, past->bo, 0, w, h, FALSE);
-		if (ret != Success)
-			return ret;
-		ret =
-		    setup_media_surface(5, past->bo, w * h, w / 2, h / 2,
-					FALSE);
-		if (ret != Success)
-			return ret;
-		ret =
-		    setup_media_surface(6, past->bo, w * h + w * h / 4, w / 2,
-					h / 2, FALSE);
-		if (ret != Success)
-			return ret;
+		setup_media_surface(state, 4, past->bo, 0, w, h, FALSE);
+		setup_media_surface(state, 5, past->bo, w * h,
+				    w / 2, h / 2, FALSE);
+		setup_media_surface(state, 6, past->bo, w * h + w * h / 4,
+				    w / 2, h / 2, FALSE);
 	}
 	if (future) {
-		ret = setup_media_surface(7, future->bo, 0, w, h, FALSE);
-		if (ret != Success)
-			return ret;
-		ret =
-		    setup_media_surface(8, future->bo, w * h, w / 2, h / 2,
-					FALSE);
-		if (ret != Success)
-			return ret;
-		ret =
-		    setup_media_surface(9, future->bo, w * h + w * h / 4, w / 2,
-					h / 2, FALSE);
-		if (ret != Success)
-			return ret;
+		setup_media_surface(state, 7, future->bo, 0, w, h, FALSE);
+		setup_media_surface(state, 8, future->bo, w * h,
+				    w / 2, h / 2, FALSE);
+		setup_media_surface(state, 9, future->bo, w * h + w * h / 4,
+				    w / 2, h / 2, FALSE);
 	}
+
+	drm_intel_bo_subdata(media_state.binding_table.bo, 0,
+			     sizeof(state), state);
+
+	/* the surface state base moves with every picture */
+	media_state.need_state = TRUE;
 	return Success;
 }
 
@@ -792,6 +827,10 @@ static Status begin_surface(Display * display, XvMCContext * context,
 	priv_past = past ? past->privData : NULL;
 	priv_future = future ? future->privData : NULL;
 
+	LOCK_HARDWARE(intel_ctx->hw_context);
+	vld_frame_stats();
+	UNLOCK_HARDWARE(intel_ctx->hw_context);
+
 	ret = vld_state(control);
 	if (ret != Success)
 		return ret;
@@ -799,19 +838,7 @@ static Status begin_surface(Display * display, XvMCContext * context,
 			    context->width, context->height);
 	if (ret != Success)
 		return ret;
-	ret = binding_tables();
-	if (ret != Success)
-		return ret;
-	ret = interface_descriptor();
-	if (ret != Success)
-		return ret;
-	ret = vfe_state(VFE_VLD_MODE);
-	if (ret != Success)
-		return ret;
 
-	LOCK_HARDWARE(intel_ctx->hw_context);
-	flush();
-	UNLOCK_HARDWARE(intel_ctx->hw_context);
 	return Success;
 }
 
@@ -829,7 +856,8 @@ static void state_base_address(struct intel_xvmc_hw_context *ctx)
 		BEGIN_BATCH(8);
 		OUT_BATCH(BRW_STATE_BASE_ADDRESS | 6);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
-		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
+		OUT_RELOC(media_state.binding_table.bo,
+			  I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
@@ -840,7 +868,8 @@ static void state_base_address(struct intel_xvmc_hw_context *ctx)
 		BEGIN_BATCH(6);
 		OUT_BATCH(BRW_STATE_BASE_ADDRESS | 4);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
-		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
+		OUT_RELOC(media_state.binding_table.bo,
+			  I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
 		OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
@@ -866,7 +895,8 @@ static void media_state_pointers(int vfe_mode)
 			  0, 1);
 	else
 		OUT_BATCH(0);
-	OUT_RELOC(media_state.vfe_state.bo, I915_GEM_DOMAIN_INSTRUCTION, 0, 0);
+	OUT_RELOC(media_state.vfe_state.bo[vfe_mode],
+		  I915_GEM_DOMAIN_INSTRUCTION, 0, 0);
 	ADVANCE_BATCH();
 }
 
@@ -914,13 +944,12 @@ static void cs_urb_layout()
 	ADVANCE_BATCH();
 }
 
-static void cs_buffer()
+static void cs_buffer(dri_bo * bo)
 {
 	BATCH_LOCALS;
 	BEGIN_BATCH(2);
 	OUT_BATCH(BRW_CONSTANT_BUFFER | 0 | (1 << 8));
-	OUT_RELOC(media_state.cs_object.bo, I915_GEM_DOMAIN_INSTRUCTION, 0,
-		  CS_SIZE);
+	OUT_RELOC(bo, I915_GEM_DOMAIN_INSTRUCTION, 0, CS_SIZE);
 	ADVANCE_BATCH();
 }
 
@@ -955,24 +984,56 @@ static void send_media_object(XvMCMacroBlock * mb, dri_bo * bo,
 	ADVANCE_BATCH();
 }
 
+/* MEDIA_OBJECT for a single slice; only the slice length, its offset
+ * within the slice buffer and the macroblock position vary.
+ */
+static const uint32_t vld_media_object_template[VLD_SLICE_DWORDS] = {
+	BRW_MEDIA_OBJECT | (VLD_SLICE_DWORDS - 2),
+	0,			/* interface descriptor offset */
+	0,			/* indirect data length */
+	0,			/* indirect data address */
+	0,			/* mb position, count and bit offset */
+	0,			/* quantiser scale code */
+};
+
 /* kick media object to gpu in vld mode*/
-static void vld_send_media_object(dri_bo * bo,
+static void vld_send_media_object(dri_bo * bo, uint32_t offset,
 				  int slice_len, int mb_h_pos, int mb_v_pos,
 				  int mb_bit_offset, int mb_count,
 				  int q_scale_code)
 {
+	uint32_t *cmd;
 	BATCH_LOCALS;
-	BEGIN_BATCH(6);
-	OUT_BATCH(BRW_MEDIA_OBJECT | 4);
-	OUT_BATCH(0);
-	OUT_BATCH(slice_len);
-	OUT_RELOC(bo, I915_GEM_DOMAIN_INSTRUCTION, 0, 0);
-	OUT_BATCH((mb_h_pos << 24) | (mb_v_pos << 16) | (mb_count << 8) |
-		  (mb_bit_offset));
-	OUT_BATCH(q_scale_code << 24);
+
+	BEGIN_BATCH(VLD_SLICE_DWORDS);
+	cmd = (uint32_t *) batch_ptr;
+	memcpy(cmd, vld_media_object_template,
+	       sizeof(vld_media_object_template));
+	cmd[2] = slice_len;
+	cmd[3] = bo->offset + offset;
+	intel_batch_emit_reloc(bo, I915_GEM_DOMAIN_INSTRUCTION, 0, offset,
+			       (unsigned char *)&cmd[3]);
+	cmd[4] = (mb_h_pos << 24) | (mb_v_pos << 16) | (mb_count << 8) |
+	    (mb_bit_offset);
+	cmd[5] = q_scale_code << 24;
+	batch_ptr += sizeof(vld_media_object_template);
 	ADVANCE_BATCH();
 }
 
+/* Media pipeline setup shared by all slices in a batch */
+static void vld_emit_state(struct intel_xvmc_hw_context *ctx)
+{
+	flush();
+	state_base_address(ctx);
+	pipeline_select();
+	media_state_pointers(VFE_VLD_MODE);
+	urb_layout();
+	cs_urb_layout();
+	cs_buffer(media_state.cs_object.bo);
+
+	media_state.need_state = FALSE;
+}
+
 static Status put_slice2(Display * display, XvMCContext * context,
 			 unsigned char *slice, int nbytes, int sliceCode)
 {
@@ -980,6 +1041,10 @@ static Status put_slice2(Display * display, XvMCContext * context,
 	intel_xvmc_context_ptr intel_ctx = context->privData;
 	struct intel_xvmc_hw_context *hw_ctx = intel_ctx->hw;
 	int q_scale_code, mb_row;
+	uint32_t offset;
+
+	if (nbytes > SLICE_BUFFER_SIZE)
+		return BadValue;
 
 	mb_row = *(slice - 1) - 1;
 	bit_buf =
@@ -987,30 +1052,45 @@ static Status put_slice2(Display * display, XvMCContext * context,
 
 	q_scale_code = bit_buf >> 27;
 
-	if (media_state.slice_data.bo) {
-		drm_intel_gem_bo_unmap_gtt(media_state.slice_data.bo);
-
-		drm_intel_bo_unreference(media_state.slice_data.bo);
+	LOCK_HARDWARE(intel_ctx->hw_context);
+	if (xvmc_driver->batch.space < VLD_BATCH_RESERVE ||
+	    (media_state.slice_data.bo &&
+	     media_state.slice_data.used + nbytes > SLICE_BUFFER_SIZE))
+		vld_flush();
+
+	if (!media_state.slice_data.bo) {
+		media_state.slice_data.bo =
+		    drm_intel_bo_alloc(xvmc_driver->bufmgr, "slice data",
+				       SLICE_BUFFER_SIZE, 64);
+		if (!media_state.slice_data.bo) {
+			UNLOCK_HARDWARE(intel_ctx->hw_context);
+			return BadAlloc;
+		}
+		drm_intel_gem_bo_map_gtt(media_state.slice_data.bo);
+		media_state.slice_data.used = 0;
 	}
-	media_state.slice_data.bo = drm_intel_bo_alloc(xvmc_driver->bufmgr,
-						       "slice data",
-						       VLD_MAX_SLICE_SIZE, 64);
-	if (!media_state.slice_data.bo)
-		return BadAlloc;
-	drm_intel_gem_bo_map_gtt(media_state.slice_data.bo);
 
-	memcpy(media_state.slice_data.bo->virtual, slice, nbytes);
+	offset = media_state.slice_data.used;
+	memcpy((char *)media_state.slice_data.bo->virtual + offset,
+	       slice, nbytes);
+	media_state.slice_data.used = ALIGN(offset + nbytes, SLICE_ALIGN);
 
-	LOCK_HARDWARE(intel_ctx->hw_context);
-	state_base_address(hw_ctx);
-	pipeline_select();
-	media_state_pointers(VFE_VLD_MODE);
-	urb_layout();
-	cs_urb_layout();
-	cs_buffer();
-	vld_send_media_object(media_state.slice_data.bo,
+	if (media_state.need_state)
+		vld_emit_state(hw_ctx);
+	vld_send_media_object(media_state.slice_data.bo, offset,
 			      nbytes, 0, mb_row, 6, 127, q_scale_code);
-	intelFlushBatch(TRUE);
+	media_state.num_slices++;
+	UNLOCK_HARDWARE(intel_ctx->hw_context);
+
+	return Success;
+}
+
+static Status flush_surface(Display * display, XvMCContext * context)
+{
+	intel_xvmc_context_ptr intel_ctx = context->privData;
+
+	LOCK_HARDWARE(intel_ctx->hw_context);
+	vld_flush();
 	UNLOCK_HARDWARE(intel_ctx->hw_context);
 
 	return Success;
@@ -1044,22 +1124,15 @@ static Status render_surface(Display * display,
 	priv_past = past_surface ? past_surface->privData : NULL;
 	priv_future = future_surface ? future_surface->privData : NULL;
 
+	/* VLD slices still queued refer to the previous surface state */
+	LOCK_HARDWARE(intel_ctx->hw_context);
+	vld_flush();
+	UNLOCK_HARDWARE(intel_ctx->hw_context);
+
 	ret = setup_surface(priv_target, priv_past, priv_future,
 			    context->width, context->height);
 	if (ret != Success)
 		return ret;
-	ret = binding_tables();
-	if (ret != Success)
-		return ret;
-	ret = interface_descriptor();
-	if (ret != Success)
-		return ret;
-	ret = cs_init(INTERFACE_NUM);
-	if (ret != Success)
-		return ret;
-	ret = vfe_state(VFE_GENERIC_MODE);
-	if (ret != Success)
-		return ret;
 
 	if (media_state.mb_data.bo) {
 		drm_intel_gem_bo_unmap_gtt(media_state.mb_data.bo);
@@ -1128,7 +1201,7 @@ static Status render_surface(Display * display,
 	urb_layout();
 	media_state_pointers(VFE_GENERIC_MODE);
 	cs_urb_layout();
-	cs_buffer();
+	cs_buffer(media_state.cs_object.idct_bo);
 	for (i = first_macroblock;
 	     i < num_macroblocks + first_macroblock;
 	     i++, block_offset += 128 * 6) {
@@ -1220,5 +1293,6 @@ struct _intel_xvmc_driver xvmc_vld_driver = {
 	.begin_surface = begin_surface,
 	.render_surface = render_surface,
 	.put_slice = put_slice,
-	.put_slice2 = put_slice2
+	.put_slice2 = put_slice2,
+	.flush_surface = flush_surface
 };
@@ -0,0 +1,505 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Decodes MPEG-2 pictures through the VLD driver in xvmc_vld.c against a
+ * mock buffer manager, and reports what would reach the kernel for each
+ * frame: execbuffers, batch bytes, bytes uploaded with subdata, buffers
+ * allocated and relocations.
+ *
+ * Each picture is driven the way intel_xvmc.c does it: load_qmatrix and
+ * begin_surface, one put_slice2 per macroblock row, then flush_surface.
+ * Pictures follow an IBBP pattern over three surfaces.
+ *
+ * Every batch is checked as it is executed. It must be terminated, and
+ * every relocation must hold the presumed address of a live buffer. Each
+ * MEDIA_OBJECT that reads slice data must point at a copy of the next
+ * slice that was put, with its length and row. By the end every slice
+ * must have been submitted, and only the surfaces may still be allocated.
+ */
+
+#include "intel_xvmc_private.h"
+#include "i965_reg.h"
+
+#define FRAMES 60
+#define MAX_RELOCS 4096
+#define MAX_SLICES 1024
+#define MAX_SLICE_SIZE 8192
+#define MI_BATCH_BUFFER_END (0xA << 23)
+#define ALIGN(m,n) (((m) + (n) - 1) & ~((n) - 1))
+
+struct _intel_xvmc_driver *xvmc_driver;
+
+struct _drm_intel_bufmgr {
+	unsigned long next_offset;
+};
+
+struct mock_reloc {
+	uint32_t offset;
+	struct mock_bo *target;
+	uint32_t delta;
+};
+
+struct mock_bo {
+	drm_intel_bo base;
+	const char *name;
+	int refcount;
+	int mapped;
+	struct mock_reloc *relocs;
+	int num_relocs;
+};
+
+static drm_intel_bufmgr bufmgr;
+
+static struct counters {
+	unsigned long execs;
+	unsigned long batch_bytes;
+	unsigned long subdata_bytes;
+	unsigned long allocs;
+	unsigned long relocs;
+	unsigned long slice_bytes;
+} count;
+
+static int live_bos;
+static int failures;
+
+static void fail(const char *what)
+{
+	if (failures++ < 10)
+		printf("%s\n", what);
+}
+
+/* The slices put but not yet seen in an executed batch, in order */
+static struct slice {
+	unsigned char data[MAX_SLICE_SIZE];
+	int len;
+	int row;
+} slices[MAX_SLICES];
+static int slice_head, slice_tail;
+
+/* What the driver itself records for each frame */
+static unsigned long dumped_bytes;
+static unsigned int dumped_batches;
+
+drm_intel_bo *drm_intel_bo_alloc(drm_intel_bufmgr *mgr, const char *name,
+				 unsigned long size, unsigned int alignment)
+{
+	struct mock_bo *bo;
+
+	bo = calloc(1, sizeof(*bo));
+	if (bo == NULL)
+		return NULL;
+
+	bo->base.virtual = calloc(1, size);
+	if (bo->base.virtual == NULL) {
+		free(bo);
+		return NULL;
+	}
+
+	if (alignment < 4096)
+		alignment = 4096;
+	mgr->next_offset = ALIGN(mgr->next_offset, alignment);
+
+	bo->base.size = size;
+	bo->base.align = alignment;
+	bo->base.offset = mgr->next_offset;
+	bo->base.bufmgr = mgr;
+	bo->name = name;
+	bo->refcount = 1;
+	mgr->next_offset += ALIGN(size, 4096);
+
+	live_bos++;
+	count.allocs++;
+	return &bo->base;
+}
+
+static void mock_bo_reference(struct mock_bo *bo)
+{
+	bo->refcount++;
+}
+
+void drm_intel_bo_unreference(drm_intel_bo *base)
+{
+	struct mock_bo *bo = (struct mock_bo *)base;
+	int i;
+
+	if (bo == NULL)
+		return;
+
+	if (bo->refcount <= 0) {
+		fail("unreference of a freed bo");
+		return;
+	}
+
+	if (--bo->refcount)
+		return;
+
+	for (i = 0; i < bo->num_relocs; i++)
+		drm_intel_bo_unreference(&bo->relocs[i].target->base);
+	free(bo->relocs);
+	free(bo->base.virtual);
+	free(bo);
+	live_bos--;
+}
+
+int drm_intel_bo_subdata(drm_intel_bo *bo, unsigned long offset,
+			 unsigned long size, const void *data)
+{
+	if (offset + size > bo->size) {
+		fail("subdata past the end of the bo");
+		return -EINVAL;
+	}
+
+	memcpy((char *)bo->virtual + offset, data, size);
+	count.subdata_bytes += size;
+	return 0;
+}
+
+int drm_intel_bo_emit_reloc(drm_intel_bo *base, uint32_t offset,
+			    drm_intel_bo *target_bo, uint32_t target_offset,
+			    uint32_t read_domains, uint32_t write_domain)
+{
+	struct mock_bo *bo = (struct mock_bo *)base;
+	struct mock_bo *target = (struct mock_bo *)target_bo;
+
+	if (offset + 4 > base->size || offset & 3) {
+		fail("relocation outside the bo");
+		return -EINVAL;
+	}
+
+	if (target->refcount <= 0) {
+		fail("relocation to a freed bo");
+		return -EINVAL;
+	}
+
+	if (bo->num_relocs == MAX_RELOCS) {
+		fail("too many relocations");
+		return -ENOSPC;
+	}
+
+	if (bo->relocs == NULL) {
+		bo->relocs = malloc(MAX_RELOCS * sizeof(*bo->relocs));
+		if (bo->relocs == NULL)
+			return -ENOMEM;
+	}
+
+	mock_bo_reference(target);
+	bo->relocs[bo->num_relocs].offset = offset;
+	bo->relocs[bo->num_relocs].target = target;
+	bo->relocs[bo->num_relocs].delta = target_offset;
+	bo->num_relocs++;
+
+	count.relocs++;
+	return 0;
+}
+
+int drm_intel_gem_bo_map_gtt(drm_intel_bo *base)
+{
+	((struct mock_bo *)base)->mapped++;
+	return 0;
+}
+
+int drm_intel_gem_bo_unmap_gtt(drm_intel_bo *base)
+{
+	struct mock_bo *bo = (struct mock_bo *)base;
+
+	if (bo->mapped == 0)
+		fail("unmap of an unmapped bo");
+	else
+		bo->mapped--;
+	return 0;
+}
+
+/* A MEDIA_OBJECT reading slice data, see vld_send_media_object() */
+static void check_slice(const uint32_t *cmd, const struct mock_reloc *r)
+{
+	struct slice *s;
+
+	if (cmd[0] != (BRW_MEDIA_OBJECT | 4)) {
+		fail("slice data used outside a MEDIA_OBJECT");
+		return;
+	}
+
+	if (slice_head == slice_tail) {
+		fail("MEDIA_OBJECT for a slice that was never put");
+		return;
+	}
+
+	s = &slices[slice_head++ % MAX_SLICES];
+	if (cmd[2] != s->len ||
+	    ((cmd[4] >> 16) & 0xff) != s->row ||
+	    r->delta + s->len > r->target->base.size ||
+	    memcmp((char *)r->target->base.virtual + r->delta,
+		   s->data, s->len))
+		fail("MEDIA_OBJECT does not match the slice put");
+}
+
+int drm_intel_bo_exec(drm_intel_bo *base, int used,
+		      struct drm_clip_rect *cliprects, int num_cliprects,
+		      int DR4)
+{
+	struct mock_bo *bo = (struct mock_bo *)base;
+	const uint32_t *batch = base->virtual;
+	int i;
+
+	if (used <= 0 || used > base->size || used & 7) {
+		fail("batch of a bad length");
+		return -EINVAL;
+	}
+
+	if (batch[used / 4 - 1] != MI_BATCH_BUFFER_END)
+		fail("batch not terminated");
+
+	for (i = 0; i < bo->num_relocs; i++) {
+		const struct mock_reloc *r = &bo->relocs[i];
+
+		if (r->offset >= used) {
+			fail("relocation past the end of the batch");
+			continue;
+		}
+
+		if (batch[r->offset / 4] != r->target->base.offset + r->delta)
+			fail("relocation does not hold the presumed address");
+
+		if (strcmp(r->target->name, "slice data") == 0) {
+			if (r->offset < 12)
+				fail("slice data used outside a MEDIA_OBJECT");
+			else
+				check_slice(batch + r->offset / 4 - 3, r);
+		}
+	}
+
+	count.execs++;
+	count.batch_bytes += used;
+	return 0;
+}
+
+void LOCK_HARDWARE(drm_context_t ctx)
+{
+	if (xvmc_driver->locked)
+		fail("hardware lock taken twice");
+	xvmc_driver->locked = 1;
+}
+
+void UNLOCK_HARDWARE(drm_context_t ctx)
+{
+	if (!xvmc_driver->locked)
+		fail("hardware lock released while free");
+	xvmc_driver->locked = 0;
+}
+
+void intel_xvmc_dump_batch(unsigned int frame, unsigned long bytes,
+			   unsigned int batches)
+{
+	dumped_bytes += bytes;
+	dumped_batches += batches;
+}
+
+static void put_slice(XvMCContext *context, int row, int len)
+{
+	unsigned char buf[4 + MAX_SLICE_SIZE];
+	struct slice *s;
+	int i;
+
+	if (slice_tail - slice_head == MAX_SLICES) {
+		fail("too many slices outstanding");
+		return;
+	}
+
+	/* slice start code, the driver reads the row before the slice */
+	buf[0] = 0;
+	buf[1] = 0;
+	buf[2] = 1;
+	buf[3] = row + 1;
+	for (i = 0; i < len; i++)
+		buf[4 + i] = rand();
+
+	s = &slices[slice_tail++ % MAX_SLICES];
+	memcpy(s->data, buf + 4, len);
+	s->len = len;
+	s->row = row;
+
+	if (xvmc_driver->put_slice2(NULL, context, buf + 4, len, row + 1))
+		fail("put_slice2 failed");
+	count.slice_bytes += len;
+}
+
+struct result {
+	struct counters total, max;
+};
+
+static void frame_counters(struct result *r, const struct counters *before)
+{
+	const unsigned long *a = (const unsigned long *)&count;
+	const unsigned long *b = (const unsigned long *)before;
+	unsigned long *total = (unsigned long *)&r->total;
+	unsigned long *max = (unsigned long *)&r->max;
+	int i;
+
+	for (i = 0; i < sizeof(count) / sizeof(unsigned long); i++) {
+		unsigned long d = a[i] - b[i];
+
+		total[i] += d;
+		if (d > max[i])
+			max[i] = d;
+	}
+}
+
+static void run(const char *name, int width, int height, int igdng)
+{
+	static const int coding[] = { 1, 3, 3, 2 };	/* I B B P */
+	struct intel_xvmc_hw_context *hw;
+	struct intel_xvmc_surface priv[3];
+	XvMCSurface surfaces[3];
+	XvMCContext context;
+	XvMCQMatrix qmx;
+	struct result r;
+	int rows = height / 16;
+	int frame, i;
+
+	memset(&r, 0, sizeof(r));
+	memset(&count, 0, sizeof(count));
+	dumped_bytes = dumped_batches = 0;
+	slice_head = slice_tail = 0;
+
+	hw = calloc(1, sizeof(*hw));
+	hw->type = XVMC_I965_MPEG2_VLD;
+	hw->i965.is_igdng = igdng;
+
+	memset(&context, 0, sizeof(context));
+	context.width = width;
+	context.height = height;
+	if (xvmc_driver->create_context(NULL, &context, 0, (CARD32 *)hw)) {
+		fail("create_context failed");
+		return;
+	}
+
+	memset(priv, 0, sizeof(priv));
+	for (i = 0; i < 3; i++) {
+		priv[i].context = &context;
+		priv[i].bo = drm_intel_bo_alloc(&bufmgr, "surface",
+						width * height * 3 / 2, 4096);
+		surfaces[i].privData = &priv[i];
+	}
+
+	for (i = 0; i < 64; i++) {
+		qmx.intra_quantiser_matrix[i] = 8 + i;
+		qmx.non_intra_quantiser_matrix[i] = 16;
+	}
+
+	for (frame = 0; frame < FRAMES; frame++) {
+		XvMCMpegControl control;
+		XvMCSurface *target, *past = NULL, *future = NULL;
+		struct counters before = count;
+		int type = coding[frame % 4];
+
+		memset(&control, 0, sizeof(control));
+		control.picture_coding_type = type;
+		control.picture_structure = XVMC_FRAME_PICTURE;
+		control.intra_dc_precision = 1;
+		control.flags = XVMC_PRED_DCT_FRAME;
+		if (type != 1)
+			control.FHMV_range = control.FVMV_range = 3;
+		if (type == 3)
+			control.BHMV_range = control.BVMV_range = 3;
+
+		target = &surfaces[frame % 3];
+		if (type != 1)
+			past = &surfaces[(frame + 1) % 3];
+		if (type == 3)
+			future = &surfaces[(frame + 2) % 3];
+
+		if (xvmc_driver->load_qmatrix(NULL, &context, &qmx))
+			fail("load_qmatrix failed");
+		if (xvmc_driver->begin_surface(NULL, &context,
+					       target, past, future,
+					       &control))
+			fail("begin_surface failed");
+
+		for (i = 0; i < rows; i++) {
+			/* intra pictures have larger slices */
+			int len = 64 + rand() % (type == 1 ? 4096 : 1024);
+
+			put_slice(&context, i, len);
+		}
+
+		if (xvmc_driver->flush_surface(NULL, &context))
+			fail("flush_surface failed");
+
+		frame_counters(&r, &before);
+	}
+
+	if (slice_head != slice_tail)
+		fail("slices put but never submitted");
+
+	xvmc_driver->destroy_context(NULL, &context);
+
+	if (dumped_batches != count.execs ||
+	    dumped_bytes != count.batch_bytes)
+		fail("the frame statistics disagree with the batches executed");
+
+	for (i = 0; i < 3; i++)
+		drm_intel_bo_unreference(priv[i].bo);
+
+	printf("%-10s %6d %6.1f %3lu %8.0f %6lu %8.0f %6.1f %6.1f %8.0f\n",
+	       name, rows,
+	       (double)r.total.execs / FRAMES, r.max.execs,
+	       (double)r.total.batch_bytes / FRAMES, r.max.batch_bytes,
+	       (double)r.total.subdata_bytes / FRAMES,
+	       (double)r.total.allocs / FRAMES,
+	       (double)r.total.relocs / FRAMES,
+	       (double)r.total.slice_bytes / FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seed = argc > 1 ? atoi(argv[1]) : 1;
+
+	printf("seed %u\n", seed);
+	srand(seed);
+
+	xvmc_driver = &xvmc_vld_driver;
+	xvmc_driver->bufmgr = &bufmgr;
+	if (!intelInitBatchBuffer()) {
+		printf("no batch buffer\n");
+		return 1;
+	}
+
+	printf("per frame, over %d frames:\n", FRAMES);
+	printf("%-10s %6s %6s %3s %8s %6s %8s %6s %6s %8s\n",
+	       "", "slices", "execs", "max", "batch", "max",
+	       "subdata", "allocs", "relocs", "slice");
+	run("gen4 SD", 720, 576, 0);
+	run("gen5 SD", 720, 576, 1);
+	run("gen4 HD", 1920, 1088, 0);
+	run("gen5 HD", 1920, 1088, 1);
+
+	intelFiniBatchBuffer();
+	if (live_bos)
+		fail("buffers leaked");
+
+	if (failures)
+		printf("%d failures\n", failures);
+	return failures != 0;
+}